@@ -27,4 +27,7 @@ fi
 cd build
 cmake -DCMAKE_BUILD_TYPE="$BUILD_TARGET" "${@:1}" ../
 make -j 4
-mv ../res/ ./
+#The build keeps its own copy of res, beside the models and textures
+#converted into it
+mkdir -p ./res
+cp -R ../res/. ./res/
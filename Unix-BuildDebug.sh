@@ -17,4 +17,7 @@
 cd build
 cmake -DCMAKE_BUILD_TYPE="Debug" ../
 make -j 4
-mv ../res/ ./
+#The build keeps its own copy of res, beside the models and textures
+#converted into it
+mkdir -p ./res
+cp -R ../res/. ./res/
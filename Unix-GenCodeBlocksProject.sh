@@ -25,4 +25,7 @@ fi
 cd build
 cmake -DCMAKE_BUILD_TYPE="$BUILD_TARGET" -G "CodeBlocks - Unix Makefiles" ../
 
-mv ../res/ ./
+#The build keeps its own copy of res, beside the models and textures
+#converted into it
+mkdir -p ./res
+cp -R ../res/. ./res/
@@ -12,6 +12,5 @@
 :: See the License for the specific language governing permissions and
 :: limitations under the License.
 
-move build\res res
 rmdir build /s /q
 mkdir build
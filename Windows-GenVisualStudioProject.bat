@@ -18,4 +18,4 @@ mkdir Debug
 mkdir Release
 copy ..\lib\_bin\ Debug
 copy ..\lib\_bin\ Release
-move ..\res res
+xcopy ..\res res /E /I /Y
@@ -15,6 +15,8 @@
  */
 
 #include "common.glh"
+#include "uniformBlocks.glh"
+#include "forwardmaterial.glh"
 
 varying vec2 texCoord0;
 varying vec3 worldPos0;
@@ -23,20 +25,26 @@ varying mat3 tbnMatrix;
 #if defined(VS_BUILD)
 attribute vec3 position;
 attribute vec2 texCoord;
-attribute vec3 normal;
-attribute vec3 tangent;
+attribute vec2 normal;
+attribute vec2 tangent;
 
+#if defined(INSTANCED)
+attribute mat4 T_model;
+#define MVP (T_viewProjection * T_model)
+#else
 uniform mat4 T_model;
 uniform mat4 T_MVP;
+#define MVP T_MVP
+#endif
 
 void main()
 {
-    gl_Position = T_MVP * vec4(position, 1.0);
+    gl_Position = MVP * vec4(position, 1.0);
     texCoord0 = texCoord; 
     worldPos0 = (T_model * vec4(position, 1.0)).xyz;
     
-    vec3 n = normalize((T_model * vec4(normal, 0.0)).xyz);
-    vec3 t = normalize((T_model * vec4(tangent, 0.0)).xyz);
+    vec3 n = normalize((T_model * vec4(DecodeOctahedral(normal), 0.0)).xyz);
+    vec3 t = normalize((T_model * vec4(DecodeOctahedral(tangent), 0.0)).xyz);
     t = normalize(t - dot(t, n) * n);
     
     vec3 biTangent = cross(t, n);
@@ -46,13 +54,9 @@ void main()
 #include "sampling.glh"
 
 uniform vec3 R_ambient;
-uniform vec3 C_eyePos;
 uniform sampler2D diffuse;
 uniform sampler2D dispMap;
 
-uniform float dispMapScale;
-uniform float dispMapBias;
-
 DeclareFragOutput(0, vec4);
 void main()
 {
@@ -15,25 +15,40 @@
  */
 
 #include "common.glh"
+#include "uniformBlocks.glh"
+#include "forwardmaterial.glh"
 #include "forwardlighting.glh"
+#include "lighting.glh"
+
+layout(std140) uniform LightBlock
+{
+    DirectionalLight R_directionalLight;
+    mat4 R_worldLightMatrix;
+    float R_shadowVarianceMin;
+    float R_shadowLightBleedingReduction;
+    vec3 R_shadowMapTile;
+    float R_shadowCascadeScale1;
+    vec3 R_shadowCascadeOffset1;
+    vec3 R_shadowCascadeTile1;
+    float R_shadowCascadeScale2;
+    vec3 R_shadowCascadeOffset2;
+    vec3 R_shadowCascadeTile2;
+    float R_shadowCascadeScale3;
+    vec3 R_shadowCascadeOffset3;
+    vec3 R_shadowCascadeTile3;
+    vec3 R_shadowCascadeSplits;
+};
 
 #if defined(VS_BUILD)
 #include "forwardlighting.vsh"
 #elif defined(FS_BUILD)
 
-#include "lighting.glh"
-
-uniform vec3 C_eyePos;
-uniform float specularIntensity;
-uniform float specularPower;
-
-uniform DirectionalLight R_directionalLight;
-
 vec4 CalcLightingEffect(vec3 normal, vec3 worldPos)
 {
 	return CalcLight(R_directionalLight.base, -R_directionalLight.direction, normal, worldPos,
 	                 specularIntensity, specularPower, C_eyePos);
 }
 
+#define SHADOW_CASCADES
 #include "lightingMain.fsh"
 #endif
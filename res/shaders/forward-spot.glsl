@@ -15,20 +15,24 @@
  */
 
 #include "common.glh"
+#include "uniformBlocks.glh"
+#include "forwardmaterial.glh"
 #include "forwardlighting.glh"
+#include "lighting.glh"
+
+layout(std140) uniform LightBlock
+{
+    SpotLight R_spotLight;
+    mat4 R_worldLightMatrix;
+    float R_shadowVarianceMin;
+    float R_shadowLightBleedingReduction;
+    vec3 R_shadowMapTile;
+};
 
 #if defined(VS_BUILD)
 #include "forwardlighting.vsh"
 #elif defined(FS_BUILD)
 
-#include "lighting.glh"
-
-uniform vec3 C_eyePos;
-uniform float specularIntensity;
-uniform float specularPower;
-
-uniform SpotLight R_spotLight;
-
 vec4 CalcLightingEffect(vec3 normal, vec3 worldPos)
 {
 	vec3 lightDirection = normalize(worldPos - R_spotLight.pointLight.position);
@@ -16,6 +16,7 @@
  */
 
 #include "common.glh"
+#include "uniformBlocks.glh"
 
 varying vec2 TexCoords;
 varying vec3 WorldPos;
@@ -24,25 +25,34 @@ varying mat3 TBN;
 #if defined(VS_BUILD)
 attribute vec3 position;
 attribute vec2 texCoord;
-attribute vec3 normal;
-attribute vec3 tangent;
+attribute vec2 normal;
+attribute vec2 tangent;
 
+#if defined(INSTANCED)
+attribute mat4 T_model;
+#define MVP (T_viewProjection * T_model)
+#else
 uniform mat4 T_model;
 uniform mat4 T_MVP;
+#define MVP T_MVP
+#endif
 
 void main()
 {
     TexCoords = texCoord;
     WorldPos = vec3(T_model * vec4(position, 1.0));
-    vec3 N = mat3(T_model) * normal;
-    vec3 T = mat3(T_model) * tangent;
+    vec3 N = mat3(T_model) * DecodeOctahedral(normal);
+    vec3 T = mat3(T_model) * DecodeOctahedral(tangent);
     vec3 B = cross(N, T);
     TBN = mat3(T, B, N);
 
-    gl_Position = T_MVP * vec4(position, 1.0);
+    gl_Position = MVP * vec4(position, 1.0);
 }
 
 #elif defined(FS_BUILD)
+
+#include "irradianceSH.glh"
+
 DeclareFragOutput(0, vec4);
 
 uniform sampler2D albedoMap;
@@ -51,12 +61,9 @@ uniform sampler2D metallicMap;
 uniform sampler2D roughnessMap;
 uniform sampler2D aoMap;
 
-uniform samplerCube E_irradianceMap;
 uniform samplerCube E_prefilterMap;
 uniform sampler2D E_brdfLUT;
 
-uniform vec3 C_eyePos;
-
 float DistributionGGX(vec3 N, vec3 H, float roughness)
 {
     float a = roughness*roughness;
@@ -105,7 +112,7 @@ vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
 void main()
 {
     vec3 albedo = pow(texture(albedoMap, TexCoords).rgb, vec3(2.2));
-    vec3 normal = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
+    vec3 normal = DecodeNormalMap(texture(normalMap, TexCoords));
     float metallic = texture(metallicMap, TexCoords).r;
     float roughness = texture(roughnessMap, TexCoords).r;
     float ao = texture(aoMap, TexCoords).r;
@@ -123,7 +130,7 @@ void main()
     vec3 Kd = 1.0 - Ks;
     Kd *= 1.0 - metallic;
 
-    vec3 irradiance = texture(E_irradianceMap, N).rgb;
+    vec3 irradiance = CalcIrradianceSH(N);
     vec3 diffuse      = irradiance * albedo;
 
     const float MAX_REFLECTION_LOD = 4.0;
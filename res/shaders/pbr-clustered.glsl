@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ * Copyright (C) 2017 Xin Song
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//Shades every point light in one pass. The rendering engine sorts the lights
+//into clusters of the view each frame, and each pixel only adds up the lights
+//listed for the cluster it's in.
+
+#include "common.glh"
+#include "uniformBlocks.glh"
+
+varying vec2 TexCoords;
+varying vec3 WorldPos;
+varying mat3 TBN;
+
+#if defined(VS_BUILD)
+attribute vec3 position;
+attribute vec2 texCoord;
+attribute vec2 normal;
+attribute vec2 tangent;
+
+#if defined(INSTANCED)
+attribute mat4 T_model;
+#define MVP (T_viewProjection * T_model)
+#else
+uniform mat4 T_model;
+uniform mat4 T_MVP;
+#define MVP T_MVP
+#endif
+
+void main()
+{
+    TexCoords = texCoord;
+    WorldPos = vec3(T_model * vec4(position, 1.0));
+    vec3 N = mat3(T_model) * DecodeOctahedral(normal);
+    vec3 T = mat3(T_model) * DecodeOctahedral(tangent);
+    vec3 B = cross(N, T);
+    TBN = mat3(T, B, N);
+
+    gl_Position = MVP * vec4(position, 1.0);
+}
+
+#elif defined(FS_BUILD)
+
+#include "pbr.glh"
+
+DeclareFragOutput(0, vec4);
+
+uniform sampler2D albedoMap;
+uniform sampler2D normalMap;
+uniform sampler2D metallicMap;
+uniform sampler2D roughnessMap;
+
+//Each light is 3 texels: position and range, color, then attenuation.
+uniform samplerBuffer R_clusterLights;
+//Each cluster is 2 texels: where its lights start in the light indices, then how many there are.
+uniform usamplerBuffer R_clusterGrid;
+uniform usamplerBuffer R_clusterLightIndices;
+uniform vec3 R_clusterTileScale;   //Tiles per pixel
+uniform vec3 R_clusterCounts;      //Tiles across, tiles down, and depth slices
+uniform float R_clusterSliceScale;
+uniform float R_clusterSliceBias;
+
+int CalcCluster()
+{
+    ivec3 counts = ivec3(R_clusterCounts);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * R_clusterTileScale.xy), counts.xy - 1);
+
+    float depth = max((T_view * vec4(WorldPos, 1.0)).z, 0.0001);
+    int slice = int(clamp(floor(log(depth) * R_clusterSliceScale + R_clusterSliceBias), 0.0, float(counts.z - 1)));
+
+    return (slice * counts.y + tile.y) * counts.x + tile.x;
+}
+
+void main()
+{
+    vec3 V = normalize(C_eyePos - WorldPos);
+
+    vec3 albedo = pow(texture(albedoMap, TexCoords).rgb, vec3(2.2));
+    vec3 normal = DecodeNormalMap(texture(normalMap, TexCoords));
+    float metallic = texture(metallicMap, TexCoords).r;
+    float roughness = texture(roughnessMap, TexCoords).r;
+
+    vec3 N = normalize(TBN * normal);
+
+    vec3 F0 = vec3(0.04);
+    F0 = mix(F0, albedo, metallic);
+
+    int cluster = CalcCluster();
+    int firstLight = int(texelFetch(R_clusterGrid, cluster * 2).r);
+    int numLights = int(texelFetch(R_clusterGrid, cluster * 2 + 1).r);
+
+    vec3 Lo = vec3(0.0);
+    for(int i = 0; i < numLights; i++)
+    {
+        int light = int(texelFetch(R_clusterLightIndices, firstLight + i).r);
+        vec4 positionAndRange = texelFetch(R_clusterLights, light * 3);
+        vec3 color = texelFetch(R_clusterLights, light * 3 + 1).rgb;
+        vec3 atten = texelFetch(R_clusterLights, light * 3 + 2).xyz;
+
+        float distance = length(positionAndRange.xyz - WorldPos);
+        if(distance < positionAndRange.w)
+        {
+            vec3 L = normalize(positionAndRange.xyz - WorldPos);
+            vec3 H = normalize(V + L);
+            float attenuation = atten.x + atten.y * distance + atten.z * distance * distance + 0.0001;
+            vec3 radiance = color / attenuation;
+            float NDF = DistributionGGX(N, H, roughness);
+            float G = GeometrySmith(N, V, L, roughness);
+            vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
+
+            vec3 nominator = NDF * G * F;
+            float denominator = 4 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.001;
+            vec3 specular = nominator / denominator;
+
+            vec3 Ks = F;
+            vec3 Kd = vec3(1.0) - Ks;
+            Kd = Kd * (1.0 - metallic);
+
+            float NdotL = max(dot(N, L), 0.0);
+
+            Lo += (Kd * albedo / PI + specular) * radiance * NdotL;
+        }
+    }
+
+    SetFragOutput(0, vec4(Lo, 1));
+}
+#endif
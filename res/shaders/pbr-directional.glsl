@@ -16,6 +16,27 @@
  */
 
 #include "common.glh"
+#include "uniformBlocks.glh"
+#include "lighting.glh"
+
+layout(std140) uniform LightBlock
+{
+    DirectionalLight R_directionalLight;
+    mat4 R_worldLightMatrix;
+    float R_shadowVarianceMin;
+    float R_shadowLightBleedingReduction;
+    vec3 R_shadowMapTile;
+    float R_shadowCascadeScale1;
+    vec3 R_shadowCascadeOffset1;
+    vec3 R_shadowCascadeTile1;
+    float R_shadowCascadeScale2;
+    vec3 R_shadowCascadeOffset2;
+    vec3 R_shadowCascadeTile2;
+    float R_shadowCascadeScale3;
+    vec3 R_shadowCascadeOffset3;
+    vec3 R_shadowCascadeTile3;
+    vec3 R_shadowCascadeSplits;
+};
 
 varying vec2 TexCoords;
 varying vec3 WorldPos;
@@ -25,30 +46,38 @@ varying mat3 TBN;
 #if defined(VS_BUILD)
 attribute vec3 position;
 attribute vec2 texCoord;
-attribute vec3 normal;
-attribute vec3 tangent;
-
+attribute vec2 normal;
+attribute vec2 tangent;
+
+#if defined(INSTANCED)
+attribute mat4 T_model;
+#define MVP (T_viewProjection * T_model)
+#define LIGHT_MATRIX (R_worldLightMatrix * T_model)
+#else
 uniform mat4 T_model;
 uniform mat4 T_MVP;
 uniform mat4 R_lightMatrix;
+#define MVP T_MVP
+#define LIGHT_MATRIX R_lightMatrix
+#endif
 
 void main()
 {
     TexCoords = texCoord;
-    ShadowMapCoords = R_lightMatrix * vec4(position, 1.0);
+    ShadowMapCoords = LIGHT_MATRIX * vec4(position, 1.0);
     WorldPos = vec3(T_model * vec4(position, 1.0));
-    vec3 N = mat3(T_model) * normal;
-    vec3 T = mat3(T_model) * tangent;
+    vec3 N = mat3(T_model) * DecodeOctahedral(normal);
+    vec3 T = mat3(T_model) * DecodeOctahedral(tangent);
     vec3 B = cross(N, T);
     TBN = mat3(T, B, N);
 
-    gl_Position = T_MVP * vec4(position, 1.0);
+    gl_Position = MVP * vec4(position, 1.0);
 }
 
 #elif defined(FS_BUILD)
 
-#include "lighting.glh"
 #include "sampling.glh"
+#include "shadowCascades.glh"
 
 DeclareFragOutput(0, vec4);
 
@@ -57,12 +86,7 @@ uniform sampler2D normalMap;
 uniform sampler2D metallicMap;
 uniform sampler2D roughnessMap;
 
-uniform vec3 C_eyePos;
-
-uniform DirectionalLight R_directionalLight;
 uniform sampler2D R_shadowMap;
-uniform float R_shadowVarianceMin;
-uniform float R_shadowLightBleedingReduction;
 
 float DistributionGGX(vec3 N, vec3 H, float roughness)
 {
@@ -109,25 +133,6 @@ vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
     return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
-bool InRange(float val)
-{
-	return val >= 0.0 && val <= 1.0;
-}
-
-float CalcShadowAmount(sampler2D shadowMap, vec4 initialShadowMapCoords)
-{
-	vec3 shadowMapCoords = (initialShadowMapCoords.xyz/initialShadowMapCoords.w);
-
-	if(InRange(shadowMapCoords.z) && InRange(shadowMapCoords.x) && InRange(shadowMapCoords.y))
-	{
-		return SampleVarianceShadowMap(shadowMap, shadowMapCoords.xy, shadowMapCoords.z, R_shadowVarianceMin, R_shadowLightBleedingReduction);
-	}
-	else
-	{
-		return 1.0;
-	}
-}
-
 void main()
 {
     vec3 Lo = vec3(0.0);
@@ -135,7 +140,7 @@ void main()
     vec3 L = normalize(R_directionalLight.direction);
 
     vec3 albedo = pow(texture(albedoMap, TexCoords).rgb, vec3(2.2));
-    vec3 normal = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
+    vec3 normal = DecodeNormalMap(texture(normalMap, TexCoords));
     float metallic = texture(metallicMap, TexCoords).r;
     float roughness = texture(roughnessMap, TexCoords).r;
 
@@ -161,7 +166,7 @@ void main()
 
     float NdotL = max(dot(N, L), 0.0);
 
-    float shadow_amount = CalcShadowAmount(R_shadowMap, ShadowMapCoords);
+    float shadow_amount = CalcCascadedShadowAmount(R_shadowMap, ShadowMapCoords, WorldPos);
 
     Lo = (Kd * albedo / PI + specular) * radiance * NdotL * (shadow_amount);
 
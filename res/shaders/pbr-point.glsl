@@ -16,6 +16,13 @@
  */
 
 #include "common.glh"
+#include "uniformBlocks.glh"
+#include "lighting.glh"
+
+layout(std140) uniform LightBlock
+{
+    PointLight R_pointLight;
+};
 
 varying vec2 TexCoords;
 varying vec3 WorldPos;
@@ -24,27 +31,32 @@ varying mat3 TBN;
 #if defined(VS_BUILD)
 attribute vec3 position;
 attribute vec2 texCoord;
-attribute vec3 normal;
-attribute vec3 tangent;
+attribute vec2 normal;
+attribute vec2 tangent;
 
+#if defined(INSTANCED)
+attribute mat4 T_model;
+#define MVP (T_viewProjection * T_model)
+#else
 uniform mat4 T_model;
 uniform mat4 T_MVP;
+#define MVP T_MVP
+#endif
 
 void main()
 {
     TexCoords = texCoord;
     WorldPos = vec3(T_model * vec4(position, 1.0));
-    vec3 N = mat3(T_model) * normal;
-    vec3 T = mat3(T_model) * tangent;
+    vec3 N = mat3(T_model) * DecodeOctahedral(normal);
+    vec3 T = mat3(T_model) * DecodeOctahedral(tangent);
     vec3 B = cross(N, T);
     TBN = mat3(T, B, N);
 
-    gl_Position = T_MVP * vec4(position, 1.0);
+    gl_Position = MVP * vec4(position, 1.0);
 }
 
 #elif defined(FS_BUILD)
 
-#include "lighting.glh"
 #include "sampling.glh"
 
 DeclareFragOutput(0, vec4);
@@ -54,10 +66,6 @@ uniform sampler2D normalMap;
 uniform sampler2D metallicMap;
 uniform sampler2D roughnessMap;
 
-uniform vec3 C_eyePos;
-
-uniform PointLight R_pointLight;
-
 float DistributionGGX(vec3 N, vec3 H, float roughness)
 {
     float a = roughness*roughness;
@@ -118,7 +126,7 @@ void main()
         vec3 L = normalize(R_pointLight.position - WorldPos);
 
         vec3 albedo = pow(texture(albedoMap, TexCoords).rgb, vec3(2.2));
-        vec3 normal = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
+        vec3 normal = DecodeNormalMap(texture(normalMap, TexCoords));
         float metallic = texture(metallicMap, TexCoords).r;
         float roughness = texture(roughnessMap, TexCoords).r;
 
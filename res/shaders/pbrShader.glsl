@@ -25,8 +25,8 @@ varying vec3 Normal;
 #if defined(VS_BUILD)
 attribute vec3 position;
 attribute vec2 texCoord;
-attribute vec3 normal;
-attribute vec3 tangent;
+attribute vec2 normal;
+attribute vec2 tangent;
 
 //uniform mat4 T_projection;
 //uniform mat4 T_view;
@@ -38,12 +38,15 @@ void main()
 {
     TexCoords = texCoord;
     WorldPos = vec3(T_model * vec4(position, 1.0));
-    Normal = mat3(T_model) * normal;
+    Normal = mat3(T_model) * DecodeOctahedral(normal);
 
     gl_Position = T_MVP * vec4(position, 1.0);
 }
 
 #elif defined(FS_BUILD)
+
+#include "irradianceSH.glh"
+
 DeclareFragOutput(0, vec4);
 
 uniform sampler2D albedoMap;
@@ -52,7 +55,6 @@ uniform sampler2D metallicMap;
 uniform sampler2D roughnessMap;
 uniform sampler2D aoMap;
 
-uniform samplerCube E_irradianceMap;
 uniform samplerCube E_prefilterMap;
 uniform sampler2D E_brdfLUT;
 
@@ -60,7 +62,7 @@ uniform vec3 C_eyePos;
 
 vec3 getNormalFromMap()
 {
-    vec3 tangentNormal = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
+    vec3 tangentNormal = DecodeNormalMap(texture(normalMap, TexCoords));
 
     vec3 Q1  = dFdx(WorldPos);
     vec3 Q2  = dFdy(WorldPos);
@@ -186,7 +188,7 @@ void main()
     vec3 kD = 1.0 - kS;
     kD *= 1.0 - metallic;
 
-    vec3 irradiance = texture(E_irradianceMap, N).rgb;
+    vec3 irradiance = CalcIrradianceSH(N);
     vec3 diffuse      = irradiance * albedo;
 
     // sample both the pre-filter map and the BRDF lut and combine them together as per the Split-Sum approximation to get the IBL specular part.
@@ -15,15 +15,27 @@
  */
 
 #include "common.glh"
+#include "uniformBlocks.glh"
 
 #if defined(VS_BUILD)
 attribute vec3 position;
 
+#if defined(INSTANCED)
+//Unused, but attributes are numbered in the order they're declared, and T_model
+//must be at the same location as in every other shader.
+attribute vec2 texCoord;
+attribute vec2 normal;
+attribute vec2 tangent;
+attribute mat4 T_model;
+#define MVP (T_viewProjection * T_model)
+#else
 uniform mat4 T_MVP;
+#define MVP T_MVP
+#endif
 
 void main()
 {
-    gl_Position = T_MVP * vec4(position, 1.0);
+    gl_Position = MVP * vec4(position, 1.0);
 }
 #elif defined(FS_BUILD)
 DeclareFragOutput(0, vec4);
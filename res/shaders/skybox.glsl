@@ -16,14 +16,13 @@
  */
 
 #include "common.glh"
+#include "uniformBlocks.glh"
 
 varying vec3 texCoord0;
 
 #if defined(VS_BUILD)
 attribute vec3 position;
 
-uniform mat4 T_projection;
-uniform mat4 T_cameraRot;
 uniform mat4 T_model;
 
 void main()
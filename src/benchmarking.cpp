@@ -0,0 +1,141 @@
+#include "benchmarking.h"
+
+#include "physics/broadphase.h"
+#include "physics/physicsBodyStore.h"
+#include "physics/physicsEngine.h"
+#include "rendering/shader.h"
+#include "rendering/window.h"
+#include "rendering/renderingEngine.h"
+#include "rendering/lightClusters.h"
+#include "rendering/occlusionCuller.h"
+#include "rendering/potentiallyVisibleSet.h"
+#include "rendering/meshOptimizer.h"
+#include "rendering/objReader.h"
+#include "rendering/packedMesh.h"
+#include "rendering/compressedTexture.h"
+#include "core/profiling.h"
+#include "3DEngine.h"
+
+#include <GL/glew.h>
+
+#include <cmath>
+#include <sstream>
+
+//A floor with a grid of point lights over it, laid out the same way as the
+//test game's, so how whole frames scale with the light count can be measured.
+class LightingBenchmarkGame : public Game
+{
+public:
+	LightingBenchmarkGame(int numPointLights) :
+		m_numPointLights(numPointLights) {}
+
+	virtual void Init(const Window& window);
+private:
+	int m_numPointLights;
+};
+
+void LightingBenchmarkGame::Init(const Window& window)
+{
+	//Only models and textures that ship with the engine are used.
+	Material material("lightingBenchmark");
+	material.SetTexture("albedoMap", Texture("bricks.jpg"));
+	material.SetTexture("normalMap", Texture("bricks_normal.jpg"));
+	material.SetTexture("metallicMap", Texture("black.png"));
+	material.SetTexture("roughnessMap", Texture("white.png"));
+	material.SetTexture("aoMap", Texture("white.png"));
+
+	AddToScene((new Entity(Vector3f(0, 8, -14), Quaternion(Matrix4f().InitRotationEuler(ToRadians(30.0f), 0, 0)), 1))
+		->AddComponent(new CameraComponent(Matrix4f().InitPerspective(
+			ToRadians(70.0f), window.GetAspect(), 0.1f, 1000.0f))));
+
+	AddToScene((new Entity(Vector3f(0, 0, 0), Quaternion(), 1.25f))
+		->AddComponent(new MeshRenderer(Mesh("plane3.obj"), material)));
+
+	for(int i = 0; i < 9; i++)
+	{
+		AddToScene((new Entity(Vector3f((float)(i % 3 - 1) * 6.0f, 1, (float)(i / 3 - 1) * 6.0f)))
+			->AddComponent(new MeshRenderer(Mesh("monkey3.obj"), material)));
+	}
+
+	const float areaSize = 20.0f;
+	int lightsPerRow = (int)ceilf(sqrtf((float)m_numPointLights));
+	float spacing = areaSize / (float)lightsPerRow;
+	float range = spacing * 1.5f;
+	float intensity = (range * range) / 256.0f;
+
+	const Vector3f colors[] = { Vector3f(1,0.2f,0.2f), Vector3f(0.2f,1,0.2f), Vector3f(0.2f,0.2f,1), Vector3f(1,1,0.2f) };
+	for(int i = 0; i < m_numPointLights; i++)
+	{
+		float x = ((float)(i % lightsPerRow) + 0.5f) * spacing - areaSize / 2.0f;
+		float z = ((float)(i / lightsPerRow) + 0.5f) * spacing - areaSize / 2.0f;
+
+		AddToScene((new Entity(Vector3f(x, 1, z)))
+			->AddComponent(new PointLight(colors[i % 4], intensity, Attenuation(0,0,1))));
+	}
+}
+
+//Times whole frames, through to the GPU finishing them, rather than just the
+//CPU side binning LightClusters::Benchmark measures.
+static void BenchmarkLighting(Window* window)
+{
+	static const int NUM_WARMUP_FRAMES = 2;
+	static const int NUM_TIMED_FRAMES  = 10;
+
+	for(int count = 1; count <= 1024; count *= 4)
+	{
+		//Lights can't be taken out of a rendering engine, so each count gets a new one.
+		RenderingEngine renderingEngine(*window);
+		LightingBenchmarkGame game(count);
+		CoreEngine engine(60, window, &renderingEngine, &game);
+
+		for(int clustered = 1; clustered >= 0; clustered--)
+		{
+			renderingEngine.SetClusteredShading(clustered != 0);
+
+			ProfileTimer timer;
+			for(int i = 0; i < NUM_WARMUP_FRAMES + NUM_TIMED_FRAMES; i++)
+			{
+				game.Update(1.0f / 60.0f);
+				renderingEngine.UpdateSceneBounds();
+
+				if(i >= NUM_WARMUP_FRAMES)
+				{
+					timer.StartInvocation();
+				}
+				game.Render(&renderingEngine);
+				glFinish();
+				if(i >= NUM_WARMUP_FRAMES)
+				{
+					timer.StopInvocation();
+				}
+			}
+
+			std::ostringstream message;
+			message << "Lit frame (" << count << " point lights, " << (clustered ? "clustered" : "forward") << "): ";
+			timer.DisplayAndReset(message.str(), 0, 56);
+		}
+	}
+}
+
+void Benchmarking::RunAllBenchmarks()
+{
+	Broadphase::Benchmark();
+	PhysicsBodyStore::Benchmark();
+	PhysicsEngine::Benchmark();
+	LightClusters::Benchmark();
+	OcclusionCuller::Benchmark();
+	PotentiallyVisibleSet::Benchmark();
+	MeshOptimizer::Benchmark();
+	ObjReader::Benchmark();
+	PackedMesh::Benchmark();
+	CompressedTexture::Benchmark();
+	Profiler::Benchmark();
+
+	//The rest need an OpenGL context.
+	Window window(1280, 720, "Benchmark", true);
+	{
+		RenderingEngine renderingEngine(window);
+		Shader::Benchmark(renderingEngine);
+	}
+	BenchmarkLighting(&window);
+}
@@ -0,0 +1,9 @@
+#ifndef BENCHMARKING_INCLUDED_H
+#define BENCHMARKING_INCLUDED_H
+
+namespace Benchmarking
+{
+	void RunAllBenchmarks();
+};
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cameraPath.h"
+
+void CameraPath::Update(float delta)
+{
+	m_time += delta;
+
+	float angle = (float)(2.0 * MATH_PI) * (m_time / m_secondsPerLap);
+	Vector3f offset(sinf(angle) * m_radius, m_height, cosf(angle) * m_radius);
+
+	GetTransform()->SetPos(m_center + offset);
+	GetTransform()->LookAt(m_center, Vector3f(0, 1, 0));
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include "../core/math3d.h"
+#include "../core/entityComponent.h"
+
+//Flies its entity around a circle, always looking at the center. The path only
+//depends on how much time has been simulated, so headless benchmark runs see
+//exactly the same views every time.
+class CameraPath : public EntityComponent
+{
+public:
+	CameraPath(const Vector3f& center, float radius, float height, float secondsPerLap = 10.0f) :
+		m_center(center),
+		m_radius(radius),
+		m_height(height),
+		m_secondsPerLap(secondsPerLap),
+		m_time(0.0f) {}
+	
+	virtual void Update(float delta);
+protected:
+private:
+	Vector3f m_center;
+	float    m_radius;
+	float    m_height;        //Above the center
+	float    m_secondsPerLap;
+	float    m_time;          //Simulated time since the path started
+};
+
+#endif // CAMERAPATH_H
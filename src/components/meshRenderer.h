@@ -19,13 +19,20 @@
 
 #include "../core/entityComponent.h"
 #include "../rendering/mesh.h"
+#include "../rendering/material.h"
+#include "../rendering/shader.h"
 
 class MeshRenderer : public EntityComponent
 {
 public:
-	MeshRenderer(const Mesh& mesh, const Material& material) :
+	//Occluders are drawn into the rendering engine's occlusion culler, to hide
+	//anything behind them. They should be big, simple meshes, like walls.
+	MeshRenderer(const Mesh& mesh, const Material& material, bool isOccluder = false) :
 		m_mesh(mesh),
-		m_material(material) {}
+		m_material(material),
+		m_isOccluder(isOccluder),
+		m_renderingEngine(0) {}
+	virtual ~MeshRenderer();
 
 	virtual void Render(const Shader& shader, const RenderingEngine& renderingEngine, const Camera& camera) const
 	{
@@ -33,10 +40,18 @@ public:
 		shader.UpdateUniforms(GetTransform(), m_material, renderingEngine, camera);
 		m_mesh.Draw();
 	}
+
+	virtual void AddToEngine(CoreEngine* engine) const;
+
+	inline const Mesh& GetMesh()         const { return m_mesh; }
+	inline const Material& GetMaterial() const { return m_material; }
+	inline bool IsOccluder()             const { return m_isOccluder; }
 protected:
 private:
 	Mesh m_mesh;
 	Material m_material;
+	bool m_isOccluder;
+	mutable RenderingEngine* m_renderingEngine; //That this is drawn by, if any
 };
 
 #endif // MESHRENDERER_H_INCLUDED
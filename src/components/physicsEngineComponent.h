@@ -27,8 +27,11 @@
 class PhysicsEngineComponent : public EntityComponent
 {
 public:
-	PhysicsEngineComponent(const PhysicsEngine& engine) :
-		m_physicsEngine(engine) {}
+	PhysicsEngineComponent(const PhysicsEngine& engine, unsigned int numThreads = ThreadPool::GetNumCPUs()) :
+		m_physicsEngine(engine)
+	{
+		m_physicsEngine.SetNumThreads(numThreads);
+	}
 
 	virtual void Update(float delta);
 
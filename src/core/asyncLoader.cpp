@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "asyncLoader.h"
+#include "profiling.h"
+#include "referenceCounter.h"
+#include "threadPool.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cassert>
+
+AsyncLoader::AsyncLoader(unsigned int numThreads) :
+	m_mutex(SDL_CreateMutex()),
+	m_jobQueued(SDL_CreateCond()),
+	m_numRunning(0),
+	m_isShuttingDown(false)
+{
+	for(unsigned int i = 0; i < numThreads; i++)
+	{
+		SDL_Thread* worker = SDL_CreateThread(WorkerMain, "AsyncLoader", this);
+		assert(worker != 0);
+		m_workers.push_back(worker);
+	}
+}
+
+AsyncLoader::~AsyncLoader()
+{
+	SDL_LockMutex(m_mutex);
+	m_isShuttingDown = true;
+	SDL_CondBroadcast(m_jobQueued);
+	SDL_UnlockMutex(m_mutex);
+
+	//Workers finish whatever they're loading before they stop.
+	for(unsigned int i = 0; i < m_workers.size(); i++)
+	{
+		SDL_WaitThread(m_workers[i], 0);
+	}
+
+	std::deque<AsyncLoadJob*>* queues[4] = { &m_loadQueue, &m_prepareQueue, &m_fillQueue, &m_uploadQueue };
+	for(int i = 0; i < 4; i++)
+	{
+		for(unsigned int j = 0; j < queues[i]->size(); j++)
+		{
+			delete (*queues[i])[j];
+		}
+	}
+
+	SDL_DestroyCond(m_jobQueued);
+	SDL_DestroyMutex(m_mutex);
+}
+
+void AsyncLoader::Queue(AsyncLoadJob* job)
+{
+	SDL_LockMutex(m_mutex);
+	m_loadQueue.push_back(job);
+	SDL_CondSignal(m_jobQueued);
+	SDL_UnlockMutex(m_mutex);
+}
+
+void AsyncLoader::Update(unsigned int uploadBudget)
+{
+	//Without threads of its own, everything is loaded and filled here instead.
+	if(m_workers.empty())
+	{
+		while(!m_loadQueue.empty())
+		{
+			m_loadQueue.front()->Load();
+			m_prepareQueue.push_back(m_loadQueue.front());
+			m_loadQueue.pop_front();
+		}
+	}
+
+	for(;;)
+	{
+		SDL_LockMutex(m_mutex);
+		AsyncLoadJob* job = m_prepareQueue.empty() ? 0 : m_prepareQueue.front();
+		SDL_UnlockMutex(m_mutex);
+
+		if(job == 0)
+		{
+			break;
+		}
+
+		job->Prepare();
+		if(m_workers.empty())
+		{
+			job->Fill();
+		}
+
+		SDL_LockMutex(m_mutex);
+		m_prepareQueue.pop_front();
+		(m_workers.empty() ? m_uploadQueue : m_fillQueue).push_back(job);
+		SDL_CondSignal(m_jobQueued);
+		SDL_UnlockMutex(m_mutex);
+	}
+
+	//Workers only ever add to the back of the upload queue, so the job at the
+	//front can be uploaded without holding the lock.
+	while(uploadBudget > 0)
+	{
+		SDL_LockMutex(m_mutex);
+		AsyncLoadJob* job = m_uploadQueue.empty() ? 0 : m_uploadQueue.front();
+		SDL_UnlockMutex(m_mutex);
+
+		if(job == 0 || !job->Upload(&uploadBudget))
+		{
+			break;
+		}
+
+		SDL_LockMutex(m_mutex);
+		m_uploadQueue.pop_front();
+		SDL_UnlockMutex(m_mutex);
+		delete job;
+	}
+}
+
+unsigned int AsyncLoader::GetNumPending() const
+{
+	SDL_LockMutex(m_mutex);
+	unsigned int numPending = (unsigned int)(m_loadQueue.size() + m_prepareQueue.size() + m_fillQueue.size() + m_uploadQueue.size()) +
+		m_numRunning;
+	SDL_UnlockMutex(m_mutex);
+	return numPending;
+}
+
+int AsyncLoader::WorkerMain(void* data)
+{
+	AsyncLoader* loader = (AsyncLoader*)data;
+
+	SDL_LockMutex(loader->m_mutex);
+	for(;;)
+	{
+		while(!loader->m_isShuttingDown && loader->m_loadQueue.empty() && loader->m_fillQueue.empty())
+		{
+			SDL_CondWait(loader->m_jobQueued, loader->m_mutex);
+		}
+		
+		if(loader->m_isShuttingDown)
+		{
+			break;
+		}
+
+		//Jobs that are further along go first, so what they've mapped is
+		//uploaded and freed as soon as it can be.
+		bool isFilling = !loader->m_fillQueue.empty();
+		std::deque<AsyncLoadJob*>& queue = isFilling ? loader->m_fillQueue : loader->m_loadQueue;
+		AsyncLoadJob* job = queue.front();
+		queue.pop_front();
+		loader->m_numRunning++;
+		SDL_UnlockMutex(loader->m_mutex);
+
+		if(isFilling)
+		{
+			ProfileZone zone("Async Fill");
+			job->Fill();
+		}
+		else
+		{
+			ProfileZone zone("Async Load");
+			job->Load();
+		}
+
+		SDL_LockMutex(loader->m_mutex);
+		loader->m_numRunning--;
+		(isFilling ? loader->m_uploadQueue : loader->m_prepareQueue).push_back(job);
+	}
+	SDL_UnlockMutex(loader->m_mutex);
+	return 0;
+}
+
+//What the test jobs did, each recording the threads it was loaded, prepared
+//and filled on under its own id.
+struct TestLoadResults
+{
+	std::vector<int>          uploadedPieces;
+	std::vector<SDL_threadID> loadThreads;
+	std::vector<SDL_threadID> prepareThreads;
+	std::vector<SDL_threadID> fillThreads;
+	int                       numDeleted;
+};
+
+//Uploads in pieces of PIECE_SIZE bytes, noting which job each piece came from.
+class TestLoadJob : public AsyncLoadJob
+{
+public:
+	static const unsigned int PIECE_SIZE = 100;
+
+	TestLoadJob(int id, unsigned int numPieces, TestLoadResults* results) :
+		m_id(id),
+		m_numPieces(numPieces),
+		m_numUploaded(0),
+		m_stage(0),
+		m_results(results) {}
+	virtual ~TestLoadJob() { m_results->numDeleted++; }
+
+	virtual void Load()
+	{
+		assert(m_stage == 0);
+		m_results->loadThreads[m_id] = SDL_ThreadID();
+		m_stage = 1;
+	}
+
+	virtual void Prepare()
+	{
+		assert(m_stage == 1);
+		m_results->prepareThreads[m_id] = SDL_ThreadID();
+		m_stage = 2;
+	}
+
+	virtual void Fill()
+	{
+		assert(m_stage == 2);
+		m_results->fillThreads[m_id] = SDL_ThreadID();
+		m_stage = 3;
+	}
+
+	virtual bool Upload(unsigned int* budget)
+	{
+		assert(m_stage == 3 && *budget > 0);
+		while(m_numUploaded < m_numPieces && *budget > 0)
+		{
+			*budget -= std::min(*budget, (unsigned int)PIECE_SIZE);
+			m_numUploaded++;
+			m_results->uploadedPieces.push_back(m_id);
+		}
+		return m_numUploaded == m_numPieces;
+	}
+private:
+	int              m_id;
+	unsigned int     m_numPieces;
+	unsigned int     m_numUploaded;
+	int              m_stage;       //How many of Load, Prepare and Fill have been called
+	TestLoadResults* m_results;
+};
+
+//Adds then removes a reference many times over for every index.
+class ReferenceCountTask : public ThreadPoolTask
+{
+public:
+	ReferenceCountTask(ReferenceCounter* counter) :
+		m_counter(counter) {}
+
+	virtual void Run(unsigned int index)
+	{
+		for(int i = 0; i < 10000; i++)
+		{
+			m_counter->AddReference();
+		}
+		for(int i = 0; i < 10000; i++)
+		{
+			m_counter->RemoveReference();
+		}
+	}
+private:
+	ReferenceCounter* m_counter;
+};
+
+void AsyncLoader::Test()
+{
+	//References counted from several threads at once all balance out.
+	ReferenceCounter counter;
+	ThreadPool threadPool(4);
+	ReferenceCountTask referenceCountTask(&counter);
+	threadPool.ParallelFor(&referenceCountTask, 8);
+	assert(counter.GetReferenceCount() == 1);
+	bool isLastReference = counter.RemoveReference();
+	assert(isLastReference);
+
+	for(unsigned int numThreads = 0; numThreads <= 2; numThreads++)
+	{
+		TestLoadResults results;
+		results.loadThreads.resize(12, 0);
+		results.prepareThreads.resize(12, 0);
+		results.fillThreads.resize(12, 0);
+		results.numDeleted = 0;
+		{
+			AsyncLoader loader(numThreads);
+			for(int i = 0; i < 8; i++)
+			{
+				loader.Queue(new TestLoadJob(i, 3, &results));
+			}
+			
+			//Every update uploads no more than the budget, rounded up to a
+			//whole piece.
+			const unsigned int uploadBudget = 250;
+			for(int i = 0; i < 10000 && loader.GetNumPending() > 0; i++)
+			{
+				unsigned int numPiecesBefore = (unsigned int)results.uploadedPieces.size();
+				loader.Update(uploadBudget);
+				assert(results.uploadedPieces.size() - numPiecesBefore <= 3);
+				Util::Sleep(1);
+			}
+			assert(loader.GetNumPending() == 0 && results.numDeleted == 8);
+
+			//Each job is uploaded completely before the next is started. It's
+			//prepared on the thread calling Update, and loaded and filled on the
+			//loader's own threads when it has any.
+			assert(results.uploadedPieces.size() == 24);
+			for(unsigned int i = 0; i < results.uploadedPieces.size(); i += 3)
+			{
+				assert(results.uploadedPieces[i] == results.uploadedPieces[i + 1] &&
+					results.uploadedPieces[i] == results.uploadedPieces[i + 2]);
+			}
+			std::vector<int> sortedPieces(results.uploadedPieces);
+			std::sort(sortedPieces.begin(), sortedPieces.end());
+			for(int i = 0; i < 24; i++)
+			{
+				assert(sortedPieces[i] == i / 3);
+			}
+			for(int i = 0; i < 8; i++)
+			{
+				assert((results.loadThreads[i] == SDL_ThreadID()) == (numThreads == 0));
+				assert((results.fillThreads[i] == SDL_ThreadID()) == (numThreads == 0));
+				assert(results.prepareThreads[i] == SDL_ThreadID());
+			}
+
+			//Jobs still waiting when the loader is destroyed are deleted with it.
+			for(int i = 8; i < 12; i++)
+			{
+				loader.Queue(new TestLoadJob(i, 1, &results));
+			}
+		}
+		assert(results.numDeleted == 12);
+	}
+}
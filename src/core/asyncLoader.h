@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef ASYNCLOADER_H_INCLUDED
+#define ASYNCLOADER_H_INCLUDED
+
+#include <SDL2/SDL.h>
+#include <deque>
+#include <vector>
+
+//Loading a resource, split into the parts that can run on any thread, like
+//reading and decoding files, and the parts that need the OpenGL context. Each
+//is called once, in order, except Upload.
+class AsyncLoadJob
+{
+public:
+	virtual ~AsyncLoadJob() {}
+
+	//Called on one of the loader's threads. Reads in enough to know how much
+	//there'll be to upload.
+	virtual void Load() = 0;
+	//Called on the thread calling AsyncLoader::Update, to map whatever Fill
+	//writes into, like a pixel unpack buffer.
+	virtual void Prepare() {}
+	//Called on one of the loader's threads, to decode or copy what was loaded
+	//into what Prepare mapped.
+	virtual void Fill() {}
+	//Called on the thread calling AsyncLoader::Update, in every Update until it
+	//returns true. *budget is how many more bytes may be uploaded this frame,
+	//and should be lowered by however many were.
+	virtual bool Upload(unsigned int* budget) = 0;
+};
+
+//Runs the loading part of jobs on threads of its own, and uploads the results
+//a little each frame, so loading never holds up the thread that draws.
+class AsyncLoader
+{
+public:
+	AsyncLoader(unsigned int numThreads = 1);
+	//Jobs that haven't finished are deleted without being uploaded.
+	virtual ~AsyncLoader();
+
+	//Takes ownership of job, which is deleted once it's been uploaded. Thread safe.
+	void Queue(AsyncLoadJob* job);
+	//Prepares jobs that have been loaded, so they can be filled, then uploads
+	//jobs that have been filled, in the order they were, until uploadBudget
+	//bytes have been uploaded. Whatever is being uploaded when the budget runs
+	//out is carried on with first next time.
+	void Update(unsigned int uploadBudget);
+
+	//Jobs that have been queued but not completely uploaded.
+	unsigned int GetNumPending() const;
+
+	static void Test();
+protected:
+private:
+	std::vector<SDL_Thread*>  m_workers;
+	SDL_mutex*                m_mutex;
+	SDL_cond*                 m_jobQueued;
+	std::deque<AsyncLoadJob*> m_loadQueue;    //Queued, and not yet picked up by a worker
+	std::deque<AsyncLoadJob*> m_prepareQueue; //Loaded, and waiting to be prepared
+	std::deque<AsyncLoadJob*> m_fillQueue;    //Prepared, and not yet picked up by a worker
+	std::deque<AsyncLoadJob*> m_uploadQueue;  //Filled, and waiting to be uploaded
+	unsigned int              m_numRunning;   //Picked up by a worker, but not loaded or filled yet
+	bool                      m_isShuttingDown;
+
+	static int WorkerMain(void* data);
+
+	AsyncLoader(const AsyncLoader& other) {}
+	void operator=(const AsyncLoader& other) {}
+};
+
+#endif // ASYNCLOADER_H_INCLUDED
@@ -22,6 +22,8 @@
 #include "game.h"
 
 #include <stdio.h>
+#include <fstream>
+#include <vector>
 
 CoreEngine::CoreEngine(double frameRate, Window* window, RenderingEngine* renderingEngine, Game* game) :
 	m_isRunning(false),
@@ -54,9 +56,10 @@ void CoreEngine::Start()
 	double unprocessedTime = 0;        //Amount of passed time that the engine hasn't accounted for
 	int frames = 0;                    //Number of frames rendered since last
 
-	ProfileTimer sleepTimer;
-	ProfileTimer swapBufferTimer;
-	ProfileTimer windowUpdateTimer;
+	ProfileTimer sleepTimer("Sleep");
+	ProfileTimer swapBufferTimer("Swap Buffers");
+	ProfileTimer windowUpdateTimer("Window Update");
+	ProfileTimer frameTimer("Frame");  //Only recorded as a zone, as the total time is already displayed
 	while(m_isRunning)
 	{
 		bool render = false;           //Whether or not the game needs to be rerendered.
@@ -78,6 +81,7 @@ void CoreEngine::Start()
 			totalMeasuredTime += m_game->DisplayInputTime((double)frames);
 			totalMeasuredTime += m_game->DisplayUpdateTime((double)frames);
 			totalMeasuredTime += m_renderingEngine->DisplayRenderTime((double)frames);
+			m_renderingEngine->DisplayDrawStats((double)frames);
 			totalMeasuredTime += sleepTimer.DisplayAndReset("Sleep Time: ", (double)frames);
 			totalMeasuredTime += windowUpdateTimer.DisplayAndReset("Window Update Time: ", (double)frames);
 			totalMeasuredTime += swapBufferTimer.DisplayAndReset("Buffer Swap Time: ", (double)frames);
@@ -89,6 +93,13 @@ void CoreEngine::Start()
 			frameCounter = 0;
 		}
 
+		//Frames where nothing is updated or rendered are just spent sleeping,
+		//and don't count as a frame in any of the stats.
+		if(unprocessedTime > m_frameTime)
+		{
+			frameTimer.StartInvocation();
+		}
+
 		//The engine works on a fixed update system, where each update is 1/frameRate seconds of time.
 		//Because of this, there can be a situation where there is, for instance, a fixed update of 16ms, 
 		//but 20ms of actual time has passed. To ensure all time is accounted for, all passed time is
@@ -111,6 +122,7 @@ void CoreEngine::Start()
 			//afterwards.
 			m_game->ProcessInput(m_window->GetInput(), (float)m_frameTime);
 			m_game->Update((float)m_frameTime);
+			m_renderingEngine->UpdateSceneBounds();
 			
 			//Since any updates can put onscreen objects in a new place, the flag
 			//must be set to rerender the scene.
@@ -128,6 +140,7 @@ void CoreEngine::Start()
 			swapBufferTimer.StartInvocation();
 			m_window->SwapBuffers();
 			swapBufferTimer.StopInvocation();
+			frameTimer.StopInvocation();
 			frames++;
 		}
 		else
@@ -146,3 +159,85 @@ void CoreEngine::Stop()
 	m_isRunning = false;
 }
 
+void CoreEngine::RunFrames(int numFrames, const std::string& reportFileName, bool writeChecksums)
+{
+	std::ofstream report(reportFileName.c_str());
+	if(!report)
+	{
+		fprintf(stderr, "Error: Could not open %s for writing\n", reportFileName.c_str());
+		return;
+	}
+	
+	report << "frame,window_update_ms,input_ms,update_ms,render_ms,window_sync_ms,swap_ms,frame_ms";
+	if(writeChecksums)
+	{
+		report << ",checksum";
+	}
+	report << "\n";
+	
+	ProfileTimer swapBufferTimer("Swap Buffers");
+	ProfileTimer windowUpdateTimer("Window Update");
+	ProfileTimer frameTimer("Frame");
+	std::vector<unsigned char> pixels;
+	
+	//Anything timed before now, like loading the game, shouldn't count towards the first frame.
+	m_game->GetInputTimeAndReset();
+	m_game->GetUpdateTimeAndReset();
+	m_renderingEngine->GetRenderTimeAndReset();
+	m_renderingEngine->GetWindowSyncTimeAndReset();
+	
+	m_isRunning = true;
+	for(int frame = 0; frame < numFrames && m_isRunning; frame++)
+	{
+		frameTimer.StartInvocation();
+		double startTime = Time::GetTime();
+		
+		windowUpdateTimer.StartInvocation();
+		m_window->Update();
+		windowUpdateTimer.StopInvocation();
+		
+		m_game->ProcessInput(m_window->GetInput(), (float)m_frameTime);
+		m_game->Update((float)m_frameTime);
+		m_renderingEngine->UpdateSceneBounds();
+		m_game->Render(m_renderingEngine);
+		
+		double frameTime = Time::GetTime() - startTime;
+		
+		//The image has to be read before the buffers are swapped, after which
+		//the back buffer's contents are undefined.
+		unsigned int checksum = 0;
+		if(writeChecksums)
+		{
+			ProfileZone zone("Read Pixels");
+			m_window->ReadPixels(&pixels);
+			checksum = Util::CalcChecksum(&pixels[0], (unsigned int)pixels.size());
+		}
+		
+		swapBufferTimer.StartInvocation();
+		m_window->SwapBuffers();
+		swapBufferTimer.StopInvocation();
+		frameTimer.StopInvocation();
+		
+		double swapTime = swapBufferTimer.GetTimeAndReset();
+		frameTime = (1000.0 * frameTime) + swapTime;
+		
+		report << frame << ","
+			<< windowUpdateTimer.GetTimeAndReset() << ","
+			<< m_game->GetInputTimeAndReset() << ","
+			<< m_game->GetUpdateTimeAndReset() << ","
+			<< m_renderingEngine->GetRenderTimeAndReset() << ","
+			<< m_renderingEngine->GetWindowSyncTimeAndReset() << ","
+			<< swapTime << ","
+			<< frameTime;
+		
+		if(writeChecksums)
+		{
+			char checksumText[9];
+			sprintf(checksumText, "%08x", checksum);
+			report << "," << checksumText;
+		}
+		report << "\n";
+	}
+	
+	m_isRunning = false;
+}
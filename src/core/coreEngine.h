@@ -31,6 +31,13 @@ public:
 	void Start(); //Starts running the game; contains central game loop.
 	void Stop();  //Stops running the game, and disables all subsystems.
 	
+	//Runs exactly numFrames frames as fast as possible, each simulating one fixed
+	//update, so every run sees the same frames however fast the machine is. The
+	//CPU time each part of every frame took is written to reportFileName as CSV.
+	//If writeChecksums is set, each frame's image is read back and a checksum
+	//of it written as well, which stalls on the GPU but isn't counted in the times.
+	void RunFrames(int numFrames, const std::string& reportFileName, bool writeChecksums);
+	
 	inline RenderingEngine* GetRenderingEngine() { return m_renderingEngine; }
 protected:
 private:
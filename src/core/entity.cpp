@@ -49,6 +49,13 @@ Entity* Entity::AddComponent(EntityComponent* component)
 {
 	m_components.push_back(component);
 	component->SetParent(this);
+
+	//Components added after the entity joined the engine still need to tell
+	//the engine about themselves.
+	if(m_coreEngine)
+	{
+		component->AddToEngine(m_coreEngine);
+	}
 	return this;
 }
 
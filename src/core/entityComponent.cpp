@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "entityComponent.h"
+#include "coreEngine.h"
+
+EntityComponent::~EntityComponent()
+{
+	if(m_renderingEngine)
+	{
+		m_renderingEngine->RemoveUnculledComponent(*this);
+	}
+}
+
+void EntityComponent::AddToEngine(CoreEngine* engine) const
+{
+	if(m_renderingEngine)
+	{
+		m_renderingEngine->RemoveUnculledComponent(*this);
+	}
+	m_renderingEngine = engine->GetRenderingEngine();
+	m_renderingEngine->AddUnculledComponent(*this);
+}
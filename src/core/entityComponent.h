@@ -27,14 +27,17 @@ class EntityComponent
 {
 public:
 	EntityComponent() :
-		m_parent(0) {}
-	virtual ~EntityComponent() {}
+		m_parent(0),
+		m_renderingEngine(0) {}
+	virtual ~EntityComponent();
 
 	virtual void ProcessInput(const Input& input, float delta) {}
 	virtual void Update(float delta) {}
 	virtual void Render(const Shader& shader, const RenderingEngine& renderingEngine, const Camera& camera) const {}
 	
-	virtual void AddToEngine(CoreEngine* engine) const { }
+	//By default, components are drawn in every pass, without being culled.
+	//Components the rendering engine culls itself, like MeshRenderer, override this.
+	virtual void AddToEngine(CoreEngine* engine) const;
 	
 	inline Transform* GetTransform()             { return m_parent->GetTransform(); }
 	inline const Transform& GetTransform() const { return *m_parent->GetTransform(); }
@@ -42,6 +45,7 @@ public:
 	virtual void SetParent(Entity* parent) { m_parent = parent; }
 private:
 	Entity* m_parent;
+	mutable RenderingEngine* m_renderingEngine; //That this is an unculled component of, if any
 	
 	EntityComponent(const EntityComponent& other) {}
 	void operator=(const EntityComponent& other) {}
@@ -24,7 +24,9 @@
 class Game
 {
 public:
-	Game() {}
+	Game() :
+		m_updateTimer("Update"),
+		m_inputTimer("Input") {}
 	virtual ~Game() {}
 
 	virtual void Init(const Window& window) {}
@@ -34,6 +36,8 @@ public:
 	
 	inline double DisplayInputTime(double dividend) { return m_inputTimer.DisplayAndReset("Input Time: ", dividend); }
 	inline double DisplayUpdateTime(double dividend) { return m_updateTimer.DisplayAndReset("Update Time: ", dividend); }
+	inline double GetInputTimeAndReset() { return m_inputTimer.GetTimeAndReset(); }
+	inline double GetUpdateTimeAndReset() { return m_updateTimer.GetTimeAndReset(); }
 	
 	inline void SetEngine(CoreEngine* engine) { m_root.SetEngine(engine); }
 protected:
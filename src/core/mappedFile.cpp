@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mappedFile.h"
+
+#if defined(WIN32) || defined(_WIN32)
+	#include <Windows.h>
+
+	MappedFile::MappedFile(const std::string& fileName) :
+		m_data(0),
+		m_size(0),
+		m_file(INVALID_HANDLE_VALUE),
+		m_mapping(0)
+	{
+		m_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+		if(m_file == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+
+		LARGE_INTEGER size;
+		if(!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+		{
+			return;
+		}
+
+		m_mapping = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+		if(m_mapping)
+		{
+			m_data = (const unsigned char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+			m_size = m_data ? (size_t)size.QuadPart : 0;
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if(m_data)
+		{
+			UnmapViewOfFile(m_data);
+		}
+		if(m_mapping)
+		{
+			CloseHandle(m_mapping);
+		}
+		if(m_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_file);
+		}
+	}
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+
+	MappedFile::MappedFile(const std::string& fileName) :
+		m_data(0),
+		m_size(0)
+	{
+		int file = open(fileName.c_str(), O_RDONLY);
+		if(file < 0)
+		{
+			return;
+		}
+
+		struct stat status;
+		if(fstat(file, &status) == 0 && status.st_size > 0)
+		{
+			void* data = mmap(0, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+			if(data != MAP_FAILED)
+			{
+				m_data = (const unsigned char*)data;
+				m_size = (size_t)status.st_size;
+			}
+		}
+
+		//The mapping keeps the file open by itself.
+		close(file);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if(m_data)
+		{
+			munmap((void*)m_data, m_size);
+		}
+	}
+#endif
+
+void MappedFile::Prefetch(const unsigned char* data, size_t size)
+{
+	//Volatile, so the reads aren't optimized away for never being used.
+	const size_t pageSize = 4096;
+	volatile unsigned char sum = 0;
+	for(size_t i = 0; i < size; i += pageSize)
+	{
+		sum += data[i];
+	}
+	if(size > 0)
+	{
+		sum += data[size - 1];
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAPPEDFILE_H_INCLUDED
+#define MAPPEDFILE_H_INCLUDED
+
+#include <string>
+
+//A whole file mapped read only into memory, so it can be read in place
+//without copying it into a buffer first. The contents stay valid until the
+//MappedFile is destroyed.
+class MappedFile
+{
+public:
+	MappedFile(const std::string& fileName);
+	virtual ~MappedFile();
+
+	//False if the file couldn't be opened or mapped. Empty files can't be
+	//mapped either.
+	inline bool IsOpen() const { return m_data != 0; }
+	//Page aligned, so anything at an aligned offset in the file is aligned in memory.
+	inline const unsigned char* GetData() const { return m_data; }
+	inline size_t GetSize() const { return m_size; }
+
+	//Reads every page of part of a mapping, so it's been read from the disk
+	//before anything that mustn't wait, like the rendering thread, touches it.
+	static void Prefetch(const unsigned char* data, size_t size);
+protected:
+private:
+	const unsigned char* m_data;
+	size_t               m_size;
+#if defined(WIN32) || defined(_WIN32)
+	void*                m_file;
+	void*                m_mapping;
+#endif
+
+	MappedFile(const MappedFile& other) {}
+	void operator=(const MappedFile& other) {}
+};
+
+#endif // MAPPEDFILE_H_INCLUDED
@@ -16,9 +16,25 @@
 
 #include "mappedValues.h"
 
-const Vector3f& MappedValues::GetVector3f(const std::string& name) const
+unsigned int MappedValues::GetNameId(const std::string& name)
 {
-	std::map<std::string, Vector3f>::const_iterator it = m_vector3fMap.find(name);
+	//Function local so that it exists before any static MappedValues.
+	static std::map<std::string, unsigned int> nameIds;
+
+	std::map<std::string, unsigned int>::const_iterator it = nameIds.find(name);
+	if(it != nameIds.end())
+	{
+		return it->second;
+	}
+
+	unsigned int nameId = (unsigned int)nameIds.size();
+	nameIds.insert(std::pair<std::string, unsigned int>(name, nameId));
+	return nameId;
+}
+
+const Vector3f& MappedValues::GetVector3f(unsigned int nameId) const
+{
+	std::map<unsigned int, Vector3f>::const_iterator it = m_vector3fMap.find(nameId);
 	if(it != m_vector3fMap.end())
 	{
 		return it->second;
@@ -27,9 +43,9 @@ const Vector3f& MappedValues::GetVector3f(const std::string& name) const
 	return m_defaultVector3f;
 }
 
-float MappedValues::GetFloat(const std::string& name) const
+float MappedValues::GetFloat(unsigned int nameId) const
 {
-	std::map<std::string, float>::const_iterator it = m_floatMap.find(name);
+	std::map<unsigned int, float>::const_iterator it = m_floatMap.find(nameId);
 	if(it != m_floatMap.end())
 	{
 		return it->second;
@@ -38,9 +54,9 @@ float MappedValues::GetFloat(const std::string& name) const
 	return 0;
 }
 
-const Texture& MappedValues::GetTexture(const std::string& name) const
+const Texture& MappedValues::GetTexture(unsigned int nameId) const
 {
-	std::map<std::string, Texture>::const_iterator it = m_textureMap.find(name);
+	std::map<unsigned int, Texture>::const_iterator it = m_textureMap.find(nameId);
 	if(it != m_textureMap.end())
 	{
 		return it->second;
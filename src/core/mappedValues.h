@@ -28,19 +28,31 @@ public:
 	MappedValues() :
 		m_defaultTexture(Texture("defaultTexture.png")),
 		m_defaultVector3f(Vector3f(0,0,0)) {}
+	virtual ~MappedValues() {}
 
-	inline void SetVector3f(const std::string& name, const Vector3f& value) { m_vector3fMap[name] = value; }
-	inline void SetFloat(const std::string& name, float value)              { m_floatMap[name] = value; }
-	inline void SetTexture(const std::string& name, const Texture& value)   { m_textureMap[name] = value; }
+	//Every name is given a small id the first time it's seen, which stays the
+	//same for the rest of the program. Looking values up by id avoids comparing
+	//strings, so it's what anything that runs every frame should use.
+	static unsigned int GetNameId(const std::string& name);
+
+	//Virtual so anything keeping its own copy of the values, like a material's
+	//uniform buffer, sees every change however it's made.
+	virtual void SetVector3f(const std::string& name, const Vector3f& value) { m_vector3fMap[GetNameId(name)] = value; }
+	virtual void SetFloat(const std::string& name, float value)              { m_floatMap[GetNameId(name)] = value; }
+	inline void SetTexture(const std::string& name, const Texture& value)   { m_textureMap[GetNameId(name)] = value; }
 	
-	const Vector3f& GetVector3f(const std::string& name) const;
-	float GetFloat(const std::string& name)              const;
-	const Texture& GetTexture(const std::string& name)   const;
+	inline const Vector3f& GetVector3f(const std::string& name) const { return GetVector3f(GetNameId(name)); }
+	inline float GetFloat(const std::string& name)              const { return GetFloat(GetNameId(name)); }
+	inline const Texture& GetTexture(const std::string& name)   const { return GetTexture(GetNameId(name)); }
+
+	const Vector3f& GetVector3f(unsigned int nameId) const;
+	float GetFloat(unsigned int nameId)              const;
+	const Texture& GetTexture(unsigned int nameId)   const;
 protected:
 private:
-	std::map<std::string, Vector3f> m_vector3fMap;
-	std::map<std::string, float> m_floatMap;
-	std::map<std::string, Texture> m_textureMap;
+	std::map<unsigned int, Vector3f> m_vector3fMap;
+	std::map<unsigned int, float> m_floatMap;
+	std::map<unsigned int, Texture> m_textureMap;
 	
 	Texture m_defaultTexture;
 	Vector3f m_defaultVector3f;
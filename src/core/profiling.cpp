@@ -16,11 +16,343 @@
 
 #include "profiling.h"
 #include "timing.h"
+#include <SDL2/SDL.h>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <map>
+
+#if defined(_MSC_VER)
+	#define THREAD_LOCAL __declspec(thread)
+#else
+	#define THREAD_LOCAL __thread
+#endif
+
+//The zones of one thread. Only that thread adds to it, so the only thing
+//that needs to be atomic is the count, which tells readers how much is there.
+class ZoneBuffer
+{
+public:
+	ZoneBuffer(int thread, unsigned int capacity) :
+		m_zones(capacity),
+		m_thread(thread),
+		m_depth(0)
+	{
+		assert((capacity & (capacity - 1)) == 0);
+		SDL_AtomicSet(&m_numAdded, 0);
+	}
+	
+	inline int GetThread() const { return m_thread; }
+	inline int PushDepth()       { return m_depth++; }
+	inline void PopDepth()       { m_depth--; }
+	
+	void Add(const Profiler::Zone& zone)
+	{
+		unsigned int index = (unsigned int)SDL_AtomicGet(&m_numAdded);
+		m_zones[index & (m_zones.size() - 1)] = zone;
+		
+		//The zone must be written before anyone can see it's there.
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&m_numAdded, (int)(index + 1));
+	}
+	
+	void Get(std::vector<Profiler::Zone>* zones) const
+	{
+		unsigned int numAdded = (unsigned int)SDL_AtomicGet((SDL_atomic_t*)&m_numAdded);
+		SDL_MemoryBarrierAcquire();
+		
+		unsigned int first = numAdded > m_zones.size() ? numAdded - (unsigned int)m_zones.size() : 0;
+		for(unsigned int i = first; i < numAdded; i++)
+		{
+			zones->push_back(m_zones[i & (m_zones.size() - 1)]);
+		}
+	}
+private:
+	std::vector<Profiler::Zone> m_zones;
+	SDL_atomic_t                m_numAdded;
+	int                         m_thread;
+	int                         m_depth;
+	
+	ZoneBuffer(const ZoneBuffer& other) {}
+	void operator=(const ZoneBuffer& other) {}
+};
+
+static void* s_zoneBuffers[Profiler::MAX_THREADS]; //Set once by their thread, then never change
+static SDL_atomic_t s_numZoneBuffers;
+static THREAD_LOCAL ZoneBuffer* s_threadZoneBuffer = 0;
+
+//Buffers are created the first time a thread adds a zone, and live until
+//the program exits, so the zones can still be read after the thread ends.
+static ZoneBuffer* GetThreadZoneBuffer()
+{
+	if(s_threadZoneBuffer == 0)
+	{
+		int thread = SDL_AtomicAdd(&s_numZoneBuffers, 1);
+		if(thread >= Profiler::MAX_THREADS)
+		{
+			return 0;
+		}
+		
+		s_threadZoneBuffer = new ZoneBuffer(thread, Profiler::ZONES_PER_THREAD);
+		SDL_AtomicSetPtr(&s_zoneBuffers[thread], s_threadZoneBuffer);
+	}
+	
+	return s_threadZoneBuffer;
+}
+
+int Profiler::BeginZone()
+{
+	#if PROFILING_DISABLE_ZONES == 0
+		ZoneBuffer* buffer = GetThreadZoneBuffer();
+		if(buffer != 0)
+		{
+			return buffer->PushDepth();
+		}
+	#endif
+	
+	return 0;
+}
+
+void Profiler::EndZone(const char* name, double startTime, double endTime, int depth)
+{
+	#if PROFILING_DISABLE_ZONES == 0
+		ZoneBuffer* buffer = GetThreadZoneBuffer();
+		if(buffer == 0)
+		{
+			return;
+		}
+		
+		buffer->PopDepth();
+		
+		Zone zone;
+		zone.name = name;
+		zone.startTime = startTime;
+		zone.endTime = endTime;
+		zone.depth = depth;
+		zone.thread = buffer->GetThread();
+		buffer->Add(zone);
+	#endif
+}
+
+void Profiler::GetZones(std::vector<Zone>* zones)
+{
+	for(int i = 0; i < MAX_THREADS; i++)
+	{
+		ZoneBuffer* buffer = (ZoneBuffer*)SDL_AtomicGetPtr(&s_zoneBuffers[i]);
+		if(buffer != 0)
+		{
+			buffer->Get(zones);
+		}
+	}
+}
+
+//The smallest value that at least fraction of the values are no bigger than.
+//Values must be sorted.
+static double CalcPercentile(const std::vector<double>& values, double fraction)
+{
+	int index = (int)ceil(fraction * (double)values.size()) - 1;
+	index = std::max(0, std::min(index, (int)values.size() - 1));
+	return values[index];
+}
+
+void Profiler::CalcZoneStats(const std::vector<Zone>& zones, std::vector<ZoneStats>* stats)
+{
+	//Zones are grouped by the text of the name, as the same name can be at
+	//different addresses in different translation units.
+	std::map<std::string, std::vector<double> > durations;
+	for(unsigned int i = 0; i < zones.size(); i++)
+	{
+		durations[zones[i].name].push_back(1000.0 * (zones[i].endTime - zones[i].startTime));
+	}
+	
+	stats->clear();
+	for(std::map<std::string, std::vector<double> >::iterator it = durations.begin(); it != durations.end(); ++it)
+	{
+		std::vector<double>& values = it->second;
+		std::sort(values.begin(), values.end());
+		
+		double total = 0.0;
+		for(unsigned int i = 0; i < values.size(); i++)
+		{
+			total += values[i];
+		}
+		
+		ZoneStats zoneStats;
+		zoneStats.name = it->first;
+		zoneStats.count = (int)values.size();
+		zoneStats.mean = total / (double)values.size();
+		zoneStats.p50 = CalcPercentile(values, 0.50);
+		zoneStats.p95 = CalcPercentile(values, 0.95);
+		zoneStats.p99 = CalcPercentile(values, 0.99);
+		zoneStats.max = values.back();
+		stats->push_back(zoneStats);
+	}
+}
+
+static void WriteJSONString(std::ostream& out, const char* text)
+{
+	out << '"';
+	for(const char* c = text; *c != 0; c++)
+	{
+		if(*c == '"' || *c == '\\')
+		{
+			out << '\\';
+		}
+		out << *c;
+	}
+	out << '"';
+}
+
+bool Profiler::WriteChromeTrace(const std::string& fileName)
+{
+	std::ofstream out(fileName.c_str());
+	if(!out)
+	{
+		return false;
+	}
+	
+	std::vector<Zone> zones;
+	GetZones(&zones);
+	
+	//Trace times are in microseconds, and are kept small so they don't lose
+	//precision when printed.
+	double firstTime = 0.0;
+	for(unsigned int i = 0; i < zones.size(); i++)
+	{
+		if(i == 0 || zones[i].startTime < firstTime)
+		{
+			firstTime = zones[i].startTime;
+		}
+	}
+	
+	out.precision(3);
+	out << std::fixed;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for(unsigned int i = 0; i < zones.size(); i++)
+	{
+		out << (i == 0 ? "\n" : ",\n") << "{\"name\":";
+		WriteJSONString(out, zones[i].name);
+		out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << zones[i].thread
+			<< ",\"ts\":" << (1000000.0 * (zones[i].startTime - firstTime))
+			<< ",\"dur\":" << (1000000.0 * (zones[i].endTime - zones[i].startTime))
+			<< ",\"args\":{\"depth\":" << zones[i].depth << "}}";
+	}
+	out << "\n]}\n";
+	
+	return (bool)out;
+}
+
+bool Profiler::WriteZoneStats(const std::string& fileName)
+{
+	std::ofstream out(fileName.c_str());
+	if(!out)
+	{
+		return false;
+	}
+	
+	std::vector<Zone> zones;
+	std::vector<ZoneStats> stats;
+	GetZones(&zones);
+	CalcZoneStats(zones, &stats);
+	
+	out << "zone,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+	for(unsigned int i = 0; i < stats.size(); i++)
+	{
+		out << stats[i].name << "," << stats[i].count << "," << stats[i].mean << "," << stats[i].p50 << ","
+			<< stats[i].p95 << "," << stats[i].p99 << "," << stats[i].max << "\n";
+	}
+	
+	return (bool)out;
+}
+
+void Profiler::Test()
+{
+	//Once full, the buffer keeps only the newest zones, oldest first.
+	ZoneBuffer buffer(3, 4);
+	for(int i = 0; i < 6; i++)
+	{
+		Zone zone;
+		zone.name = "Test";
+		zone.startTime = (double)i;
+		zone.endTime = (double)i + 0.5;
+		zone.depth = 0;
+		zone.thread = buffer.GetThread();
+		buffer.Add(zone);
+	}
+	
+	std::vector<Zone> zones;
+	buffer.Get(&zones);
+	assert(zones.size() == 4);
+	for(unsigned int i = 0; i < zones.size(); i++)
+	{
+		assert(zones[i].startTime == (double)(i + 2));
+		assert(zones[i].depth == 0 && zones[i].thread == 3);
+	}
+	
+	//100 zones taking 1 to 100 ms, plus one elsewhere, in no particular order.
+	zones.clear();
+	for(int i = 0; i < 100; i++)
+	{
+		Zone zone;
+		zone.name = "B";
+		zone.startTime = 10.0;
+		zone.endTime = 10.0 + (double)((i * 37) % 100 + 1) / 1000.0;
+		zone.depth = 1;
+		zone.thread = 0;
+		zones.push_back(zone);
+	}
+	Zone other = zones[0];
+	other.name = "A";
+	other.endTime = other.startTime + 0.25;
+	zones.push_back(other);
+	
+	std::vector<ZoneStats> stats;
+	CalcZoneStats(zones, &stats);
+	assert(stats.size() == 2);
+	assert(stats[0].name == "A" && stats[0].count == 1);
+	assert(fabs(stats[0].p50 - 250.0) < 0.001 && fabs(stats[0].p99 - 250.0) < 0.001);
+	assert(stats[1].name == "B" && stats[1].count == 100);
+	assert(fabs(stats[1].mean - 50.5) < 0.001);
+	assert(fabs(stats[1].p50 - 50.0) < 0.001);
+	assert(fabs(stats[1].p95 - 95.0) < 0.001);
+	assert(fabs(stats[1].p99 - 99.0) < 0.001);
+	assert(fabs(stats[1].max - 100.0) < 0.001);
+}
+
+void Profiler::Benchmark()
+{
+	const int numZones = 1000000;
+	
+	double startTime = Time::GetTime();
+	for(int i = 0; i < numZones; i++)
+	{
+		ProfileZone zone("Benchmark Zone");
+	}
+	double zoneTime = Time::GetTime() - startTime;
+	
+	printf("Profile zone cost:                      %f ns\n", 1000000000.0 * zoneTime / (double)numZones);
+}
+
+ProfileZone::ProfileZone(const char* name) :
+	m_name(name),
+	m_depth(Profiler::BeginZone()),
+	m_startTime(Time::GetTime()) {}
+
+ProfileZone::~ProfileZone()
+{
+	Profiler::EndZone(m_name, m_startTime, Time::GetTime(), m_depth);
+}
 
 void ProfileTimer::StartInvocation()
 {
+	if(m_zoneName != 0)
+	{
+		m_zoneDepth = Profiler::BeginZone();
+	}
+	
 	m_startTime = Time::GetTime();
 }
 
@@ -32,8 +364,14 @@ void ProfileTimer::StopInvocation()
 		assert(m_startTime != 0);
 	}
 	
+	double endTime = Time::GetTime();
+	if(m_zoneName != 0)
+	{
+		Profiler::EndZone(m_zoneName, m_startTime, endTime, m_zoneDepth);
+	}
+	
 	m_numInvocations++;
-	m_totalTime += (Time::GetTime() - m_startTime);
+	m_totalTime += (endTime - m_startTime);
 	m_startTime = 0;
 }
 
@@ -47,15 +385,33 @@ double ProfileTimer::GetTimeAndReset(double divisor)
 	return result;
 }
 
-double ProfileTimer::DisplayAndReset(const std::string& message, double divisor, int displayedMessageLength)
+static std::string GetPadding(const std::string& message, int displayedMessageLength)
 {
 	std::string whiteSpace = "";
 	for(int i = message.length(); i < displayedMessageLength; i++)
 	{
 		whiteSpace += " ";
 	}
-	
+	return whiteSpace;
+}
+
+double ProfileTimer::DisplayAndReset(const std::string& message, double divisor, int displayedMessageLength)
+{
 	double time = GetTimeAndReset(divisor);
-	std::cout << message << whiteSpace << time << " ms" << std::endl;
+	std::cout << message << GetPadding(message, displayedMessageLength) << time << " ms" << std::endl;
 	return time;
 }
+
+double ProfileCounter::GetCountAndReset(double divisor)
+{
+	double result = (divisor == 0) ? (double)m_count : (double)m_count / divisor;
+	m_count = 0;
+	return result;
+}
+
+double ProfileCounter::DisplayAndReset(const std::string& message, double divisor, int displayedMessageLength)
+{
+	double count = GetCountAndReset(divisor);
+	std::cout << message << GetPadding(message, displayedMessageLength) << count << std::endl;
+	return count;
+}
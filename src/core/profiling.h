@@ -18,19 +18,92 @@
 #define PROFILING_H_INCLUDED
 
 #include <string>
+#include <vector>
 
 #define PROFILING_DISABLE_MESH_DRAWING 0
 #define PROFILING_DISABLE_SHADING 0
 #define PROFILING_SET_1x1_VIEWPORT 0
 #define PROFILING_SET_2x2_TEXTURE 0
+#define PROFILING_DISABLE_ZONES 0
+
+//Records every zone, a named span of time on one thread, so individual slow
+//frames can be found rather than just averages. Each thread writes to its own
+//ring buffer without locking, and when one fills up the oldest zones are lost.
+//Zones nest, so a zone started inside another is drawn inside it in a trace.
+class Profiler
+{
+public:
+	enum
+	{
+		MAX_THREADS       = 32,      //Zones on threads after this many are ignored
+		ZONES_PER_THREAD  = 1 << 16  //Must be a power of 2
+	};
+
+	struct Zone
+	{
+		const char* name;      //Must outlive the profiler, so is normally a string literal
+		double      startTime; //In seconds, from Time::GetTime
+		double      endTime;
+		int         depth;     //How many zones this one is inside
+		int         thread;    //Index of the thread's buffer, not an OS thread ID
+	};
+
+	//Times are in milliseconds.
+	struct ZoneStats
+	{
+		std::string name;
+		int         count;
+		double      mean;
+		double      p50;
+		double      p95;
+		double      p99;
+		double      max;
+	};
+
+	//Returns the depth of the new zone, which must be passed to EndZone.
+	static int BeginZone();
+	static void EndZone(const char* name, double startTime, double endTime, int depth);
+
+	//These read every thread's buffer, so should only be used when no other
+	//threads are adding zones.
+	static void GetZones(std::vector<Zone>* zones);
+	//Writes the zones in Chrome's trace event format, for chrome://tracing or Perfetto.
+	static bool WriteChromeTrace(const std::string& fileName);
+	//Writes the stats of every zone name as CSV.
+	static bool WriteZoneStats(const std::string& fileName);
+
+	//One entry for each name, sorted by name.
+	static void CalcZoneStats(const std::vector<Zone>& zones, std::vector<ZoneStats>* stats);
+
+	static void Test();
+	static void Benchmark();
+};
+
+//Adds a zone covering the rest of the scope it's declared in.
+class ProfileZone
+{
+public:
+	ProfileZone(const char* name);
+	~ProfileZone();
+private:
+	const char* m_name;
+	int         m_depth;
+	double      m_startTime;
+
+	ProfileZone(const ProfileZone& other) {}
+	void operator=(const ProfileZone& other) {}
+};
 
 class ProfileTimer
 {
 public:
-	ProfileTimer() :
+	//Each invocation of a timer with a zone name is also recorded as a zone.
+	ProfileTimer(const char* zoneName = 0) :
 		m_numInvocations(0),
 		m_totalTime(0.0),
-		m_startTime(0) {}
+		m_startTime(0),
+		m_zoneName(zoneName),
+		m_zoneDepth(0) {}
 
 	void StartInvocation();
 	void StopInvocation();
@@ -42,6 +115,26 @@ private:
 	int    m_numInvocations;
 	double m_totalTime;
 	double m_startTime;
+	const char* m_zoneName;
+	int    m_zoneDepth;
+};
+
+//Counts how often something happens, like draw calls, and displays it the
+//same way ProfileTimer displays times.
+class ProfileCounter
+{
+public:
+	ProfileCounter() :
+		m_count(0) {}
+
+	inline void Add(unsigned int amount = 1) { m_count += amount; }
+	inline unsigned int GetCount() const     { return m_count; }
+
+	//The count is divided by the divisor, unless it's 0.
+	double DisplayAndReset(const std::string& message, double divisor = 0, int displayedMessageLength = 40);
+	double GetCountAndReset(double divisor = 0);
+private:
+	unsigned int m_count;
 };
 
 #endif // PROFILING_H_INCLUDED
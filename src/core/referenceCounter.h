@@ -17,19 +17,22 @@
 #ifndef REFERENCECOUNTER_H
 #define REFERENCECOUNTER_H
 
+#include <SDL2/SDL_atomic.h>
+
+//The count is atomic, so references can be added and removed from any
+//thread, like the ones resources are streamed in on.
 class ReferenceCounter
 {
 public:
-	ReferenceCounter() :
-		m_refCount(1) {}
+	ReferenceCounter() { SDL_AtomicSet(&m_refCount, 1); }
 	
-	inline int GetReferenceCount() { return m_refCount; }
+	inline int GetReferenceCount() { return SDL_AtomicGet(&m_refCount); }
 	
-	inline void AddReference() { m_refCount++; }
-	inline bool RemoveReference() { m_refCount--; return m_refCount == 0; }
+	inline void AddReference() { SDL_AtomicIncRef(&m_refCount); }
+	inline bool RemoveReference() { return SDL_AtomicDecRef(&m_refCount); }
 protected:
 private:
-	int m_refCount;
+	SDL_atomic_t m_refCount;
 };
 
 #endif // REFERENCECOUNTER_H
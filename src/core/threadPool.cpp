@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "threadPool.h"
+#include <cassert>
+
+ThreadPool::ThreadPool(unsigned int numThreads) :
+	m_mutex(SDL_CreateMutex()),
+	m_workAvailable(SDL_CreateCond()),
+	m_workDone(SDL_CreateCond()),
+	m_task(0),
+	m_count(0),
+	m_generation(0),
+	m_numBusy(0),
+	m_isShuttingDown(false)
+{
+	SDL_AtomicSet(&m_nextIndex, 0);
+
+	for(unsigned int i = 1; i < numThreads; i++)
+	{
+		SDL_Thread* worker = SDL_CreateThread(WorkerMain, "ThreadPool", this);
+		assert(worker != 0);
+		m_workers.push_back(worker);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	SDL_LockMutex(m_mutex);
+	m_isShuttingDown = true;
+	SDL_CondBroadcast(m_workAvailable);
+	SDL_UnlockMutex(m_mutex);
+
+	for(unsigned int i = 0; i < m_workers.size(); i++)
+	{
+		SDL_WaitThread(m_workers[i], 0);
+	}
+
+	SDL_DestroyCond(m_workDone);
+	SDL_DestroyCond(m_workAvailable);
+	SDL_DestroyMutex(m_mutex);
+}
+
+void ThreadPool::ParallelFor(ThreadPoolTask* task, unsigned int count)
+{
+	if(m_workers.empty() || count <= 1)
+	{
+		for(unsigned int i = 0; i < count; i++)
+		{
+			task->Run(i);
+		}
+		return;
+	}
+
+	SDL_LockMutex(m_mutex);
+	m_task = task;
+	m_count = count;
+	SDL_AtomicSet(&m_nextIndex, 0);
+	m_numBusy = (unsigned int)m_workers.size();
+	m_generation++;
+	SDL_CondBroadcast(m_workAvailable);
+	SDL_UnlockMutex(m_mutex);
+
+	RunTasks();
+
+	//Every index has been handed out once RunTasks returns, but workers may
+	//still be finishing theirs.
+	SDL_LockMutex(m_mutex);
+	while(m_numBusy > 0)
+	{
+		SDL_CondWait(m_workDone, m_mutex);
+	}
+	m_task = 0;
+	SDL_UnlockMutex(m_mutex);
+}
+
+unsigned int ThreadPool::GetNumCPUs()
+{
+	int numCPUs = SDL_GetCPUCount();
+	return numCPUs > 0 ? (unsigned int)numCPUs : 1;
+}
+
+void ThreadPool::RunTasks()
+{
+	while(true)
+	{
+		unsigned int index = (unsigned int)SDL_AtomicAdd(&m_nextIndex, 1);
+		if(index >= m_count)
+		{
+			break;
+		}
+
+		m_task->Run(index);
+	}
+}
+
+int ThreadPool::WorkerMain(void* data)
+{
+	ThreadPool* pool = (ThreadPool*)data;
+
+	//Workers can start after work was already posted, so they compare against
+	//the generation the pool started with rather than whatever it is now.
+	unsigned int lastGeneration = 0;
+
+	SDL_LockMutex(pool->m_mutex);
+	while(true)
+	{
+		while(!pool->m_isShuttingDown && pool->m_generation == lastGeneration)
+		{
+			SDL_CondWait(pool->m_workAvailable, pool->m_mutex);
+		}
+
+		if(pool->m_isShuttingDown)
+		{
+			break;
+		}
+
+		lastGeneration = pool->m_generation;
+		SDL_UnlockMutex(pool->m_mutex);
+
+		pool->RunTasks();
+
+		SDL_LockMutex(pool->m_mutex);
+		pool->m_numBusy--;
+		if(pool->m_numBusy == 0)
+		{
+			SDL_CondSignal(pool->m_workDone);
+		}
+	}
+	SDL_UnlockMutex(pool->m_mutex);
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef THREADPOOL_H_INCLUDED
+#define THREADPOOL_H_INCLUDED
+
+#include "referenceCounter.h"
+#include <SDL2/SDL.h>
+#include <vector>
+
+//A piece of work that can be split into independent, numbered parts.
+class ThreadPoolTask
+{
+public:
+	virtual ~ThreadPoolTask() {}
+
+	//Called once for every index passed to ThreadPool::ParallelFor. May be
+	//called from any thread, so must only touch data belonging to that index.
+	virtual void Run(unsigned int index) = 0;
+};
+
+//A fixed set of worker threads that split up tasks between them. The thread
+//calling ParallelFor also does work, so a pool with N threads creates N - 1
+//workers.
+class ThreadPool : public ReferenceCounter
+{
+public:
+	ThreadPool(unsigned int numThreads);
+	virtual ~ThreadPool();
+
+	//Runs task->Run(i) for every i in [0, count), spread across all threads,
+	//and returns once every index has finished. Not reentrant.
+	void ParallelFor(ThreadPoolTask* task, unsigned int count);
+
+	inline unsigned int GetNumThreads() const { return (unsigned int)m_workers.size() + 1; }
+
+	//How many threads this machine can run at once.
+	static unsigned int GetNumCPUs();
+protected:
+private:
+	std::vector<SDL_Thread*> m_workers;
+	SDL_mutex*               m_mutex;
+	SDL_cond*                m_workAvailable;
+	SDL_cond*                m_workDone;
+
+	ThreadPoolTask*          m_task;
+	unsigned int             m_count;
+	SDL_atomic_t             m_nextIndex;
+	unsigned int             m_generation; //Incremented every time new work is posted
+	unsigned int             m_numBusy;    //Workers that haven't finished the current work
+	bool                     m_isShuttingDown;
+
+	void RunTasks();
+	static int WorkerMain(void* data);
+
+	ThreadPool(const ThreadPool& other) {}
+	void operator=(const ThreadPool& other) {}
+};
+
+#endif // THREADPOOL_H_INCLUDED
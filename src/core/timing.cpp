@@ -45,7 +45,7 @@
 
 #ifdef OS_OTHER_CPP11
 	#include <chrono>
-	static std::chrono::system_clock::time_point m_epoch = std::chrono::high_resolution_clock::now();
+	static std::chrono::steady_clock::time_point m_epoch = std::chrono::steady_clock::now();
 #endif
 
 double Time::GetTime()
@@ -69,13 +69,16 @@ double Time::GetTime()
 	#endif
 
 	#ifdef OS_LINUX
+		//Monotonic, so times can't jump when the system clock is changed. The
+		//seconds and nanoseconds are converted separately so the nanoseconds
+		//aren't rounded away once the total is too big for a double to hold exactly.
 		timespec ts;
-		clock_gettime(CLOCK_REALTIME, &ts);
-		return (double)(((long) ts.tv_sec * NANOSECONDS_PER_SECOND) + ts.tv_nsec)/((double)(NANOSECONDS_PER_SECOND));
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (double)ts.tv_sec + (double)ts.tv_nsec/((double)(NANOSECONDS_PER_SECOND));
 	#endif
 
 	#ifdef OS_OTHER_CPP11
-		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - m_epoch).count() / 1000000000.0;
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count() / 1000000000.0;
 	#endif
 
 	#ifdef OS_OTHER
@@ -16,7 +16,7 @@
 
 #include "transform.h"
 
-bool Transform::HasChanged()
+bool Transform::HasChanged() const
 {	
 	if(m_parent != 0 && m_parent->HasChanged())
 	{
@@ -33,7 +33,7 @@ bool Transform::HasChanged()
 		return true;
 	}
 	
-	if(m_scale != m_scale)
+	if(m_scale != m_oldScale)
 	{
 		return true;
 	}
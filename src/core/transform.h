@@ -31,7 +31,7 @@ public:
 		m_initializedOldStuff(false) {}
 
 	Matrix4f GetTransformation() const;
-	bool HasChanged();
+	bool HasChanged() const;
 	void Update();
 	void Rotate(const Vector3f& axis, float angle);
 	void Rotate(const Quaternion& rotation);
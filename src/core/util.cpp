@@ -16,6 +16,13 @@
 
 #include "util.h"
 #include <SDL2/SDL.h>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
 
 void Util::Sleep(int milliseconds)
 {
@@ -47,3 +54,63 @@ std::vector<std::string> Util::Split(const std::string& s, char delim)
         
     return elems;
 }
+
+unsigned int Util::CalcChecksum(const void* data, unsigned int size, unsigned int checksum)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for(unsigned int i = 0; i < size; i++)
+	{
+		checksum ^= bytes[i];
+		checksum *= 16777619u;
+	}
+
+	return checksum;
+}
+
+unsigned int Util::CalcFileChecksum(const std::string& fileName, unsigned int checksum)
+{
+	std::ifstream file(fileName.c_str(), std::ios::binary);
+	if(!file.is_open())
+	{
+		return 0;
+	}
+
+	char buffer[65536];
+	while(file.good())
+	{
+		file.read(buffer, sizeof(buffer));
+		checksum = CalcChecksum(buffer, (unsigned int)file.gcount(), checksum);
+	}
+
+	return checksum;
+}
+
+float Util::RandomFloat(float min, float max)
+{
+	return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+std::string Util::GetPartialFileName(const std::string& fileName)
+{
+	return fileName + ".tmp";
+}
+
+bool Util::CommitPartialFile(const std::string& fileName, bool complete)
+{
+	std::string partialFileName = GetPartialFileName(fileName);
+	if(complete)
+	{
+		//rename won't replace a file that's already there on Windows.
+#ifdef WIN32
+		if(MoveFileExA(partialFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+		if(rename(partialFileName.c_str(), fileName.c_str()) == 0)
+#endif
+		{
+			return true;
+		}
+	}
+
+	remove(partialFileName.c_str());
+	return false;
+}
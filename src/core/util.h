@@ -51,6 +51,20 @@ namespace Util
 {
 	void Sleep(int milliseconds);
 	std::vector<std::string> Split(const std::string &s, char delim);
+	//32 bit FNV-1a, which is plenty to tell whether two sets of data are the
+	//same. Passing in the checksum of earlier data continues on from it.
+	unsigned int CalcChecksum(const void* data, unsigned int size, unsigned int checksum = 2166136261u);
+	//Returns 0 if the file can't be read.
+	unsigned int CalcFileChecksum(const std::string& fileName, unsigned int checksum = 2166136261u);
+	//Evenly spread between min and max. Uses rand, so tests that call srand
+	//first see the same numbers every run.
+	float RandomFloat(float min, float max);
+	//Files are written to GetPartialFileName(fileName) and only moved over
+	//fileName by CommitPartialFile once they're complete, so a crash partway
+	//through can't leave a broken file behind. If complete is false, or the
+	//move fails, the partial file is deleted and false is returned.
+	std::string GetPartialFileName(const std::string& fileName);
+	bool CommitPartialFile(const std::string& fileName, bool complete);
 };
 
 #endif
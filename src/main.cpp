@@ -17,9 +17,11 @@
 
 #include "3DEngine.h"
 #include "testing.h"
+#include "benchmarking.h"
 
 #include "components/freeLook.h"
 #include "components/freeMove.h"
+#include "components/cameraPath.h"
 #include "components/physicsEngineComponent.h"
 #include "components/physicsObjectComponent.h"
 #include "physics/boundingSphere.h"
@@ -27,42 +29,78 @@
 class TestGame : public Game
 {
 public:
-	TestGame() {}
+	//With a camera path, the camera flies around the scene by itself rather
+	//than being controlled by the mouse and keyboard. The point lights are
+	//spread over the floor in a grid, to see how lighting scales. The level is
+	//an occluder drawn around everything else. With a loader, textures and
+	//models are streamed in through it rather than loaded before the first frame.
+	TestGame(bool useCameraPath = false, int numPointLights = 0, const std::string& levelFileName = "", AsyncLoader* loader = 0) :
+		m_useCameraPath(useCameraPath),
+		m_numPointLights(numPointLights),
+		m_levelFileName(levelFileName),
+		m_loader(loader) {}
 	
 	virtual void Init(const Window& window);
 protected:
 private:
+	bool         m_useCameraPath;
+	int          m_numPointLights;
+	std::string  m_levelFileName;
+	AsyncLoader* m_loader;
+
+	void AddPointLights();
+	Texture LoadTexture(const std::string& fileName) const;
+	Mesh LoadMesh(const std::string& fileName) const;
+	
 	TestGame(const TestGame& other) {}
 	void operator=(const TestGame& other) {}
 };
 
+Texture TestGame::LoadTexture(const std::string& fileName) const
+{
+	if(m_loader)
+	{
+		return Texture(fileName, m_loader);
+	}
+	return Texture(fileName);
+}
+
+Mesh TestGame::LoadMesh(const std::string& fileName) const
+{
+	if(m_loader)
+	{
+		return Mesh(fileName, m_loader);
+	}
+	return Mesh(fileName);
+}
+
 void TestGame::Init(const Window& window)
 {
-	Material bricks("bricks", Texture("bricks.jpg"), 0.0f, 0,
-			Texture("bricks_normal.jpg"), Texture("bricks_disp.png"), 0.03f, -0.5f);
-	Material bricks2("bricks2", Texture("bricks2.jpg"), 0.0f, 0,
-			Texture("bricks2_normal.png"), Texture("bricks2_disp.jpg"), 0.04f, -1.0f);
+	Material bricks("bricks", LoadTexture("bricks.jpg"), 0.0f, 0,
+			LoadTexture("bricks_normal.jpg"), LoadTexture("bricks_disp.png"), 0.03f, -0.5f);
+	Material bricks2("bricks2", LoadTexture("bricks2.jpg"), 0.0f, 0,
+			LoadTexture("bricks2_normal.png"), LoadTexture("bricks2_disp.jpg"), 0.04f, -1.0f);
 
 	Material gun_pbr_material("gun_pbr");
-	gun_pbr_material.SetTexture("albedoMap", Texture("Cerberus_A.tga"));
-	gun_pbr_material.SetTexture("normalMap", Texture("Cerberus_N.tga"));
-	gun_pbr_material.SetTexture("metallicMap", Texture("Cerberus_M.tga"));
-	gun_pbr_material.SetTexture("roughnessMap", Texture("Cerberus_R.tga"));
-	gun_pbr_material.SetTexture("aoMap", Texture("Cerberus_AO.tga"));
+	gun_pbr_material.SetTexture("albedoMap", LoadTexture("Cerberus_A.tga"));
+	gun_pbr_material.SetTexture("normalMap", LoadTexture("Cerberus_N.tga"));
+	gun_pbr_material.SetTexture("metallicMap", LoadTexture("Cerberus_M.tga"));
+	gun_pbr_material.SetTexture("roughnessMap", LoadTexture("Cerberus_R.tga"));
+	gun_pbr_material.SetTexture("aoMap", LoadTexture("Cerberus_AO.tga"));
 
     Material gold_pbr_material("gold_pbr");
-    gold_pbr_material.SetTexture("albedoMap", Texture("Gold_Glossy_00_M.tga"));
-    gold_pbr_material.SetTexture("normalMap", Texture("Gold_Glossy_00_N.tga"));
-    gold_pbr_material.SetTexture("metallicMap", Texture("Gold_Glossy_00_M.tga"));
-    gold_pbr_material.SetTexture("roughnessMap", Texture("Gold_Glossy_00_R.tga"));
-    gold_pbr_material.SetTexture("aoMap", Texture("Gold_Glossy_00_AO.tga"));
+    gold_pbr_material.SetTexture("albedoMap", LoadTexture("Gold_Glossy_00_M.tga"));
+    gold_pbr_material.SetTexture("normalMap", LoadTexture("Gold_Glossy_00_N.tga"));
+    gold_pbr_material.SetTexture("metallicMap", LoadTexture("Gold_Glossy_00_M.tga"));
+    gold_pbr_material.SetTexture("roughnessMap", LoadTexture("Gold_Glossy_00_R.tga"));
+    gold_pbr_material.SetTexture("aoMap", LoadTexture("Gold_Glossy_00_AO.tga"));
 
     Material floor_pbr_material("floor_pbr");
-    floor_pbr_material.SetTexture("albedoMap", Texture("mahogfloor_basecolor.png"));
-    floor_pbr_material.SetTexture("normalMap", Texture("mahogfloor_normal.png"));
-    floor_pbr_material.SetTexture("metallicMap", Texture("Gold_Glossy_00_R.tga"));
-    floor_pbr_material.SetTexture("roughnessMap", Texture("mahogfloor_roughness.png"));
-    floor_pbr_material.SetTexture("aoMap", Texture("Gold_Glossy_00_AO.tga"));
+    floor_pbr_material.SetTexture("albedoMap", LoadTexture("mahogfloor_basecolor.png"));
+    floor_pbr_material.SetTexture("normalMap", LoadTexture("mahogfloor_normal.png"));
+    floor_pbr_material.SetTexture("metallicMap", LoadTexture("Gold_Glossy_00_R.tga"));
+    floor_pbr_material.SetTexture("roughnessMap", LoadTexture("mahogfloor_roughness.png"));
+    floor_pbr_material.SetTexture("aoMap", LoadTexture("Gold_Glossy_00_AO.tga"));
 
 	IndexedModel square;
 	{
@@ -74,24 +112,41 @@ void TestGame::Init(const Window& window)
 	}
 	Mesh customMesh("square", square.Finalize());
 
-	AddToScene((new Entity(Vector3f(0, 2, -7), Quaternion(Matrix4f().InitRotationEuler(0, ToRadians(0), 0)), 1))
+	Entity* camera = (new Entity(Vector3f(0, 2, -7), Quaternion(Matrix4f().InitRotationEuler(0, ToRadians(0), 0)), 1))
 				->AddComponent(new CameraComponent(Matrix4f().InitPerspective(
-							ToRadians(70.0f), window.GetAspect(), 0.1f, 1000.0f)))
-				->AddComponent(new FreeLook(window.GetCenter()))
-				->AddComponent(new FreeMove(10.0f)));
+							ToRadians(70.0f), window.GetAspect(), 0.1f, 1000.0f)));
+	
+	if(m_useCameraPath)
+	{
+		camera->AddComponent(new CameraPath(Vector3f(0, 2, 0), 7.0f, 1.0f));
+	}
+	else
+	{
+		camera->AddComponent(new FreeLook(window.GetCenter()))
+			->AddComponent(new FreeMove(10.0f));
+	}
+	AddToScene(camera);
 
 
     AddToScene((new Entity(Vector3f(0, 2, 0), Quaternion(), 3))
-                       ->AddComponent(new MeshRenderer(Mesh("gun.obj"),
+                       ->AddComponent(new MeshRenderer(LoadMesh("gun.obj"),
                                                        Material("gun_pbr"))));
 
     AddToScene((new Entity(Vector3f(0, 0, 0), Quaternion(Matrix4f().InitRotationFromDirection(Vector3f(0,0,1), Vector3f(0, 1, 0))), 1))
-                       ->AddComponent(new MeshRenderer(Mesh("floor.obj"),
+                       ->AddComponent(new MeshRenderer(LoadMesh("floor.obj"),
                                                        Material("floor_pbr"))));
 
     AddToScene((new Entity(Vector3f(3, 5, -3), Quaternion(Matrix4f().InitRotationFromDirection(Vector3f(1,1,-1), Vector3f(2,0,1)))))
                        ->AddComponent(new DirectionalLight(Vector3f(1,1,1),
-                                                           3, 10, 20)));
+                                                           3, 9, 40)));
+
+	if(!m_levelFileName.empty())
+	{
+		AddToScene((new Entity())
+			->AddComponent(new MeshRenderer(LoadMesh(m_levelFileName), Material("floor_pbr"), true)));
+	}
+
+	AddPointLights();
 
 //    AddToScene((new Entity(Vector3f(-10, 10, 10), Quaternion(0,0,0,1)))
 //                       ->AddComponent(new PointLight(Vector3f(1,1,1),
@@ -112,20 +167,188 @@ void TestGame::Init(const Window& window)
 
 }
 
+void TestGame::AddPointLights()
+{
+	if(m_numPointLights <= 0)
+	{
+		return;
+	}
+
+	//Each light reaches a little past its neighbours, so every part of the
+	//floor is lit by a few lights whatever the count.
+	const float areaSize = 20.0f;
+	int lightsPerRow = (int)ceilf(sqrtf((float)m_numPointLights));
+	float spacing = areaSize / (float)lightsPerRow;
+	float range = spacing * 1.5f;
+	float intensity = (range * range) / 256.0f;
+
+	const Vector3f colors[] = { Vector3f(1,0.2f,0.2f), Vector3f(0.2f,1,0.2f), Vector3f(0.2f,0.2f,1), Vector3f(1,1,0.2f) };
+	for(int i = 0; i < m_numPointLights; i++)
+	{
+		float x = ((float)(i % lightsPerRow) + 0.5f) * spacing - areaSize / 2.0f;
+		float z = ((float)(i / lightsPerRow) + 0.5f) * spacing - areaSize / 2.0f;
+
+		AddToScene((new Entity(Vector3f(x, 1, z)))
+			->AddComponent(new PointLight(colors[i % 4], intensity, Attenuation(0,0,1))));
+	}
+}
+
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 
-int main()
+int main(int argc, char** argv)
 {
 	Testing::RunAllTests();
 
-	TestGame game;
-	Window window(1280, 720, "3D Game Engine");
-	RenderingEngine renderer(window);
+	//--headless <frames> draws that many frames along a fixed camera path
+	//without a window, writing how long each took to --report <file>.
+	int headlessFrames = 0;
+	std::string reportFileName = "frames.csv";
+	bool writeChecksums = false;
+
+	//--point-lights <count> adds that many point lights, and --forward-lighting
+	//gives each its own pass rather than shading them all at once.
+	int numPointLights = 0;
+	bool clusteredShading = true;
+
+	//--no-shadow-cache draws every shadow map again every frame.
+	bool shadowCaching = true;
+
+	//--no-occlusion-culling draws meshes even when occluders hide them.
+	bool occlusionCulling = true;
+
+	//--level <model> adds a level around the scene, and only draws what's in
+	//the parts of it the camera can see.
+	std::string levelFileName;
+
+	//--shadow-atlas <power of 2> sets how wide the texture every shadow map is
+	//packed into is, and --16-bit-shadows stores it at half the size.
+	int shadowAtlasSizeAsPowerOf2 = 11;
+	bool use16BitShadows = false;
+
+	//--float-vertices stores every vertex attribute of meshes built in code as
+	//full floats rather than packing them into half the space. Models keep the
+	//format meshConverter wrote them in, which takes the same flag.
+	bool floatVertices = false;
+
+	//--cpu-environment works out the environment lighting on the CPU rather
+	//than by drawing it, which is faster when OpenGL is emulated in software.
+	bool bakeEnvironmentOnCpu = false;
+
+	//--stream loads the scene's textures and models in the background while
+	//it's drawn, rather than before the first frame.
+	bool streamAssets = false;
+
+	//When the engine stops, every profile zone is written to --trace <file>
+	//for chrome://tracing, and their percentiles to --zone-stats <file>.
+	std::string traceFileName;
+	std::string zoneStatsFileName;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--benchmark") == 0)
+		{
+			Benchmarking::RunAllBenchmarks();
+			return 0;
+		}
+		else if(strcmp(argv[i], "--headless") == 0 && i + 1 < argc)
+		{
+			headlessFrames = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+		{
+			reportFileName = argv[++i];
+		}
+		else if(strcmp(argv[i], "--checksum") == 0)
+		{
+			writeChecksums = true;
+		}
+		else if(strcmp(argv[i], "--point-lights") == 0 && i + 1 < argc)
+		{
+			numPointLights = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--forward-lighting") == 0)
+		{
+			clusteredShading = false;
+		}
+		else if(strcmp(argv[i], "--no-shadow-cache") == 0)
+		{
+			shadowCaching = false;
+		}
+		else if(strcmp(argv[i], "--no-occlusion-culling") == 0)
+		{
+			occlusionCulling = false;
+		}
+		else if(strcmp(argv[i], "--level") == 0 && i + 1 < argc)
+		{
+			levelFileName = argv[++i];
+		}
+		else if(strcmp(argv[i], "--shadow-atlas") == 0 && i + 1 < argc)
+		{
+			shadowAtlasSizeAsPowerOf2 = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--16-bit-shadows") == 0)
+		{
+			use16BitShadows = true;
+		}
+		else if(strcmp(argv[i], "--float-vertices") == 0)
+		{
+			floatVertices = true;
+		}
+		else if(strcmp(argv[i], "--cpu-environment") == 0)
+		{
+			bakeEnvironmentOnCpu = true;
+		}
+		else if(strcmp(argv[i], "--stream") == 0)
+		{
+			streamAssets = true;
+		}
+		else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+		{
+			traceFileName = argv[++i];
+		}
+		else if(strcmp(argv[i], "--zone-stats") == 0 && i + 1 < argc)
+		{
+			zoneStatsFileName = argv[++i];
+		}
+	}
+
+	bool isHeadless = headlessFrames > 0;
+	Mesh::SetVertexFormat(floatVertices ? VERTEX_FORMAT_FLOAT : VERTEX_FORMAT_PACKED);
+
+	Window window(1280, 720, "3D Game Engine", isHeadless);
+	RenderingEngine renderer(window, bakeEnvironmentOnCpu);
+	TestGame game(isHeadless, numPointLights, levelFileName, streamAssets ? renderer.GetAsyncLoader() : 0);
+	renderer.SetClusteredShading(clusteredShading);
+	renderer.SetShadowCaching(shadowCaching);
+	renderer.SetOcclusionCulling(occlusionCulling);
+	renderer.SetShadowAtlas(shadowAtlasSizeAsPowerOf2, use16BitShadows);
+	if(!levelFileName.empty())
+	{
+		renderer.LoadPotentiallyVisibleSet(levelFileName);
+	}
 	
 	//window.SetFullScreen(true);
 	
 	CoreEngine engine(60, &window, &renderer, &game);
-	engine.Start();
+	if(isHeadless)
+	{
+		engine.RunFrames(headlessFrames, reportFileName, writeChecksums);
+	}
+	else
+	{
+		engine.Start();
+	}
+
+	if(!traceFileName.empty() && !Profiler::WriteChromeTrace(traceFileName))
+	{
+		std::cerr << "Error: Could not write " << traceFileName << std::endl;
+	}
+	if(!zoneStatsFileName.empty() && !Profiler::WriteZoneStats(zoneStatsFileName))
+	{
+		std::cerr << "Error: Could not write " << zoneStatsFileName << std::endl;
+	}
 	
 	return 0;
 }
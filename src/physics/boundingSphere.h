@@ -52,6 +52,11 @@ public:
 	IntersectData IntersectBoundingSphere(const BoundingSphere& other) const;
 	virtual void Transform(const Vector3f& translation);
 	virtual Vector3f GetCenter() const { return m_center; }
+	virtual AABB GetAABB() const
+	{
+		Vector3f extents(m_radius, m_radius, m_radius);
+		return AABB(m_center - extents, m_center + extents);
+	}
 
 	/** Basic getter for the radius */
 	inline float GetRadius()           const { return m_radius; }
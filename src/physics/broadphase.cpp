@@ -0,0 +1,458 @@
+/*
+ * @file
+ * @author Benny Bobaganoosh <thebennybox@gmail.com>
+ * @section LICENSE
+ *
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "broadphase.h"
+#include "boundingSphere.h"
+#include "physicsEngine.h"
+#include "../core/profiling.h"
+#include "../core/util.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+/** Sorts object indices by their minimum extent along one axis. */
+class SweepAndPruneCompare
+{
+public:
+	SweepAndPruneCompare(const std::vector<AABB>& bounds, int axis) :
+		m_bounds(bounds),
+		m_axis(axis) {}
+
+	inline bool operator()(unsigned int a, unsigned int b) const
+	{
+		return m_bounds[a].GetMinExtents()[m_axis] <
+			m_bounds[b].GetMinExtents()[m_axis];
+	}
+private:
+	const std::vector<AABB>& m_bounds;
+	int m_axis;
+};
+
+void BruteForceBroadphase::FindPairs(const std::vector<AABB>& bounds,
+	std::vector<BroadphasePair>* result)
+{
+	result->clear();
+	for(unsigned int i = 0; i < bounds.size(); i++)
+	{
+		for(unsigned int j = i + 1; j < bounds.size(); j++)
+		{
+			if(Overlaps(bounds[i], bounds[j]))
+			{
+				result->push_back(BroadphasePair(i, j));
+			}
+		}
+	}
+}
+
+void SweepAndPruneBroadphase::ChooseAxis(const std::vector<AABB>& bounds)
+{
+	//Sweeping along the axis the objects are most spread out on leaves the
+	//fewest overlapping intervals to check.
+	float sum[3] = { 0.0f, 0.0f, 0.0f };
+	float sumSquared[3] = { 0.0f, 0.0f, 0.0f };
+	for(unsigned int i = 0; i < bounds.size(); i++)
+	{
+		Vector3f center = (bounds[i].GetMinExtents() + bounds[i].GetMaxExtents()) * 0.5f;
+		for(unsigned int j = 0; j < 3; j++)
+		{
+			sum[j] += center[j];
+			sumSquared[j] += center[j] * center[j];
+		}
+	}
+
+	float invCount = 1.0f / (float)bounds.size();
+	float variance[3];
+	for(unsigned int j = 0; j < 3; j++)
+	{
+		float mean = sum[j] * invCount;
+		variance[j] = sumSquared[j] * invCount - mean * mean;
+	}
+
+	int axis = 0;
+	if(variance[1] > variance[axis]) axis = 1;
+	if(variance[2] > variance[axis]) axis = 2;
+
+	if(axis != m_axis)
+	{
+		m_axis = axis;
+		m_order.clear();
+	}
+}
+
+void SweepAndPruneBroadphase::FindPairs(const std::vector<AABB>& bounds,
+	std::vector<BroadphasePair>* result)
+{
+	result->clear();
+	if(bounds.size() < 2)
+	{
+		return;
+	}
+
+	ChooseAxis(bounds);
+	SweepAndPruneCompare compare(bounds, m_axis);
+
+	if(m_order.size() != bounds.size())
+	{
+		m_order.resize(bounds.size());
+		for(unsigned int i = 0; i < m_order.size(); i++)
+		{
+			m_order[i] = i;
+		}
+		std::sort(m_order.begin(), m_order.end(), compare);
+	}
+	else
+	{
+		//Objects rarely move far between steps, so last step's order is
+		//almost sorted and insertion sort is close to linear. If they did
+		//move a lot, give up and sort from scratch.
+		unsigned int maxShifts = (unsigned int)m_order.size() * 8;
+		unsigned int numShifts = 0;
+		for(unsigned int i = 1; i < m_order.size() && numShifts <= maxShifts; i++)
+		{
+			unsigned int current = m_order[i];
+			unsigned int j = i;
+			while(j > 0 && compare(current, m_order[j - 1]))
+			{
+				m_order[j] = m_order[j - 1];
+				j--;
+				numShifts++;
+			}
+			m_order[j] = current;
+		}
+
+		if(numShifts > maxShifts)
+		{
+			std::sort(m_order.begin(), m_order.end(), compare);
+		}
+	}
+
+	for(unsigned int i = 0; i < m_order.size(); i++)
+	{
+		unsigned int first = m_order[i];
+		float maxExtent = bounds[first].GetMaxExtents()[m_axis];
+
+		for(unsigned int j = i + 1; j < m_order.size(); j++)
+		{
+			unsigned int second = m_order[j];
+			if(bounds[second].GetMinExtents()[m_axis] > maxExtent)
+			{
+				break;
+			}
+
+			if(Overlaps(bounds[first], bounds[second]))
+			{
+				result->push_back(first < second ?
+					BroadphasePair(first, second) :
+					BroadphasePair(second, first));
+			}
+		}
+	}
+
+	std::sort(result->begin(), result->end());
+}
+
+static inline int GetCell(float value, float invCellSize)
+{
+	//Casting a float outside of int's range is undefined, so clamp first. The
+	//negated test also catches NaN.
+	float cell = floorf(value * invCellSize);
+	if(!(cell > (float)-UniformGridBroadphase::MAX_CELL))
+	{
+		return -UniformGridBroadphase::MAX_CELL;
+	}
+	if(cell > (float)UniformGridBroadphase::MAX_CELL)
+	{
+		return UniformGridBroadphase::MAX_CELL;
+	}
+	return (int)cell;
+}
+
+void UniformGridBroadphase::FindPairs(const std::vector<AABB>& bounds,
+	std::vector<BroadphasePair>* result)
+{
+	result->clear();
+	if(bounds.size() < 2)
+	{
+		return;
+	}
+
+	float cellSize = m_cellSize;
+	if(cellSize <= 0.0f)
+	{
+		//The median rather than the mean, so a few huge objects can't make
+		//every cell huge.
+		m_extents.resize(bounds.size());
+		for(unsigned int i = 0; i < bounds.size(); i++)
+		{
+			m_extents[i] = (bounds[i].GetMaxExtents() - bounds[i].GetMinExtents()).Max();
+		}
+		std::nth_element(m_extents.begin(), m_extents.begin() + m_extents.size() / 2, m_extents.end());
+		cellSize = 2.0f * m_extents[m_extents.size() / 2];
+		if(!(cellSize > 0.0f))
+		{
+			cellSize = 1.0f;
+		}
+	}
+	float invCellSize = 1.0f / cellSize;
+
+	//Put an entry for every cell each object touches, then sort so that
+	//everything in the same cell ends up next to each other.
+	m_entries.clear();
+	m_largeObjects.clear();
+	for(unsigned int i = 0; i < bounds.size(); i++)
+	{
+		const Vector3f& minExtents = bounds[i].GetMinExtents();
+		const Vector3f& maxExtents = bounds[i].GetMaxExtents();
+		int minX = GetCell(minExtents.GetX(), invCellSize);
+		int minY = GetCell(minExtents.GetY(), invCellSize);
+		int minZ = GetCell(minExtents.GetZ(), invCellSize);
+		int maxX = GetCell(maxExtents.GetX(), invCellSize);
+		int maxY = GetCell(maxExtents.GetY(), invCellSize);
+		int maxZ = GetCell(maxExtents.GetZ(), invCellSize);
+
+		if(maxX - minX >= MAX_CELLS_PER_AXIS ||
+		   maxY - minY >= MAX_CELLS_PER_AXIS ||
+		   maxZ - minZ >= MAX_CELLS_PER_AXIS)
+		{
+			m_largeObjects.push_back(i);
+			continue;
+		}
+
+		CellEntry entry;
+		entry.object = i;
+		for(entry.x = minX; entry.x <= maxX; entry.x++)
+		{
+			for(entry.y = minY; entry.y <= maxY; entry.y++)
+			{
+				for(entry.z = minZ; entry.z <= maxZ; entry.z++)
+				{
+					m_entries.push_back(entry);
+				}
+			}
+		}
+	}
+	std::sort(m_entries.begin(), m_entries.end());
+
+	unsigned int cellStart = 0;
+	while(cellStart < m_entries.size())
+	{
+		const CellEntry& cell = m_entries[cellStart];
+		unsigned int cellEnd = cellStart + 1;
+		while(cellEnd < m_entries.size() &&
+			m_entries[cellEnd].x == cell.x &&
+			m_entries[cellEnd].y == cell.y &&
+			m_entries[cellEnd].z == cell.z)
+		{
+			cellEnd++;
+		}
+
+		for(unsigned int i = cellStart; i < cellEnd; i++)
+		{
+			unsigned int first = m_entries[i].object;
+			for(unsigned int j = i + 1; j < cellEnd; j++)
+			{
+				unsigned int second = m_entries[j].object;
+				if(!Overlaps(bounds[first], bounds[second]))
+				{
+					continue;
+				}
+
+				//Two objects can share many cells. Only report the pair from
+				//the cell holding the minimum corner of their overlap, so it
+				//is reported exactly once.
+				const Vector3f& minFirst = bounds[first].GetMinExtents();
+				const Vector3f& minSecond = bounds[second].GetMinExtents();
+				if(GetCell(std::max(minFirst.GetX(), minSecond.GetX()), invCellSize) == cell.x &&
+				   GetCell(std::max(minFirst.GetY(), minSecond.GetY()), invCellSize) == cell.y &&
+				   GetCell(std::max(minFirst.GetZ(), minSecond.GetZ()), invCellSize) == cell.z)
+				{
+					//Entries within a cell are sorted by object, so first < second.
+					result->push_back(BroadphasePair(first, second));
+				}
+			}
+		}
+
+		cellStart = cellEnd;
+	}
+
+	//Large objects are checked against everything. A pair of two large
+	//objects is only reported from the first of them.
+	for(unsigned int i = 0; i < m_largeObjects.size(); i++)
+	{
+		unsigned int large = m_largeObjects[i];
+		for(unsigned int j = 0; j < bounds.size(); j++)
+		{
+			if(j == large || (j < large && std::binary_search(m_largeObjects.begin(), m_largeObjects.end(), j)))
+			{
+				continue;
+			}
+
+			if(Overlaps(bounds[large], bounds[j]))
+			{
+				result->push_back(large < j ?
+					BroadphasePair(large, j) :
+					BroadphasePair(j, large));
+			}
+		}
+	}
+
+	std::sort(result->begin(), result->end());
+}
+
+static void AddRandomBounds(std::vector<AABB>* bounds, unsigned int count,
+	float worldSize)
+{
+	for(unsigned int i = 0; i < count; i++)
+	{
+		Vector3f center(Util::RandomFloat(0.0f, worldSize),
+			Util::RandomFloat(0.0f, worldSize), Util::RandomFloat(0.0f, worldSize));
+		Vector3f extents(Util::RandomFloat(0.1f, 2.0f),
+			Util::RandomFloat(0.1f, 2.0f), Util::RandomFloat(0.1f, 2.0f));
+		bounds->push_back(AABB(center - extents, center + extents));
+	}
+}
+
+static void CheckMatchesBruteForce(Broadphase* broadphase,
+	const std::vector<AABB>& bounds)
+{
+	BruteForceBroadphase bruteForce;
+	std::vector<BroadphasePair> expected;
+	std::vector<BroadphasePair> actual;
+
+	bruteForce.FindPairs(bounds, &expected);
+	broadphase->FindPairs(bounds, &actual);
+
+	assert(expected.size() == actual.size());
+	for(unsigned int i = 0; i < expected.size(); i++)
+	{
+		assert(expected[i] == actual[i]);
+	}
+}
+
+void Broadphase::Test()
+{
+	SweepAndPruneBroadphase sweepAndPrune;
+	UniformGridBroadphase   uniformGrid;
+	UniformGridBroadphase   fixedGrid(1.0f);
+
+	//Boxes that only touch should still be reported, like in IntersectAABB.
+	std::vector<AABB> bounds;
+	bounds.push_back(AABB(Vector3f(0.0f, 0.0f, 0.0f), Vector3f(1.0f, 1.0f, 1.0f)));
+	bounds.push_back(AABB(Vector3f(1.0f, 0.0f, 0.0f), Vector3f(2.0f, 1.0f, 1.0f)));
+	bounds.push_back(AABB(Vector3f(0.0f, 5.0f, 0.0f), Vector3f(1.0f, 6.0f, 1.0f)));
+	bounds.push_back(AABB(Vector3f(-3.0f, -3.0f, -3.0f), Vector3f(3.0f, 3.0f, 3.0f)));
+
+	std::vector<BroadphasePair> pairs;
+	sweepAndPrune.FindPairs(bounds, &pairs);
+	assert(pairs.size() == 3);
+	assert(pairs[0] == BroadphasePair(0, 1));
+	assert(pairs[1] == BroadphasePair(0, 3));
+	assert(pairs[2] == BroadphasePair(1, 3));
+
+	CheckMatchesBruteForce(&uniformGrid, bounds);
+	CheckMatchesBruteForce(&fixedGrid, bounds);
+
+	//Random scenes, including repeated calls so the sweep and prune order
+	//from the previous call gets reused.
+	srand(1);
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		bounds.clear();
+		AddRandomBounds(&bounds, 300 + i, 40.0f);
+		CheckMatchesBruteForce(&sweepAndPrune, bounds);
+		CheckMatchesBruteForce(&sweepAndPrune, bounds);
+		CheckMatchesBruteForce(&uniformGrid, bounds);
+		CheckMatchesBruteForce(&fixedGrid, bounds);
+	}
+
+	//One huge body shouldn't blow up the cell size, and bounds far outside
+	//int range, or spanning it, still have to be found.
+	bounds.clear();
+	AddRandomBounds(&bounds, 200, 40.0f);
+	bounds.push_back(AABB(Vector3f(-1000.0f, -1000.0f, -1000.0f), Vector3f(1000.0f, 1000.0f, 1000.0f)));
+	bounds.push_back(AABB(Vector3f(1e30f, 1e30f, 1e30f), Vector3f(2e30f, 2e30f, 2e30f)));
+	bounds.push_back(AABB(Vector3f(1.5e30f, 1.5e30f, 1.5e30f), Vector3f(3e30f, 3e30f, 3e30f)));
+	bounds.push_back(AABB(Vector3f(-1e30f, 0.0f, 0.0f), Vector3f(1e30f, 1.0f, 1.0f)));
+	CheckMatchesBruteForce(&sweepAndPrune, bounds);
+	CheckMatchesBruteForce(&uniformGrid, bounds);
+	CheckMatchesBruteForce(&fixedGrid, bounds);
+
+	//Clones start out empty but find the same pairs.
+	Broadphase* clone = uniformGrid.Clone();
+	CheckMatchesBruteForce(clone, bounds);
+	delete clone;
+}
+
+static void AddRandomSpheres(PhysicsEngine* engine, unsigned int count)
+{
+	//Keep the density constant so every size has a similar number of
+	//collisions per object.
+	float worldSize = powf(64.0f * (float)count, 1.0f / 3.0f);
+
+	srand(count);
+	for(unsigned int i = 0; i < count; i++)
+	{
+		Vector3f center(Util::RandomFloat(0.0f, worldSize),
+			Util::RandomFloat(0.0f, worldSize), Util::RandomFloat(0.0f, worldSize));
+		Vector3f velocity(Util::RandomFloat(-1.0f, 1.0f),
+			Util::RandomFloat(-1.0f, 1.0f), Util::RandomFloat(-1.0f, 1.0f));
+
+		engine->AddObject(PhysicsObject(
+			new BoundingSphere(center, Util::RandomFloat(0.5f, 1.0f)), velocity));
+	}
+}
+
+static void BenchmarkBroadphase(const std::string& name, Broadphase* broadphase,
+	unsigned int count, unsigned int numSteps)
+{
+	PhysicsEngine engine(broadphase);
+	AddRandomSpheres(&engine, count);
+
+	ProfileTimer timer;
+	for(unsigned int i = 0; i < numSteps; i++)
+	{
+		engine.Simulate(1.0f / 60.0f);
+		timer.StartInvocation();
+		engine.HandleCollisions();
+		timer.StopInvocation();
+	}
+
+	std::ostringstream message;
+	message << "Collisions (" << count << " spheres, " << name << "): ";
+	timer.DisplayAndReset(message.str(), 0, 56);
+}
+
+void Broadphase::Benchmark()
+{
+	unsigned int counts[] = { 1000, 10000, 100000 };
+	for(unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+	{
+		//Brute force is quadratic; 100k objects would take minutes per step.
+		if(counts[i] <= 10000)
+		{
+			BenchmarkBroadphase("brute force", new BruteForceBroadphase(), counts[i], 10);
+		}
+		BenchmarkBroadphase("sweep and prune", new SweepAndPruneBroadphase(), counts[i], 10);
+		BenchmarkBroadphase("uniform grid", new UniformGridBroadphase(), counts[i], 10);
+	}
+}
@@ -0,0 +1,208 @@
+/*
+ * @file
+ * @author Benny Bobaganoosh <thebennybox@gmail.com>
+ * @section LICENSE
+ *
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BROADPHASE_INCLUDED_H
+#define BROADPHASE_INCLUDED_H
+
+#include "aabb.h"
+#include "../core/referenceCounter.h"
+#include <vector>
+
+/**
+ * The BroadphasePair class stores the indices of two objects whose bounds
+ * overlap, and which therefore need to be checked by the narrowphase.
+ */
+class BroadphasePair
+{
+public:
+	/**
+	 * Creates a BroadphasePair in a usable state.
+	 *
+	 * @param first  The smaller of the two object indices.
+	 * @param second The larger of the two object indices.
+	 */
+	BroadphasePair(unsigned int first, unsigned int second) :
+		m_first(first),
+		m_second(second) {}
+
+	/** Basic getter */
+	inline unsigned int GetFirst()  const { return m_first; }
+	/** Basic getter */
+	inline unsigned int GetSecond() const { return m_second; }
+
+	/** Orders pairs the same way a nested i < j loop would visit them. */
+	inline bool operator<(const BroadphasePair& other) const
+	{
+		return m_first < other.m_first ||
+			(m_first == other.m_first && m_second < other.m_second);
+	}
+	inline bool operator==(const BroadphasePair& other) const
+	{
+		return m_first == other.m_first && m_second == other.m_second;
+	}
+private:
+	/** The smaller of the two object indices */
+	unsigned int m_first;
+	/** The larger of the two object indices */
+	unsigned int m_second;
+};
+
+/**
+ * The Broadphase class is the base class for spatial indices that the
+ * physics engine uses to find candidate collision pairs. Only the pairs it
+ * reports are ever passed on to Collider::Intersect.
+ */
+class Broadphase : public ReferenceCounter
+{
+public:
+	Broadphase() :
+		ReferenceCounter() {}
+	virtual ~Broadphase() {}
+
+	/**
+	 * Finds every pair of bounds that overlap. Each pair has the smaller
+	 * index first, and the result is sorted so collisions are resolved in
+	 * the same order regardless of which broadphase is used.
+	 *
+	 * @param bounds The bounds of every object, indexed by object.
+	 * @param result Where the overlapping pairs are written. Cleared first.
+	 */
+	virtual void FindPairs(const std::vector<AABB>& bounds,
+		std::vector<BroadphasePair>* result) = 0;
+
+	/**
+	 * Creates a new broadphase of the same kind and settings, without any of
+	 * the state kept between steps. Used to copy a PhysicsEngine.
+	 *
+	 * @return A broadphase in allocated memory.
+	 */
+	virtual Broadphase* Clone() const = 0;
+
+	/** Returns true if two AABBs overlap, including touching boxes. */
+	static inline bool Overlaps(const AABB& a, const AABB& b)
+	{
+		return a.GetMinExtents().GetX() <= b.GetMaxExtents().GetX() &&
+		       a.GetMaxExtents().GetX() >= b.GetMinExtents().GetX() &&
+		       a.GetMinExtents().GetY() <= b.GetMaxExtents().GetY() &&
+		       a.GetMaxExtents().GetY() >= b.GetMinExtents().GetY() &&
+		       a.GetMinExtents().GetZ() <= b.GetMaxExtents().GetZ() &&
+		       a.GetMaxExtents().GetZ() >= b.GetMinExtents().GetZ();
+	}
+
+	/** Performs a Unit Test of the broadphase implementations */
+	static void Test();
+	/** Times every broadphase on 1k, 10k and 100k BoundingSpheres */
+	static void Benchmark();
+private:
+	Broadphase(const Broadphase& other) {}
+	void operator=(const Broadphase& other) {}
+};
+
+/**
+ * Checks every pair of objects. This is what the PhysicsEngine did before
+ * broadphases existed, and is kept as a reference for testing.
+ */
+class BruteForceBroadphase : public Broadphase
+{
+public:
+	virtual void FindPairs(const std::vector<AABB>& bounds,
+		std::vector<BroadphasePair>* result);
+	virtual Broadphase* Clone() const { return new BruteForceBroadphase(); }
+};
+
+/**
+ * Sorts bounds along one axis and only checks objects whose intervals on that
+ * axis overlap. The sorted order is kept between steps, so when objects move
+ * only a little the re-sort is close to linear.
+ */
+class SweepAndPruneBroadphase : public Broadphase
+{
+public:
+	SweepAndPruneBroadphase() :
+		Broadphase(),
+		m_axis(0) {}
+
+	virtual void FindPairs(const std::vector<AABB>& bounds,
+		std::vector<BroadphasePair>* result);
+	virtual Broadphase* Clone() const { return new SweepAndPruneBroadphase(); }
+private:
+	/** Object indices sorted by their minimum extent along m_axis */
+	std::vector<unsigned int> m_order;
+	/** Which axis (0 = X, 1 = Y, 2 = Z) the objects are sorted along */
+	int m_axis;
+
+	void ChooseAxis(const std::vector<AABB>& bounds);
+};
+
+/**
+ * Buckets bounds into a uniform grid of cells, and only checks objects that
+ * share a cell. Works best when objects are of similar size; objects that span
+ * more than a few cells are kept out of the grid and checked against everything.
+ */
+class UniformGridBroadphase : public Broadphase
+{
+public:
+	/**
+	 * Creates a UniformGridBroadphase in a usable state.
+	 *
+	 * @param cellSize The width of a grid cell. If 0, twice the median
+	 *                   object extent is used every step.
+	 */
+	UniformGridBroadphase(float cellSize = 0.0f) :
+		Broadphase(),
+		m_cellSize(cellSize) {}
+
+	virtual void FindPairs(const std::vector<AABB>& bounds,
+		std::vector<BroadphasePair>* result);
+	virtual Broadphase* Clone() const { return new UniformGridBroadphase(m_cellSize); }
+
+	/** Objects spanning more cells than this on any axis skip the grid */
+	static const int MAX_CELLS_PER_AXIS = 4;
+	/** Cell coordinates are clamped to +/- this, so far away bounds can't overflow */
+	static const int MAX_CELL = 1 << 24;
+private:
+	/** An object's entry in one of the grid cells it overlaps */
+	struct CellEntry
+	{
+		int          x;
+		int          y;
+		int          z;
+		unsigned int object;
+
+		inline bool operator<(const CellEntry& other) const
+		{
+			if(x != other.x) return x < other.x;
+			if(y != other.y) return y < other.y;
+			if(z != other.z) return z < other.z;
+			return object < other.object;
+		}
+	};
+
+	/** The width of a grid cell, or 0 to choose one automatically */
+	float m_cellSize;
+	/** Reused between steps to avoid reallocating */
+	std::vector<CellEntry> m_entries;
+	/** Objects too large for the grid, reused between steps */
+	std::vector<unsigned int> m_largeObjects;
+	/** Every object's largest extent, reused between steps */
+	std::vector<float> m_extents;
+};
+
+#endif
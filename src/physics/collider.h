@@ -22,6 +22,7 @@
 #define COLLIDER_INCLUDED_H
 
 #include "intersectData.h"
+#include "aabb.h"
 #include "../core/math3d.h"
 #include "../core/referenceCounter.h"
 
@@ -51,6 +52,7 @@ public:
 	Collider(int type) :
 		ReferenceCounter(),
 		m_type(type) {}
+	virtual ~Collider() {}
 	
 	/**
 	 * Calculates information about if this collider is intersecting with 
@@ -72,6 +74,11 @@ public:
 	 * subclasses.
 	 */
 	virtual Vector3f GetCenter() const { return Vector3f(0,0,0); }
+	/**
+	 * Returns an AABB that fully encloses the collider, for use by the
+	 * broadphase. Should be overriden by subclasses.
+	 */
+	virtual AABB GetAABB() const { return AABB(GetCenter(), GetCenter()); }
 
 	/** Basic getter */
 	inline int GetType() const { return m_type; }
@@ -0,0 +1,328 @@
+/*
+ * @file
+ * @author Benny Bobaganoosh <thebennybox@gmail.com>
+ * @section LICENSE
+ *
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "physicsBodyStore.h"
+#include "boundingSphere.h"
+#include "../core/profiling.h"
+#include "../core/util.h"
+#include "../staticLibs/simdaccel.h"
+#include <cassert>
+#include <cstdlib>
+
+PhysicsBodyStore::~PhysicsBodyStore()
+{
+	for(unsigned int i = 0; i < m_colliders.size(); i++)
+	{
+		if(m_colliders[i]->RemoveReference())
+		{
+			delete m_colliders[i];
+		}
+	}
+}
+
+unsigned int PhysicsBodyStore::AddBody(Collider* collider, const Vector3f& position,
+	const Vector3f& velocity)
+{
+	unsigned int handle = m_numBodies;
+	m_numBodies++;
+
+	//Always grow by a whole batch, so the padding bodies past the end are
+	//harmless zeros.
+	if(handle % 4 == 0)
+	{
+		unsigned int paddedSize = handle + 4;
+		m_positionX.resize(paddedSize, 0.0f);
+		m_positionY.resize(paddedSize, 0.0f);
+		m_positionZ.resize(paddedSize, 0.0f);
+		m_velocityX.resize(paddedSize, 0.0f);
+		m_velocityY.resize(paddedSize, 0.0f);
+		m_velocityZ.resize(paddedSize, 0.0f);
+		m_radius.resize(paddedSize, 0.0f);
+	}
+
+	m_positionX[handle] = position.GetX();
+	m_positionY[handle] = position.GetY();
+	m_positionZ[handle] = position.GetZ();
+	SetVelocity(handle, velocity);
+
+	if(collider->GetType() == Collider::TYPE_SPHERE)
+	{
+		m_radius[handle] = ((BoundingSphere*)collider)->GetRadius();
+	}
+	else
+	{
+		m_radius[handle] = -1.0f;
+	}
+
+	m_colliders.push_back(collider);
+	return handle;
+}
+
+void PhysicsBodyStore::Integrate(float delta)
+{
+	IntegrateRange(0, (unsigned int)m_positionX.size(), delta);
+}
+
+void PhysicsBodyStore::IntegrateRange(unsigned int begin, unsigned int end, float delta)
+{
+	assert(begin % 4 == 0);
+	if(end > m_positionX.size())
+	{
+		end = (unsigned int)m_positionX.size();
+	}
+
+	SIMD4f simdDelta(delta);
+	for(unsigned int i = begin; i < end; i += 4)
+	{
+		SIMD4f position;
+		SIMD4f velocity;
+
+		position.Set(&m_positionX[i]);
+		velocity.Set(&m_velocityX[i]);
+		(position + velocity * simdDelta).Get(&m_positionX[i]);
+
+		position.Set(&m_positionY[i]);
+		velocity.Set(&m_velocityY[i]);
+		(position + velocity * simdDelta).Get(&m_positionY[i]);
+
+		position.Set(&m_positionZ[i]);
+		velocity.Set(&m_velocityZ[i]);
+		(position + velocity * simdDelta).Get(&m_positionZ[i]);
+	}
+}
+
+void PhysicsBodyStore::IntegrateBody(unsigned int handle, float delta)
+{
+	m_positionX[handle] += m_velocityX[handle] * delta;
+	m_positionY[handle] += m_velocityY[handle] * delta;
+	m_positionZ[handle] += m_velocityZ[handle] * delta;
+}
+
+void PhysicsBodyStore::CalcBounds(std::vector<AABB>* bounds)
+{
+	bounds->clear();
+	for(unsigned int i = 0; i < m_numBodies; i++)
+	{
+		if(m_radius[i] < 0.0f)
+		{
+			bounds->push_back(GetCollider(i).GetAABB());
+			continue;
+		}
+
+		Vector3f position = GetPosition(i);
+		Vector3f extents(m_radius[i], m_radius[i], m_radius[i]);
+		bounds->push_back(AABB(position - extents, position + extents));
+	}
+}
+
+void PhysicsBodyStore::FindContacts(const std::vector<BroadphasePair>& pairs,
+	std::vector<unsigned int>* result) const
+{
+	result->clear();
+	FindContactsRange(pairs, 0, (unsigned int)pairs.size(), result);
+}
+
+void PhysicsBodyStore::FindContactsRange(const std::vector<BroadphasePair>& pairs,
+	unsigned int begin, unsigned int end, std::vector<unsigned int>* result) const
+{
+	for(unsigned int start = begin; start < end; start += 4)
+	{
+		float firstX[4]  = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float firstY[4]  = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float firstZ[4]  = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float secondX[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float secondY[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float secondZ[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float radii[4]   = { 0.0f, 0.0f, 0.0f, 0.0f };
+		int   keepMask   = 0;
+
+		unsigned int count = end - start < 4 ? end - start : 4;
+		for(unsigned int lane = 0; lane < count; lane++)
+		{
+			unsigned int first  = pairs[start + lane].GetFirst();
+			unsigned int second = pairs[start + lane].GetSecond();
+
+			if(m_radius[first] < 0.0f || m_radius[second] < 0.0f)
+			{
+				keepMask |= (1 << lane);
+				continue;
+			}
+
+			firstX[lane]  = m_positionX[first];
+			firstY[lane]  = m_positionY[first];
+			firstZ[lane]  = m_positionZ[first];
+			secondX[lane] = m_positionX[second];
+			secondY[lane] = m_positionY[second];
+			secondZ[lane] = m_positionZ[second];
+			radii[lane]   = m_radius[first] + m_radius[second];
+		}
+
+		//Same calculation as BoundingSphere::IntersectBoundingSphere, in the
+		//same order, so the batched and scalar tests always agree.
+		SIMD4f x;
+		SIMD4f y;
+		SIMD4f z;
+		SIMD4f other;
+		SIMD4f radiusDistance;
+
+		x.Set(secondX); other.Set(firstX); x -= other;
+		y.Set(secondY); other.Set(firstY); y -= other;
+		z.Set(secondZ); other.Set(firstZ); z -= other;
+		radiusDistance.Set(radii);
+
+		SIMD4f centerDistance = (x * x + y * y + z * z).Sqrt();
+		SIMD4f distance = centerDistance - radiusDistance;
+		keepMask |= (distance < SIMD4f(0.0f)).GetSignMask();
+
+		for(unsigned int lane = 0; lane < count; lane++)
+		{
+			if(keepMask & (1 << lane))
+			{
+				result->push_back(start + lane);
+			}
+		}
+	}
+}
+
+IntersectData PhysicsBodyStore::Intersect(unsigned int first, unsigned int second)
+{
+	if(m_radius[first] < 0.0f || m_radius[second] < 0.0f)
+	{
+		return GetCollider(first).Intersect(GetCollider(second));
+	}
+
+	float radiusDistance = m_radius[first] + m_radius[second];
+	Vector3f direction = GetPosition(second) - GetPosition(first);
+	float centerDistance = direction.Length();
+	direction /= centerDistance;
+
+	float distance = centerDistance - radiusDistance;
+	return IntersectData(distance < 0, direction * distance);
+}
+
+const Collider& PhysicsBodyStore::GetCollider(unsigned int handle)
+{
+	Collider* collider = m_colliders[handle];
+	collider->Transform(GetPosition(handle) - collider->GetCenter());
+	return *collider;
+}
+
+void PhysicsBodyStore::Test()
+{
+	PhysicsBodyStore store;
+	std::vector<BoundingSphere> spheres;
+
+	//Use a count that isn't a multiple of 4 so padding gets exercised.
+	srand(2);
+	for(unsigned int i = 0; i < 23; i++)
+	{
+		Vector3f center(Util::RandomFloat(0.0f, 8.0f), Util::RandomFloat(0.0f, 8.0f),
+			Util::RandomFloat(0.0f, 8.0f));
+		float radius = Util::RandomFloat(0.5f, 2.0f);
+		Vector3f velocity(Util::RandomFloat(-1.0f, 1.0f), Util::RandomFloat(-1.0f, 1.0f),
+			Util::RandomFloat(-1.0f, 1.0f));
+
+		unsigned int handle = store.AddBody(new BoundingSphere(center, radius), center, velocity);
+		assert(handle == i);
+		spheres.push_back(BoundingSphere(center, radius));
+	}
+	assert(store.GetNumBodies() == 23);
+
+	//Batched integration must match integrating one body at a time.
+	std::vector<Vector3f> expected;
+	for(unsigned int i = 0; i < store.GetNumBodies(); i++)
+	{
+		Vector3f position = store.GetPosition(i);
+		Vector3f velocity = store.GetVelocity(i);
+		expected.push_back(position + velocity * 0.5f);
+	}
+	store.Integrate(0.5f);
+	for(unsigned int i = 0; i < store.GetNumBodies(); i++)
+	{
+		assert(store.GetPosition(i) == expected[i]);
+		spheres[i] = BoundingSphere(store.GetPosition(i), spheres[i].GetRadius());
+	}
+
+	//Batched contacts must match testing every pair with BoundingSphere.
+	std::vector<BroadphasePair> pairs;
+	for(unsigned int i = 0; i < store.GetNumBodies(); i++)
+	{
+		for(unsigned int j = i + 1; j < store.GetNumBodies(); j++)
+		{
+			pairs.push_back(BroadphasePair(i, j));
+		}
+	}
+
+	std::vector<unsigned int> contacts;
+	store.FindContacts(pairs, &contacts);
+
+	unsigned int numContacts = 0;
+	for(unsigned int k = 0; k < pairs.size(); k++)
+	{
+		unsigned int i = pairs[k].GetFirst();
+		unsigned int j = pairs[k].GetSecond();
+		IntersectData reference = spheres[i].IntersectBoundingSphere(spheres[j]);
+		IntersectData batched = store.Intersect(i, j);
+
+		assert(reference.GetDoesIntersect() == batched.GetDoesIntersect());
+		if(reference.GetDoesIntersect())
+		{
+			assert(numContacts < contacts.size());
+			assert(contacts[numContacts] == k);
+			numContacts++;
+		}
+	}
+	assert(numContacts == contacts.size());
+	assert(numContacts > 0);
+}
+
+void PhysicsBodyStore::Benchmark()
+{
+	PhysicsBodyStore store;
+
+	srand(3);
+	for(unsigned int i = 0; i < 100000; i++)
+	{
+		Vector3f center(Util::RandomFloat(0.0f, 100.0f), Util::RandomFloat(0.0f, 100.0f),
+			Util::RandomFloat(0.0f, 100.0f));
+		Vector3f velocity(Util::RandomFloat(-1.0f, 1.0f), Util::RandomFloat(-1.0f, 1.0f),
+			Util::RandomFloat(-1.0f, 1.0f));
+		store.AddBody(new BoundingSphere(center, 1.0f), center, velocity);
+	}
+
+	ProfileTimer batchedTimer;
+	ProfileTimer scalarTimer;
+	for(unsigned int i = 0; i < 100; i++)
+	{
+		batchedTimer.StartInvocation();
+		store.Integrate(1.0f / 60.0f);
+		batchedTimer.StopInvocation();
+
+		scalarTimer.StartInvocation();
+		for(unsigned int j = 0; j < store.GetNumBodies(); j++)
+		{
+			store.IntegrateBody(j, 1.0f / 60.0f);
+		}
+		scalarTimer.StopInvocation();
+	}
+
+	batchedTimer.DisplayAndReset("Integrate (100000 bodies, batched): ", 0, 56);
+	scalarTimer.DisplayAndReset("Integrate (100000 bodies, one at a time): ", 0, 56);
+}
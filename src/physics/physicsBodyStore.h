@@ -0,0 +1,182 @@
+/*
+ * @file
+ * @author Benny Bobaganoosh <thebennybox@gmail.com>
+ * @section LICENSE
+ *
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHYSICS_BODY_STORE_INCLUDED_H
+#define PHYSICS_BODY_STORE_INCLUDED_H
+
+#include "../core/math3d.h"
+#include "../core/referenceCounter.h"
+#include "collider.h"
+#include "broadphase.h"
+#include "intersectData.h"
+#include <vector>
+
+/**
+ * The PhysicsBodyStore class keeps the state of many physics bodies in
+ * separate, contiguous arrays for each component, so that they can be
+ * processed four at a time with SIMD instructions.
+ *
+ * Bodies are referred to by handle, which is their index in the arrays. The
+ * arrays are always padded to a multiple of 4 bodies, so batched code never
+ * needs a scalar tail.
+ */
+class PhysicsBodyStore : public ReferenceCounter
+{
+public:
+	/**
+	 * Creates a PhysicsBodyStore in a usable state.
+	 */
+	PhysicsBodyStore() :
+		ReferenceCounter(),
+		m_numBodies(0) {}
+	virtual ~PhysicsBodyStore();
+
+	/**
+	 * Adds a body to the store.
+	 *
+	 * @param collider A collider representing the shape of the body. The
+	 *                   store takes over one reference to it.
+	 * @param position Where the body is in 3D space.
+	 * @param velocity How fast this body is moving and in what direction.
+	 *
+	 * @return The handle of the new body.
+	 */
+	unsigned int AddBody(Collider* collider, const Vector3f& position,
+		const Vector3f& velocity);
+
+	/**
+	 * Moves every body by its velocity for delta seconds, four bodies at a
+	 * time.
+	 *
+	 * @param delta How much time to simulate.
+	 */
+	void Integrate(float delta);
+
+	/**
+	 * Moves some of the bodies by their velocity for delta seconds. Ranges
+	 * that don't overlap can be integrated on different threads.
+	 *
+	 * @param begin The first body to move. Must be a multiple of 4.
+	 * @param end   One past the last body to move. Rounded up to a multiple
+	 *                of 4.
+	 * @param delta How much time to simulate.
+	 */
+	void IntegrateRange(unsigned int begin, unsigned int end, float delta);
+
+	/**
+	 * Moves a single body by its velocity for delta seconds. Gives exactly
+	 * the same result as Integrate for that body.
+	 *
+	 * @param handle Which body to move.
+	 * @param delta  How much time to simulate.
+	 */
+	void IntegrateBody(unsigned int handle, float delta);
+
+	/**
+	 * Calculates an AABB around every body, for use by the broadphase.
+	 *
+	 * @param bounds Where the bounds are written, indexed by handle.
+	 */
+	void CalcBounds(std::vector<AABB>* bounds);
+
+	/**
+	 * Tests candidate pairs four at a time, and finds which ones need a
+	 * collision response. Pairs of spheres are only kept if they actually
+	 * intersect; pairs with any other shape are always kept, since they
+	 * can't be tested in batches.
+	 *
+	 * @param pairs  The candidate pairs, usually from a Broadphase.
+	 * @param result Where the indices into pairs of the kept pairs are
+	 *                 written, in order. Cleared first.
+	 */
+	void FindContacts(const std::vector<BroadphasePair>& pairs,
+		std::vector<unsigned int>* result) const;
+
+	/**
+	 * Same as FindContacts, but only tests pairs in [begin, end). The result
+	 * is appended to rather than cleared, so ranges can be tested
+	 * separately and then joined in order.
+	 */
+	void FindContactsRange(const std::vector<BroadphasePair>& pairs,
+		unsigned int begin, unsigned int end,
+		std::vector<unsigned int>* result) const;
+
+	/**
+	 * Calculates information about if two bodies are intersecting. Gives the
+	 * same result as Collider::Intersect on the bodies' colliders.
+	 *
+	 * @param first  The handle of the first body.
+	 * @param second The handle of the second body.
+	 */
+	IntersectData Intersect(unsigned int first, unsigned int second);
+
+	/**
+	 * Returns a body's collider in the position of the body, updating the
+	 * collider's position if necessary.
+	 */
+	const Collider& GetCollider(unsigned int handle);
+
+	/** Basic getter */
+	inline Vector3f GetPosition(unsigned int handle) const
+	{
+		return Vector3f(m_positionX[handle], m_positionY[handle], m_positionZ[handle]);
+	}
+	/** Basic getter */
+	inline Vector3f GetVelocity(unsigned int handle) const
+	{
+		return Vector3f(m_velocityX[handle], m_velocityY[handle], m_velocityZ[handle]);
+	}
+	/** Basic getter */
+	inline Collider* GetColliderPointer(unsigned int handle) const { return m_colliders[handle]; }
+	/** Basic getter */
+	inline unsigned int GetNumBodies() const { return m_numBodies; }
+
+	/** Basic setter */
+	inline void SetVelocity(unsigned int handle, const Vector3f& velocity)
+	{
+		m_velocityX[handle] = velocity.GetX();
+		m_velocityY[handle] = velocity.GetY();
+		m_velocityZ[handle] = velocity.GetZ();
+	}
+
+	/** Performs a Unit Test of this class */
+	static void Test();
+	/** Times batched integration against integrating one body at a time */
+	static void Benchmark();
+private:
+	/** How many bodies are in the store, not counting padding */
+	unsigned int m_numBodies;
+
+	std::vector<float> m_positionX;
+	std::vector<float> m_positionY;
+	std::vector<float> m_positionZ;
+	std::vector<float> m_velocityX;
+	std::vector<float> m_velocityY;
+	std::vector<float> m_velocityZ;
+	/** The radius of each body if it's a sphere, otherwise -1 */
+	std::vector<float> m_radius;
+	/** The shape of each body. Only kept in position when requested. */
+	std::vector<Collider*> m_colliders;
+
+	PhysicsBodyStore(const PhysicsBodyStore& other) {}
+	void operator=(const PhysicsBodyStore& other) {}
+};
+
+#endif
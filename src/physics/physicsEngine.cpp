@@ -19,40 +19,413 @@
  */
 #include "physicsEngine.h"
 #include "boundingSphere.h"
+#include "../core/profiling.h"
+#include "../core/util.h"
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+/** How many tasks to split islands into, per thread. */
+static const unsigned int ISLAND_TASKS_PER_THREAD = 8;
+
+/**
+ * Changes the velocities of two colliding objects so they bounce off each
+ * other.
+ */
+static void RespondToCollision(PhysicsBodyStore* store, unsigned int i, unsigned int j)
+{
+	IntersectData intersectData = store->Intersect(i, j);
+
+	if(intersectData.GetDoesIntersect())
+	{
+		Vector3f velocityI = store->GetVelocity(i);
+		Vector3f velocityJ = store->GetVelocity(j);
+
+		Vector3f direction = intersectData.GetDirection().Normalized();
+		Vector3f otherDirection = Vector3f(direction.Reflect(velocityI.Normalized()));
+		store->SetVelocity(i, Vector3f(velocityI.Reflect(otherDirection)));
+		store->SetVelocity(j, Vector3f(velocityJ.Reflect(direction)));
+	}
+}
+
+class IntegrateTask : public ThreadPoolTask
+{
+public:
+	IntegrateTask(PhysicsBodyStore* store, float delta, unsigned int taskSize) :
+		m_store(store),
+		m_delta(delta),
+		m_taskSize(taskSize) {}
+
+	virtual void Run(unsigned int index)
+	{
+		m_store->IntegrateRange(index * m_taskSize, (index + 1) * m_taskSize, m_delta);
+	}
+private:
+	PhysicsBodyStore* m_store;
+	float             m_delta;
+	unsigned int      m_taskSize;
+};
+
+class FindContactsTask : public ThreadPoolTask
+{
+public:
+	FindContactsTask(const PhysicsBodyStore* store,
+			const std::vector<BroadphasePair>& pairs,
+			std::vector<std::vector<unsigned int> >* results,
+			unsigned int taskSize) :
+		m_store(store),
+		m_pairs(pairs),
+		m_results(results),
+		m_taskSize(taskSize) {}
+
+	virtual void Run(unsigned int index)
+	{
+		unsigned int begin = index * m_taskSize;
+		unsigned int end = begin + m_taskSize;
+		if(end > m_pairs.size())
+		{
+			end = (unsigned int)m_pairs.size();
+		}
+
+		(*m_results)[index].clear();
+		m_store->FindContactsRange(m_pairs, begin, end, &(*m_results)[index]);
+	}
+private:
+	const PhysicsBodyStore*                  m_store;
+	const std::vector<BroadphasePair>&       m_pairs;
+	std::vector<std::vector<unsigned int> >* m_results;
+	unsigned int                             m_taskSize;
+};
+
+class ResolveIslandsTask : public ThreadPoolTask
+{
+public:
+	ResolveIslandsTask(PhysicsBodyStore* store,
+			const std::vector<BroadphasePair>& pairs,
+			const std::vector<unsigned int>& islandStarts,
+			const std::vector<unsigned int>& islandContacts,
+			unsigned int numTasks) :
+		m_store(store),
+		m_pairs(pairs),
+		m_islandStarts(islandStarts),
+		m_islandContacts(islandContacts),
+		m_numTasks(numTasks) {}
+
+	virtual void Run(unsigned int index)
+	{
+		//Islands never share objects, so each task can resolve its islands
+		//without synchronising with any other task.
+		unsigned int numIslands = (unsigned int)m_islandStarts.size() - 1;
+		unsigned int firstIsland = (unsigned int)(((unsigned long long)numIslands * index) / m_numTasks);
+		unsigned int lastIsland = (unsigned int)(((unsigned long long)numIslands * (index + 1)) / m_numTasks);
+
+		for(unsigned int k = m_islandStarts[firstIsland]; k < m_islandStarts[lastIsland]; k++)
+		{
+			const BroadphasePair& pair = m_pairs[m_islandContacts[k]];
+			RespondToCollision(m_store, pair.GetFirst(), pair.GetSecond());
+		}
+	}
+private:
+	PhysicsBodyStore*                  m_store;
+	const std::vector<BroadphasePair>& m_pairs;
+	const std::vector<unsigned int>&   m_islandStarts;
+	const std::vector<unsigned int>&   m_islandContacts;
+	unsigned int                       m_numTasks;
+};
+
+const unsigned int PhysicsEngine::DEFAULT_INTEGRATE_TASK_SIZE;
+const unsigned int PhysicsEngine::DEFAULT_CONTACTS_TASK_SIZE;
+
+PhysicsEngine::PhysicsEngine(const PhysicsEngine& other) :
+	m_store(new PhysicsBodyStore()),
+	m_broadphase(other.m_broadphase->Clone()),
+	m_threadPool(other.m_threadPool ? new ThreadPool(other.m_threadPool->GetNumThreads()) : 0),
+	m_integrateTaskSize(other.m_integrateTaskSize),
+	m_contactsTaskSize(other.m_contactsTaskSize)
+{
+	//The bodies and the broadphase's sorted state are copied, so stepping one
+	//engine never touches the other. The thread pool isn't shared either, as
+	//ParallelFor can't be called from two threads at once.
+	for(unsigned int i = 0; i < other.m_objects.size(); i++)
+	{
+		AddObject(other.m_objects[i]);
+	}
+}
+
+PhysicsEngine::~PhysicsEngine()
+{
+	if(m_store->RemoveReference())
+	{
+		delete m_store;
+	}
+	if(m_broadphase->RemoveReference())
+	{
+		delete m_broadphase;
+	}
+	if(m_threadPool && m_threadPool->RemoveReference())
+	{
+		delete m_threadPool;
+	}
+}
+
+void PhysicsEngine::SetNumThreads(unsigned int numThreads)
+{
+	if(m_threadPool && m_threadPool->RemoveReference())
+	{
+		delete m_threadPool;
+	}
+	m_threadPool = numThreads > 1 ? new ThreadPool(numThreads) : 0;
+}
+
+void PhysicsEngine::SetTaskSizes(unsigned int integrateTaskSize, unsigned int contactsTaskSize)
+{
+	assert(integrateTaskSize > 0 && integrateTaskSize % 4 == 0);
+	assert(contactsTaskSize > 0);
+	m_integrateTaskSize = integrateTaskSize;
+	m_contactsTaskSize = contactsTaskSize;
+}
 
 void PhysicsEngine::AddObject(const PhysicsObject& object)
 {
-	m_objects.push_back(object);
+	PhysicsBodyStore* source = object.GetStore();
+	Collider* collider = source->GetColliderPointer(object.GetHandle());
+	collider->AddReference();
+
+	unsigned int handle = m_store->AddBody(collider, object.GetPosition(),
+		object.GetVelocity());
+	m_objects.push_back(PhysicsObject(m_store, handle));
 }
 
 void PhysicsEngine::Simulate(float delta)
 {
-	for(unsigned int i = 0; i < m_objects.size(); i++)
+	if(!m_threadPool)
 	{
-		m_objects[i].Integrate(delta);
+		m_store->Integrate(delta);
+		return;
 	}
+
+	IntegrateTask task(m_store, delta, m_integrateTaskSize);
+	unsigned int numTasks = (m_store->GetNumBodies() + m_integrateTaskSize - 1) / m_integrateTaskSize;
+	m_threadPool->ParallelFor(&task, numTasks);
 }
 
 void PhysicsEngine::HandleCollisions()
 {
-	for(unsigned int i = 0; i < m_objects.size(); i++)
+	m_store->CalcBounds(&m_bounds);
+
+	//Pairs come back sorted, so collisions are responded to in the same
+	//order as checking every i < j pair would.
+	m_broadphase->FindPairs(m_bounds, &m_pairs);
+
+	if(!m_threadPool)
+	{
+		//Responses only change velocities, so every pair can be tested up
+		//front in batches without affecting the result.
+		m_store->FindContacts(m_pairs, &m_contacts);
+
+		for(unsigned int k = 0; k < m_contacts.size(); k++)
+		{
+			const BroadphasePair& pair = m_pairs[m_contacts[k]];
+			RespondToCollision(m_store, pair.GetFirst(), pair.GetSecond());
+		}
+		return;
+	}
+
+	FindContactsParallel();
+	BuildIslands();
+
+	unsigned int numIslands = (unsigned int)m_islandStarts.size() - 1;
+	unsigned int numTasks = m_threadPool->GetNumThreads() * ISLAND_TASKS_PER_THREAD;
+	if(numTasks > numIslands)
+	{
+		numTasks = numIslands;
+	}
+
+	ResolveIslandsTask task(m_store, m_pairs, m_islandStarts, m_islandContacts, numTasks);
+	m_threadPool->ParallelFor(&task, numTasks);
+}
+
+void PhysicsEngine::FindContactsParallel()
+{
+	unsigned int numTasks = ((unsigned int)m_pairs.size() + m_contactsTaskSize - 1) / m_contactsTaskSize;
+	if(m_taskContacts.size() < numTasks)
+	{
+		m_taskContacts.resize(numTasks);
+	}
+
+	FindContactsTask task(m_store, m_pairs, &m_taskContacts, m_contactsTaskSize);
+	m_threadPool->ParallelFor(&task, numTasks);
+
+	//Joining the results in task order gives exactly what FindContacts
+	//would have.
+	m_contacts.clear();
+	for(unsigned int i = 0; i < numTasks; i++)
+	{
+		m_contacts.insert(m_contacts.end(), m_taskContacts[i].begin(), m_taskContacts[i].end());
+	}
+}
+
+unsigned int PhysicsEngine::FindIslandRoot(unsigned int object)
+{
+	while(m_islandParents[object] != object)
+	{
+		//Path halving keeps the trees shallow.
+		m_islandParents[object] = m_islandParents[m_islandParents[object]];
+		object = m_islandParents[object];
+	}
+	return object;
+}
+
+void PhysicsEngine::BuildIslands()
+{
+	unsigned int numObjects = m_store->GetNumBodies();
+	m_islandParents.resize(numObjects);
+	for(unsigned int i = 0; i < numObjects; i++)
+	{
+		m_islandParents[i] = i;
+	}
+
+	//Objects that might touch end up in the same island.
+	for(unsigned int k = 0; k < m_contacts.size(); k++)
+	{
+		const BroadphasePair& pair = m_pairs[m_contacts[k]];
+		unsigned int rootFirst = FindIslandRoot(pair.GetFirst());
+		unsigned int rootSecond = FindIslandRoot(pair.GetSecond());
+
+		if(rootFirst < rootSecond)
+		{
+			m_islandParents[rootSecond] = rootFirst;
+		}
+		else if(rootSecond < rootFirst)
+		{
+			m_islandParents[rootFirst] = rootSecond;
+		}
+	}
+
+	//Number the islands in order of their first contact, and count how many
+	//contacts each has.
+	const unsigned int NO_ISLAND = (unsigned int)-1;
+	m_rootIslands.assign(numObjects, NO_ISLAND);
+	m_islandStarts.clear();
+	m_islandStarts.push_back(0);
+
+	for(unsigned int k = 0; k < m_contacts.size(); k++)
+	{
+		unsigned int root = FindIslandRoot(m_pairs[m_contacts[k]].GetFirst());
+		if(m_rootIslands[root] == NO_ISLAND)
+		{
+			m_rootIslands[root] = (unsigned int)m_islandStarts.size() - 1;
+			m_islandStarts.push_back(0);
+		}
+		m_islandStarts[m_rootIslands[root] + 1]++;
+	}
+
+	for(unsigned int i = 1; i < m_islandStarts.size(); i++)
+	{
+		m_islandStarts[i] += m_islandStarts[i - 1];
+	}
+
+	//Stable counting sort, so each island's contacts keep their order.
+	std::vector<unsigned int> insertPositions(m_islandStarts.begin(), m_islandStarts.end() - 1);
+	m_islandContacts.resize(m_contacts.size());
+	for(unsigned int k = 0; k < m_contacts.size(); k++)
+	{
+		unsigned int island = m_rootIslands[FindIslandRoot(m_pairs[m_contacts[k]].GetFirst())];
+		m_islandContacts[insertPositions[island]] = m_contacts[k];
+		insertPositions[island]++;
+	}
+}
+
+static void AddDenseScene(PhysicsEngine* engine, unsigned int count)
+{
+	float worldSize = powf(8.0f * (float)count, 1.0f / 3.0f);
+
+	srand(count);
+	for(unsigned int i = 0; i < count; i++)
 	{
-		for(unsigned int j = i + 1; j < m_objects.size(); j++)
+		Vector3f center(Util::RandomFloat(0.0f, worldSize),
+			Util::RandomFloat(0.0f, worldSize), Util::RandomFloat(0.0f, worldSize));
+		Vector3f velocity(Util::RandomFloat(-1.0f, 1.0f),
+			Util::RandomFloat(-1.0f, 1.0f), Util::RandomFloat(-1.0f, 1.0f));
+
+		engine->AddObject(PhysicsObject(
+			new BoundingSphere(center, Util::RandomFloat(0.5f, 1.0f)), velocity));
+	}
+}
+
+void PhysicsEngine::Test()
+{
+	//Every thread count must give exactly the same result as one thread. The
+	//scene is small enough to run on every launch; Benchmark has the big one.
+	//The tasks are made small so every stage is split across several of them.
+	const unsigned int integrateTaskSize = 16;
+	const unsigned int contactsTaskSize = 8;
+	PhysicsEngine reference(new UniformGridBroadphase(), 1);
+	PhysicsEngine threaded(new UniformGridBroadphase());
+	threaded.SetNumThreads(4);
+	threaded.SetTaskSizes(integrateTaskSize, contactsTaskSize);
+	AddDenseScene(&reference, 300);
+	AddDenseScene(&threaded, 300);
+
+	for(unsigned int step = 0; step < 30; step++)
+	{
+		reference.Simulate(1.0f / 60.0f);
+		reference.HandleCollisions();
+		threaded.Simulate(1.0f / 60.0f);
+		threaded.HandleCollisions();
+
+		assert(threaded.GetNumObjects() > 4 * integrateTaskSize);
+		assert(threaded.m_pairs.size() > 4 * contactsTaskSize);
+	}
+
+	assert(reference.GetNumObjects() == threaded.GetNumObjects());
+	for(unsigned int i = 0; i < reference.GetNumObjects(); i++)
+	{
+		assert(reference.GetObject(i).GetPosition() == threaded.GetObject(i).GetPosition());
+		assert(reference.GetObject(i).GetVelocity() == threaded.GetObject(i).GetVelocity());
+	}
+
+	//Copies are independent; stepping one leaves the other where it was, and
+	//each has its own thread pool.
+	PhysicsEngine copy(threaded);
+	assert(copy.GetNumObjects() == threaded.GetNumObjects());
+	assert(copy.m_threadPool != 0 && copy.m_threadPool != threaded.m_threadPool);
+	assert(copy.m_integrateTaskSize == integrateTaskSize);
+	assert(copy.m_contactsTaskSize == contactsTaskSize);
+	copy.Simulate(1.0f / 60.0f);
+	copy.HandleCollisions();
+	for(unsigned int i = 0; i < reference.GetNumObjects(); i++)
+	{
+		assert(reference.GetObject(i).GetPosition() == threaded.GetObject(i).GetPosition());
+		assert(reference.GetObject(i).GetVelocity() == threaded.GetObject(i).GetVelocity());
+	}
+}
+
+void PhysicsEngine::Benchmark()
+{
+	unsigned int maxThreads = ThreadPool::GetNumCPUs();
+	for(unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		PhysicsEngine engine(new UniformGridBroadphase(), numThreads);
+		AddDenseScene(&engine, 100000);
+
+		ProfileTimer simulateTimer;
+		ProfileTimer collisionTimer;
+		for(unsigned int step = 0; step < 10; step++)
 		{
-			IntersectData intersectData = 
-				m_objects[i].GetCollider().Intersect(
-					m_objects[j].GetCollider());
-
-			if(intersectData.GetDoesIntersect())
-			{
-				Vector3f direction = intersectData.GetDirection().Normalized();
-				Vector3f otherDirection = Vector3f(direction.Reflect(m_objects[i].GetVelocity().Normalized()));
-				m_objects[i].SetVelocity(
-						Vector3f(m_objects[i].GetVelocity().Reflect(otherDirection)));
-
-				m_objects[j].SetVelocity(
-						Vector3f(m_objects[j].GetVelocity().Reflect(direction)));
-			}
+			simulateTimer.StartInvocation();
+			engine.Simulate(1.0f / 60.0f);
+			simulateTimer.StopInvocation();
+
+			collisionTimer.StartInvocation();
+			engine.HandleCollisions();
+			collisionTimer.StopInvocation();
 		}
+
+		std::ostringstream message;
+		message << "Physics step (100000 spheres, " << numThreads << " threads): ";
+		simulateTimer.DisplayAndReset(message.str() + "simulate ", 0, 56);
+		collisionTimer.DisplayAndReset(message.str() + "collide ", 0, 56);
 	}
 }
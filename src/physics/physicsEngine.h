@@ -21,6 +21,9 @@
 #define PHYSICS_ENGINE_INCLUDED_H
 
 #include "physicsObject.h"
+#include "physicsBodyStore.h"
+#include "broadphase.h"
+#include "../core/threadPool.h"
 #include <vector>
 
 /**
@@ -30,12 +33,65 @@
 class PhysicsEngine
 {
 public:
+	/** 
+	 * Creates a PhysicsEngine in a usable state, using a uniform grid
+	 * broadphase.
+	 */
+	PhysicsEngine() :
+		m_store(new PhysicsBodyStore()),
+		m_broadphase(new UniformGridBroadphase()),
+		m_threadPool(0),
+		m_integrateTaskSize(DEFAULT_INTEGRATE_TASK_SIZE),
+		m_contactsTaskSize(DEFAULT_CONTACTS_TASK_SIZE) {}
+
 	/** 
 	 * Creates a PhysicsEngine in a usable state.
+	 *
+	 * @param broadphase The spatial index used to find which objects might be
+	 *                     colliding. Should be in allocated memory.
+	 * @param numThreads How many threads to split each step across. The
+	 *                     result is exactly the same for any thread count.
+	 */
+	PhysicsEngine(Broadphase* broadphase, unsigned int numThreads = 1) :
+		m_store(new PhysicsBodyStore()),
+		m_broadphase(broadphase),
+		m_threadPool(numThreads > 1 ? new ThreadPool(numThreads) : 0),
+		m_integrateTaskSize(DEFAULT_INTEGRATE_TASK_SIZE),
+		m_contactsTaskSize(DEFAULT_CONTACTS_TASK_SIZE) {}
+
+	/** 
+	 * Copies every object into a new store, with a fresh broadphase and a
+	 * thread pool of its own, so the copy can be stepped on another thread.
 	 */
-	PhysicsEngine() {}
+	PhysicsEngine(const PhysicsEngine& other);
+	virtual ~PhysicsEngine();
 
+	/**
+	 * Adds a copy of an object to the simulation. The copy is stored with
+	 * every other object in the engine, not in the original's store.
+	 *
+	 * @param object The object to add.
+	 */
 	void AddObject(const PhysicsObject& object);
+
+	/**
+	 * Changes how many threads each step is split across. The result is
+	 * exactly the same for any thread count.
+	 *
+	 * @param numThreads How many threads to use. 1 runs on this thread only.
+	 */
+	void SetNumThreads(unsigned int numThreads);
+
+	/**
+	 * Changes how much work each parallel task is given. The result is
+	 * exactly the same for any task size.
+	 *
+	 * @param integrateTaskSize How many objects each integration task moves.
+	 *                            Must be a multiple of 4.
+	 * @param contactsTaskSize  How many broadphase pairs each narrowphase
+	 *                            task tests.
+	 */
+	void SetTaskSizes(unsigned int integrateTaskSize, unsigned int contactsTaskSize);
 	
 	/**
 	 * Simulates the physics world for a certain period of time. Does not take
@@ -52,6 +108,10 @@ public:
 	/** 
 	 * Finds all objects that have collided since the last step and updates
 	 * them to adjust for the collision.
+	 *
+	 * When running on several threads, colliding objects are grouped into
+	 * islands that don't touch each other, and each island is resolved on a
+	 * single thread in the same order as the single threaded path.
 	 */
 	void HandleCollisions();
 
@@ -64,9 +124,55 @@ public:
 	{ 
 		return (unsigned int)m_objects.size();
 	}
+
+	/** Performs a Unit Test of this class */
+	static void Test();
+	/** Times a step of a dense scene with different numbers of threads */
+	static void Benchmark();
 private:
-	/** All the objects being simulated by the PhysicsEngine. */
+	/** How many objects each integration task moves by default. */
+	static const unsigned int DEFAULT_INTEGRATE_TASK_SIZE = 4096;
+	/** How many broadphase pairs each narrowphase task tests by default. */
+	static const unsigned int DEFAULT_CONTACTS_TASK_SIZE = 4096;
+
+	/** The state of every object being simulated by the PhysicsEngine. */
+	PhysicsBodyStore*          m_store;
+	/** Handles to all the objects in m_store, in the order they were added. */
 	std::vector<PhysicsObject> m_objects;
+	/** Finds the pairs of objects that need a full intersection check. */
+	Broadphase*                m_broadphase;
+	/** The bounds of every object, reused between steps. */
+	std::vector<AABB>          m_bounds;
+	/** The potentially colliding pairs, reused between steps. */
+	std::vector<BroadphasePair> m_pairs;
+	/** Indices into m_pairs of the pairs that need a response. */
+	std::vector<unsigned int>   m_contacts;
+	/** 
+	 * Splits each step across threads, or 0 to run on this thread only.
+	 * Never shared with another engine, since ParallelFor isn't reentrant.
+	 */
+	ThreadPool*                 m_threadPool;
+	/** How many objects each integration task moves. A multiple of 4. */
+	unsigned int                m_integrateTaskSize;
+	/** How many broadphase pairs each narrowphase task tests. */
+	unsigned int                m_contactsTaskSize;
+
+	/** The contacts found by each parallel task, joined into m_contacts. */
+	std::vector<std::vector<unsigned int> > m_taskContacts;
+	/** Union-find parent of every object, used to build islands. */
+	std::vector<unsigned int>   m_islandParents;
+	/** Which island each union-find root belongs to. */
+	std::vector<unsigned int>   m_rootIslands;
+	/** Where each island's contacts start in m_islandContacts. */
+	std::vector<unsigned int>   m_islandStarts;
+	/** m_contacts, grouped by island but otherwise in the same order. */
+	std::vector<unsigned int>   m_islandContacts;
+
+	void FindContactsParallel();
+	void BuildIslands();
+	unsigned int FindIslandRoot(unsigned int object);
+
+	void operator=(const PhysicsEngine& other) {}
 };
 
 #endif
@@ -4,13 +4,24 @@
 #include <cassert>
 #include <cstring>
 
+PhysicsObject::PhysicsObject(Collider* collider, const Vector3f& velocity) :
+	m_store(new PhysicsBodyStore())
+{
+	m_handle = m_store->AddBody(collider, collider->GetCenter(), velocity);
+}
+
+PhysicsObject::PhysicsObject(PhysicsBodyStore* store, unsigned int handle) :
+	m_store(store),
+	m_handle(handle)
+{
+	m_store->AddReference();
+}
+
 PhysicsObject::PhysicsObject(const PhysicsObject& other) :
-	m_position(other.m_position),
-	m_oldPosition(other.m_oldPosition),
-	m_velocity(other.m_velocity),
-	m_collider(other.m_collider)
+	m_store(other.m_store),
+	m_handle(other.m_handle)
 {
-	m_collider->AddReference();
+	m_store->AddReference();
 }
 
 void PhysicsObject::operator=(PhysicsObject other)
@@ -24,18 +35,12 @@ void PhysicsObject::operator=(PhysicsObject other)
 
 PhysicsObject::~PhysicsObject()
 {
-	if(m_collider->RemoveReference())
+	if(m_store->RemoveReference())
 	{
-		if(m_collider) delete m_collider;
+		delete m_store;
 	}
 }
 
-
-void PhysicsObject::Integrate(float delta)
-{
-	m_position += m_velocity * delta;
-}
-
 void PhysicsObject::Test()
 {
 	PhysicsObject test(new BoundingSphere(Vector3f(0.0f, 1.0f, 0.0f), 1.0f),
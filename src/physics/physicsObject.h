@@ -23,26 +23,32 @@
 
 #include "../core/math3d.h"
 #include "collider.h"
+#include "physicsBodyStore.h"
 
 /**
  * The PhysicsObject class represents an object that can be used in a physics
- * engine.
+ * engine. It's a handle to a body in a PhysicsBodyStore, which holds the
+ * actual position, velocity and shape.
  */
 class PhysicsObject
 {
 public:
 	/**
-	 * Creates a PhysicsObject in a usable state.
+	 * Creates a PhysicsObject in a usable state, in a store of its own.
 	 *
 	 * @param collider A collider representing the shape and position of the
 	 *                   object. Should be in allocated memory.
 	 * @param velocity How fast this object is moving and in what direction.
 	 */
-	PhysicsObject(Collider* collider, const Vector3f& velocity) :
-		m_position(collider->GetCenter()),
-		m_oldPosition(collider->GetCenter()),
-		m_velocity(velocity),
-		m_collider(collider) {}
+	PhysicsObject(Collider* collider, const Vector3f& velocity);
+
+	/**
+	 * Creates a PhysicsObject referring to a body that is already in a store.
+	 *
+	 * @param store  The store holding the body.
+	 * @param handle The handle of the body in the store.
+	 */
+	PhysicsObject(PhysicsBodyStore* store, unsigned int handle);
 
 	PhysicsObject(const PhysicsObject& other);
 	void operator=(PhysicsObject other);
@@ -53,43 +59,33 @@ public:
 	 *
 	 * @param delta How much time to simulate.
 	 */
-	void Integrate(float delta);
+	inline void Integrate(float delta) { m_store->IntegrateBody(m_handle, delta); }
 
 	/** Basic getter */
-	inline const Vector3f& GetPosition() const { return m_position; }
+	inline Vector3f GetPosition() const { return m_store->GetPosition(m_handle); }
 	/** Basic getter */
-	inline const Vector3f& GetVelocity() const { return m_velocity; }
+	inline Vector3f GetVelocity() const { return m_store->GetVelocity(m_handle); }
+	/** Basic getter */
+	inline PhysicsBodyStore* GetStore() const { return m_store; }
+	/** Basic getter */
+	inline unsigned int GetHandle() const { return m_handle; }
 
 	/**
 	 * Returns a collider in the position of this object, updating the
 	 * collider's position if necessary.
 	 */
-	inline const Collider& GetCollider()
-	{
-		//Find distance between current and old position
-		Vector3f translation = m_position - m_oldPosition;
-		//Update old position back to current position.
-		m_oldPosition = m_position;
-		//Move collider by distance moved.
-		m_collider->Transform(translation);
-
-		return *m_collider;
-	}
+	inline const Collider& GetCollider() { return m_store->GetCollider(m_handle); }
 
 	/** Basic setter */
-	inline void SetVelocity(const Vector3f& velocity) { m_velocity = velocity; }
+	inline void SetVelocity(const Vector3f& velocity) { m_store->SetVelocity(m_handle, velocity); }
 
 	/** Performs a Unit Test of this class */
 	static void Test();
 private:
-	/** Where this object is in 3D space. */
-	Vector3f m_position;
-	/** The position of the object when the collider was last updated. */
-	Vector3f m_oldPosition;
-	/** How fast this object is moving and in what direction */
-	Vector3f m_velocity;
-	/** The collider representing the shape and position of this object. */
-	Collider* m_collider;
+	/** The store holding this object's position, velocity and shape. */
+	PhysicsBodyStore* m_store;
+	/** Which body in m_store this object refers to. */
+	unsigned int      m_handle;
 };
 
 #endif
@@ -0,0 +1,485 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "boundingVolumeHierarchy.h"
+#include "../core/util.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+
+static Vector3f MinOf(const Vector3f& a, const Vector3f& b)
+{
+	return Vector3f(std::min(a.GetX(), b.GetX()), std::min(a.GetY(), b.GetY()), std::min(a.GetZ(), b.GetZ()));
+}
+
+static Vector3f MaxOf(const Vector3f& a, const Vector3f& b)
+{
+	return Vector3f(std::max(a.GetX(), b.GetX()), std::max(a.GetY(), b.GetY()), std::max(a.GetZ(), b.GetZ()));
+}
+
+//Half the surface area of a box, which is proportional to how likely a random
+//ray or frustum plane is to hit it.
+static float CalcArea(const Vector3f& minExtents, const Vector3f& maxExtents)
+{
+	Vector3f size = maxExtents - minExtents;
+	return size.GetX() * size.GetY() + size.GetY() * size.GetZ() + size.GetZ() * size.GetX();
+}
+
+static bool Contains(const Vector3f& outerMin, const Vector3f& outerMax, const Vector3f& innerMin, const Vector3f& innerMax)
+{
+	return outerMin.GetX() <= innerMin.GetX() && outerMin.GetY() <= innerMin.GetY() && outerMin.GetZ() <= innerMin.GetZ() &&
+		innerMax.GetX() <= outerMax.GetX() && innerMax.GetY() <= outerMax.GetY() && innerMax.GetZ() <= outerMax.GetZ();
+}
+
+unsigned int BoundingVolumeHierarchy::AddProxy(const Vector3f& minExtents, const Vector3f& maxExtents, unsigned int userData)
+{
+	unsigned int proxy = AllocateNode();
+	m_nodes[proxy].userData = userData;
+	m_nodes[proxy].height = 0;
+	SetFattenedExtents(proxy, minExtents, maxExtents);
+
+	InsertLeaf(proxy);
+	m_numProxies++;
+	return proxy;
+}
+
+void BoundingVolumeHierarchy::RemoveProxy(unsigned int proxy)
+{
+	assert(proxy < m_nodes.size() && m_nodes[proxy].IsLeaf());
+
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	m_numProxies--;
+}
+
+bool BoundingVolumeHierarchy::MoveProxy(unsigned int proxy, const Vector3f& minExtents, const Vector3f& maxExtents)
+{
+	assert(proxy < m_nodes.size() && m_nodes[proxy].IsLeaf());
+
+	if(Contains(m_nodes[proxy].minExtents, m_nodes[proxy].maxExtents, minExtents, maxExtents))
+	{
+		return false;
+	}
+
+	//The leaf keeps its index, so the proxy stays valid.
+	RemoveLeaf(proxy);
+	SetFattenedExtents(proxy, minExtents, maxExtents);
+	InsertLeaf(proxy);
+	return true;
+}
+
+void BoundingVolumeHierarchy::FindVisible(const Frustum& frustum, std::vector<unsigned int>* result) const
+{
+	result->clear();
+	if(m_root == NULL_NODE)
+	{
+		return;
+	}
+
+	m_stack.clear();
+	m_stack.push_back(m_root);
+	while(!m_stack.empty())
+	{
+		unsigned int index = m_stack.back();
+		m_stack.pop_back();
+
+		const Node& node = m_nodes[index];
+		int classification = frustum.ClassifyAABB(node.minExtents, node.maxExtents);
+		if(classification == Frustum::OUTSIDE)
+		{
+			continue;
+		}
+
+		//Everything under a node that's entirely on screen is too, so there's
+		//no need to test any further down.
+		if(classification == Frustum::INSIDE || node.IsLeaf())
+		{
+			CollectLeaves(index, result);
+			continue;
+		}
+
+		m_stack.push_back(node.child1);
+		m_stack.push_back(node.child2);
+	}
+
+	//Keep the order independent of the tree's shape, so objects are drawn in
+	//the same order every frame.
+	std::sort(result->begin(), result->end());
+}
+
+void BoundingVolumeHierarchy::TransformAABB(const Matrix4f& transform, const Vector3f& minExtents, const Vector3f& maxExtents,
+	Vector3f* resultMinExtents, Vector3f* resultMaxExtents)
+{
+	Vector3f center = (minExtents + maxExtents) / 2.0f;
+	Vector3f halfExtents = (maxExtents - minExtents) / 2.0f;
+	Vector3f newCenter(transform.Transform(center));
+
+	//Each new half extent is how far the old half extents can reach along
+	//that axis once rotated and scaled, which is the sum of their absolute
+	//contributions.
+	Vector3f newHalfExtents;
+	for(int i = 0; i < 3; i++)
+	{
+		newHalfExtents[i] = fabs(transform[0][i]) * halfExtents.GetX() +
+			fabs(transform[1][i]) * halfExtents.GetY() +
+			fabs(transform[2][i]) * halfExtents.GetZ();
+	}
+
+	*resultMinExtents = newCenter - newHalfExtents;
+	*resultMaxExtents = newCenter + newHalfExtents;
+}
+
+unsigned int BoundingVolumeHierarchy::AllocateNode()
+{
+	unsigned int index;
+	if(m_freeList != NULL_NODE)
+	{
+		index = m_freeList;
+		m_freeList = m_nodes[index].parent;
+	}
+	else
+	{
+		index = (unsigned int)m_nodes.size();
+		m_nodes.push_back(Node());
+	}
+
+	Node& node = m_nodes[index];
+	node.parent = NULL_NODE;
+	node.child1 = NULL_NODE;
+	node.child2 = NULL_NODE;
+	node.height = 0;
+	node.userData = 0;
+	return index;
+}
+
+void BoundingVolumeHierarchy::FreeNode(unsigned int index)
+{
+	m_nodes[index].parent = m_freeList;
+	m_nodes[index].height = -1;
+	m_freeList = index;
+}
+
+void BoundingVolumeHierarchy::InsertLeaf(unsigned int leaf)
+{
+	if(m_root == NULL_NODE)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = NULL_NODE;
+		return;
+	}
+
+	//Walk down towards the sibling that makes the tree's total area grow the
+	//least. Every node above the new leaf has to grow to contain it, so that
+	//cost is paid no matter which child is taken.
+	Vector3f leafMin = m_nodes[leaf].minExtents;
+	Vector3f leafMax = m_nodes[leaf].maxExtents;
+	unsigned int index = m_root;
+	while(!m_nodes[index].IsLeaf())
+	{
+		const Node& node = m_nodes[index];
+		float area = CalcArea(node.minExtents, node.maxExtents);
+		float combinedArea = CalcArea(MinOf(node.minExtents, leafMin), MaxOf(node.maxExtents, leafMax));
+
+		float siblingCost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		unsigned int children[2] = { node.child1, node.child2 };
+		for(int i = 0; i < 2; i++)
+		{
+			const Node& child = m_nodes[children[i]];
+			float newArea = CalcArea(MinOf(child.minExtents, leafMin), MaxOf(child.maxExtents, leafMax));
+			if(!child.IsLeaf())
+			{
+				newArea -= CalcArea(child.minExtents, child.maxExtents);
+			}
+			childCosts[i] = newArea + inheritanceCost;
+		}
+
+		if(siblingCost < childCosts[0] && siblingCost < childCosts[1])
+		{
+			break;
+		}
+
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+
+	unsigned int sibling = index;
+	unsigned int newParent = AllocateNode();
+	unsigned int oldParent = m_nodes[sibling].parent;
+
+	m_nodes[newParent].parent = oldParent;
+	m_nodes[newParent].child1 = sibling;
+	m_nodes[newParent].child2 = leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	if(oldParent == NULL_NODE)
+	{
+		m_root = newParent;
+	}
+	else if(m_nodes[oldParent].child1 == sibling)
+	{
+		m_nodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		m_nodes[oldParent].child2 = newParent;
+	}
+
+	Refit(newParent);
+}
+
+void BoundingVolumeHierarchy::RemoveLeaf(unsigned int leaf)
+{
+	if(leaf == m_root)
+	{
+		m_root = NULL_NODE;
+		return;
+	}
+
+	unsigned int parent = m_nodes[leaf].parent;
+	unsigned int grandParent = m_nodes[parent].parent;
+	unsigned int sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	//The parent only existed to join the leaf and its sibling, so the sibling
+	//takes its place.
+	m_nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+
+	if(grandParent == NULL_NODE)
+	{
+		m_root = sibling;
+		return;
+	}
+
+	if(m_nodes[grandParent].child1 == parent)
+	{
+		m_nodes[grandParent].child1 = sibling;
+	}
+	else
+	{
+		m_nodes[grandParent].child2 = sibling;
+	}
+
+	Refit(grandParent);
+}
+
+void BoundingVolumeHierarchy::Refit(unsigned int index)
+{
+	while(index != NULL_NODE)
+	{
+		index = Balance(index);
+		UpdateFromChildren(index);
+		index = m_nodes[index].parent;
+	}
+}
+
+unsigned int BoundingVolumeHierarchy::Balance(unsigned int indexA)
+{
+	Node& a = m_nodes[indexA];
+	if(a.IsLeaf())
+	{
+		return indexA;
+	}
+
+	//If one child is more than a level taller than the other, it's rotated up
+	//to take a's place, and a takes whichever of its children is shorter.
+	unsigned int indexB = a.child1;
+	unsigned int indexC = a.child2;
+	int balance = m_nodes[indexC].height - m_nodes[indexB].height;
+	if(balance >= -1 && balance <= 1)
+	{
+		return indexA;
+	}
+
+	unsigned int indexShort = balance > 1 ? indexB : indexC;
+	unsigned int indexTall  = balance > 1 ? indexC : indexB;
+	Node& tall = m_nodes[indexTall];
+
+	unsigned int indexTallChild1 = tall.child1;
+	unsigned int indexTallChild2 = tall.child2;
+	bool keepFirst = m_nodes[indexTallChild1].height > m_nodes[indexTallChild2].height;
+	unsigned int indexKept  = keepFirst ? indexTallChild1 : indexTallChild2;
+	unsigned int indexMoved = keepFirst ? indexTallChild2 : indexTallChild1;
+
+	//Swap a and tall.
+	tall.child1 = indexA;
+	tall.child2 = indexKept;
+	tall.parent = a.parent;
+	a.parent = indexTall;
+
+	if(tall.parent == NULL_NODE)
+	{
+		m_root = indexTall;
+	}
+	else if(m_nodes[tall.parent].child1 == indexA)
+	{
+		m_nodes[tall.parent].child1 = indexTall;
+	}
+	else
+	{
+		m_nodes[tall.parent].child2 = indexTall;
+	}
+
+	//a keeps its shorter child and adopts the child tall gave up.
+	a.child1 = indexShort;
+	a.child2 = indexMoved;
+	m_nodes[indexMoved].parent = indexA;
+
+	UpdateFromChildren(indexA);
+	UpdateFromChildren(indexTall);
+	return indexTall;
+}
+
+void BoundingVolumeHierarchy::SetFattenedExtents(unsigned int leaf, const Vector3f& minExtents, const Vector3f& maxExtents)
+{
+	Vector3f margin = (maxExtents - minExtents) * m_margin;
+	m_nodes[leaf].minExtents = minExtents - margin;
+	m_nodes[leaf].maxExtents = maxExtents + margin;
+}
+
+void BoundingVolumeHierarchy::CollectLeaves(unsigned int index, std::vector<unsigned int>* result) const
+{
+	const Node& node = m_nodes[index];
+	if(node.IsLeaf())
+	{
+		result->push_back(node.userData);
+		return;
+	}
+
+	CollectLeaves(node.child1, result);
+	CollectLeaves(node.child2, result);
+}
+
+void BoundingVolumeHierarchy::UpdateFromChildren(unsigned int index)
+{
+	Node& node = m_nodes[index];
+	const Node& child1 = m_nodes[node.child1];
+	const Node& child2 = m_nodes[node.child2];
+
+	node.minExtents = MinOf(child1.minExtents, child2.minExtents);
+	node.maxExtents = MaxOf(child1.maxExtents, child2.maxExtents);
+	node.height = 1 + std::max(child1.height, child2.height);
+}
+
+void BoundingVolumeHierarchy::Test()
+{
+	//An identity view projection sees exactly the box from -1 to 1.
+	Frustum identity(Matrix4f().InitIdentity());
+	assert(identity.ClassifyAABB(Vector3f(-0.5f, -0.5f, -0.5f), Vector3f(0.5f, 0.5f, 0.5f)) == Frustum::INSIDE);
+	assert(identity.ClassifyAABB(Vector3f(0.5f, 0.5f, 0.5f), Vector3f(1.5f, 1.5f, 1.5f)) == Frustum::INTERSECTING);
+	assert(identity.ClassifyAABB(Vector3f(2.0f, 0.0f, 0.0f), Vector3f(3.0f, 1.0f, 1.0f)) == Frustum::OUTSIDE);
+	assert(identity.ClassifyAABB(Vector3f(0.0f, 0.0f, 2.0f), Vector3f(1.0f, 1.0f, 3.0f)) == Frustum::OUTSIDE);
+
+	Frustum noDepth(Matrix4f().InitIdentity(), false);
+	assert(noDepth.ClassifyAABB(Vector3f(0.0f, 0.0f, 2.0f), Vector3f(1.0f, 1.0f, 3.0f)) == Frustum::INSIDE);
+
+	//Extra planes only ever cut the frustum down.
+	Frustum narrowed(Matrix4f().InitIdentity());
+	narrowed.AddPlane(Vector3f(-1.0f, 0.0f, 0.0f), 0.0f);
+	assert(narrowed.ClassifyAABB(Vector3f(-0.5f, -0.5f, -0.5f), Vector3f(-0.1f, 0.5f, 0.5f)) == Frustum::INSIDE);
+	assert(narrowed.ClassifyAABB(Vector3f(-0.5f, -0.5f, -0.5f), Vector3f(0.5f, 0.5f, 0.5f)) == Frustum::INTERSECTING);
+	assert(narrowed.ClassifyAABB(Vector3f(0.1f, -0.5f, -0.5f), Vector3f(0.5f, 0.5f, 0.5f)) == Frustum::OUTSIDE);
+
+	//Transformed boxes must contain every transformed corner.
+	Matrix4f transform = Matrix4f().InitTranslation(Vector3f(1.0f, 2.0f, 3.0f)) *
+		Quaternion(Vector3f(0.0f, 1.0f, 0.0f), 0.7f).ToRotationMatrix() *
+		Matrix4f().InitScale(Vector3f(2.0f, 2.0f, 2.0f));
+	Vector3f localMin(-1.0f, -2.0f, -3.0f);
+	Vector3f localMax(1.0f, 2.0f, 3.0f);
+	Vector3f worldMin;
+	Vector3f worldMax;
+	TransformAABB(transform, localMin, localMax, &worldMin, &worldMax);
+	for(int i = 0; i < 8; i++)
+	{
+		Vector3f corner((i & 1) ? localMax.GetX() : localMin.GetX(),
+			(i & 2) ? localMax.GetY() : localMin.GetY(),
+			(i & 4) ? localMax.GetZ() : localMin.GetZ());
+		Vector3f transformedCorner(transform.Transform(corner));
+		assert(Contains(worldMin - Vector3f(0.001f, 0.001f, 0.001f), worldMax + Vector3f(0.001f, 0.001f, 0.001f),
+			transformedCorner, transformedCorner));
+	}
+
+	//With no margin, the tree must find exactly what testing every box
+	//would, through adding, moving and removing proxies.
+	BoundingVolumeHierarchy bvh(0.0f);
+	std::vector<Vector3f> minExtents;
+	std::vector<Vector3f> maxExtents;
+	std::vector<unsigned int> proxies;
+	std::vector<bool> removed;
+
+	srand(4);
+	for(unsigned int i = 0; i < 500; i++)
+	{
+		Vector3f center(Util::RandomFloat(-50.0f, 50.0f), Util::RandomFloat(-50.0f, 50.0f), Util::RandomFloat(-50.0f, 50.0f));
+		Vector3f extents(Util::RandomFloat(0.1f, 2.0f), Util::RandomFloat(0.1f, 2.0f), Util::RandomFloat(0.1f, 2.0f));
+		minExtents.push_back(center - extents);
+		maxExtents.push_back(center + extents);
+		proxies.push_back(bvh.AddProxy(center - extents, center + extents, i));
+		removed.push_back(false);
+	}
+
+	for(unsigned int i = 0; i < 500; i += 2)
+	{
+		Vector3f offset(Util::RandomFloat(-10.0f, 10.0f), Util::RandomFloat(-10.0f, 10.0f), Util::RandomFloat(-10.0f, 10.0f));
+		minExtents[i] += offset;
+		maxExtents[i] += offset;
+		bvh.MoveProxy(proxies[i], minExtents[i], maxExtents[i]);
+	}
+
+	for(unsigned int i = 0; i < 500; i += 7)
+	{
+		bvh.RemoveProxy(proxies[i]);
+		removed[i] = true;
+	}
+	assert(bvh.GetNumProxies() == 500 - 72);
+
+	Matrix4f projection = Matrix4f().InitPerspective(ToRadians(70.0f), 16.0f / 9.0f, 0.1f, 40.0f);
+	Matrix4f view = Quaternion(Vector3f(0.0f, 1.0f, 0.0f), 0.4f).ToRotationMatrix() *
+		Matrix4f().InitTranslation(Vector3f(5.0f, -3.0f, 20.0f));
+	Frustum frustum(projection * view);
+
+	std::vector<unsigned int> visible;
+	bvh.FindVisible(frustum, &visible);
+
+	std::vector<unsigned int> expected;
+	for(unsigned int i = 0; i < 500; i++)
+	{
+		if(!removed[i] && frustum.ClassifyAABB(minExtents[i], maxExtents[i]) != Frustum::OUTSIDE)
+		{
+			expected.push_back(i);
+		}
+	}
+	assert(visible == expected);
+	assert(!visible.empty() && visible.size() < 500 - 72);
+
+	bvh.SetUserData(proxies[visible[0]], 1000);
+	bvh.FindVisible(frustum, &visible);
+	assert(visible.size() == expected.size() && visible.back() == 1000);
+
+	//The tree must stay balanced no matter what order boxes arrive in.
+	BoundingVolumeHierarchy line;
+	for(unsigned int i = 0; i < 1024; i++)
+	{
+		Vector3f position((float)i, 0.0f, 0.0f);
+		line.AddProxy(position, position + Vector3f(0.5f, 0.5f, 0.5f), i);
+	}
+	assert(line.m_nodes[line.m_root].height < 20);
+}
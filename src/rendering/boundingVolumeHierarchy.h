@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef BOUNDINGVOLUMEHIERARCHY_H
+#define BOUNDINGVOLUMEHIERARCHY_H
+
+#include "frustum.h"
+#include "../core/math3d.h"
+
+#include <vector>
+
+//A tree of axis aligned boxes that can be changed while it's in use, so it can
+//track objects that move around without being rebuilt.
+//
+//Each object is a proxy, stored with a box slightly bigger than the object
+//itself. Small movements stay inside that box and leave the tree untouched;
+//only objects that leave it are taken out and reinserted. Inserting picks the
+//spot that adds the least surface area, and the tree is rebalanced on the way
+//back up, so it stays shallow no matter what order objects are added in.
+class BoundingVolumeHierarchy
+{
+public:
+	static const unsigned int NULL_NODE = 0xFFFFFFFF;
+
+	//margin is how much bigger than the object each stored box is, as a
+	//fraction of the object's size along each axis.
+	BoundingVolumeHierarchy(float margin = 0.1f) :
+		m_root(NULL_NODE),
+		m_freeList(NULL_NODE),
+		m_numProxies(0),
+		m_margin(margin) {}
+
+	//Adds a box to the tree, returning the proxy used to refer to it later.
+	//userData is what FindVisible reports when the box can be seen.
+	unsigned int AddProxy(const Vector3f& minExtents, const Vector3f& maxExtents, unsigned int userData);
+	void RemoveProxy(unsigned int proxy);
+	inline void SetUserData(unsigned int proxy, unsigned int userData) { m_nodes[proxy].userData = userData; }
+
+	//Updates a proxy after its object has moved. Returns true if the tree had
+	//to be changed, or false if the object was still inside its stored box.
+	bool MoveProxy(unsigned int proxy, const Vector3f& minExtents, const Vector3f& maxExtents);
+
+	//Finds the userData of every proxy that might be inside the frustum, in
+	//increasing order.
+	void FindVisible(const Frustum& frustum, std::vector<unsigned int>* result) const;
+
+	inline unsigned int GetNumProxies() const { return m_numProxies; }
+
+	//Finds the world space box around a local space box after it's been
+	//transformed, without transforming all 8 corners.
+	static void TransformAABB(const Matrix4f& transform, const Vector3f& minExtents, const Vector3f& maxExtents,
+		Vector3f* resultMinExtents, Vector3f* resultMaxExtents);
+
+	static void Test();
+protected:
+private:
+	struct Node
+	{
+		Vector3f     minExtents;
+		Vector3f     maxExtents;
+		unsigned int parent;     //Also the next free node when this is in the free list
+		unsigned int child1;     //NULL_NODE if this is a leaf
+		unsigned int child2;
+		int          height;     //0 for leaves, -1 for free nodes
+		unsigned int userData;
+
+		inline bool IsLeaf() const { return child1 == NULL_NODE; }
+	};
+
+	std::vector<Node>                 m_nodes;
+	unsigned int                      m_root;
+	unsigned int                      m_freeList;
+	unsigned int                      m_numProxies;
+	float                             m_margin;
+	mutable std::vector<unsigned int> m_stack; //Reused by FindVisible to avoid reallocating
+
+	unsigned int AllocateNode();
+	void FreeNode(unsigned int index);
+	void InsertLeaf(unsigned int leaf);
+	void RemoveLeaf(unsigned int leaf);
+	void Refit(unsigned int index);
+	unsigned int Balance(unsigned int index);
+	void SetFattenedExtents(unsigned int leaf, const Vector3f& minExtents, const Vector3f& maxExtents);
+	void CollectLeaves(unsigned int index, std::vector<unsigned int>* result) const;
+	void UpdateFromChildren(unsigned int index);
+};
+
+#endif
@@ -19,6 +19,12 @@
 #include "renderingEngine.h"
 
 #include "../core/coreEngine.h"
+#include "../core/util.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
 
 Matrix4f Camera::GetViewProjection() const
 {
@@ -54,6 +60,51 @@ Matrix4f Camera::GetCameraRotation() const
 	return cameraRotation;
 }
 
+float Camera::CalcNearPlane(const Matrix4f& perspective)
+{
+	//Undoes how InitPerspective works out the depth terms.
+	return -perspective[3][2] / (perspective[2][2] + 1.0f);
+}
+
+float Camera::CalcFarPlane(const Matrix4f& perspective)
+{
+	return -perspective[3][2] / (perspective[2][2] - 1.0f);
+}
+
+bool Camera::CalcScreenBounds(const Vector3f& center, float radius, Vector3f* minBounds, Vector3f* maxBounds) const
+{
+	float nearPlane = GetNearPlane();
+	float farPlane = GetFarPlane();
+
+	//Works with the box around the sphere, which is simpler and never smaller.
+	//Only the part between the near and far planes can be seen, which also
+	//keeps the depths used below positive.
+	Vector3f viewCenter(GetView().Transform(center));
+	float minDepth = std::max(viewCenter.GetZ() - radius, nearPlane);
+	float maxDepth = std::min(viewCenter.GetZ() + radius, farPlane);
+	if(minDepth > maxDepth)
+	{
+		return false;
+	}
+
+	float minX = m_projection[0][0] * CalcMinScreenPos(viewCenter.GetX() - radius, minDepth, maxDepth);
+	float maxX = m_projection[0][0] * CalcMaxScreenPos(viewCenter.GetX() + radius, minDepth, maxDepth);
+	float minY = m_projection[1][1] * CalcMinScreenPos(viewCenter.GetY() - radius, minDepth, maxDepth);
+	float maxY = m_projection[1][1] * CalcMaxScreenPos(viewCenter.GetY() + radius, minDepth, maxDepth);
+	if(maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+	{
+		return false;
+	}
+
+	//Depth buffer values only ever increase with depth.
+	float minZ = (m_projection[2][2] + m_projection[3][2] / minDepth) * 0.5f + 0.5f;
+	float maxZ = (m_projection[2][2] + m_projection[3][2] / maxDepth) * 0.5f + 0.5f;
+
+	*minBounds = Vector3f(std::max(minX, -1.0f), std::max(minY, -1.0f), std::max(minZ, 0.0f));
+	*maxBounds = Vector3f(std::min(maxX, 1.0f), std::min(maxY, 1.0f), std::min(maxZ, 1.0f));
+	return true;
+}
+
 Camera Camera::GetCubeCamera(unsigned int index)
 {
 	index = index % 6;
@@ -87,11 +138,73 @@ Camera Camera::GetCubeCamera(unsigned int index)
     return Camera(projection, &transform);
 }
 
+void Camera::Test()
+{
+	Transform transform;
+	Camera camera(Matrix4f().InitPerspective(ToRadians(70.0f), 16.0f / 9.0f, 0.1f, 100.0f), &transform);
+	Vector3f minBounds;
+	Vector3f maxBounds;
+
+	assert(fabsf(camera.GetNearPlane() - 0.1f) < 0.0001f);
+	assert(fabsf(camera.GetFarPlane() - 100.0f) < 0.01f);
+
+	assert(camera.CalcScreenBounds(Vector3f(0.0f, 0.0f, 10.0f), 1.0f, &minBounds, &maxBounds));
+	assert(minBounds.GetX() < 0.0f && maxBounds.GetX() > 0.0f && minBounds.GetY() < 0.0f && maxBounds.GetY() > 0.0f);
+	assert(minBounds.GetZ() > 0.0f && maxBounds.GetZ() < 1.0f && minBounds.GetZ() < maxBounds.GetZ());
+
+	//Behind the camera, beyond the far plane, and off to the side.
+	assert(!camera.CalcScreenBounds(Vector3f(0.0f, 0.0f, -10.0f), 1.0f, &minBounds, &maxBounds));
+	assert(!camera.CalcScreenBounds(Vector3f(0.0f, 0.0f, 110.0f), 1.0f, &minBounds, &maxBounds));
+	assert(!camera.CalcScreenBounds(Vector3f(100.0f, 0.0f, 10.0f), 1.0f, &minBounds, &maxBounds));
+
+	//Spheres around the camera cover everything.
+	assert(camera.CalcScreenBounds(Vector3f(0.0f, 0.5f, 0.0f), 2.0f, &minBounds, &maxBounds));
+	assert(minBounds.GetX() == -1.0f && maxBounds.GetX() == 1.0f && minBounds.GetY() == -1.0f && maxBounds.GetY() == 1.0f);
+	assert(minBounds.GetZ() == 0.0f);
+
+	//Every visible point of a sphere must be inside its bounds, wherever the
+	//camera is looking from.
+	for(int i = 0; i < 200; i++)
+	{
+		transform.SetPos(Vector3f(Util::RandomFloat(-5.0f, 5.0f), Util::RandomFloat(-5.0f, 5.0f), Util::RandomFloat(-5.0f, 5.0f)));
+		transform.SetRot(Quaternion(Vector3f(Util::RandomFloat(-1.0f, 1.0f), Util::RandomFloat(-1.0f, 1.0f), Util::RandomFloat(-1.0f, 1.0f)).Normalized(),
+			Util::RandomFloat(0.0f, 6.28f)));
+		Vector3f center(Util::RandomFloat(-10.0f, 10.0f), Util::RandomFloat(-10.0f, 10.0f), Util::RandomFloat(-10.0f, 10.0f));
+		float radius = Util::RandomFloat(0.1f, 4.0f);
+		bool visible = camera.CalcScreenBounds(center, radius, &minBounds, &maxBounds);
+
+		Matrix4f viewProjection = camera.GetViewProjection();
+		for(int j = 0; j < 100; j++)
+		{
+			Vector3f offset(Util::RandomFloat(-1.0f, 1.0f), Util::RandomFloat(-1.0f, 1.0f), Util::RandomFloat(-1.0f, 1.0f));
+			Vector3f point = center + offset.Normalized() * (radius * Util::RandomFloat(0.0f, 1.0f));
+			Vector4f clip = viewProjection.Transform(Vector4f(point.GetX(), point.GetY(), point.GetZ(), 1.0f));
+			if(clip.GetW() <= 0.0f)
+			{
+				continue;
+			}
+
+			Vector3f screen(clip.GetX() / clip.GetW(), clip.GetY() / clip.GetW(), clip.GetZ() / clip.GetW() * 0.5f + 0.5f);
+			if(fabsf(screen.GetX()) > 1.0f || fabsf(screen.GetY()) > 1.0f || screen.GetZ() < 0.0f || screen.GetZ() > 1.0f)
+			{
+				continue;
+			}
+
+			const float epsilon = 0.0001f;
+			assert(visible);
+			assert(screen.GetX() >= minBounds.GetX() - epsilon && screen.GetX() <= maxBounds.GetX() + epsilon);
+			assert(screen.GetY() >= minBounds.GetY() - epsilon && screen.GetY() <= maxBounds.GetY() + epsilon);
+			assert(screen.GetZ() >= minBounds.GetZ() - epsilon && screen.GetZ() <= maxBounds.GetZ() + epsilon);
+		}
+	}
+}
+
 void CameraComponent::AddToEngine(CoreEngine* engine) const
 {
 	//TODO: This is probably not the correct solution in the case of multiple cameras,
 	//and should be investigated in the future.
 	engine->GetRenderingEngine()->SetMainCamera(m_camera);
+	EntityComponent::AddToEngine(engine);
 }
 
 void CameraComponent::SetParent(Entity* parent)
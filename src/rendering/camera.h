@@ -43,12 +43,33 @@ public:
 	Matrix4f GetView()					   const;
 	Matrix4f GetProjection()			   const;
 	Matrix4f GetCameraRotation()    	   const;
+
+	//Finds the part of the screen a sphere could cover, from -1 to 1 on each
+	//axis, and the range of depth buffer values it could have, from 0 to 1, as
+	//z. Returns false if none of the sphere can be seen. Only works when the
+	//projection was made by Matrix4f::InitPerspective.
+	bool CalcScreenBounds(const Vector3f& center, float radius, Vector3f* minBounds, Vector3f* maxBounds) const;
+
+	//How far in front of the camera the near and far planes are. Only work when
+	//the projection was made by Matrix4f::InitPerspective.
+	inline float GetNearPlane() const { return CalcNearPlane(m_projection); }
+	inline float GetFarPlane()  const { return CalcFarPlane(m_projection); }
+	static float CalcNearPlane(const Matrix4f& perspective);
+	static float CalcFarPlane(const Matrix4f& perspective);
+
+	//The smallest and largest screen positions, before scaling by the
+	//projection, of anything between x and the other side of a box in view
+	//space, from minDepth to maxDepth in front of the camera.
+	static inline float CalcMinScreenPos(float x, float minDepth, float maxDepth) { return x / (x < 0.0f ? minDepth : maxDepth); }
+	static inline float CalcMaxScreenPos(float x, float minDepth, float maxDepth) { return x / (x > 0.0f ? minDepth : maxDepth); }
 	
 	inline void SetProjection(const Matrix4f& projection) { m_projection = projection; }
 	inline void SetTransform(Transform* transform)        { m_transform = transform; }
 
 	static Camera GetCubeCamera(unsigned int index);
 
+	static void Test();
+
 protected:
 private:
 	Matrix4f   m_projection; //The projection with which the camera sees the world (i.e. perspective, orthographic, identity, etc.)
@@ -0,0 +1,1015 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compressedTexture.h"
+#include "../core/profiling.h"
+#include "../core/util.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+//OpenGL's names for the formats, which KTX files store.
+static const unsigned int GL_COMPRESSED_RGB_S3TC_DXT1  = 0x83F0;
+static const unsigned int GL_COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+static const unsigned int GL_COMPRESSED_RG_RGTC2       = 0x8DBD;
+static const unsigned int GL_RGB_FORMAT                = 0x1907;
+static const unsigned int GL_RGBA_FORMAT               = 0x1908;
+static const unsigned int GL_RG_FORMAT                 = 0x8227;
+
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const unsigned int KTX_ENDIANNESS = 0x04030201;
+
+//The start of every KTX 1.1 file. The key/value data after it is skipped,
+//then each mip level is its size in bytes followed by its blocks.
+struct KtxHeader
+{
+	unsigned char identifier[12];
+	unsigned int  endianness;
+	unsigned int  glType;
+	unsigned int  glTypeSize;
+	unsigned int  glFormat;
+	unsigned int  glInternalFormat;
+	unsigned int  glBaseInternalFormat;
+	unsigned int  pixelWidth;
+	unsigned int  pixelHeight;
+	unsigned int  pixelDepth;
+	unsigned int  numberOfArrayElements;
+	unsigned int  numberOfFaces;
+	unsigned int  numberOfMipmapLevels;
+	unsigned int  bytesOfKeyValueData;
+};
+
+static const float PI = 3.14159265358979f;
+
+//Lobes either side of the middle of the Lanczos filter used for mips.
+static const float LANCZOS_RADIUS = 2.0f;
+
+static float Lanczos(float x)
+{
+	x = fabsf(x);
+	if(x < 1e-5f)
+	{
+		return 1.0f;
+	}
+	if(x >= LANCZOS_RADIUS)
+	{
+		return 0.0f;
+	}
+	return LANCZOS_RADIUS * sinf(PI * x) * sinf(PI * x / LANCZOS_RADIUS) / (PI * PI * x * x);
+}
+
+//The source pixels, and how much of each, that make up every resampled pixel
+//along one axis. Each pixel has numTaps of them, starting at its first tap.
+struct FilterTaps
+{
+	int                numTaps;
+	std::vector<int>   firstTaps;
+	std::vector<float> weights;
+};
+
+static void CalcFilterTaps(int size, int resultSize, FilterTaps* taps)
+{
+	float scale = (float)size / (float)resultSize;
+	float radius = LANCZOS_RADIUS * std::max(scale, 1.0f);
+	taps->numTaps = (int)ceilf(radius * 2.0f) + 1;
+	taps->firstTaps.resize(resultSize);
+	taps->weights.resize(resultSize * taps->numTaps);
+	for(int i = 0; i < resultSize; i++)
+	{
+		float center = ((float)i + 0.5f) * scale - 0.5f;
+		int firstTap = (int)floorf(center - radius) + 1;
+		float totalWeight = 0.0f;
+		for(int j = 0; j < taps->numTaps; j++)
+		{
+			float weight = Lanczos(((float)(firstTap + j) - center) / std::max(scale, 1.0f));
+			taps->weights[i * taps->numTaps + j] = weight;
+			totalWeight += weight;
+		}
+		for(int j = 0; j < taps->numTaps; j++)
+		{
+			taps->weights[i * taps->numTaps + j] /= totalWeight;
+		}
+		taps->firstTaps[i] = firstTap;
+	}
+}
+
+static inline int AddressPixel(int x, int size, bool isWrapped)
+{
+	if(isWrapped)
+	{
+		x %= size;
+		return x < 0 ? x + size : x;
+	}
+	return std::min(std::max(x, 0), size - 1);
+}
+
+static inline unsigned char ToByte(float value)
+{
+	return (unsigned char)std::min(std::max(value + 0.5f, 0.0f), 255.0f);
+}
+
+//Both from 0 to 255, so linear values are filtered and rounded like any other.
+static inline float SRGBToLinear(float value)
+{
+	value /= 255.0f;
+	return 255.0f * (value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f));
+}
+
+static inline float LinearToSRGB(float value)
+{
+	value = std::min(std::max(value / 255.0f, 0.0f), 1.0f);
+	return 255.0f * (value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f);
+}
+
+void CompressedTexture::Resample(const unsigned char* pixels, int width, int height, unsigned char* result, int resultWidth, int resultHeight,
+	TextureContent content, bool isWrapped)
+{
+	//Averaging sRGB values directly would darken everywhere light and dark
+	//meet, so colours are filtered as the light they stand for. Alpha is
+	//always stored linearly.
+	float channelValues[4][256];
+	for(int i = 0; i < 256; i++)
+	{
+		float linear = content == TEXTURE_CONTENT_COLOR ? SRGBToLinear((float)i) : (float)i;
+		channelValues[0][i] = channelValues[1][i] = channelValues[2][i] = linear;
+		channelValues[3][i] = (float)i;
+	}
+
+	FilterTaps horizontalTaps;
+	FilterTaps verticalTaps;
+	CalcFilterTaps(width, resultWidth, &horizontalTaps);
+	CalcFilterTaps(height, resultHeight, &verticalTaps);
+
+	//Across first, keeping every row, then down.
+	std::vector<float> across(resultWidth * height * 4);
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < resultWidth; x++)
+		{
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for(int i = 0; i < horizontalTaps.numTaps; i++)
+			{
+				float weight = horizontalTaps.weights[x * horizontalTaps.numTaps + i];
+				const unsigned char* pixel = &pixels[(y * width + AddressPixel(horizontalTaps.firstTaps[x] + i, width, isWrapped)) * 4];
+				for(int j = 0; j < 4; j++)
+				{
+					sum[j] += weight * channelValues[j][pixel[j]];
+				}
+			}
+			memcpy(&across[(y * resultWidth + x) * 4], sum, sizeof(sum));
+		}
+	}
+
+	for(int y = 0; y < resultHeight; y++)
+	{
+		for(int x = 0; x < resultWidth; x++)
+		{
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for(int i = 0; i < verticalTaps.numTaps; i++)
+			{
+				float weight = verticalTaps.weights[y * verticalTaps.numTaps + i];
+				const float* pixel = &across[(AddressPixel(verticalTaps.firstTaps[y] + i, height, isWrapped) * resultWidth + x) * 4];
+				for(int j = 0; j < 4; j++)
+				{
+					sum[j] += weight * pixel[j];
+				}
+			}
+
+			if(content == TEXTURE_CONTENT_COLOR)
+			{
+				for(int j = 0; j < 3; j++)
+				{
+					sum[j] = LinearToSRGB(sum[j]);
+				}
+			}
+			else if(content == TEXTURE_CONTENT_NORMAL)
+			{
+				//Averaged normals are shorter than they should be, which would
+				//make lighting dimmer in the distance.
+				float normal[3] = { sum[0] / 127.5f - 1.0f, sum[1] / 127.5f - 1.0f, sum[2] / 127.5f - 1.0f };
+				float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				for(int j = 0; j < 3 && length > 0.0f; j++)
+				{
+					sum[j] = (normal[j] / length + 1.0f) * 127.5f;
+				}
+			}
+
+			unsigned char* resultPixel = &result[(y * resultWidth + x) * 4];
+			for(int j = 0; j < 4; j++)
+			{
+				resultPixel[j] = ToByte(sum[j]);
+			}
+		}
+	}
+}
+
+static inline unsigned short To565(const float* color)
+{
+	int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+	int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static inline void From565(unsigned short color, int* rgb)
+{
+	int r = (color >> 11) & 31;
+	int g = (color >> 5) & 63;
+	int b = color & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+//The four colours a block with these endpoints can use, in the 4 colour mode
+//where the first endpoint is the larger.
+static void CalcColorPalette(unsigned short color0, unsigned short color1, int palette[4][3])
+{
+	From565(color0, palette[0]);
+	From565(color1, palette[1]);
+	for(int i = 0; i < 3; i++)
+	{
+		palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+		palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+	}
+}
+
+//Picks the nearest palette colour for every pixel, returning the total
+//squared error. Endpoints are swapped if needed so the block is in 4 colour mode.
+static int FitColorIndices(const unsigned char* pixels, unsigned short* color0, unsigned short* color1, unsigned int* indices)
+{
+	if(*color0 < *color1)
+	{
+		std::swap(*color0, *color1);
+	}
+
+	int palette[4][3];
+	CalcColorPalette(*color0, *color1, palette);
+	int numColors = *color0 == *color1 ? 1 : 4;
+
+	int totalError = 0;
+	*indices = 0;
+	for(int i = 0; i < 16; i++)
+	{
+		int bestError = 0x7FFFFFFF;
+		int bestIndex = 0;
+		for(int j = 0; j < numColors; j++)
+		{
+			int dr = pixels[i * 4] - palette[j][0];
+			int dg = pixels[i * 4 + 1] - palette[j][1];
+			int db = pixels[i * 4 + 2] - palette[j][2];
+			int error = dr * dr + dg * dg + db * db;
+			if(error < bestError)
+			{
+				bestError = error;
+				bestIndex = j;
+			}
+		}
+		*indices |= (unsigned int)bestIndex << (i * 2);
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+//Endpoints along the colours' principal axis, then refined once by least
+//squares for the indices they gave.
+static void CompressColorBlock(const unsigned char* pixels, unsigned char* block)
+{
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for(int i = 0; i < 16; i++)
+	{
+		for(int j = 0; j < 3; j++)
+		{
+			mean[j] += pixels[i * 4 + j] / 16.0f;
+		}
+	}
+
+	float covariance[3][3] = { { 0 } };
+	for(int i = 0; i < 16; i++)
+	{
+		float d[3] = { pixels[i * 4] - mean[0], pixels[i * 4 + 1] - mean[1], pixels[i * 4 + 2] - mean[2] };
+		for(int j = 0; j < 3; j++)
+		{
+			for(int k = 0; k < 3; k++)
+			{
+				covariance[j][k] += d[j] * d[k];
+			}
+		}
+	}
+
+	//Power iteration, starting from the luminance direction, which is close
+	//to right for most blocks.
+	float axis[3] = { 0.577f, 0.577f, 0.577f };
+	for(int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[3];
+		for(int j = 0; j < 3; j++)
+		{
+			next[j] = covariance[j][0] * axis[0] + covariance[j][1] * axis[1] + covariance[j][2] * axis[2];
+		}
+		float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if(length < 1e-6f)
+		{
+			break;
+		}
+		for(int j = 0; j < 3; j++)
+		{
+			axis[j] = next[j] / length;
+		}
+	}
+
+	float minProjection = 0.0f;
+	float maxProjection = 0.0f;
+	for(int i = 0; i < 16; i++)
+	{
+		float projection = (pixels[i * 4] - mean[0]) * axis[0] + (pixels[i * 4 + 1] - mean[1]) * axis[1] + (pixels[i * 4 + 2] - mean[2]) * axis[2];
+		minProjection = std::min(minProjection, projection);
+		maxProjection = std::max(maxProjection, projection);
+	}
+
+	float endpoint0[3];
+	float endpoint1[3];
+	for(int j = 0; j < 3; j++)
+	{
+		endpoint0[j] = mean[j] + axis[j] * maxProjection;
+		endpoint1[j] = mean[j] + axis[j] * minProjection;
+	}
+	unsigned short color0 = To565(endpoint0);
+	unsigned short color1 = To565(endpoint1);
+	unsigned int indices;
+	int error = FitColorIndices(pixels, &color0, &color1, &indices);
+
+	//The endpoints that best reproduce the block with those indices.
+	static const float WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	float aa = 0.0f;
+	float ab = 0.0f;
+	float bb = 0.0f;
+	float ax[3] = { 0.0f, 0.0f, 0.0f };
+	float bx[3] = { 0.0f, 0.0f, 0.0f };
+	for(int i = 0; i < 16; i++)
+	{
+		float a = WEIGHTS[(indices >> (i * 2)) & 3];
+		float b = 1.0f - a;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for(int j = 0; j < 3; j++)
+		{
+			ax[j] += a * pixels[i * 4 + j];
+			bx[j] += b * pixels[i * 4 + j];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if(color0 != color1 && fabsf(determinant) > 1e-6f)
+	{
+		for(int j = 0; j < 3; j++)
+		{
+			endpoint0[j] = (bb * ax[j] - ab * bx[j]) / determinant;
+			endpoint1[j] = (aa * bx[j] - ab * ax[j]) / determinant;
+		}
+		unsigned short refinedColor0 = To565(endpoint0);
+		unsigned short refinedColor1 = To565(endpoint1);
+		unsigned int refinedIndices;
+		if(FitColorIndices(pixels, &refinedColor0, &refinedColor1, &refinedIndices) < error)
+		{
+			color0 = refinedColor0;
+			color1 = refinedColor1;
+			indices = refinedIndices;
+		}
+	}
+
+	memcpy(block, &color0, 2);
+	memcpy(block + 2, &color1, 2);
+	memcpy(block + 4, &indices, 4);
+}
+
+//One channel of a block, as BC3's alpha and each of BC5's channels are
+//stored: two endpoints, with six values evenly spaced between them.
+static void CompressChannelBlock(const unsigned char* pixels, int channel, unsigned char* block)
+{
+	int minValue = 255;
+	int maxValue = 0;
+	for(int i = 0; i < 16; i++)
+	{
+		minValue = std::min(minValue, (int)pixels[i * 4 + channel]);
+		maxValue = std::max(maxValue, (int)pixels[i * 4 + channel]);
+	}
+
+	int palette[8];
+	palette[0] = maxValue;
+	palette[1] = minValue;
+	for(int i = 2; i < 8; i++)
+	{
+		palette[i] = ((8 - i) * maxValue + (i - 1) * minValue) / 7;
+	}
+
+	unsigned long long indices = 0;
+	for(int i = 0; i < 16 && maxValue > minValue; i++)
+	{
+		int bestIndex = 0;
+		for(int j = 1; j < 8; j++)
+		{
+			if(abs(pixels[i * 4 + channel] - palette[j]) < abs(pixels[i * 4 + channel] - palette[bestIndex]))
+			{
+				bestIndex = j;
+			}
+		}
+		indices |= (unsigned long long)bestIndex << (i * 3);
+	}
+
+	block[0] = (unsigned char)maxValue;
+	block[1] = (unsigned char)minValue;
+	for(int i = 0; i < 6; i++)
+	{
+		block[2 + i] = (unsigned char)(indices >> (i * 8));
+	}
+}
+
+static void DecompressColorBlock(const unsigned char* block, bool isBC1, unsigned char* pixels)
+{
+	unsigned short color0;
+	unsigned short color1;
+	unsigned int indices;
+	memcpy(&color0, block, 2);
+	memcpy(&color1, block + 2, 2);
+	memcpy(&indices, block + 4, 4);
+
+	int palette[4][4];
+	From565(color0, palette[0]);
+	From565(color1, palette[1]);
+	palette[0][3] = 255;
+	palette[1][3] = 255;
+	palette[2][3] = 255;
+	palette[3][3] = 255;
+	if(color0 > color1 || !isBC1)
+	{
+		for(int i = 0; i < 3; i++)
+		{
+			palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+			palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+		}
+	}
+	else
+	{
+		//BC1's 3 colour mode, with transparent black as the fourth.
+		for(int i = 0; i < 3; i++)
+		{
+			palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+			palette[3][i] = 0;
+		}
+		palette[3][3] = 0;
+	}
+
+	for(int i = 0; i < 16; i++)
+	{
+		const int* color = palette[(indices >> (i * 2)) & 3];
+		for(int j = 0; j < 4; j++)
+		{
+			pixels[i * 4 + j] = (unsigned char)color[j];
+		}
+	}
+}
+
+static void DecompressChannelBlock(const unsigned char* block, int channel, unsigned char* pixels)
+{
+	int palette[8];
+	palette[0] = block[0];
+	palette[1] = block[1];
+	if(palette[0] > palette[1])
+	{
+		for(int i = 2; i < 8; i++)
+		{
+			palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7;
+		}
+	}
+	else
+	{
+		for(int i = 2; i < 6; i++)
+		{
+			palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	unsigned long long indices = 0;
+	for(int i = 0; i < 6; i++)
+	{
+		indices |= (unsigned long long)block[2 + i] << (i * 8);
+	}
+	for(int i = 0; i < 16; i++)
+	{
+		pixels[i * 4 + channel] = (unsigned char)palette[(indices >> (i * 3)) & 7];
+	}
+}
+
+static int GetBlockSize(TextureCompression compression)
+{
+	return compression == TEXTURE_COMPRESSION_BC1 ? 8 : 16;
+}
+
+//Compresses a row of blocks at a time.
+class CompressTask : public ThreadPoolTask
+{
+public:
+	CompressTask(const unsigned char* pixels, int width, int height, TextureCompression compression, unsigned char* blocks) :
+		m_pixels(pixels),
+		m_width(width),
+		m_height(height),
+		m_compression(compression),
+		m_blocks(blocks) {}
+
+	virtual void Run(unsigned int index)
+	{
+		int numBlocksX = (m_width + 3) / 4;
+		int blockSize = GetBlockSize(m_compression);
+		for(int blockX = 0; blockX < numBlocksX; blockX++)
+		{
+			//Blocks hanging off the edge repeat the last row and column.
+			unsigned char pixels[16 * 4];
+			for(int y = 0; y < 4; y++)
+			{
+				for(int x = 0; x < 4; x++)
+				{
+					int sourceX = std::min(blockX * 4 + x, m_width - 1);
+					int sourceY = std::min((int)index * 4 + y, m_height - 1);
+					memcpy(&pixels[(y * 4 + x) * 4], &m_pixels[(sourceY * m_width + sourceX) * 4], 4);
+				}
+			}
+
+			unsigned char* block = m_blocks + (index * numBlocksX + blockX) * blockSize;
+			if(m_compression == TEXTURE_COMPRESSION_BC1)
+			{
+				CompressColorBlock(pixels, block);
+			}
+			else if(m_compression == TEXTURE_COMPRESSION_BC3)
+			{
+				CompressChannelBlock(pixels, 3, block);
+				CompressColorBlock(pixels, block + 8);
+			}
+			else
+			{
+				CompressChannelBlock(pixels, 0, block);
+				CompressChannelBlock(pixels, 1, block + 8);
+			}
+		}
+	}
+private:
+	const unsigned char* m_pixels;
+	int                  m_width;
+	int                  m_height;
+	TextureCompression   m_compression;
+	unsigned char*       m_blocks;
+};
+
+CompressedTexture::CompressedTexture(const unsigned char* pixels, int width, int height, TextureCompression compression,
+	TextureContent content, bool isWrapped, ThreadPool* threadPool) :
+	m_file(0),
+	m_compression(compression),
+	m_width(width),
+	m_height(height),
+	m_isValid(width > 0 && height > 0)
+{
+	if(!m_isValid)
+	{
+		return;
+	}
+
+	int numMips = 1;
+	while(GetMipWidth(numMips - 1) > 1 || GetMipHeight(numMips - 1) > 1)
+	{
+		numMips++;
+	}
+
+	std::vector<unsigned int> mipOffsets(numMips);
+	unsigned int totalSize = 0;
+	for(int i = 0; i < numMips; i++)
+	{
+		mipOffsets[i] = totalSize;
+		totalSize += GetMipSize(i);
+	}
+	m_mipData.resize(totalSize);
+
+	//Each mip is filtered down from the one before.
+	std::vector<unsigned char> mipPixels(pixels, pixels + width * height * 4);
+	std::vector<unsigned char> nextMipPixels;
+	for(int i = 0; i < numMips; i++)
+	{
+		if(i > 0)
+		{
+			nextMipPixels.resize(GetMipWidth(i) * GetMipHeight(i) * 4);
+			Resample(&mipPixels[0], GetMipWidth(i - 1), GetMipHeight(i - 1), &nextMipPixels[0], GetMipWidth(i), GetMipHeight(i),
+				content, isWrapped);
+			mipPixels.swap(nextMipPixels);
+		}
+
+		CompressTask task(&mipPixels[0], GetMipWidth(i), GetMipHeight(i), compression, &m_mipData[mipOffsets[i]]);
+		unsigned int numBlockRows = (unsigned int)(GetMipHeight(i) + 3) / 4;
+		if(threadPool)
+		{
+			threadPool->ParallelFor(&task, numBlockRows);
+		}
+		else
+		{
+			for(unsigned int j = 0; j < numBlockRows; j++)
+			{
+				task.Run(j);
+			}
+		}
+	}
+
+	for(int i = 0; i < numMips; i++)
+	{
+		m_mips.push_back(&m_mipData[mipOffsets[i]]);
+	}
+}
+
+CompressedTexture::CompressedTexture(const std::string& fileName) :
+	m_file(new MappedFile(fileName)),
+	m_compression(TEXTURE_COMPRESSION_BC1),
+	m_width(0),
+	m_height(0),
+	m_isValid(false)
+{
+	if(!m_file->IsOpen() || m_file->GetSize() < sizeof(KtxHeader))
+	{
+		return;
+	}
+
+	KtxHeader header;
+	memcpy(&header, m_file->GetData(), sizeof(header));
+	if(memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 || header.endianness != KTX_ENDIANNESS ||
+		header.glType != 0 || header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelWidth > 65536 || header.pixelHeight > 65536 ||
+		header.pixelDepth != 0 || header.numberOfArrayElements != 0 || header.numberOfFaces != 1 || header.numberOfMipmapLevels == 0)
+	{
+		return;
+	}
+
+	if(header.glInternalFormat == GL_COMPRESSED_RGB_S3TC_DXT1)
+	{
+		m_compression = TEXTURE_COMPRESSION_BC1;
+	}
+	else if(header.glInternalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5)
+	{
+		m_compression = TEXTURE_COMPRESSION_BC3;
+	}
+	else if(header.glInternalFormat == GL_COMPRESSED_RG_RGTC2)
+	{
+		m_compression = TEXTURE_COMPRESSION_BC5;
+	}
+	else
+	{
+		return;
+	}
+
+	m_width = (int)header.pixelWidth;
+	m_height = (int)header.pixelHeight;
+	size_t offset = sizeof(header) + header.bytesOfKeyValueData;
+	for(unsigned int i = 0; i < header.numberOfMipmapLevels && i < 32; i++)
+	{
+		unsigned int imageSize;
+		if(offset > m_file->GetSize() || m_file->GetSize() - offset < sizeof(imageSize))
+		{
+			break;
+		}
+		memcpy(&imageSize, m_file->GetData() + offset, sizeof(imageSize));
+		offset += sizeof(imageSize);
+		if(imageSize != GetMipSize(i) || m_file->GetSize() - offset < imageSize)
+		{
+			break;
+		}
+
+		m_mips.push_back(m_file->GetData() + offset);
+		offset += (imageSize + 3) / 4 * 4;
+	}
+	m_isValid = m_mips.size() == header.numberOfMipmapLevels;
+}
+
+CompressedTexture::~CompressedTexture()
+{
+	delete m_file;
+}
+
+bool CompressedTexture::Save(const std::string& fileName) const
+{
+	KtxHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+	header.endianness = KTX_ENDIANNESS;
+	header.glTypeSize = 1;
+	header.glInternalFormat = GetInternalFormat();
+	header.glBaseInternalFormat = m_compression == TEXTURE_COMPRESSION_BC1 ? GL_RGB_FORMAT :
+		m_compression == TEXTURE_COMPRESSION_BC3 ? GL_RGBA_FORMAT : GL_RG_FORMAT;
+	header.pixelWidth = m_width;
+	header.pixelHeight = m_height;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = GetNumMips();
+
+	bool complete;
+	{
+		std::ofstream file(Util::GetPartialFileName(fileName).c_str(), std::ios::binary);
+		if(!file)
+		{
+			return false;
+		}
+
+		file.write((const char*)&header, sizeof(header));
+		for(int i = 0; i < GetNumMips(); i++)
+		{
+			//Blocks are 8 or 16 bytes, so mips never need padding to 4.
+			unsigned int imageSize = GetMipSize(i);
+			file.write((const char*)&imageSize, sizeof(imageSize));
+			file.write((const char*)m_mips[i], imageSize);
+		}
+
+		complete = file.good();
+	}
+
+	return Util::CommitPartialFile(fileName, complete);
+}
+
+unsigned int CompressedTexture::GetInternalFormat() const
+{
+	if(m_compression == TEXTURE_COMPRESSION_BC1)
+	{
+		return GL_COMPRESSED_RGB_S3TC_DXT1;
+	}
+	return m_compression == TEXTURE_COMPRESSION_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5 : GL_COMPRESSED_RG_RGTC2;
+}
+
+unsigned int CompressedTexture::GetMipSize(int mip) const
+{
+	return CalcBlocksSize(m_compression, GetMipWidth(mip), GetMipHeight(mip));
+}
+
+unsigned int CompressedTexture::CalcBlocksSize(TextureCompression compression, int width, int height)
+{
+	return (unsigned int)(((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(compression));
+}
+
+void CompressedTexture::Decompress(TextureCompression compression, const unsigned char* blocks, int width, int height, unsigned char* pixels)
+{
+	int numBlocksX = (width + 3) / 4;
+	int numBlocksY = (height + 3) / 4;
+	int blockSize = GetBlockSize(compression);
+	for(int blockY = 0; blockY < numBlocksY; blockY++)
+	{
+		for(int blockX = 0; blockX < numBlocksX; blockX++)
+		{
+			const unsigned char* block = blocks + (blockY * numBlocksX + blockX) * blockSize;
+			unsigned char blockPixels[16 * 4];
+			if(compression == TEXTURE_COMPRESSION_BC1)
+			{
+				DecompressColorBlock(block, true, blockPixels);
+			}
+			else if(compression == TEXTURE_COMPRESSION_BC3)
+			{
+				DecompressColorBlock(block + 8, false, blockPixels);
+				DecompressChannelBlock(block, 3, blockPixels);
+			}
+			else
+			{
+				DecompressChannelBlock(block, 0, blockPixels);
+				DecompressChannelBlock(block + 8, 1, blockPixels);
+				for(int i = 0; i < 16; i++)
+				{
+					blockPixels[i * 4 + 2] = 0;
+					blockPixels[i * 4 + 3] = 255;
+				}
+			}
+
+			for(int y = 0; y < 4 && blockY * 4 + y < height; y++)
+			{
+				for(int x = 0; x < 4 && blockX * 4 + x < width; x++)
+				{
+					memcpy(&pixels[((blockY * 4 + y) * width + blockX * 4 + x) * 4], &blockPixels[(y * 4 + x) * 4], 4);
+				}
+			}
+		}
+	}
+}
+
+//Root mean squared difference between two RGBA images, over the channels in mask.
+static float CalcRMSE(const unsigned char* a, const unsigned char* b, int numPixels, const bool* mask)
+{
+	double sum = 0.0;
+	int numValues = 0;
+	for(int i = 0; i < numPixels; i++)
+	{
+		for(int j = 0; j < 4; j++)
+		{
+			if(mask[j])
+			{
+				double difference = (double)a[i * 4 + j] - (double)b[i * 4 + j];
+				sum += difference * difference;
+				numValues++;
+			}
+		}
+	}
+	return (float)sqrt(sum / numValues);
+}
+
+//Something like a photo: smooth gradients with some noise and a few edges.
+static std::vector<unsigned char> CreateTestImage(int width, int height, bool isNormalMap)
+{
+	std::vector<unsigned char> pixels(width * height * 4);
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < width; x++)
+		{
+			unsigned char* pixel = &pixels[(y * width + x) * 4];
+			float u = (float)x / width;
+			float v = (float)y / height;
+			float noise = (float)(rand() % 9 - 4);
+			if(isNormalMap)
+			{
+				float nx = 0.5f * sinf(u * 12.0f) * cosf(v * 7.0f);
+				float ny = 0.5f * cosf(u * 5.0f + v * 9.0f);
+				float nz = sqrtf(std::max(1.0f - nx * nx - ny * ny, 0.0f));
+				pixel[0] = ToByte((nx + 1.0f) * 127.5f);
+				pixel[1] = ToByte((ny + 1.0f) * 127.5f);
+				pixel[2] = ToByte((nz + 1.0f) * 127.5f);
+				pixel[3] = 255;
+			}
+			else
+			{
+				bool isEdge = ((x / 24) + (y / 24)) % 2 == 0;
+				pixel[0] = ToByte(200.0f * u + noise + (isEdge ? 40.0f : 0.0f));
+				pixel[1] = ToByte(120.0f + 100.0f * sinf(v * 6.0f) + noise);
+				pixel[2] = ToByte(60.0f + 150.0f * u * v + noise);
+				pixel[3] = ToByte(255.0f * v);
+			}
+		}
+	}
+	return pixels;
+}
+
+void CompressedTexture::Test()
+{
+	//A flat image stays flat through every mip, wrapped or not.
+	std::vector<unsigned char> flat(37 * 20 * 4);
+	for(unsigned int i = 0; i < flat.size(); i += 4)
+	{
+		flat[i] = 10;
+		flat[i + 1] = 100;
+		flat[i + 2] = 200;
+		flat[i + 3] = 255;
+	}
+	std::vector<unsigned char> halved(18 * 10 * 4);
+	TextureContent flatContents[2] = { TEXTURE_CONTENT_COLOR, TEXTURE_CONTENT_DATA };
+	for(int isWrapped = 0; isWrapped < 2; isWrapped++)
+	{
+		for(int content = 0; content < 2; content++)
+		{
+			Resample(&flat[0], 37, 20, &halved[0], 18, 10, flatContents[content], isWrapped != 0);
+			for(unsigned int i = 0; i < halved.size(); i++)
+			{
+				assert(halved[i] == flat[i]);
+			}
+		}
+	}
+
+	//Black and white stripes average to half as much light, which is brighter
+	//than halfway once it's sRGB encoded again. Data is averaged as it is.
+	std::vector<unsigned char> stripes(16 * 16 * 4);
+	for(int i = 0; i < 16 * 16; i++)
+	{
+		unsigned char value = (i % 2) ? 255 : 0;
+		stripes[i * 4] = stripes[i * 4 + 1] = stripes[i * 4 + 2] = stripes[i * 4 + 3] = value;
+	}
+	std::vector<unsigned char> stripesMip(8 * 8 * 4);
+	Resample(&stripes[0], 16, 16, &stripesMip[0], 8, 8, TEXTURE_CONTENT_COLOR, true);
+	assert(abs(stripesMip[0] - 188) <= 2 && abs(stripesMip[3] - 128) <= 1);
+	Resample(&stripes[0], 16, 16, &stripesMip[0], 8, 8, TEXTURE_CONTENT_DATA, true);
+	assert(abs(stripesMip[0] - 128) <= 1 && abs(stripesMip[3] - 128) <= 1);
+
+	//Normal map mips stay unit length.
+	srand(3);
+	std::vector<unsigned char> normalMap = CreateTestImage(64, 64, true);
+	std::vector<unsigned char> normalMip(32 * 32 * 4);
+	Resample(&normalMap[0], 64, 64, &normalMip[0], 32, 32, TEXTURE_CONTENT_NORMAL, true);
+	for(int i = 0; i < 32 * 32; i++)
+	{
+		float x = normalMip[i * 4] / 127.5f - 1.0f;
+		float y = normalMip[i * 4 + 1] / 127.5f - 1.0f;
+		float z = normalMip[i * 4 + 2] / 127.5f - 1.0f;
+		assert(fabsf(sqrtf(x * x + y * y + z * z) - 1.0f) < 0.02f);
+	}
+
+	//Every mip down to 1 by 1 is there, with the right number of blocks.
+	CompressedTexture flatTexture(&flat[0], 37, 20, TEXTURE_COMPRESSION_BC1);
+	assert(flatTexture.IsValid() && flatTexture.GetNumMips() == 6);
+	assert(flatTexture.GetMipWidth(1) == 18 && flatTexture.GetMipHeight(1) == 10);
+	assert(flatTexture.GetMipWidth(5) == 1 && flatTexture.GetMipHeight(5) == 1);
+	assert(flatTexture.GetMipSize(0) == 10 * 5 * 8 && flatTexture.GetMipSize(5) == 8);
+	std::vector<unsigned char> decompressed(37 * 20 * 4);
+	Decompress(TEXTURE_COMPRESSION_BC1, flatTexture.GetMipData(0), 37, 20, &decompressed[0]);
+	for(int i = 0; i < 37 * 20; i++)
+	{
+		assert(abs(decompressed[i * 4] - 10) <= 4 && abs(decompressed[i * 4 + 1] - 100) <= 2 && abs(decompressed[i * 4 + 2] - 200) <= 4);
+		assert(decompressed[i * 4 + 3] == 255);
+	}
+
+	//Compression only loses a little, and is the same however it's threaded.
+	const bool RGB[4] = { true, true, true, false };
+	const bool ALPHA[4] = { false, false, false, true };
+	const bool RG[4] = { true, true, false, false };
+	ThreadPool threadPool(4);
+	TextureCompression compressions[3] = { TEXTURE_COMPRESSION_BC1, TEXTURE_COMPRESSION_BC3, TEXTURE_COMPRESSION_BC5 };
+	for(int i = 0; i < 3; i++)
+	{
+		bool isNormalMap = compressions[i] == TEXTURE_COMPRESSION_BC5;
+		TextureContent content = isNormalMap ? TEXTURE_CONTENT_NORMAL : TEXTURE_CONTENT_COLOR;
+		srand(5);
+		std::vector<unsigned char> image = CreateTestImage(128, 96, isNormalMap);
+		CompressedTexture texture(&image[0], 128, 96, compressions[i], content);
+		CompressedTexture threadedTexture(&image[0], 128, 96, compressions[i], content, true, &threadPool);
+		assert(texture.GetNumMips() == 8 && threadedTexture.GetNumMips() == 8);
+		for(int mip = 0; mip < texture.GetNumMips(); mip++)
+		{
+			assert(memcmp(texture.GetMipData(mip), threadedTexture.GetMipData(mip), texture.GetMipSize(mip)) == 0);
+		}
+
+		std::vector<unsigned char> result(128 * 96 * 4);
+		Decompress(compressions[i], texture.GetMipData(0), 128, 96, &result[0]);
+		if(isNormalMap)
+		{
+			assert(CalcRMSE(&image[0], &result[0], 128 * 96, RG) < 1.0f);
+		}
+		else
+		{
+			assert(CalcRMSE(&image[0], &result[0], 128 * 96, RGB) < 6.0f);
+		}
+		if(compressions[i] == TEXTURE_COMPRESSION_BC3)
+		{
+			assert(CalcRMSE(&image[0], &result[0], 128 * 96, ALPHA) < 1.0f);
+		}
+
+		//Saved and mapped back, every block is the same.
+		std::string fileName = "./compressedTextureTest.ktx";
+		bool saved = texture.Save(fileName);
+		assert(saved);
+		CompressedTexture loaded(fileName);
+		assert(loaded.IsValid() && loaded.GetCompression() == compressions[i]);
+		assert(loaded.GetWidth() == 128 && loaded.GetHeight() == 96 && loaded.GetNumMips() == texture.GetNumMips());
+		for(int mip = 0; mip < texture.GetNumMips(); mip++)
+		{
+			assert(memcmp(texture.GetMipData(mip), loaded.GetMipData(mip), texture.GetMipSize(mip)) == 0);
+		}
+
+		//Cut short, it's rejected rather than read past its end.
+		std::vector<char> contents;
+		{
+			std::ifstream file(fileName.c_str(), std::ios::binary);
+			contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+		{
+			std::ofstream file(fileName.c_str(), std::ios::binary);
+			file.write(&contents[0], contents.size() - 1);
+		}
+		assert(!CompressedTexture(fileName).IsValid());
+		remove(fileName.c_str());
+	}
+	assert(!CompressedTexture("./res/textures/doesNotExist.ktx").IsValid());
+}
+
+void CompressedTexture::Benchmark()
+{
+	srand(9);
+	std::vector<unsigned char> image = CreateTestImage(1024, 1024, false);
+	unsigned int maxThreads = ThreadPool::GetNumCPUs();
+	for(unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		ThreadPool* threadPool = numThreads > 1 ? new ThreadPool(numThreads) : 0;
+		ProfileTimer timer;
+		timer.StartInvocation();
+		CompressedTexture texture(&image[0], 1024, 1024, TEXTURE_COMPRESSION_BC1, TEXTURE_CONTENT_COLOR, true, threadPool);
+		timer.StopInvocation();
+		delete threadPool;
+
+		std::ostringstream message;
+		message << "Texture cooking (1024x1024 BC1, " << numThreads << " threads): ";
+		timer.DisplayAndReset(message.str(), 0, 56);
+	}
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPRESSEDTEXTURE_H
+#define COMPRESSEDTEXTURE_H
+
+#include "../core/mappedFile.h"
+#include "../core/threadPool.h"
+
+#include <string>
+#include <vector>
+
+//The block compressed formats textures are cooked into. Each one stores 4x4
+//pixel blocks in a fixed number of bytes, and is read directly by the GPU.
+enum TextureCompression
+{
+	TEXTURE_COMPRESSION_BC1, //RGB in 8 bytes per block, for anything without alpha
+	TEXTURE_COMPRESSION_BC3, //RGBA in 16 bytes per block, with alpha stored apart from the colour
+	TEXTURE_COMPRESSION_BC5  //Just red and green in 16 bytes per block, each as well as BC3's alpha, for normal maps
+};
+
+//What a texture's pixels hold, which decides how its mips are filtered.
+enum TextureContent
+{
+	TEXTURE_CONTENT_COLOR,  //sRGB encoded colour, filtered in linear light
+	TEXTURE_CONTENT_NORMAL, //Normals, renormalized once they've been filtered
+	TEXTURE_CONTENT_DATA    //Anything else, like displacement, filtered as it's stored
+};
+
+//A block compressed texture with every mip level, either cooked from pixels
+//or mapped from a KTX file written by Save, in which case the mips are used
+//where they are in the mapping.
+class CompressedTexture
+{
+public:
+	//Generates every mip level from pixels, which are RGBA with 8 bits per
+	//channel, then compresses each. Mips are filtered as content says, and
+	//wrapping textures are filtered across their edges.
+	CompressedTexture(const unsigned char* pixels, int width, int height, TextureCompression compression,
+		TextureContent content = TEXTURE_CONTENT_COLOR, bool isWrapped = true, ThreadPool* threadPool = 0);
+	//IsValid is false if the file is missing, cut short, or in another format.
+	CompressedTexture(const std::string& fileName);
+	virtual ~CompressedTexture();
+
+	bool Save(const std::string& fileName) const;
+
+	inline bool IsValid() const                         { return m_isValid; }
+	inline TextureCompression GetCompression() const    { return m_compression; }
+	//The OpenGL internal format, like GL_COMPRESSED_RGB_S3TC_DXT1_EXT.
+	unsigned int GetInternalFormat() const;
+	inline int GetWidth() const                         { return m_width; }
+	inline int GetHeight() const                        { return m_height; }
+	inline int GetNumMips() const                       { return (int)m_mips.size(); }
+	inline int GetMipWidth(int mip) const               { return m_width >> mip > 0 ? m_width >> mip : 1; }
+	inline int GetMipHeight(int mip) const              { return m_height >> mip > 0 ? m_height >> mip : 1; }
+	inline const unsigned char* GetMipData(int mip) const { return m_mips[mip]; }
+	unsigned int GetMipSize(int mip) const;
+
+	//Halves an image, or whatever size is asked for, with a Lanczos filter.
+	//Colours are filtered in linear light, and normals come out unit length.
+	static void Resample(const unsigned char* pixels, int width, int height, unsigned char* result, int resultWidth, int resultHeight,
+		TextureContent content, bool isWrapped);
+	//Decompresses blocks back into RGBA with 8 bits per channel, for contexts
+	//that can't read the compressed format.
+	static void Decompress(TextureCompression compression, const unsigned char* blocks, int width, int height, unsigned char* pixels);
+	static unsigned int CalcBlocksSize(TextureCompression compression, int width, int height);
+
+	static void Test();
+	static void Benchmark();
+protected:
+private:
+	MappedFile*                 m_file;     //0 unless loaded from a file
+	std::vector<unsigned char>  m_mipData;  //Only used when cooked from pixels
+	std::vector<const unsigned char*> m_mips;
+	TextureCompression          m_compression;
+	int                         m_width;
+	int                         m_height;
+	bool                        m_isValid;
+
+	CompressedTexture(const CompressedTexture& other) {}
+	void operator=(const CompressedTexture& other) {}
+};
+
+#endif
@@ -0,0 +1,646 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "environmentBaker.h"
+#include "../staticLibs/simdaccel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+//Rows of the environment each task projects into spherical harmonics.
+static const int SH_ROWS_PER_TASK = 16;
+static const int NUM_SH_SUMS = EnvironmentBaker::NUM_SH_COEFFICIENTS * 3;
+
+//Convolving with a cosine scales each band of spherical harmonics by pi, 2pi/3
+//and pi/4. The irradiance is then divided by pi.
+static const float SH_BAND_SCALES[EnvironmentBaker::NUM_SH_COEFFICIENTS] =
+	{ 1.0f, 2.0f/3.0f, 2.0f/3.0f, 2.0f/3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+class ProjectSHTask : public ThreadPoolTask
+{
+public:
+	ProjectSHTask(const EnvironmentBaker* baker, int height, std::vector<float>* sums) :
+		m_baker(baker),
+		m_height(height),
+		m_sums(sums) {}
+
+	virtual void Run(unsigned int index)
+	{
+		int firstRow = (int)index * SH_ROWS_PER_TASK;
+		int lastRow = std::min(firstRow + SH_ROWS_PER_TASK, m_height);
+		m_baker->ProjectSHRows(firstRow, lastRow, &(*m_sums)[index * NUM_SH_SUMS]);
+	}
+private:
+	const EnvironmentBaker* m_baker;
+	int                     m_height;
+	std::vector<float>*     m_sums;
+};
+
+class BuildSourceCubeTask : public ThreadPoolTask
+{
+public:
+	BuildSourceCubeTask(EnvironmentBaker* baker) :
+		m_baker(baker) {}
+
+	virtual void Run(unsigned int index)
+	{
+		m_baker->BuildSourceCubeRow((int)index / EnvironmentBaker::SOURCE_CUBE_SIZE, (int)index % EnvironmentBaker::SOURCE_CUBE_SIZE);
+	}
+private:
+	EnvironmentBaker* m_baker;
+};
+
+class PrefilterTask : public ThreadPoolTask
+{
+public:
+	PrefilterTask(const EnvironmentBaker* baker, const EnvironmentBaker::PrefilterSamples& samples, int size, std::vector<float>* pixels) :
+		m_baker(baker),
+		m_samples(samples),
+		m_size(size),
+		m_pixels(pixels) {}
+
+	virtual void Run(unsigned int index)
+	{
+		m_baker->FilterRow(m_samples, m_size, (int)index / m_size, (int)index % m_size, &(*m_pixels)[0]);
+	}
+private:
+	const EnvironmentBaker*                  m_baker;
+	const EnvironmentBaker::PrefilterSamples& m_samples;
+	int                                      m_size;
+	std::vector<float>*                      m_pixels;
+};
+
+//Van der Corpus sequence, for the second coordinate of the Hammersley set.
+static float CalcRadicalInverse(unsigned int bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return (float)bits * 2.3283064365386963e-10f;
+}
+
+EnvironmentBaker::EnvironmentBaker(const float* pixels, int width, int height, ThreadPool* threadPool) :
+	m_pixels(pixels),
+	m_width(width),
+	m_height(height),
+	m_threadPool(threadPool)
+{
+	//The 4 columns at a time projected into spherical harmonics may run past
+	//the edge, where the padding has no light.
+	int paddedWidth = (width + 3) & ~3;
+	m_cosLongitudes.resize(paddedWidth, 0.0f);
+	m_sinLongitudes.resize(paddedWidth, 0.0f);
+	for(int i = 0; i < width; i++)
+	{
+		float longitude = (((float)i + 0.5f) / (float)width - 0.5f) * 2.0f * (float)MATH_PI;
+		m_cosLongitudes[i] = cosf(longitude);
+		m_sinLongitudes[i] = sinf(longitude);
+	}
+}
+
+void EnvironmentBaker::CalcIrradianceSH(Vector3f* coefficients) const
+{
+	unsigned int numTasks = (unsigned int)((m_height + SH_ROWS_PER_TASK - 1) / SH_ROWS_PER_TASK);
+	std::vector<float> sums(numTasks * NUM_SH_SUMS);
+	ProjectSHTask task(this, m_height, &sums);
+	RunTask(&task, numTasks);
+
+	//Added up in task order, so the result doesn't depend on the threads.
+	for(int i = 0; i < NUM_SH_COEFFICIENTS; i++)
+	{
+		float total[3] = { 0.0f, 0.0f, 0.0f };
+		for(unsigned int j = 0; j < numTasks; j++)
+		{
+			for(int channel = 0; channel < 3; channel++)
+			{
+				total[channel] += sums[j * NUM_SH_SUMS + i * 3 + channel];
+			}
+		}
+
+		coefficients[i] = Vector3f(total[0], total[1], total[2]) * SH_BAND_SCALES[i];
+	}
+}
+
+void EnvironmentBaker::ProjectSHRows(int firstRow, int lastRow, float* sums) const
+{
+	SIMD4f totals[NUM_SH_SUMS];
+	for(int i = 0; i < NUM_SH_SUMS; i++)
+	{
+		totals[i] = SIMD4f(0.0f);
+	}
+
+	for(int row = firstRow; row < lastRow; row++)
+	{
+		float latitude = (0.5f - ((float)row + 0.5f) / (float)m_height) * (float)MATH_PI;
+		float cosLatitude = cosf(latitude);
+		float solidAngle = (2.0f * (float)MATH_PI / (float)m_width) * ((float)MATH_PI / (float)m_height) * cosLatitude;
+		const float* rowPixels = m_pixels + row * m_width * 3;
+
+		//Each texel is seen from the world direction mirrored on x from the
+		//one it's at in the image.
+		SIMD4f y(sinf(latitude));
+		SIMD4f negCosLatitude(-cosLatitude);
+		SIMD4f simdCosLatitude(cosLatitude);
+		SIMD4f simdSolidAngle(solidAngle);
+
+		for(int i = 0; i < m_width; i += 4)
+		{
+			SIMD4f x;
+			SIMD4f z;
+			x.Set(&m_cosLongitudes[i]);
+			z.Set(&m_sinLongitudes[i]);
+			x = x * negCosLatitude;
+			z = z * simdCosLatitude;
+
+			float channels[3][4] = { { 0.0f } };
+			for(int j = 0; j < 4 && i + j < m_width; j++)
+			{
+				for(int channel = 0; channel < 3; channel++)
+				{
+					channels[channel][j] = rowPixels[(i + j) * 3 + channel] * solidAngle;
+				}
+			}
+
+			SIMD4f basis[NUM_SH_COEFFICIENTS];
+			basis[0] = SIMD4f(0.282095f);
+			basis[1] = y * SIMD4f(0.488603f);
+			basis[2] = z * SIMD4f(0.488603f);
+			basis[3] = x * SIMD4f(0.488603f);
+			basis[4] = x * y * SIMD4f(1.092548f);
+			basis[5] = y * z * SIMD4f(1.092548f);
+			basis[6] = (z * z * SIMD4f(3.0f) - SIMD4f(1.0f)) * SIMD4f(0.315392f);
+			basis[7] = x * z * SIMD4f(1.092548f);
+			basis[8] = (x * x - y * y) * SIMD4f(0.546274f);
+
+			for(int channel = 0; channel < 3; channel++)
+			{
+				SIMD4f radiance;
+				radiance.Set(channels[channel]);
+				for(int k = 0; k < NUM_SH_COEFFICIENTS; k++)
+				{
+					totals[k * 3 + channel] = totals[k * 3 + channel] + basis[k] * radiance;
+				}
+			}
+		}
+	}
+
+	for(int i = 0; i < NUM_SH_SUMS; i++)
+	{
+		sums[i] = totals[i].HorizontalAdd();
+	}
+}
+
+Vector3f EnvironmentBaker::EvaluateSH(const Vector3f* coefficients, const Vector3f& direction)
+{
+	float x = direction.GetX();
+	float y = direction.GetY();
+	float z = direction.GetZ();
+
+	return coefficients[0] * 0.282095f +
+		coefficients[1] * (0.488603f * y) +
+		coefficients[2] * (0.488603f * z) +
+		coefficients[3] * (0.488603f * x) +
+		coefficients[4] * (1.092548f * x * y) +
+		coefficients[5] * (1.092548f * y * z) +
+		coefficients[6] * (0.315392f * (3.0f * z * z - 1.0f)) +
+		coefficients[7] * (1.092548f * x * z) +
+		coefficients[8] * (0.546274f * (x * x - y * y));
+}
+
+Vector3f EnvironmentBaker::SampleEnvironment(const Vector3f& direction) const
+{
+	Vector3f imageDirection = Vector3f(-direction.GetX(), direction.GetY(), direction.GetZ()).Normalized();
+	float u = atan2f(imageDirection.GetZ(), imageDirection.GetX()) / (2.0f * (float)MATH_PI) + 0.5f;
+	float v = 0.5f - asinf(std::max(-1.0f, std::min(imageDirection.GetY(), 1.0f))) / (float)MATH_PI;
+
+	//Bilinear, wrapping around in longitude.
+	float x = u * (float)m_width - 0.5f;
+	float y = std::max(0.0f, std::min(v * (float)m_height - 0.5f, (float)(m_height - 1)));
+	int x0 = (int)floorf(x);
+	int y0 = (int)y;
+	float fx = x - (float)x0;
+	float fy = y - (float)y0;
+	int y1 = std::min(y0 + 1, m_height - 1);
+	x0 = (x0 % m_width + m_width) % m_width;
+	int x1 = (x0 + 1) % m_width;
+
+	const float* p00 = m_pixels + (y0 * m_width + x0) * 3;
+	const float* p10 = m_pixels + (y0 * m_width + x1) * 3;
+	const float* p01 = m_pixels + (y1 * m_width + x0) * 3;
+	const float* p11 = m_pixels + (y1 * m_width + x1) * 3;
+
+	float result[3];
+	for(int channel = 0; channel < 3; channel++)
+	{
+		float top = p00[channel] + (p10[channel] - p00[channel]) * fx;
+		float bottom = p01[channel] + (p11[channel] - p01[channel]) * fx;
+		result[channel] = top + (bottom - top) * fy;
+	}
+
+	return Vector3f(result[0], result[1], result[2]);
+}
+
+Vector3f EnvironmentBaker::CalcCubeMapDirection(int face, float s, float t)
+{
+	float sc = s * 2.0f - 1.0f;
+	float tc = t * 2.0f - 1.0f;
+
+	Vector3f direction;
+	switch(face)
+	{
+		case 0: direction = Vector3f(1.0f, -tc, -sc); break;
+		case 1: direction = Vector3f(-1.0f, -tc, sc); break;
+		case 2: direction = Vector3f(sc, 1.0f, tc); break;
+		case 3: direction = Vector3f(sc, -1.0f, -tc); break;
+		case 4: direction = Vector3f(sc, -tc, 1.0f); break;
+		default: direction = Vector3f(-sc, -tc, -1.0f); break;
+	}
+
+	return direction.Normalized();
+}
+
+void EnvironmentBaker::CalcPrefilteredCubeMap(int size, float roughness, std::vector<float>* pixels)
+{
+	if(m_sourceCube.empty())
+	{
+		BuildSourceCube();
+	}
+
+	PrefilterSamples samples;
+	CalcPrefilterSamples(roughness, &samples);
+
+	pixels->resize(6 * size * size * 3);
+	PrefilterTask task(this, samples, size, pixels);
+	RunTask(&task, 6 * size);
+}
+
+void EnvironmentBaker::CalcPrefilterSamples(float roughness, PrefilterSamples* samples) const
+{
+	//A mirror just reads the environment itself.
+	if(roughness <= 0.0f)
+	{
+		samples->totalWeight = 0.0f;
+		return;
+	}
+
+	//Filtered importance sampling: each sample reads from the mip level whose
+	//texels cover about as much of the sphere as the sample does, so a few
+	//hundred samples are as smooth as thousands reading the top level.
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float texelSolidAngle = 4.0f * (float)MATH_PI / (6.0f * SOURCE_CUBE_SIZE * SOURCE_CUBE_SIZE);
+	int maxMipLevel = (int)m_sourceCube.size() - 1;
+
+	samples->totalWeight = 0.0f;
+	for(int i = 0; i < NUM_PREFILTER_SAMPLES; i++)
+	{
+		float phi = 2.0f * (float)MATH_PI * (float)i / (float)NUM_PREFILTER_SAMPLES;
+		float xi = CalcRadicalInverse((unsigned int)i);
+		float cosTheta = sqrtf((1.0f - xi) / (1.0f + (a2 - 1.0f) * xi));
+		float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+
+		//Reflecting the view, which is along the normal, about the half vector.
+		float z = 2.0f * cosTheta * cosTheta - 1.0f;
+		if(z <= 0.0f)
+		{
+			continue;
+		}
+
+		float d = cosTheta * cosTheta * (a2 - 1.0f) + 1.0f;
+		float pdf = a2 / ((float)MATH_PI * d * d) / 4.0f;
+		float sampleSolidAngle = 1.0f / ((float)NUM_PREFILTER_SAMPLES * pdf);
+		float mipLevel = 0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f;
+
+		samples->x.push_back(2.0f * cosTheta * sinTheta * cosf(phi));
+		samples->y.push_back(2.0f * cosTheta * sinTheta * sinf(phi));
+		samples->z.push_back(z);
+		samples->weights.push_back(z);
+		samples->mipLevels.push_back(std::max(0, std::min((int)(mipLevel + 0.5f), maxMipLevel)));
+		samples->totalWeight += z;
+	}
+
+	while(samples->x.size() % 4 != 0)
+	{
+		samples->x.push_back(0.0f);
+		samples->y.push_back(0.0f);
+		samples->z.push_back(1.0f);
+		samples->weights.push_back(0.0f);
+		samples->mipLevels.push_back(0);
+	}
+}
+
+void EnvironmentBaker::FilterRow(const PrefilterSamples& samples, int size, int face, int row, float* pixels) const
+{
+	float* rowPixels = pixels + ((face * size + row) * size) * 3;
+	float t = ((float)row + 0.5f) / (float)size;
+
+	for(int i = 0; i < size; i++)
+	{
+		Vector3f normal = CalcCubeMapDirection(face, ((float)i + 0.5f) / (float)size, t);
+		Vector3f result;
+
+		if(samples.totalWeight <= 0.0f)
+		{
+			result = SampleEnvironment(normal);
+		}
+		else
+		{
+			Vector3f up = fabsf(normal.GetZ()) < 0.999f ? Vector3f(0.0f, 0.0f, 1.0f) : Vector3f(1.0f, 0.0f, 0.0f);
+			Vector3f tangent = up.Cross(normal).Normalized();
+			Vector3f bitangent = normal.Cross(tangent);
+
+			//The samples are turned from around z to around the normal 4 at a
+			//time, then read one by one, since each may be on a different face.
+			SIMD4f tangentX(tangent.GetX()), tangentY(tangent.GetY()), tangentZ(tangent.GetZ());
+			SIMD4f bitangentX(bitangent.GetX()), bitangentY(bitangent.GetY()), bitangentZ(bitangent.GetZ());
+			SIMD4f normalX(normal.GetX()), normalY(normal.GetY()), normalZ(normal.GetZ());
+
+			result = Vector3f(0.0f, 0.0f, 0.0f);
+			for(unsigned int j = 0; j < samples.x.size(); j += 4)
+			{
+				SIMD4f x, y, z;
+				x.Set(&samples.x[j]);
+				y.Set(&samples.y[j]);
+				z.Set(&samples.z[j]);
+
+				float directionX[4], directionY[4], directionZ[4];
+				(tangentX * x + bitangentX * y + normalX * z).Get(directionX);
+				(tangentY * x + bitangentY * y + normalY * z).Get(directionY);
+				(tangentZ * x + bitangentZ * y + normalZ * z).Get(directionZ);
+
+				for(unsigned int k = 0; k < 4; k++)
+				{
+					Vector3f direction(directionX[k], directionY[k], directionZ[k]);
+					result += SampleSourceCube(direction, samples.mipLevels[j + k]) * samples.weights[j + k];
+				}
+			}
+
+			result = result / samples.totalWeight;
+		}
+
+		rowPixels[i * 3 + 0] = result.GetX();
+		rowPixels[i * 3 + 1] = result.GetY();
+		rowPixels[i * 3 + 2] = result.GetZ();
+	}
+}
+
+void EnvironmentBaker::BuildSourceCube()
+{
+	for(int size = SOURCE_CUBE_SIZE; size > 0; size /= 2)
+	{
+		m_sourceCube.push_back(std::vector<float>(6 * size * size * 3));
+	}
+
+	BuildSourceCubeTask task(this);
+	RunTask(&task, 6 * SOURCE_CUBE_SIZE);
+
+	//Each mip level averages 2x2 texels of the one above. They're small enough
+	//after the first not to be worth splitting up.
+	for(unsigned int level = 1; level < m_sourceCube.size(); level++)
+	{
+		int size = SOURCE_CUBE_SIZE >> level;
+		const float* source = &m_sourceCube[level - 1][0];
+		float* dest = &m_sourceCube[level][0];
+
+		for(int face = 0; face < 6; face++)
+		{
+			for(int j = 0; j < size; j++)
+			{
+				for(int i = 0; i < size; i++)
+				{
+					for(int channel = 0; channel < 3; channel++)
+					{
+						const float* corner = source + ((face * size * 2 + j * 2) * size * 2 + i * 2) * 3 + channel;
+						dest[((face * size + j) * size + i) * 3 + channel] =
+							(corner[0] + corner[3] + corner[size * 2 * 3] + corner[size * 2 * 3 + 3]) * 0.25f;
+					}
+				}
+			}
+		}
+	}
+}
+
+void EnvironmentBaker::BuildSourceCubeRow(int face, int row)
+{
+	float* rowPixels = &m_sourceCube[0][((face * SOURCE_CUBE_SIZE + row) * SOURCE_CUBE_SIZE) * 3];
+	float t = ((float)row + 0.5f) / (float)SOURCE_CUBE_SIZE;
+
+	for(int i = 0; i < SOURCE_CUBE_SIZE; i++)
+	{
+		Vector3f radiance = SampleEnvironment(CalcCubeMapDirection(face, ((float)i + 0.5f) / (float)SOURCE_CUBE_SIZE, t));
+		rowPixels[i * 3 + 0] = radiance.GetX();
+		rowPixels[i * 3 + 1] = radiance.GetY();
+		rowPixels[i * 3 + 2] = radiance.GetZ();
+	}
+}
+
+Vector3f EnvironmentBaker::SampleSourceCube(const Vector3f& direction, int mipLevel) const
+{
+	float absX = fabsf(direction.GetX());
+	float absY = fabsf(direction.GetY());
+	float absZ = fabsf(direction.GetZ());
+
+	//The inverse of CalcCubeMapDirection.
+	int face;
+	float sc, tc, major;
+	if(absX >= absY && absX >= absZ)
+	{
+		major = absX;
+		face = direction.GetX() > 0.0f ? 0 : 1;
+		sc = direction.GetX() > 0.0f ? -direction.GetZ() : direction.GetZ();
+		tc = -direction.GetY();
+	}
+	else if(absY >= absZ)
+	{
+		major = absY;
+		face = direction.GetY() > 0.0f ? 2 : 3;
+		sc = direction.GetX();
+		tc = direction.GetY() > 0.0f ? direction.GetZ() : -direction.GetZ();
+	}
+	else
+	{
+		major = absZ;
+		face = direction.GetZ() > 0.0f ? 4 : 5;
+		sc = direction.GetZ() > 0.0f ? direction.GetX() : -direction.GetX();
+		tc = -direction.GetY();
+	}
+
+	//Bilinear within the face, clamped at its edges.
+	int size = SOURCE_CUBE_SIZE >> mipLevel;
+	float maxCoord = (float)(size - 1);
+	float x = std::max(0.0f, std::min((sc / major + 1.0f) * 0.5f * (float)size - 0.5f, maxCoord));
+	float y = std::max(0.0f, std::min((tc / major + 1.0f) * 0.5f * (float)size - 0.5f, maxCoord));
+	int x0 = (int)x;
+	int y0 = (int)y;
+	int x1 = std::min(x0 + 1, size - 1);
+	int y1 = std::min(y0 + 1, size - 1);
+	float fx = x - (float)x0;
+	float fy = y - (float)y0;
+
+	const float* facePixels = &m_sourceCube[mipLevel][face * size * size * 3];
+	const float* p00 = facePixels + (y0 * size + x0) * 3;
+	const float* p10 = facePixels + (y0 * size + x1) * 3;
+	const float* p01 = facePixels + (y1 * size + x0) * 3;
+	const float* p11 = facePixels + (y1 * size + x1) * 3;
+
+	float result[3];
+	for(int channel = 0; channel < 3; channel++)
+	{
+		float top = p00[channel] + (p10[channel] - p00[channel]) * fx;
+		float bottom = p01[channel] + (p11[channel] - p01[channel]) * fx;
+		result[channel] = top + (bottom - top) * fy;
+	}
+
+	return Vector3f(result[0], result[1], result[2]);
+}
+
+void EnvironmentBaker::RunTask(ThreadPoolTask* task, unsigned int count) const
+{
+	if(m_threadPool)
+	{
+		m_threadPool->ParallelFor(task, count);
+		return;
+	}
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		task->Run(i);
+	}
+}
+
+static bool IsClose(const Vector3f& a, const Vector3f& b, float tolerance)
+{
+	return fabsf(a.GetX() - b.GetX()) <= tolerance && fabsf(a.GetY() - b.GetY()) <= tolerance &&
+		fabsf(a.GetZ() - b.GetZ()) <= tolerance;
+}
+
+void EnvironmentBaker::Test()
+{
+	const int width = 64;
+	const int height = 32;
+	std::vector<float> pixels(width * height * 3);
+
+	//The same light from everywhere is the same irradiance everywhere, and
+	//stays the same however it's blurred.
+	for(int i = 0; i < width * height; i++)
+	{
+		pixels[i * 3 + 0] = 0.5f;
+		pixels[i * 3 + 1] = 1.0f;
+		pixels[i * 3 + 2] = 2.0f;
+	}
+
+	{
+		EnvironmentBaker baker(&pixels[0], width, height, 0);
+		Vector3f coefficients[NUM_SH_COEFFICIENTS];
+		baker.CalcIrradianceSH(coefficients);
+		Vector3f directions[] = { Vector3f(1, 0, 0), Vector3f(0, -1, 0), Vector3f(0.6f, 0.0f, 0.8f) };
+		for(unsigned int i = 0; i < sizeof(directions) / sizeof(directions[0]); i++)
+		{
+			assert(IsClose(EvaluateSH(coefficients, directions[i]), Vector3f(0.5f, 1.0f, 2.0f), 0.01f));
+		}
+
+		std::vector<float> prefiltered;
+		baker.CalcPrefilteredCubeMap(4, 0.5f, &prefiltered);
+		assert(prefiltered.size() == 6 * 4 * 4 * 3);
+		for(unsigned int i = 0; i < prefiltered.size(); i += 3)
+		{
+			assert(IsClose(Vector3f(prefiltered[i], prefiltered[i + 1], prefiltered[i + 2]), Vector3f(0.5f, 1.0f, 2.0f), 0.001f));
+		}
+	}
+
+	//Each texel holds the direction it's at in the image. The world sees it
+	//mirrored on x, and the source cube map has to agree.
+	for(int j = 0; j < height; j++)
+	{
+		float latitude = (0.5f - ((float)j + 0.5f) / (float)height) * (float)MATH_PI;
+		for(int i = 0; i < width; i++)
+		{
+			float longitude = (((float)i + 0.5f) / (float)width - 0.5f) * 2.0f * (float)MATH_PI;
+			float* pixel = &pixels[(j * width + i) * 3];
+			pixel[0] = cosf(latitude) * cosf(longitude) + 1.0f;
+			pixel[1] = sinf(latitude) + 1.0f;
+			pixel[2] = cosf(latitude) * sinf(longitude) + 1.0f;
+		}
+	}
+
+	{
+		EnvironmentBaker baker(&pixels[0], width, height, 0);
+		std::vector<float> prefiltered;
+		baker.CalcPrefilteredCubeMap(2, 0.0f, &prefiltered);
+
+		//Away from the poles, where the image has too few texels to be exact.
+		const float coords[] = { 0.1f, 0.4f, 0.8f };
+		for(int face = 0; face < 6; face++)
+		{
+			for(int k = 0; k < 9; k++)
+			{
+				Vector3f direction = CalcCubeMapDirection(face, coords[k % 3], coords[k / 3]);
+				Vector3f expected = Vector3f(-direction.GetX(), direction.GetY(), direction.GetZ()) + Vector3f(1, 1, 1);
+				assert(IsClose(baker.SampleEnvironment(direction), expected, 0.02f));
+				assert(IsClose(baker.SampleSourceCube(direction, 0), expected, 0.02f));
+			}
+		}
+	}
+
+	//Light from one side only lights surfaces facing that side, whichever
+	//thread works it out.
+	for(int j = 0; j < height; j++)
+	{
+		for(int i = 0; i < width; i++)
+		{
+			float longitude = (((float)i + 0.5f) / (float)width - 0.5f) * 2.0f * (float)MATH_PI;
+			float value = cosf(longitude) > 0.0f ? 1.0f : 0.0f;
+			for(int channel = 0; channel < 3; channel++)
+			{
+				pixels[(j * width + i) * 3 + channel] = value;
+			}
+		}
+	}
+
+	{
+		ThreadPool threadPool(3);
+		EnvironmentBaker serialBaker(&pixels[0], width, height, 0);
+		EnvironmentBaker baker(&pixels[0], width, height, &threadPool);
+
+		Vector3f serialCoefficients[NUM_SH_COEFFICIENTS];
+		Vector3f coefficients[NUM_SH_COEFFICIENTS];
+		serialBaker.CalcIrradianceSH(serialCoefficients);
+		baker.CalcIrradianceSH(coefficients);
+		for(int i = 0; i < NUM_SH_COEFFICIENTS; i++)
+		{
+			assert(IsClose(coefficients[i], serialCoefficients[i], 1e-6f));
+		}
+
+		assert(EvaluateSH(coefficients, Vector3f(-1, 0, 0)).GetX() > 0.8f);
+		assert(EvaluateSH(coefficients, Vector3f(1, 0, 0)).GetX() < 0.2f);
+		assert(fabsf(EvaluateSH(coefficients, Vector3f(0, 1, 0)).GetX() - 0.5f) < 0.05f);
+
+		std::vector<float> serialPrefiltered;
+		std::vector<float> prefiltered;
+		serialBaker.CalcPrefilteredCubeMap(8, 0.25f, &serialPrefiltered);
+		baker.CalcPrefilteredCubeMap(8, 0.25f, &prefiltered);
+		assert(prefiltered == serialPrefiltered);
+
+		//The centers of the -x and +x faces.
+		const float* negativeX = &prefiltered[((1 * 8 + 4) * 8 + 4) * 3];
+		const float* positiveX = &prefiltered[((0 * 8 + 4) * 8 + 4) * 3];
+		assert(negativeX[0] > 0.9f && positiveX[0] < 0.1f);
+	}
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ENVIRONMENTBAKER_H
+#define ENVIRONMENTBAKER_H
+
+#include "../core/math3d.h"
+#include "../core/threadPool.h"
+
+#include <vector>
+
+//Works out the lighting an equirectangular HDR environment gives, on the CPU
+//rather than by drawing with shaders, which is faster wherever OpenGL is
+//emulated in software. Directions are in world space, where the skybox shows
+//the image mirrored on x.
+class EnvironmentBaker
+{
+public:
+	static const int NUM_SH_COEFFICIENTS = 9;
+	//Each face of the cube map the environment is blurred from.
+	static const int SOURCE_CUBE_SIZE = 256;
+	//GGX samples for each texel of a blurred cube map.
+	static const int NUM_PREFILTER_SAMPLES = 256;
+
+	//pixels are RGB floats, starting from the top row, as stbi_loadf gives
+	//them, and must outlive the baker. Work is split across threadPool, or
+	//done on the calling thread if it's 0.
+	EnvironmentBaker(const float* pixels, int width, int height, ThreadPool* threadPool);
+
+	//The irradiance as 9 spherical harmonics, already convolved with a cosine
+	//and divided by pi, so evaluating them at a normal gives the light a white,
+	//perfectly diffuse surface facing that way reflects.
+	void CalcIrradianceSH(Vector3f* coefficients) const;
+
+	//The environment blurred by the GGX distribution for roughness, with the
+	//view along the normal. pixels gets size * size RGB floats for each face of
+	//a cube map, in OpenGL's order, with the rows from the bottom up.
+	void CalcPrefilteredCubeMap(int size, float roughness, std::vector<float>* pixels);
+
+	//The light arriving from direction.
+	Vector3f SampleEnvironment(const Vector3f& direction) const;
+
+	//The direction through s, t on a face of a cube map, as OpenGL lays them out.
+	static Vector3f CalcCubeMapDirection(int face, float s, float t);
+	static Vector3f EvaluateSH(const Vector3f* coefficients, const Vector3f& direction);
+
+	static void Test();
+
+	//Directions to sample the source cube map in around a normal along z, with
+	//the mip level each is read from. Padded with weightless samples to a
+	//multiple of 4, so they can be turned 4 at a time.
+	struct PrefilterSamples
+	{
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<float> weights;
+		std::vector<int>   mipLevels;
+		float              totalWeight;
+	};
+
+	//Used by the tasks the work is split into.
+	void ProjectSHRows(int firstRow, int lastRow, float* sums) const;
+	void BuildSourceCubeRow(int face, int row);
+	void FilterRow(const PrefilterSamples& samples, int size, int face, int row, float* pixels) const;
+protected:
+private:
+	const float*                     m_pixels;
+	int                              m_width;
+	int                              m_height;
+	ThreadPool*                      m_threadPool;
+	std::vector<float>               m_cosLongitudes; //For each column, padded to a multiple of 4
+	std::vector<float>               m_sinLongitudes;
+	std::vector<std::vector<float> > m_sourceCube;    //Mip levels of all 6 faces, down to 1x1
+
+	void BuildSourceCube();
+	void CalcPrefilterSamples(float roughness, PrefilterSamples* samples) const;
+	void RunTask(ThreadPoolTask* task, unsigned int count) const;
+	Vector3f SampleSourceCube(const Vector3f& direction, int mipLevel) const;
+
+	EnvironmentBaker(const EnvironmentBaker& other) {}
+	void operator=(const EnvironmentBaker& other) {}
+};
+
+#endif
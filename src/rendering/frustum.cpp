@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "frustum.h"
+
+#include <cassert>
+
+Frustum::Frustum(const Matrix4f& viewProjection, bool includeDepthPlanes) :
+	m_numPlanes(0)
+{
+	//Matrices are indexed [column][row], so these are the rows of the matrix.
+	//A point is on screen when -w <= x, y, z <= w after the transform, and each
+	//of those comparisons is a plane in world space.
+	Vector4f rows[4];
+	for(int i = 0; i < 4; i++)
+	{
+		rows[i] = Vector4f(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	AddPlane(rows[3] + rows[0]); //Left
+	AddPlane(rows[3] - rows[0]); //Right
+	AddPlane(rows[3] + rows[1]); //Bottom
+	AddPlane(rows[3] - rows[1]); //Top
+
+	if(includeDepthPlanes)
+	{
+		AddPlane(rows[3] + rows[2]); //Near
+		AddPlane(rows[3] - rows[2]); //Far
+	}
+}
+
+int Frustum::ClassifyAABB(const Vector3f& minExtents, const Vector3f& maxExtents) const
+{
+	int result = INSIDE;
+
+	for(int i = 0; i < m_numPlanes; i++)
+	{
+		const Vector3f& normal = m_normals[i];
+
+		//The corner furthest along the normal decides if the box is entirely
+		//behind the plane, and the corner furthest against it decides if the
+		//box is entirely in front.
+		Vector3f positive(normal.GetX() >= 0 ? maxExtents.GetX() : minExtents.GetX(),
+			normal.GetY() >= 0 ? maxExtents.GetY() : minExtents.GetY(),
+			normal.GetZ() >= 0 ? maxExtents.GetZ() : minExtents.GetZ());
+
+		if(normal.Dot(positive) + m_distances[i] < 0)
+		{
+			return OUTSIDE;
+		}
+
+		Vector3f negative(normal.GetX() >= 0 ? minExtents.GetX() : maxExtents.GetX(),
+			normal.GetY() >= 0 ? minExtents.GetY() : maxExtents.GetY(),
+			normal.GetZ() >= 0 ? minExtents.GetZ() : maxExtents.GetZ());
+
+		if(normal.Dot(negative) + m_distances[i] < 0)
+		{
+			result = INTERSECTING;
+		}
+	}
+
+	return result;
+}
+
+void Frustum::AddPlane(const Vector3f& normal, float distance)
+{
+	assert(m_numPlanes < MAX_PLANES);
+	m_normals[m_numPlanes] = normal;
+	m_distances[m_numPlanes] = distance;
+	m_numPlanes++;
+}
+
+void Frustum::AddPlane(const Vector4f& plane)
+{
+	AddPlane(Vector3f(plane.GetX(), plane.GetY(), plane.GetZ()), plane.GetW());
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "../core/math3d.h"
+
+//The volume a camera can see, stored as the planes that bound it. Anything
+//on the negative side of any plane is off screen.
+class Frustum
+{
+public:
+	enum
+	{
+		OUTSIDE,
+		INTERSECTING,
+		INSIDE
+	};
+
+	//Extracts the planes from a view projection matrix, such as the one returned
+	//by Camera::GetViewProjection. The near and far planes can be left out for
+	//passes that clamp depth instead of clipping it, such as shadow maps.
+	Frustum(const Matrix4f& viewProjection, bool includeDepthPlanes = true);
+
+	//Returns OUTSIDE, INTERSECTING or INSIDE depending on how much of the box
+	//is in the frustum. Boxes near the corners can be reported as INTERSECTING
+	//when they're actually outside, but never the other way around.
+	int ClassifyAABB(const Vector3f& minExtents, const Vector3f& maxExtents) const;
+
+	//Narrows the frustum down to the part on the positive side of another plane,
+	//where normal.Dot(point) + distance >= 0, such as the bounds of a light.
+	void AddPlane(const Vector3f& normal, float distance);
+protected:
+private:
+	static const int MAX_PLANES = 16;
+
+	Vector3f m_normals[MAX_PLANES];
+	float    m_distances[MAX_PLANES];
+	int      m_numPlanes;
+
+	void AddPlane(const Vector4f& plane);
+};
+
+#endif
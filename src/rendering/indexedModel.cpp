@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "indexedModel.h"
+
+#include <algorithm>
+
+bool IndexedModel::IsValid() const
+{
+	return m_positions.size() == m_texCoords.size()
+		&& m_texCoords.size() == m_normals.size()
+		&& m_normals.size() == m_tangents.size();
+}
+
+void IndexedModel::AddVertex(const Vector3f& vert)
+{
+	m_positions.push_back(vert);
+}
+
+void IndexedModel::AddTexCoord(const Vector2f& texCoord)
+{
+	m_texCoords.push_back(texCoord);
+}
+
+void IndexedModel::AddNormal(const Vector3f& normal)
+{
+	m_normals.push_back(normal);
+}
+	
+void IndexedModel::AddTangent(const Vector3f& tangent)
+{
+	m_tangents.push_back(tangent);
+}
+
+IndexedModel IndexedModel::Finalize(ThreadPool* threadPool)
+{
+	if(IsValid())
+	{
+		return *this;
+	}
+	
+	if(m_texCoords.size() == 0)
+	{
+		for(unsigned int i = m_texCoords.size(); i < m_positions.size(); i++)
+		{
+			m_texCoords.push_back(Vector2f(0.0f, 0.0f));
+		}
+	}
+	
+	if(m_normals.size() == 0)
+	{
+		CalcNormals(threadPool);
+	}
+	
+	if(m_tangents.size() == 0)
+	{
+		CalcTangents(threadPool);
+	}
+	
+	return *this;
+}
+
+void IndexedModel::AddFace(unsigned int vertIndex0, unsigned int vertIndex1, unsigned int vertIndex2)
+{
+	m_indices.push_back(vertIndex0);
+	m_indices.push_back(vertIndex1);
+	m_indices.push_back(vertIndex2);
+}
+
+//Triangles and vertices are handed out to threads in blocks this big.
+static const unsigned int TRIANGLES_PER_TASK = 4096;
+static const unsigned int VERTICES_PER_TASK = 4096;
+
+class TriangleVectorTask : public ThreadPoolTask
+{
+public:
+	TriangleVectorTask(const IndexedModel* model, bool isTangent, std::vector<Vector3f>* triangleVectors) :
+		m_model(model),
+		m_isTangent(isTangent),
+		m_triangleVectors(triangleVectors) {}
+
+	virtual void Run(unsigned int index)
+	{
+		unsigned int end = std::min((index + 1) * TRIANGLES_PER_TASK, (unsigned int)m_triangleVectors->size());
+		for(unsigned int i = index * TRIANGLES_PER_TASK; i < end; i++)
+		{
+			(*m_triangleVectors)[i] = m_isTangent ? m_model->CalcTriangleTangent(i) : m_model->CalcTriangleNormal(i);
+		}
+	}
+private:
+	const IndexedModel*    m_model;
+	bool                   m_isTangent;
+	std::vector<Vector3f>* m_triangleVectors;
+};
+
+class VertexSumTask : public ThreadPoolTask
+{
+public:
+	VertexSumTask(const std::vector<unsigned int>& firstCorners, const std::vector<unsigned int>& cornerTriangles,
+		const std::vector<Vector3f>& triangleVectors, std::vector<Vector3f>* vertexVectors) :
+		m_firstCorners(firstCorners),
+		m_cornerTriangles(cornerTriangles),
+		m_triangleVectors(triangleVectors),
+		m_vertexVectors(vertexVectors) {}
+
+	virtual void Run(unsigned int index)
+	{
+		unsigned int end = std::min((index + 1) * VERTICES_PER_TASK, (unsigned int)m_vertexVectors->size());
+		for(unsigned int i = index * VERTICES_PER_TASK; i < end; i++)
+		{
+			Vector3f sum(0, 0, 0);
+			for(unsigned int j = m_firstCorners[i]; j < m_firstCorners[i + 1]; j++)
+			{
+				sum += m_triangleVectors[m_cornerTriangles[j]];
+			}
+			(*m_vertexVectors)[i] = sum.Normalized();
+		}
+	}
+private:
+	const std::vector<unsigned int>& m_firstCorners;
+	const std::vector<unsigned int>& m_cornerTriangles;
+	const std::vector<Vector3f>&     m_triangleVectors;
+	std::vector<Vector3f>*           m_vertexVectors;
+};
+
+static void RunTask(ThreadPool* threadPool, ThreadPoolTask* task, unsigned int count)
+{
+	if(threadPool)
+	{
+		threadPool->ParallelFor(task, count);
+		return;
+	}
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		task->Run(i);
+	}
+}
+
+//Works out a vector for each triangle, then gives each vertex the normalized
+//sum of the ones around it. Every vertex adds its triangles up in order, so
+//the result doesn't depend on how the work is split.
+static void CalcVertexVectors(const IndexedModel& model, bool isTangent, ThreadPool* threadPool, std::vector<Vector3f>* vertexVectors)
+{
+	const std::vector<unsigned int>& indices = model.GetIndices();
+	unsigned int numTriangles = (unsigned int)indices.size() / 3;
+	unsigned int numVertices = (unsigned int)model.GetPositions().size();
+
+	std::vector<Vector3f> triangleVectors(numTriangles);
+	TriangleVectorTask triangleTask(&model, isTangent, &triangleVectors);
+	RunTask(threadPool, &triangleTask, (numTriangles + TRIANGLES_PER_TASK - 1) / TRIANGLES_PER_TASK);
+
+	//The triangle of every corner that uses each vertex, grouped by vertex.
+	std::vector<unsigned int> firstCorners(numVertices + 1, 0);
+	for(unsigned int i = 0; i < numTriangles * 3; i++)
+	{
+		firstCorners[indices[i] + 1]++;
+	}
+	for(unsigned int i = 0; i < numVertices; i++)
+	{
+		firstCorners[i + 1] += firstCorners[i];
+	}
+
+	std::vector<unsigned int> cornerTriangles(numTriangles * 3);
+	std::vector<unsigned int> nextCorners(firstCorners.begin(), firstCorners.end() - 1);
+	for(unsigned int i = 0; i < numTriangles * 3; i++)
+	{
+		cornerTriangles[nextCorners[indices[i]]++] = i / 3;
+	}
+
+	vertexVectors->resize(numVertices);
+	VertexSumTask vertexTask(firstCorners, cornerTriangles, triangleVectors, vertexVectors);
+	RunTask(threadPool, &vertexTask, (numVertices + VERTICES_PER_TASK - 1) / VERTICES_PER_TASK);
+}
+
+void IndexedModel::CalcNormals(ThreadPool* threadPool)
+{
+	CalcVertexVectors(*this, false, threadPool, &m_normals);
+}
+
+void IndexedModel::CalcTangents(ThreadPool* threadPool)
+{
+	CalcVertexVectors(*this, true, threadPool, &m_tangents);
+}
+
+Vector3f IndexedModel::CalcTriangleNormal(unsigned int triangle) const
+{
+	int i0 = m_indices[triangle * 3];
+	int i1 = m_indices[triangle * 3 + 1];
+	int i2 = m_indices[triangle * 3 + 2];
+		
+	Vector3f v1 = m_positions[i1] - m_positions[i0];
+	Vector3f v2 = m_positions[i2] - m_positions[i0];
+	
+	return v1.Cross(v2).Normalized();
+}
+
+Vector3f IndexedModel::CalcTriangleTangent(unsigned int triangle) const
+{
+	int i0 = m_indices[triangle * 3];
+	int i1 = m_indices[triangle * 3 + 1];
+	int i2 = m_indices[triangle * 3 + 2];
+
+	Vector3f edge1 = m_positions[i1] - m_positions[i0];
+	Vector3f edge2 = m_positions[i2] - m_positions[i0];
+	
+	float deltaU1 = m_texCoords[i1].GetX() - m_texCoords[i0].GetX();
+	float deltaU2 = m_texCoords[i2].GetX() - m_texCoords[i0].GetX();
+	float deltaV1 = m_texCoords[i1].GetY() - m_texCoords[i0].GetY();
+	float deltaV2 = m_texCoords[i2].GetY() - m_texCoords[i0].GetY();
+	
+	float dividend = (deltaU1 * deltaV2 - deltaU2 * deltaV1);
+	float f = dividend == 0.0f ? 0.0f : 1.0f/dividend;
+	
+	Vector3f tangent = Vector3f(0,0,0);
+	
+	tangent.SetX(f * (deltaV2 * edge1.GetX() - deltaV1 * edge2.GetX()));
+	tangent.SetY(f * (deltaV2 * edge1.GetY() - deltaV1 * edge2.GetY()));
+	tangent.SetZ(f * (deltaV2 * edge1.GetZ() - deltaV1 * edge2.GetZ()));
+
+//Bitangent example, in Java
+//		Vector3f bitangent = new Vector3f(0,0,0);
+//		
+//		bitangent.setX(f * (-deltaU2 * edge1.getX() - deltaU1 * edge2.getX()));
+//		bitangent.setX(f * (-deltaU2 * edge1.getY() - deltaU1 * edge2.getY()));
+//		bitangent.setX(f * (-deltaU2 * edge1.getZ() - deltaU1 * edge2.getZ()));
+
+	return tangent;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INDEXEDMODEL_H
+#define INDEXEDMODEL_H
+
+#include "../core/math3d.h"
+#include "../core/threadPool.h"
+
+#include <vector>
+
+class IndexedModel
+{
+public:
+	IndexedModel() {}
+	IndexedModel(const std::vector<unsigned int> indices, const std::vector<Vector3f>& positions, const std::vector<Vector2f>& texCoords,
+		const std::vector<Vector3f>& normals = std::vector<Vector3f>(), const std::vector<Vector3f>& tangents = std::vector<Vector3f>()) :
+			m_indices(indices),
+			m_positions(positions),
+			m_texCoords(texCoords),
+			m_normals(normals),
+			m_tangents(tangents) {}
+
+	bool IsValid() const;
+	//Every vertex gets the average of the triangles around it. Triangles are
+	//split between threadPool's threads, or done on the calling thread if it's
+	//0, and give the same result either way.
+	void CalcNormals(ThreadPool* threadPool = 0);
+	void CalcTangents(ThreadPool* threadPool = 0);
+
+	IndexedModel Finalize(ThreadPool* threadPool = 0);
+
+	void AddVertex(const Vector3f& vert);
+	inline void AddVertex(float x, float y, float z) { AddVertex(Vector3f(x, y, z)); }
+	
+	void AddTexCoord(const Vector2f& texCoord);
+	inline void AddTexCoord(float x, float y) { AddTexCoord(Vector2f(x, y)); }
+	
+	void AddNormal(const Vector3f& normal);
+	inline void AddNormal(float x, float y, float z) { AddNormal(Vector3f(x, y, z)); }
+	
+	void AddTangent(const Vector3f& tangent);
+	inline void AddTangent(float x, float y, float z) { AddTangent(Vector3f(x, y, z)); }
+	
+	void AddFace(unsigned int vertIndex0, unsigned int vertIndex1, unsigned int vertIndex2);
+
+	inline const std::vector<unsigned int>& GetIndices() const { return m_indices; }
+	inline const std::vector<Vector3f>& GetPositions()   const { return m_positions; }
+	inline const std::vector<Vector2f>& GetTexCoords()   const { return m_texCoords; }
+	inline const std::vector<Vector3f>& GetNormals()     const { return m_normals; }
+	inline const std::vector<Vector3f>& GetTangents()    const { return m_tangents; }
+
+	//A triangle's unit normal, and the direction its texture's u coordinate
+	//increases along it, which isn't normalized.
+	Vector3f CalcTriangleNormal(unsigned int triangle) const;
+	Vector3f CalcTriangleTangent(unsigned int triangle) const;
+private:
+	std::vector<unsigned int> m_indices;
+    std::vector<Vector3f> m_positions;
+    std::vector<Vector2f> m_texCoords;
+    std::vector<Vector3f> m_normals;
+    std::vector<Vector3f> m_tangents;  
+};
+
+#endif
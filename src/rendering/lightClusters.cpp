@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "lightClusters.h"
+#include "camera.h"
+#include "../core/profiling.h"
+#include "../core/util.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+//Clusters are made slightly bigger than they are, so a point exactly on the
+//edge of two is in both, however the rounding goes.
+static const float CLUSTER_EDGE_PADDING = 0.0001f;
+
+LightClusters::LightClusters() :
+	m_clusters(NUM_CLUSTERS * 2, 0),
+	m_clusterBounds(NUM_CLUSTERS * 6, 0.0f),
+	m_scaleX(0.0f),
+	m_scaleY(0.0f),
+	m_near(0.0f),
+	m_far(0.0f),
+	m_sliceScale(0.0f),
+	m_sliceBias(0.0f)
+{
+	for(unsigned int i = 0; i < 3; i++)
+	{
+		m_buffers[i] = 0;
+		m_textures[i] = 0;
+	}
+}
+
+LightClusters::~LightClusters()
+{
+	if(m_buffers[0] != 0)
+	{
+		glDeleteTextures(3, m_textures);
+		glDeleteBuffers(3, m_buffers);
+	}
+}
+
+static inline int CalcTile(float screenPos, int numTiles)
+{
+	int tile = (int)floorf((screenPos * 0.5f + 0.5f) * (float)numTiles);
+	return std::max(0, std::min(tile, numTiles - 1));
+}
+
+void LightClusters::Build(const std::vector<Light>& lights, const Matrix4f& view, const Matrix4f& projection)
+{
+	float scaleX = projection[0][0];
+	float scaleY = projection[1][1];
+	float nearPlane = Camera::CalcNearPlane(projection);
+	float farPlane = Camera::CalcFarPlane(projection);
+
+	if(scaleX != m_scaleX || scaleY != m_scaleY || nearPlane != m_near || farPlane != m_far)
+	{
+		m_scaleX = scaleX;
+		m_scaleY = scaleY;
+		m_near = nearPlane;
+		m_far = farPlane;
+		m_sliceScale = (float)SLICES / logf(m_far / m_near);
+		m_sliceBias = -logf(m_near) * m_sliceScale;
+		CalcClusterBounds();
+	}
+
+	unsigned int numLights = std::min((unsigned int)lights.size(), (unsigned int)MAX_LIGHTS);
+	m_lightData.resize(numLights * 12);
+	m_clusterLights.clear();
+
+	for(unsigned int i = 0; i < numLights; i++)
+	{
+		const Light& light = lights[i];
+		float* lightData = &m_lightData[i * 12];
+		lightData[0] = light.position.GetX();
+		lightData[1] = light.position.GetY();
+		lightData[2] = light.position.GetZ();
+		lightData[3] = light.range;
+		lightData[4] = light.color.GetX();
+		lightData[5] = light.color.GetY();
+		lightData[6] = light.color.GetZ();
+		lightData[7] = 0.0f;
+		lightData[8] = light.attenuation.GetX();
+		lightData[9] = light.attenuation.GetY();
+		lightData[10] = light.attenuation.GetZ();
+		lightData[11] = 0.0f;
+
+		//Only the part of the light's bounding box between the near and far
+		//planes can be seen, which also keeps the depths used below positive.
+		Vector3f center(view.Transform(light.position));
+		float radius = light.range;
+		float minDepth = std::max(center.GetZ() - radius, m_near);
+		float maxDepth = std::min(center.GetZ() + radius, m_far);
+		if(minDepth > maxDepth)
+		{
+			continue;
+		}
+
+		float minX = scaleX * Camera::CalcMinScreenPos(center.GetX() - radius, minDepth, maxDepth);
+		float maxX = scaleX * Camera::CalcMaxScreenPos(center.GetX() + radius, minDepth, maxDepth);
+		float minY = scaleY * Camera::CalcMinScreenPos(center.GetY() - radius, minDepth, maxDepth);
+		float maxY = scaleY * Camera::CalcMaxScreenPos(center.GetY() + radius, minDepth, maxDepth);
+		if(maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+		{
+			continue;
+		}
+
+		int minTileX = CalcTile(minX, TILES_X);
+		int maxTileX = CalcTile(maxX, TILES_X);
+		int minTileY = CalcTile(minY, TILES_Y);
+		int maxTileY = CalcTile(maxY, TILES_Y);
+		int minSlice = CalcSlice(minDepth);
+		int maxSlice = CalcSlice(maxDepth);
+
+		//The rectangle is only tight for the middle of the light, so each
+		//cluster's corners are checked to cut the ones the sphere misses.
+		float radiusSquared = radius * radius;
+		for(int slice = minSlice; slice <= maxSlice; slice++)
+		{
+			for(int tileY = minTileY; tileY <= maxTileY; tileY++)
+			{
+				for(int tileX = minTileX; tileX <= maxTileX; tileX++)
+				{
+					unsigned int cluster = (slice * TILES_Y + tileY) * TILES_X + tileX;
+					const float* bounds = &m_clusterBounds[cluster * 6];
+
+					float distanceSquared = 0.0f;
+					for(int j = 0; j < 3; j++)
+					{
+						float distance = std::max(bounds[j] - center[j], 0.0f) + std::max(center[j] - bounds[j + 3], 0.0f);
+						distanceSquared += distance * distance;
+					}
+
+					if(distanceSquared <= radiusSquared)
+					{
+						m_clusterLights.push_back(cluster);
+						m_clusterLights.push_back(i);
+					}
+				}
+			}
+		}
+	}
+
+	//Counting sort the lights into their clusters.
+	for(unsigned int i = 0; i < NUM_CLUSTERS; i++)
+	{
+		m_clusters[i * 2 + 1] = 0;
+	}
+
+	for(unsigned int i = 0; i < m_clusterLights.size(); i += 2)
+	{
+		m_clusters[m_clusterLights[i] * 2 + 1]++;
+	}
+
+	unsigned int numLightIndices = 0;
+	for(unsigned int i = 0; i < NUM_CLUSTERS; i++)
+	{
+		unsigned int count = std::min(m_clusters[i * 2 + 1], (unsigned int)MAX_LIGHT_INDICES - numLightIndices);
+		m_clusters[i * 2] = numLightIndices;
+		m_clusters[i * 2 + 1] = 0;
+		numLightIndices += count;
+	}
+
+	m_lightIndices.resize(numLightIndices);
+	for(unsigned int i = 0; i < m_clusterLights.size(); i += 2)
+	{
+		unsigned int cluster = m_clusterLights[i];
+		unsigned int index = m_clusters[cluster * 2] + m_clusters[cluster * 2 + 1];
+		unsigned int end = (cluster + 1 < NUM_CLUSTERS) ? m_clusters[(cluster + 1) * 2] : numLightIndices;
+
+		if(index < end)
+		{
+			m_lightIndices[index] = m_clusterLights[i + 1];
+			m_clusters[cluster * 2 + 1]++;
+		}
+	}
+}
+
+int LightClusters::GetCluster(float screenX, float screenY, float depth) const
+{
+	return (CalcSlice(depth) * TILES_Y + CalcTile(screenY, TILES_Y)) * TILES_X + CalcTile(screenX, TILES_X);
+}
+
+int LightClusters::CalcSlice(float depth) const
+{
+	if(depth <= m_near)
+	{
+		return 0;
+	}
+
+	int slice = (int)floorf(logf(depth) * m_sliceScale + m_sliceBias);
+	return std::max(0, std::min(slice, (int)SLICES - 1));
+}
+
+void LightClusters::CalcClusterBounds()
+{
+	float depthRatio = m_far / m_near;
+
+	for(int slice = 0; slice < SLICES; slice++)
+	{
+		float minDepth = m_near * powf(depthRatio, (float)slice / (float)SLICES) * (1.0f - CLUSTER_EDGE_PADDING);
+		float maxDepth = m_near * powf(depthRatio, (float)(slice + 1) / (float)SLICES) * (1.0f + CLUSTER_EDGE_PADDING);
+
+		for(int tileY = 0; tileY < TILES_Y; tileY++)
+		{
+			float minY = -1.0f + 2.0f * (float)tileY / (float)TILES_Y - CLUSTER_EDGE_PADDING;
+			float maxY = -1.0f + 2.0f * (float)(tileY + 1) / (float)TILES_Y + CLUSTER_EDGE_PADDING;
+
+			for(int tileX = 0; tileX < TILES_X; tileX++)
+			{
+				float minX = -1.0f + 2.0f * (float)tileX / (float)TILES_X - CLUSTER_EDGE_PADDING;
+				float maxX = -1.0f + 2.0f * (float)(tileX + 1) / (float)TILES_X + CLUSTER_EDGE_PADDING;
+
+				//The sides of a cluster slope out with depth, so the box has
+				//to fit whichever end of it is wider.
+				float* bounds = &m_clusterBounds[((slice * TILES_Y + tileY) * TILES_X + tileX) * 6];
+				bounds[0] = std::min(minX * minDepth, minX * maxDepth) / m_scaleX;
+				bounds[1] = std::min(minY * minDepth, minY * maxDepth) / m_scaleY;
+				bounds[2] = minDepth;
+				bounds[3] = std::max(maxX * minDepth, maxX * maxDepth) / m_scaleX;
+				bounds[4] = std::max(maxY * minDepth, maxY * maxDepth) / m_scaleY;
+				bounds[5] = maxDepth;
+			}
+		}
+	}
+}
+
+static void UploadBufferTexture(unsigned int buffer, unsigned int texture, GLenum format, const void* data, unsigned int size)
+{
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+}
+
+void LightClusters::Upload()
+{
+	if(m_buffers[0] == 0)
+	{
+		glGenBuffers(3, m_buffers);
+		glGenTextures(3, m_textures);
+	}
+
+	UploadBufferTexture(m_buffers[0], m_textures[0], GL_RGBA32F,
+		m_lightData.empty() ? 0 : &m_lightData[0], (unsigned int)(m_lightData.size() * sizeof(float)));
+	UploadBufferTexture(m_buffers[1], m_textures[1], GL_R32UI,
+		&m_clusters[0], (unsigned int)(m_clusters.size() * sizeof(unsigned int)));
+	UploadBufferTexture(m_buffers[2], m_textures[2], GL_R32UI,
+		m_lightIndices.empty() ? 0 : &m_lightIndices[0], (unsigned int)(m_lightIndices.size() * sizeof(unsigned int)));
+}
+
+void LightClusters::Bind(unsigned int lightsUnit, unsigned int clustersUnit, unsigned int lightIndicesUnit) const
+{
+	unsigned int units[] = { lightsUnit, clustersUnit, lightIndicesUnit };
+	for(unsigned int i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + units[i]);
+		glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+	}
+}
+
+static Matrix4f CreateTestProjection()
+{
+	return Matrix4f().InitPerspective(ToRadians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+}
+
+//Lights scattered in front of a camera at the origin.
+static std::vector<LightClusters::Light> CreateRandomLights(unsigned int count)
+{
+	std::vector<LightClusters::Light> lights;
+	for(unsigned int i = 0; i < count; i++)
+	{
+		LightClusters::Light light;
+		light.position = Vector3f(Util::RandomFloat(-50.0f, 50.0f), Util::RandomFloat(-5.0f, 5.0f), Util::RandomFloat(-10.0f, 100.0f));
+		light.range = Util::RandomFloat(1.0f, 8.0f);
+		light.color = Vector3f(1.0f, 1.0f, 1.0f);
+		light.attenuation = Vector3f(0.0f, 0.0f, 1.0f);
+		lights.push_back(light);
+	}
+
+	return lights;
+}
+
+static bool ClusterHasLight(const LightClusters& clusters, int cluster, unsigned int light)
+{
+	unsigned int first = clusters.GetClusters()[cluster * 2];
+	unsigned int count = clusters.GetClusters()[cluster * 2 + 1];
+	for(unsigned int i = first; i < first + count; i++)
+	{
+		if(clusters.GetLightIndices()[i] == light)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void LightClusters::Test()
+{
+	Matrix4f view = Matrix4f().InitIdentity();
+	Matrix4f projection = CreateTestProjection();
+	LightClusters clusters;
+
+	//A light entirely behind the camera reaches nothing.
+	std::vector<Light> lights = CreateRandomLights(1);
+	lights[0].position = Vector3f(0.0f, 0.0f, -10.0f);
+	lights[0].range = 2.0f;
+	clusters.Build(lights, view, projection);
+	assert(clusters.GetLightIndices().empty());
+
+	//A small light in the middle of the screen only reaches the middle.
+	lights[0].position = Vector3f(0.0f, 0.0f, 10.0f);
+	clusters.Build(lights, view, projection);
+	assert(!clusters.GetLightIndices().empty());
+	assert(ClusterHasLight(clusters, clusters.GetCluster(0.0f, 0.0f, 10.0f), 0));
+	assert(!ClusterHasLight(clusters, clusters.GetCluster(-0.99f, -0.99f, 10.0f), 0));
+	assert(!ClusterHasLight(clusters, clusters.GetCluster(0.0f, 0.0f, 100.0f), 0));
+	assert(!ClusterHasLight(clusters, clusters.GetCluster(0.0f, 0.0f, 1.0f), 0));
+
+	//Every visible point a light reaches must be in a cluster that has the light.
+	srand(11);
+	lights = CreateRandomLights(200);
+	clusters.Build(lights, view, projection);
+
+	unsigned int numPointsChecked = 0;
+	for(unsigned int i = 0; i < lights.size(); i++)
+	{
+		for(unsigned int j = 0; j < 200; j++)
+		{
+			Vector3f offset(Util::RandomFloat(-1.0f, 1.0f), Util::RandomFloat(-1.0f, 1.0f), Util::RandomFloat(-1.0f, 1.0f));
+			if(offset.Length() > 1.0f)
+			{
+				continue;
+			}
+
+			Vector3f point = lights[i].position + offset * lights[i].range;
+			float depth = point.GetZ();
+			if(depth < 0.1f || depth > 1000.0f)
+			{
+				continue;
+			}
+
+			float screenX = projection[0][0] * point.GetX() / depth;
+			float screenY = projection[1][1] * point.GetY() / depth;
+			if(fabsf(screenX) > 1.0f || fabsf(screenY) > 1.0f)
+			{
+				continue;
+			}
+
+			assert(ClusterHasLight(clusters, clusters.GetCluster(screenX, screenY, depth), i));
+			numPointsChecked++;
+		}
+	}
+	assert(numPointsChecked > 1000);
+
+	//Clusters list their lights in order, with no gaps between clusters.
+	unsigned int nextIndex = 0;
+	for(unsigned int i = 0; i < NUM_CLUSTERS; i++)
+	{
+		assert(clusters.GetClusters()[i * 2] == nextIndex);
+		nextIndex += clusters.GetClusters()[i * 2 + 1];
+
+		for(unsigned int j = clusters.GetClusters()[i * 2] + 1; j < nextIndex; j++)
+		{
+			assert(clusters.GetLightIndices()[j - 1] < clusters.GetLightIndices()[j]);
+		}
+	}
+	assert(nextIndex == clusters.GetLightIndices().size());
+}
+
+void LightClusters::Benchmark()
+{
+	Matrix4f view = Matrix4f().InitIdentity();
+	Matrix4f projection = CreateTestProjection();
+	LightClusters clusters;
+
+	srand(3);
+	for(unsigned int count = 1; count <= 1024; count *= 4)
+	{
+		std::vector<Light> lights = CreateRandomLights(count);
+
+		ProfileTimer timer;
+		for(unsigned int i = 0; i < 100; i++)
+		{
+			timer.StartInvocation();
+			clusters.Build(lights, view, projection);
+			timer.StopInvocation();
+		}
+
+		std::ostringstream message;
+		message << "Light binning, CPU only (" << count << " point lights): ";
+		timer.DisplayAndReset(message.str(), 0, 56);
+		printf("    %u light indices, %f per cluster\n", (unsigned int)clusters.GetLightIndices().size(),
+			(double)clusters.GetLightIndices().size() / (double)NUM_CLUSTERS);
+	}
+}
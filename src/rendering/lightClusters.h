@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include "../core/math3d.h"
+
+#include <vector>
+
+//Splits the view frustum into clusters, tiles of the screen cut into slices of
+//depth, and lists which point lights reach each one. That lets a single pass
+//shade every point light, while each pixel only looks at the lights near it.
+class LightClusters
+{
+public:
+	enum
+	{
+		TILES_X           = 16,
+		TILES_Y           = 9,
+		SLICES            = 24,    //Spaced exponentially, so every cluster is roughly as deep as it is wide
+		NUM_CLUSTERS      = TILES_X * TILES_Y * SLICES,
+		MAX_LIGHTS        = 4096,  //Any lights after this many are ignored
+		MAX_LIGHT_INDICES = 65536  //The smallest buffer texture OpenGL allows; later lights in clusters past it are dropped
+	};
+
+	//The values of a point light the shader needs.
+	struct Light
+	{
+		Vector3f position;    //In world space
+		float    range;
+		Vector3f color;       //Already multiplied by the intensity
+		Vector3f attenuation; //Constant, linear and exponent
+	};
+
+	LightClusters();
+	virtual ~LightClusters();
+
+	//view and projection are the camera's. The projection must be a perspective
+	//projection made by Matrix4f::InitPerspective.
+	void Build(const std::vector<Light>& lights, const Matrix4f& view, const Matrix4f& projection);
+
+	//Copies the last build to buffer textures, creating them the first time.
+	void Upload();
+	void Bind(unsigned int lightsUnit, unsigned int clustersUnit, unsigned int lightIndicesUnit) const;
+
+	//The cluster a point is in, from where it is on screen, -1 to 1 on each axis,
+	//and how far it is in front of the camera. Works the same way as the shader.
+	int GetCluster(float screenX, float screenY, float depth) const;
+
+	//A cluster's slice is log(depth) * sliceScale + sliceBias.
+	inline float GetSliceScale()                            const { return m_sliceScale; }
+	inline float GetSliceBias()                             const { return m_sliceBias; }
+	//The first of each cluster's lights in the light indices, then how many it has.
+	inline const std::vector<unsigned int>& GetClusters()     const { return m_clusters; }
+	inline const std::vector<unsigned int>& GetLightIndices() const { return m_lightIndices; }
+
+	static void Test();
+	//Only times Build on the CPU. Benchmarking times whole frames drawn with
+	//clustered shading.
+	static void Benchmark();
+protected:
+private:
+	std::vector<float>        m_lightData;    //3 RGBA texels per light
+	std::vector<unsigned int> m_clusters;
+	std::vector<unsigned int> m_lightIndices;
+	std::vector<unsigned int> m_clusterLights; //Pairs of cluster and light, before they're sorted by cluster
+	std::vector<float>        m_clusterBounds; //View space min and max corners of each cluster
+	float                     m_scaleX;        //The projection m_clusterBounds was worked out for
+	float                     m_scaleY;
+	float                     m_near;
+	float                     m_far;
+	float                     m_sliceScale;
+	float                     m_sliceBias;
+	unsigned int              m_buffers[3];
+	unsigned int              m_textures[3];
+
+	void CalcClusterBounds();
+	int CalcSlice(float depth) const;
+
+	LightClusters(const LightClusters& other) {}
+	void operator=(const LightClusters& other) {}
+};
+
+#endif
@@ -18,11 +18,21 @@
 #include "renderingEngine.h"
 #include "../core/coreEngine.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
 #define COLOR_DEPTH 256
 
+//How much cascades are spaced out by how far they are from the camera, rather
+//than evenly. Spacing them out entirely would give a tiny first cascade when
+//the near plane is close.
+static const float CASCADE_SPLIT_LOG_WEIGHT = 0.75f;
+
 void BaseLight::AddToEngine(CoreEngine* engine) const
 {
 	engine->GetRenderingEngine()->AddLight(*this);
+	EntityComponent::AddToEngine(engine);
 }
 
 ShadowCameraTransform BaseLight::CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot) const
@@ -30,6 +40,15 @@ ShadowCameraTransform BaseLight::CalcShadowCameraTransform(const Vector3f& mainC
 	return ShadowCameraTransform(GetTransform().GetTransformedPos(), GetTransform().GetTransformedRot());
 }
 
+void BaseLight::CalcShadowCamera(const Camera& mainCamera, int cascade, int shadowMapSizeAsPowerOf2, Camera* shadowCamera) const
+{
+	ShadowCameraTransform shadowCameraTransform = CalcShadowCameraTransform(mainCamera.GetTransform().GetTransformedPos(),
+		mainCamera.GetTransform().GetTransformedRot());
+	shadowCamera->SetProjection(GetShadowInfo().GetProjection());
+	shadowCamera->GetTransform()->SetPos(shadowCameraTransform.GetPos());
+	shadowCamera->GetTransform()->SetRot(shadowCameraTransform.GetRot());
+}
+
 void BaseLight::Render(const Shader &shader, const RenderingEngine &renderingEngine, const Camera &camera) const {
 	if(renderingEngine.m_renderLight)
 	{
@@ -43,36 +62,156 @@ void BaseLight::Render(const Shader &shader, const RenderingEngine &renderingEng
 }
 
 DirectionalLight::DirectionalLight(const Vector3f& color, float intensity, int shadowMapSizeAsPowerOf2, 
-	                 float shadowArea, float shadowSoftness, float lightBleedReductionAmount, float minVariance) :
+	                 float shadowDistance, float shadowSoftness, float lightBleedReductionAmount, float minVariance, int numCascades) :
 	BaseLight(color, intensity, Shader("pbr-directional")),
-	m_halfShadowArea(shadowArea / 2.0f)
+	m_shadowDistance(shadowDistance)
 {
+	assert(numCascades > 0 && numCascades <= ShadowInfo::MAX_CASCADES);
+
+	//Each cascade has its own projection, worked out by CalcShadowCamera.
 	if(shadowMapSizeAsPowerOf2 != 0)
 	{
-		SetShadowInfo(ShadowInfo(Matrix4f().InitOrthographic(-m_halfShadowArea, m_halfShadowArea, -m_halfShadowArea, 
-		                                                      m_halfShadowArea, -m_halfShadowArea, m_halfShadowArea), 
-								 false, shadowMapSizeAsPowerOf2, shadowSoftness, lightBleedReductionAmount, minVariance));
+		SetShadowInfo(ShadowInfo(Matrix4f().InitIdentity(), false, shadowMapSizeAsPowerOf2, shadowSoftness, lightBleedReductionAmount, minVariance,
+		                         numCascades));
 	}
 }
 
+//Where the view is split between two cascades, as a fraction of the way from
+//the near plane to the furthest shadows.
+static float CalcCascadeSplit(float nearPlane, float farPlane, float fraction)
+{
+	float evenSplit = nearPlane + (farPlane - nearPlane) * fraction;
+	float logSplit = nearPlane * powf(farPlane / nearPlane, fraction);
+	return evenSplit + (logSplit - evenSplit) * CASCADE_SPLIT_LOG_WEIGHT;
+}
+
+void DirectionalLight::CalcCascadeSlice(const Camera& mainCamera, float shadowDistance, int numCascades, int cascade, float* sliceNear, float* sliceFar)
+{
+	float nearPlane = mainCamera.GetNearPlane();
+	float farPlane = std::min(mainCamera.GetFarPlane(), std::max(shadowDistance, nearPlane));
+
+	*sliceNear = CalcCascadeSplit(nearPlane, farPlane, (float)cascade / (float)numCascades);
+	*sliceFar = CalcCascadeSplit(nearPlane, farPlane, (float)(cascade + 1) / (float)numCascades);
+}
+
+float DirectionalLight::CalcCascadeFar(const Camera& mainCamera, int cascade) const
+{
+	float sliceNear;
+	float sliceFar;
+	CalcCascadeSlice(mainCamera, m_shadowDistance, GetShadowInfo().GetNumCascades(), cascade, &sliceNear, &sliceFar);
+	return sliceFar;
+}
+
+void DirectionalLight::CalcShadowCamera(const Camera& mainCamera, int cascade, int shadowMapSizeAsPowerOf2, Camera* shadowCamera) const
+{
+	float sliceNear;
+	float sliceFar;
+	CalcCascadeSlice(mainCamera, m_shadowDistance, GetShadowInfo().GetNumCascades(), cascade, &sliceNear, &sliceFar);
+
+	float halfWidth;
+	Matrix4f mainProjection = mainCamera.GetProjection();
+	ShadowCameraTransform shadowCameraTransform = FitCascade(mainProjection, mainCamera.GetTransform().GetTransformedPos(),
+		mainCamera.GetTransform().GetTransformedRot(), GetTransform().GetTransformedRot(), sliceNear, sliceFar, shadowMapSizeAsPowerOf2, &halfWidth);
+
+	//Depth reaches further than the slice, since the position's depth is only
+	//snapped to every half width. Casters beyond that are clamped rather than
+	//clipped while drawing the shadow map.
+	float halfDepth = halfWidth * 2.0f;
+	shadowCamera->SetProjection(Matrix4f().InitOrthographic(-halfWidth, halfWidth, -halfWidth, halfWidth, -halfDepth, halfDepth));
+	shadowCamera->GetTransform()->SetPos(shadowCameraTransform.GetPos());
+	shadowCamera->GetTransform()->SetRot(shadowCameraTransform.GetRot());
+}
+
+ShadowCameraTransform DirectionalLight::FitCascade(const Matrix4f& mainProjection, const Vector3f& mainCameraPos, const Quaternion& mainCameraRot,
+	const Quaternion& lightRot, float sliceNear, float sliceFar, int shadowMapSizeAsPowerOf2, float* halfWidth)
+{
+	//The smallest sphere around the slice's corners is centered on the view's
+	//axis, where it's as far from the near corners as the far ones, unless the
+	//far corners are so wide apart that a sphere around them has room to spare.
+	float cornerSpread = sqrtf(1.0f / (mainProjection[0][0] * mainProjection[0][0]) + 1.0f / (mainProjection[1][1] * mainProjection[1][1]));
+	float nearCornerDistance = sliceNear * cornerSpread;
+	float farCornerDistance = sliceFar * cornerSpread;
+	float centerDepth = (sliceFar * sliceFar + farCornerDistance * farCornerDistance - sliceNear * sliceNear - nearCornerDistance * nearCornerDistance) /
+		(2.0f * (sliceFar - sliceNear));
+	centerDepth = std::min(centerDepth, sliceFar);
+	float radius = sqrtf((sliceFar - centerDepth) * (sliceFar - centerDepth) + farCornerDistance * farCornerDistance);
+
+	//Snapping to whole texels in the light's view keeps every texel covering the
+	//same part of the scene from frame to frame. The map is a texel wider on
+	//each side, since snapping can move it up to half a texel off center.
+	float size = (float)(1 << shadowMapSizeAsPowerOf2);
+	radius *= 1.0f + 2.0f / size;
+	float texelSize = (radius * 2.0f) / size;
+	Vector3f center = mainCameraPos + mainCameraRot.GetForward() * centerDepth;
+	Vector3f lightSpaceCenter = center.Rotate(lightRot.Conjugate());
+	lightSpaceCenter.SetX(texelSize * floorf(lightSpaceCenter.GetX() / texelSize + 0.5f));
+	lightSpaceCenter.SetY(texelSize * floorf(lightSpaceCenter.GetY() / texelSize + 0.5f));
+	lightSpaceCenter.SetZ(radius * floorf(lightSpaceCenter.GetZ() / radius + 0.5f));
+
+	*halfWidth = radius;
+	return ShadowCameraTransform(lightSpaceCenter.Rotate(lightRot), lightRot);
+}
 
-ShadowCameraTransform DirectionalLight::CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot) const
+void DirectionalLight::Test()
 {
-//	Vector3f resultPos = mainCameraPos + mainCameraRot.GetForward() * GetHalfShadowArea();
-//	Quaternion resultRot = GetTransform().GetTransformedRot();
-//
-//	float worldTexelSize = (GetHalfShadowArea()*2)/((float)(1 << GetShadowInfo().GetShadowMapSizeAsPowerOf2()));
-//
-//	Vector3f lightSpaceCameraPos = resultPos.Rotate(resultRot.Conjugate());
-//
-//	lightSpaceCameraPos.SetX(worldTexelSize * floor(lightSpaceCameraPos.GetX() / worldTexelSize));
-//	lightSpaceCameraPos.SetY(worldTexelSize * floor(lightSpaceCameraPos.GetY() / worldTexelSize));
-//
-//	resultPos = lightSpaceCameraPos.Rotate(resultRot);
-//
-//	return ShadowCameraTransform(resultPos, resultRot);
+	Matrix4f projection = Matrix4f().InitPerspective(ToRadians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	Quaternion lightRot(Vector3f(1, 0, 0), ToRadians(60.0f));
+	lightRot = Quaternion(Vector3f(0, 1, 0), ToRadians(30.0f)) * lightRot;
+	const int sizeAsPowerOf2 = 10;
+
+	for(int i = 0; i < 4; i++)
+	{
+		float sliceNear = CalcCascadeSplit(0.1f, 80.0f, (float)i / 4.0f);
+		float sliceFar = CalcCascadeSplit(0.1f, 80.0f, (float)(i + 1) / 4.0f);
+		assert(sliceNear < sliceFar);
+
+		Vector3f cameraPos((float)i * 3.7f, 1.5f, -2.3f);
+		Quaternion cameraRot(Vector3f(0, 1, 0), ToRadians(40.0f * (float)i));
+		float halfWidth;
+		ShadowCameraTransform fit = FitCascade(projection, cameraPos, cameraRot, lightRot, sliceNear, sliceFar, sizeAsPowerOf2, &halfWidth);
 
-    return ShadowCameraTransform(GetTransform().GetTransformedPos(), GetTransform().GetTransformedRot());
+		//Every corner of the slice is inside the shadow map.
+		for(int j = 0; j < 8; j++)
+		{
+			float depth = (j & 4) ? sliceFar : sliceNear;
+			Vector3f corner((j & 1 ? 1.0f : -1.0f) * depth / projection[0][0], (j & 2 ? 1.0f : -1.0f) * depth / projection[1][1], depth);
+			Vector3f lightSpaceCorner = (corner.Rotate(cameraRot) + cameraPos - fit.GetPos()).Rotate(lightRot.Conjugate());
+			assert(fabsf(lightSpaceCorner.GetX()) <= halfWidth);
+			assert(fabsf(lightSpaceCorner.GetY()) <= halfWidth);
+			assert(fabsf(lightSpaceCorner.GetZ()) <= halfWidth * 2.0f);
+		}
+
+		//Turning the camera doesn't change the size of the shadow map.
+		float turnedHalfWidth;
+		FitCascade(projection, cameraPos, Quaternion(Vector3f(1, 0, 0), ToRadians(25.0f)) * cameraRot, lightRot,
+			sliceNear, sliceFar, sizeAsPowerOf2, &turnedHalfWidth);
+		assert(turnedHalfWidth == halfWidth);
+
+		//Moving the camera moves the shadow map by whole texels.
+		float movedHalfWidth;
+		ShadowCameraTransform moved = FitCascade(projection, cameraPos + Vector3f(0.37f, 0.11f, 0.53f) * halfWidth, cameraRot, lightRot,
+			sliceNear, sliceFar, sizeAsPowerOf2, &movedHalfWidth);
+		float texelSize = (halfWidth * 2.0f) / (float)(1 << sizeAsPowerOf2);
+		Vector3f texelsMoved = (moved.GetPos() - fit.GetPos()).Rotate(lightRot.Conjugate()) / texelSize;
+		assert(fabsf(texelsMoved.GetX() - floorf(texelsMoved.GetX() + 0.5f)) < 0.01f);
+		assert(fabsf(texelsMoved.GetY() - floorf(texelsMoved.GetY() + 0.5f)) < 0.01f);
+	}
+
+	//Cascades pick up where the last one left off, and the last one ends at the
+	//shadow distance.
+	Transform cameraTransform;
+	Camera camera(projection, &cameraTransform);
+	float lastSliceFar = camera.GetNearPlane();
+	for(int i = 0; i < ShadowInfo::MAX_CASCADES; i++)
+	{
+		float sliceNear;
+		float sliceFar;
+		CalcCascadeSlice(camera, 80.0f, ShadowInfo::MAX_CASCADES, i, &sliceNear, &sliceFar);
+		assert(fabsf(sliceNear - lastSliceFar) < 0.01f);
+		assert(sliceFar > sliceNear);
+		lastSliceFar = sliceFar;
+	}
+	assert(fabsf(lastSliceFar - 80.0f) < 0.01f);
 }
 
 PointLight::PointLight(const Vector3f& color, float intensity, const Attenuation& attenuation, const Shader& shader) :
@@ -86,6 +225,31 @@ PointLight::PointLight(const Vector3f& color, float intensity, const Attenuation
 	m_range = (-b + sqrtf(b*b - 4*a*c))/(2*a);
 }
 
+void PointLight::AddToEngine(CoreEngine* engine) const
+{
+	engine->GetRenderingEngine()->AddPointLight(*this);
+	EntityComponent::AddToEngine(engine);
+}
+
+bool PointLight::CalcBoundingSphere(Vector3f* center, float* radius) const
+{
+	*center = GetTransform().GetTransformedPos();
+	*radius = m_range;
+	return true;
+}
+
+void PointLight::AddBoundingPlanes(Frustum* frustum) const
+{
+	//Planes facing into the box around the light's sphere on each axis.
+	Vector3f pos = GetTransform().GetTransformedPos();
+	frustum->AddPlane(Vector3f( 1, 0, 0), m_range - pos.GetX());
+	frustum->AddPlane(Vector3f(-1, 0, 0), m_range + pos.GetX());
+	frustum->AddPlane(Vector3f( 0, 1, 0), m_range - pos.GetY());
+	frustum->AddPlane(Vector3f( 0,-1, 0), m_range + pos.GetY());
+	frustum->AddPlane(Vector3f( 0, 0, 1), m_range - pos.GetZ());
+	frustum->AddPlane(Vector3f( 0, 0,-1), m_range + pos.GetZ());
+}
+
 SpotLight::SpotLight(const Vector3f& color, float intensity, const Attenuation& attenuation, float viewAngle, 
                      int shadowMapSizeAsPowerOf2, float shadowSoftness, float lightBleedReductionAmount, float minVariance) :
 	PointLight(color, intensity, attenuation, Shader("forward-spot")),
@@ -97,3 +261,32 @@ SpotLight::SpotLight(const Vector3f& color, float intensity, const Attenuation&
 		                             shadowSoftness, lightBleedReductionAmount, minVariance));
 	}
 }
+
+void SpotLight::AddToEngine(CoreEngine* engine) const
+{
+	BaseLight::AddToEngine(engine);
+}
+
+void SpotLight::AddBoundingPlanes(Frustum* frustum) const
+{
+	PointLight::AddBoundingPlanes(frustum);
+
+	//Cones wider than a half space are only bounded by their range.
+	if(m_cutoff <= 0)
+	{
+		return;
+	}
+
+	//Each side of the pyramid goes through the light and touches the cone, so
+	//its normal is tilted back from the side's direction by the cone's angle.
+	Vector3f pos = GetTransform().GetTransformedPos();
+	Quaternion rot = GetTransform().GetTransformedRot();
+	Vector3f forward = rot.GetForward() * sqrtf(1.0f - m_cutoff * m_cutoff);
+	Vector3f sides[4] = { rot.GetRight(), rot.GetRight() * -1, rot.GetUp(), rot.GetUp() * -1 };
+
+	for(int i = 0; i < 4; i++)
+	{
+		Vector3f normal = forward + sides[i] * m_cutoff;
+		frustum->AddPlane(normal, -normal.Dot(pos));
+	}
+}
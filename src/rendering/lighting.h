@@ -18,11 +18,15 @@
 #define LIGHTING_H
 
 #include "shader.h"
+#include "frustum.h"
 
 #include "../core/math3d.h"
 #include "../core/entityComponent.h"
 
+#include <limits>
+
 class CoreEngine;
+class Camera;
 
 class ShadowCameraTransform
 {
@@ -41,13 +45,18 @@ private:
 class ShadowInfo
 {
 public:
-	ShadowInfo(const Matrix4f& projection = Matrix4f().InitIdentity(), bool flipFaces = false, int shadowMapSizeAsPowerOf2 = 0, float shadowSoftness = 1.0f, float lightBleedReductionAmount = 0.2f, float minVariance = 0.00002f) :
+	//Shaders can pick between at most this many shadow maps for one light.
+	static const int MAX_CASCADES = 4;
+
+	ShadowInfo(const Matrix4f& projection = Matrix4f().InitIdentity(), bool flipFaces = false, int shadowMapSizeAsPowerOf2 = 0, float shadowSoftness = 1.0f, float lightBleedReductionAmount = 0.2f, float minVariance = 0.00002f,
+	           int numCascades = 1) :
 		m_projection(projection),
 		m_flipFaces(flipFaces),
 		m_shadowMapSizeAsPowerOf2(shadowMapSizeAsPowerOf2),
 		m_shadowSoftness(shadowSoftness),
 		m_lightBleedReductionAmount(lightBleedReductionAmount),
-		m_minVariance(minVariance) {}
+		m_minVariance(minVariance),
+		m_numCascades(numCascades) {}
 		
 	inline const Matrix4f& GetProjection()      const { return m_projection; }
 	inline bool GetFlipFaces()                  const { return m_flipFaces; }
@@ -55,6 +64,9 @@ public:
 	inline float GetShadowSoftness()            const { return m_shadowSoftness; }
 	inline float GetMinVariance()               const { return m_minVariance; }
 	inline float GetLightBleedReductionAmount() const { return m_lightBleedReductionAmount; }
+	//How many shadow maps the light has, each 2^shadowMapSizeAsPowerOf2 wide and
+	//covering a different part of the view.
+	inline int GetNumCascades()                 const { return m_numCascades; }
 protected:
 private:
 	Matrix4f m_projection;
@@ -63,6 +75,7 @@ private:
 	float m_shadowSoftness;
 	float m_lightBleedReductionAmount;
 	float m_minVariance;
+	int m_numCascades;
 };
 
 class BaseLight : public EntityComponent
@@ -75,10 +88,24 @@ public:
 		m_shadowInfo(ShadowInfo()) {}
 	
 	virtual ShadowCameraTransform CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot) const;
+	//Sets up shadowCamera to draw one of the light's shadow maps, which is
+	//2^shadowMapSizeAsPowerOf2 texels wide. By default, that's the shadow info's
+	//projection from CalcShadowCameraTransform.
+	virtual void CalcShadowCamera(const Camera& mainCamera, int cascade, int shadowMapSizeAsPowerOf2, Camera* shadowCamera) const;
+	//How far in front of mainCamera a cascade is used, after which shaders
+	//pick the next one. By default, there's one cascade used everywhere.
+	virtual float CalcCascadeFar(const Camera& mainCamera, int cascade) const { return std::numeric_limits<float>::max(); }
 	virtual void AddToEngine(CoreEngine* engine) const;
 
 	virtual void Render(const Shader &shader, const RenderingEngine &renderingEngine, const Camera &camera) const;
 
+	//Finds a sphere around everything the light can reach. Returns false if the
+	//light reaches everywhere, like directional lights.
+	virtual bool CalcBoundingSphere(Vector3f* center, float* radius) const { return false; }
+	//Narrows frustum down to about the part the light can reach, so its pass
+	//only draws what it lights.
+	virtual void AddBoundingPlanes(Frustum* frustum) const {}
+
 	inline const Vector3f& GetColor()        const { return m_color; }
 	inline const float GetIntensity()        const { return m_intensity; }
 	inline const Shader& GetShader()         const { return m_shader; }
@@ -92,17 +119,36 @@ private:
 	ShadowInfo  m_shadowInfo;
 };
 
+//Shadows reach shadowDistance from the camera, which is split into cascades that
+//get further apart the further they are from the camera, each with its own
+//shadow map. Nearby shadows get as many texels as far away ones that cover
+//much more of the view.
 class DirectionalLight : public BaseLight
 {
 public:
 	DirectionalLight(const Vector3f& color = Vector3f(0,0,0), float intensity = 0, int shadowMapSizeAsPowerOf2 = 0, 
-	                 float shadowArea = 80.0f, float shadowSoftness = 1.0f, float lightBleedReductionAmount = 0.2f, float minVariance = 0.00002f);
+	                 float shadowDistance = 80.0f, float shadowSoftness = 1.0f, float lightBleedReductionAmount = 0.2f, float minVariance = 0.00002f,
+	                 int numCascades = ShadowInfo::MAX_CASCADES);
 	                 
-	virtual ShadowCameraTransform CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot) const;
+	//Fits the shadow map around the cascade's slice of mainCamera's view.
+	virtual void CalcShadowCamera(const Camera& mainCamera, int cascade, int shadowMapSizeAsPowerOf2, Camera* shadowCamera) const;
+	virtual float CalcCascadeFar(const Camera& mainCamera, int cascade) const;
 	
-	inline float GetHalfShadowArea() const { return m_halfShadowArea; }
+	inline float GetShadowDistance() const { return m_shadowDistance; }
+
+	//Finds the shadow camera transform and half width for the slice of a
+	//perspective camera's view from sliceNear to sliceFar. The width only depends
+	//on the slice, and the position only moves by whole texels, so shadows don't
+	//shimmer as the camera moves.
+	static ShadowCameraTransform FitCascade(const Matrix4f& mainProjection, const Vector3f& mainCameraPos, const Quaternion& mainCameraRot,
+		const Quaternion& lightRot, float sliceNear, float sliceFar, int shadowMapSizeAsPowerOf2, float* halfWidth);
+
+	static void Test();
 private:
-	float m_halfShadowArea;
+	float m_shadowDistance;
+
+	//Where the cascade's slice of mainCamera's view starts and ends.
+	static void CalcCascadeSlice(const Camera& mainCamera, float shadowDistance, int numCascades, int cascade, float* sliceNear, float* sliceFar);
 };
 
 class Attenuation
@@ -128,6 +174,10 @@ public:
 	PointLight(const Vector3f& color = Vector3f(0,0,0), float intensity = 0, const Attenuation& atten = Attenuation(), 
 	           const Shader& shader = Shader("pbr-point"));
 	           
+	virtual void AddToEngine(CoreEngine* engine) const;
+	virtual bool CalcBoundingSphere(Vector3f* center, float* radius) const;
+	virtual void AddBoundingPlanes(Frustum* frustum) const;
+
 	inline const Attenuation& GetAttenuation() const { return m_attenuation; }
 	inline const float GetRange()              const { return m_range; }
 private:
@@ -141,6 +191,11 @@ public:
 	SpotLight(const Vector3f& color = Vector3f(0,0,0), float intensity = 0, const Attenuation& atten = Attenuation(), float viewAngle = ToRadians(170.0f),
 			  int shadowMapSizeAsPowerOf2 = 0, float shadowSoftness = 1.0f, float lightBleedReductionAmount = 0.2f, float minVariance = 0.00002f);
 			  
+	//Added as a plain light, since clustered shading only handles point lights.
+	virtual void AddToEngine(CoreEngine* engine) const;
+	//The box around the light's range, cut down to the pyramid around its cone.
+	virtual void AddBoundingPlanes(Frustum* frustum) const;
+
 	inline float GetCutoff() const { return m_cutoff; }
 private:
 	float m_cutoff;
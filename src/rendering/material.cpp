@@ -16,10 +16,57 @@
  */
 
 #include "material.h"
+#include "uniformBuffer.h"
 #include <iostream>
 #include <cassert>
 
 std::map<std::string, MaterialData*> Material::s_resourceMap;
+unsigned int MaterialData::s_nextId = 1;
+
+MaterialData::~MaterialData()
+{
+	delete m_uniformBuffer;
+}
+
+void MaterialData::SetVector3f(const std::string& name, const Vector3f& value)
+{
+	MappedValues::SetVector3f(name, value);
+	if(m_uniformBuffer)
+	{
+		m_uniformBuffer->SetVector3f(name, value);
+	}
+}
+
+void MaterialData::SetFloat(const std::string& name, float value)
+{
+	MappedValues::SetFloat(name, value);
+	if(m_uniformBuffer)
+	{
+		m_uniformBuffer->SetFloat(name, value);
+	}
+}
+
+void MaterialData::BindUniformBuffer(const UniformBlockLayout& layout) const
+{
+	if(m_uniformBuffer == 0 || m_uniformBuffer->GetLayout().GetId() != layout.GetId())
+	{
+		delete m_uniformBuffer;
+		m_uniformBuffer = new UniformBuffer(layout);
+
+		const std::vector<TypedData>& members = layout.GetMembers();
+		for(unsigned int i = 0; i < members.size(); i++)
+		{
+			if(members[i].GetType() == "vec3")
+				m_uniformBuffer->SetVector3f(members[i].GetName(), GetVector3f(members[i].GetName()));
+			else if(members[i].GetType() == "float")
+				m_uniformBuffer->SetFloat(members[i].GetName(), GetFloat(members[i].GetName()));
+			else
+				throw members[i].GetType() + " is not supported by the Material class";
+		}
+	}
+
+	m_uniformBuffer->Bind();
+}
 
 Material::Material(const std::string& materialName) :
 	m_materialName(materialName)
@@ -23,10 +23,35 @@
 #include "../core/mappedValues.h"
 #include <map>
 
+class UniformBlockLayout;
+class UniformBuffer;
+
 class MaterialData : public ReferenceCounter, public MappedValues
 {
 public:
+	MaterialData() :
+		m_id(s_nextId++),
+		m_uniformBuffer(0) {}
+	virtual ~MaterialData();
+
+	//Values also have to be changed in the uniform buffer, if there is one.
+	virtual void SetVector3f(const std::string& name, const Vector3f& value);
+	virtual void SetFloat(const std::string& name, float value);
+
+	//Different for every material that exists at the same time, and cheaper to
+	//compare than names.
+	inline unsigned int GetId() const { return m_id; }
+
+	//Binds a buffer holding the material's values, laid out for a shader's
+	//material block.
+	void BindUniformBuffer(const UniformBlockLayout& layout) const;
 private:
+	static unsigned int s_nextId;
+	unsigned int m_id;
+	mutable UniformBuffer* m_uniformBuffer; //Created the first time it's bound
+
+	MaterialData(const MaterialData& other) {}
+	void operator=(const MaterialData& other) {}
 };
 
 class Material
@@ -47,6 +72,11 @@ public:
 	inline const Vector3f& GetVector3f(const std::string& name) const { return m_materialData->GetVector3f(name); }
 	inline float GetFloat(const std::string& name)              const { return m_materialData->GetFloat(name); }
 	inline const Texture& GetTexture(const std::string& name)   const { return m_materialData->GetTexture(name); }
+	inline const Vector3f& GetVector3f(unsigned int nameId)     const { return m_materialData->GetVector3f(nameId); }
+	inline float GetFloat(unsigned int nameId)                  const { return m_materialData->GetFloat(nameId); }
+	inline const Texture& GetTexture(unsigned int nameId)       const { return m_materialData->GetTexture(nameId); }
+	inline unsigned int GetId()                                 const { return m_materialData->GetId(); }
+	inline void BindUniformBuffer(const UniformBlockLayout& layout) const { m_materialData->BindUniformBuffer(layout); }
 protected:
 private:
 	static std::map<std::string, MaterialData*> s_resourceMap;
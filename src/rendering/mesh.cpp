@@ -15,216 +15,412 @@
  */
 
 #include "mesh.h"
+#include "stagingBuffer.h"
 
 #include "../core/profiling.h"
+#include "../core/util.h"
 
 #include <GL/glew.h>
 #include <iostream>
 
 #include <vector>
 #include <cassert>
-
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 std::map<std::string, MeshData*> Mesh::s_resourceMap;
+VertexFormat Mesh::s_vertexFormat = VERTEX_FORMAT_PACKED;
 
-bool IndexedModel::IsValid() const
+//Whether the context can read GL_INT_2_10_10_10_REV attributes.
+static bool Supports1010102()
 {
-	return m_positions.size() == m_texCoords.size()
-		&& m_texCoords.size() == m_normals.size()
-		&& m_normals.size() == m_tangents.size();
+	return GLEW_VERSION_3_3 || GLEW_ARB_vertex_type_2_10_10_10_rev;
 }
 
-void IndexedModel::AddVertex(const Vector3f& vert)
+static void SetUpInstanceAttributes(GLuint instanceBuffer)
 {
-	m_positions.push_back(vert);
-}
-
-void IndexedModel::AddTexCoord(const Vector2f& texCoord)
-{
-	m_texCoords.push_back(texCoord);
+	//Instanced shaders read T_model as a mat4 attribute, which takes up one
+	//location per column. It's filled in just before each instanced draw.
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(4 + i);
+		glVertexAttribPointer(4 + i, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4f), (const GLvoid*)(sizeof(float) * 4 * i));
+		
+		if(GLEW_VERSION_3_3)
+			glVertexAttribDivisor(4 + i, 1);
+		else
+			glVertexAttribDivisorARB(4 + i, 1);
+	}
 }
 
-void IndexedModel::AddNormal(const Vector3f& normal)
-{
-	m_normals.push_back(normal);
-}
-	
-void IndexedModel::AddTangent(const Vector3f& tangent)
+//Maps a mesh on a loader thread, then copies it there into a buffer that's
+//mapped for it on the thread that draws. As much of that as the budget allows
+//is copied into the mesh's own buffers each frame, and it's only drawn once
+//all of it is there.
+class MeshStreamJob : public AsyncLoadJob
 {
-	m_tangents.push_back(tangent);
-}
+public:
+	MeshStreamJob(MeshData* meshData, const std::string& fileName) :
+		m_meshData(meshData),
+		m_fileName(fileName),
+		m_packedMesh(0),
+		m_use1010102(false),
+		m_isFilled(false),
+		m_hasStarted(false),
+		m_numUploaded(0) {}
+	virtual ~MeshStreamJob()
+	{
+		if(m_meshData) m_meshData->m_streamJob = 0;
+		delete m_packedMesh;
+	}
 
-IndexedModel IndexedModel::Finalize()
-{
-	if(IsValid())
+	virtual void Load()
 	{
-		return *this;
+		m_packedMesh = new PackedMesh("./res/models/" + m_fileName + ".mesh");
 	}
-	
-	if(m_texCoords.size() == 0)
+
+	virtual void Prepare()
 	{
-		for(unsigned int i = m_texCoords.size(); i < m_positions.size(); i++)
+		if(m_meshData == 0 || !m_packedMesh->IsValid())
 		{
-			m_texCoords.push_back(Vector2f(0.0f, 0.0f));
+			return;
 		}
+
+		//The buffers are staged one after another, as if they were one.
+		m_sizes[0] = m_packedMesh->GetNumVertices() * (unsigned int)sizeof(Vector3f);
+		m_sizes[1] = m_packedMesh->GetNumVertices() * m_packedMesh->GetVertexSize();
+		m_sizes[2] = m_packedMesh->GetNumIndices() * m_packedMesh->GetIndexSize();
+		m_use1010102 = m_packedMesh->Uses1010102() && Supports1010102();
+		m_meshData->InitBuffers(m_sizes, 0);
+		m_staging.Map(m_sizes[0] + m_sizes[1] + m_sizes[2]);
 	}
-	
-	if(m_normals.size() == 0)
+
+	virtual void Fill()
 	{
-		CalcNormals();
+		unsigned char* data = m_staging.GetData();
+		if(data == 0)
+		{
+			return;
+		}
+
+		//Directions are widened here, on the rare context that can't read 10
+		//bit ones, so nothing but copying is left for the thread that draws.
+		const unsigned char* vertices = m_packedMesh->GetVertices();
+		std::vector<unsigned char> convertedVertices;
+		if(m_packedMesh->Uses1010102() && !m_use1010102)
+		{
+			PackedMesh::ConvertTo16BitDirections(vertices, m_packedMesh->GetNumVertices(), &convertedVertices);
+			vertices = convertedVertices.empty() ? 0 : &convertedVertices[0];
+		}
+
+		const void* blobs[3] = { m_packedMesh->GetPositions(), vertices, m_packedMesh->GetIndices() };
+		for(int i = 0; i < 3; i++)
+		{
+			if(m_sizes[i] > 0)
+			{
+				memcpy(data, blobs[i], m_sizes[i]);
+			}
+			data += m_sizes[i];
+		}
+		m_isFilled = true;
 	}
-	
-	if(m_tangents.size() == 0)
+
+	virtual bool Upload(unsigned int* budget)
 	{
-		CalcTangents();
+		if(m_meshData == 0)
+		{
+			return true;
+		}
+		
+		if(!m_hasStarted)
+		{
+			m_hasStarted = true;
+			bool isIntact = m_staging.Unmap();
+			if(!m_isFilled || !isIntact)
+			{
+				std::cout << "Mesh load failed!: " << m_fileName << " (convert it with meshConverter)" << std::endl;
+				return true;
+			}
+		}
+
+		unsigned int bufferStart = 0;
+		for(int i = 0; i < 3 && *budget > 0; i++)
+		{
+			unsigned int bufferEnd = bufferStart + m_sizes[i];
+			if(m_numUploaded < bufferEnd)
+			{
+				unsigned int size = std::min(bufferEnd - m_numUploaded, *budget);
+				m_meshData->CopyToBuffer(i, m_numUploaded - bufferStart, size, m_staging, m_numUploaded);
+				m_numUploaded += size;
+				*budget -= size;
+			}
+			bufferStart = bufferEnd;
+		}
+
+		if(m_numUploaded < m_sizes[0] + m_sizes[1] + m_sizes[2])
+		{
+			return false;
+		}
+
+		m_meshData->InitVertexArrays(*m_packedMesh, m_use1010102);
+		return true;
 	}
-	
-	return *this;
+
+	//For when the mesh is deleted before it's been streamed in.
+	inline void Cancel() { m_meshData = 0; }
+private:
+	MeshData*     m_meshData;
+	std::string   m_fileName;
+	PackedMesh*   m_packedMesh;
+	unsigned int  m_sizes[3];    //Of the position, vertex and index buffers
+	bool          m_use1010102;
+	StagingBuffer m_staging;
+	bool          m_isFilled;    //Whether everything was staged
+	bool          m_hasStarted;  //Whether anything's been uploaded yet
+	unsigned int  m_numUploaded; //Bytes, across every buffer
+
+	MeshStreamJob(const MeshStreamJob& other) {}
+	void operator=(const MeshStreamJob& other) {}
+};
+
+MeshData::MeshData(const PackedMesh& packedMesh) : 
+	ReferenceCounter(),
+	m_vertexArrayObject(0),
+	m_positionArrayObject(0),
+	m_drawCount(0),
+	m_numVertices(0),
+	m_indexType(GL_UNSIGNED_INT),
+	m_streamJob(0)
+{
+	Init(packedMesh);
 }
 
-void IndexedModel::AddFace(unsigned int vertIndex0, unsigned int vertIndex1, unsigned int vertIndex2)
+MeshData::MeshData(const std::string& fileName, AsyncLoader* loader) :
+	ReferenceCounter(),
+	m_vertexArrayObject(0),
+	m_positionArrayObject(0),
+	m_drawCount(0),
+	m_numVertices(0),
+	m_indexType(GL_UNSIGNED_INT),
+	m_streamJob(new MeshStreamJob(this, fileName))
 {
-	m_indices.push_back(vertIndex0);
-	m_indices.push_back(vertIndex1);
-	m_indices.push_back(vertIndex2);
+	for(unsigned int i = 0; i < NUM_BUFFERS; i++)
+	{
+		m_vertexArrayBuffers[i] = 0;
+	}
+	loader->Queue(m_streamJob);
 }
 
-void IndexedModel::CalcNormals()
+void MeshData::Init(const PackedMesh& packedMesh)
 {
-	m_normals.clear();
-	m_normals.reserve(m_positions.size());
-	
-	for(unsigned int i = 0; i < m_positions.size(); i++)
-		m_normals.push_back(Vector3f(0,0,0));
+	bool use1010102 = packedMesh.Uses1010102();
+	const unsigned char* vertices = packedMesh.GetVertices();
 
-	for(unsigned int i = 0; i < m_indices.size(); i += 3)
+	//Packed meshes converted ahead of time use 10 bit directions, so they're
+	//only widened here on the rare context that can't read them.
+	std::vector<unsigned char> convertedVertices;
+	if(use1010102 && !Supports1010102())
 	{
-		int i0 = m_indices[i];
-		int i1 = m_indices[i + 1];
-		int i2 = m_indices[i + 2];
-			
-		Vector3f v1 = m_positions[i1] - m_positions[i0];
-		Vector3f v2 = m_positions[i2] - m_positions[i0];
-		
-		Vector3f normal = v1.Cross(v2).Normalized();
-		
-		m_normals[i0] = m_normals[i0] + normal;
-		m_normals[i1] = m_normals[i1] + normal;
-		m_normals[i2] = m_normals[i2] + normal;
+		PackedMesh::ConvertTo16BitDirections(vertices, packedMesh.GetNumVertices(), &convertedVertices);
+		vertices = convertedVertices.empty() ? 0 : &convertedVertices[0];
+		use1010102 = false;
 	}
-	
-	for(unsigned int i = 0; i < m_normals.size(); i++)
-		m_normals[i] = m_normals[i].Normalized();
+
+	unsigned int sizes[3] =
+	{
+		packedMesh.GetNumVertices() * (unsigned int)sizeof(Vector3f),
+		packedMesh.GetNumVertices() * packedMesh.GetVertexSize(),
+		packedMesh.GetNumIndices() * packedMesh.GetIndexSize()
+	};
+	const void* data[3] = { packedMesh.GetPositions(), vertices, packedMesh.GetIndices() };
+	InitBuffers(sizes, data);
+	InitVertexArrays(packedMesh, use1010102);
 }
 
-void IndexedModel::CalcTangents()
+void MeshData::InitBuffers(const unsigned int* sizes, const void* const* data)
 {
-	m_tangents.clear();
-	m_tangents.reserve(m_positions.size());
-	
-	for(unsigned int i = 0; i < m_positions.size(); i++)
-		m_tangents.push_back(Vector3f(0,0,0));
-		
-	for(unsigned int i = 0; i < m_indices.size(); i += 3)
-    {
-		int i0 = m_indices[i];
-		int i1 = m_indices[i + 1];
-		int i2 = m_indices[i + 2];
-    
-        Vector3f edge1 = m_positions[i1] - m_positions[i0];
-        Vector3f edge2 = m_positions[i2] - m_positions[i0];
-        
-        float deltaU1 = m_texCoords[i1].GetX() - m_texCoords[i0].GetX();
-        float deltaU2 = m_texCoords[i2].GetX() - m_texCoords[i0].GetX();
-        float deltaV1 = m_texCoords[i1].GetY() - m_texCoords[i0].GetY();
-        float deltaV2 = m_texCoords[i2].GetY() - m_texCoords[i0].GetY();
-        
-        float dividend = (deltaU1 * deltaV2 - deltaU2 * deltaV1);
-        float f = dividend == 0.0f ? 0.0f : 1.0f/dividend;
-        
-        Vector3f tangent = Vector3f(0,0,0);
-        
-        tangent.SetX(f * (deltaV2 * edge1.GetX() - deltaV1 * edge2.GetX()));
-        tangent.SetY(f * (deltaV2 * edge1.GetY() - deltaV1 * edge2.GetY()));
-        tangent.SetZ(f * (deltaV2 * edge1.GetZ() - deltaV1 * edge2.GetZ()));
-
-//Bitangent example, in Java
-//		Vector3f bitangent = new Vector3f(0,0,0);
-//		
-//		bitangent.setX(f * (-deltaU2 * edge1.getX() - deltaU1 * edge2.getX()));
-//		bitangent.setX(f * (-deltaU2 * edge1.getY() - deltaU1 * edge2.getY()));
-//		bitangent.setX(f * (-deltaU2 * edge1.getZ() - deltaU1 * edge2.getZ()));
-
-		m_tangents[i0] += tangent;
-		m_tangents[i1] += tangent;
-		m_tangents[i2] += tangent;	
-    }
-
-    for(unsigned int i = 0; i < m_tangents.size(); i++)
-		m_tangents[i] = m_tangents[i].Normalized();
+	//Filled through a binding no vertex array keeps, so whichever one is bound
+	//is left as it was.
+	GLuint buffers[3] = { POSITION_VB, VERTEX_VB, INDEX_VB };
+	glGenBuffers(NUM_BUFFERS, m_vertexArrayBuffers);
+	for(int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertexArrayBuffers[buffers[i]]);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizes[i], data ? data[i] : 0, GL_STATIC_DRAW);
+	}
 }
 
+void MeshData::CopyToBuffer(int buffer, unsigned int offset, unsigned int size, const StagingBuffer& staging, unsigned int stagingOffset)
+{
+	GLuint buffers[3] = { POSITION_VB, VERTEX_VB, INDEX_VB };
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertexArrayBuffers[buffers[buffer]]);
+	staging.CopyToBuffer(stagingOffset, offset, size);
+}
 
-MeshData::MeshData(const IndexedModel& model) : 
-	ReferenceCounter(),
-	m_drawCount(model.GetIndices().size())
+void MeshData::InitVertexArrays(const PackedMesh& packedMesh, bool use1010102)
 {
-	if(!model.IsValid())
-	{
-		std::cout << "Error: Invalid mesh! Must have same number of positions, texCoords, normals, and tangents! "
-			<< "(Maybe you forgot to Finalize() your IndexedModel?)" << std::endl;
-		assert(0 != 0);
-	}
+	m_drawCount = packedMesh.GetNumIndices();
+	m_numVertices = packedMesh.GetNumVertices();
+	m_indexType = packedMesh.GetIndexSize() == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	m_minExtents = packedMesh.GetMinExtents();
+	m_maxExtents = packedMesh.GetMaxExtents();
+
+	bool isPacked = packedMesh.GetVertexFormat() == VERTEX_FORMAT_PACKED;
+	int vertexSize = packedMesh.GetVertexSize();
+
 	glGenVertexArrays(1, &m_vertexArrayObject);
 	glBindVertexArray(m_vertexArrayObject);
 
-	glGenBuffers(NUM_BUFFERS, m_vertexArrayBuffers);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[POSITION_VB]);
-	glBufferData(GL_ARRAY_BUFFER, model.GetPositions().size() * sizeof(model.GetPositions()[0]), &model.GetPositions()[0], GL_STATIC_DRAW);
-	
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[TEXCOORD_VB]);
-	glBufferData(GL_ARRAY_BUFFER, model.GetTexCoords().size() * sizeof(model.GetTexCoords()[0]), &model.GetTexCoords()[0], GL_STATIC_DRAW);
-	
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[VERTEX_VB]);
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[NORMAL_VB]);
-	glBufferData(GL_ARRAY_BUFFER, model.GetNormals().size() * sizeof(model.GetNormals()[0]), &model.GetNormals()[0], GL_STATIC_DRAW);
-	
 	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[TANGENT_VB]);
-	glBufferData(GL_ARRAY_BUFFER, model.GetTangents().size() * sizeof(model.GetTangents()[0]), &model.GetTangents()[0], GL_STATIC_DRAW);
-	
 	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	
+	if(isPacked)
+	{
+		GLint directionSize = use1010102 ? 4 : 2;
+		GLenum directionType = use1010102 ? GL_INT_2_10_10_10_REV : GL_SHORT;
+		glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, vertexSize, 0);
+		glVertexAttribPointer(2, directionSize, directionType, GL_TRUE, vertexSize, (const GLvoid*)4);
+		glVertexAttribPointer(3, directionSize, directionType, GL_TRUE, vertexSize, (const GLvoid*)8);
+	}
+	else
+	{
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, vertexSize, 0);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, vertexSize, (const GLvoid*)(sizeof(float) * 2));
+		glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, vertexSize, (const GLvoid*)(sizeof(float) * 4));
+	}
+
+	if(Mesh::SupportsInstancing())
+	{
+		SetUpInstanceAttributes(m_vertexArrayBuffers[INSTANCE_VB]);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vertexArrayBuffers[INDEX_VB]);
+
+	glGenVertexArrays(1, &m_positionArrayObject);
+	glBindVertexArray(m_positionArrayObject);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[POSITION_VB]);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+	if(Mesh::SupportsInstancing())
+	{
+		SetUpInstanceAttributes(m_vertexArrayBuffers[INSTANCE_VB]);
+	}
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vertexArrayBuffers[INDEX_VB]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, model.GetIndices().size() * sizeof(model.GetIndices()[0]), &model.GetIndices()[0], GL_STATIC_DRAW);
+}
+
+void MeshData::ReadBackPositionsAndIndices() const
+{
+	m_positions.resize(m_numVertices);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[POSITION_VB]);
+	glGetBufferSubData(GL_ARRAY_BUFFER, 0, m_numVertices * sizeof(Vector3f), &m_positions[0]);
+
+	//The index buffer is bound through the vertex array, so it's read from
+	//another target to leave whatever's bound alone.
+	m_indices.resize(m_drawCount);
+	glBindBuffer(GL_COPY_READ_BUFFER, m_vertexArrayBuffers[INDEX_VB]);
+	if(m_indexType == GL_UNSIGNED_SHORT)
+	{
+		std::vector<unsigned short> shortIndices(m_drawCount);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, m_drawCount * sizeof(unsigned short), &shortIndices[0]);
+		m_indices.assign(shortIndices.begin(), shortIndices.end());
+	}
+	else
+	{
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, m_drawCount * sizeof(unsigned int), &m_indices[0]);
+	}
+}
+
+const std::vector<Vector3f>& MeshData::GetPositions() const
+{
+	if(m_positions.empty() && m_drawCount != 0)
+	{
+		ReadBackPositionsAndIndices();
+	}
+	return m_positions;
+}
+
+const std::vector<unsigned int>& MeshData::GetIndices() const
+{
+	if(m_indices.empty() && m_drawCount != 0)
+	{
+		ReadBackPositionsAndIndices();
+	}
+	return m_indices;
 }
 
 MeshData::~MeshData() 
 {	
+	if(m_streamJob) m_streamJob->Cancel();
 	glDeleteBuffers(NUM_BUFFERS, m_vertexArrayBuffers);
 	glDeleteVertexArrays(1, &m_vertexArrayObject);
+	glDeleteVertexArrays(1, &m_positionArrayObject);
 }
 
 void MeshData::Draw() const
 {
-	glBindVertexArray(m_vertexArrayObject);
+	Bind();
+	DrawBound();
+}
+
+void MeshData::Bind(bool positionsOnly) const
+{
+	glBindVertexArray(positionsOnly ? m_positionArrayObject : m_vertexArrayObject);
+}
+
+void MeshData::DrawBound() const
+{
+	//Meshes still being streamed in have nothing to draw yet.
+	if(m_drawCount == 0)
+	{
+		return;
+	}
 	
 	#if PROFILING_DISABLE_MESH_DRAWING == 0
-		glDrawElements(GL_TRIANGLES, m_drawCount, GL_UNSIGNED_INT, 0);
+		glDrawElements(GL_TRIANGLES, m_drawCount, m_indexType, 0);
 	#endif
 }
 
+void MeshData::DrawBoundInstanced(const Matrix4f* transforms, unsigned int numInstances) const
+{
+	if(m_drawCount == 0)
+	{
+		return;
+	}
+	
+	//Reallocating the buffer every time lets the driver hand out fresh memory
+	//instead of waiting for the last draw to finish with the old contents.
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[INSTANCE_VB]);
+	glBufferData(GL_ARRAY_BUFFER, numInstances * sizeof(transforms[0]), transforms, GL_STREAM_DRAW);
+	
+	#if PROFILING_DISABLE_MESH_DRAWING == 0
+		glDrawElementsInstanced(GL_TRIANGLES, m_drawCount, m_indexType, 0, numInstances);
+	#endif
+}
+
+Mesh::Mesh(const std::string& fileName, AsyncLoader* loader) :
+	m_fileName(fileName),
+	m_meshData(0)
+{
+	std::map<std::string, MeshData*>::const_iterator it = s_resourceMap.find(fileName);
+	if(it != s_resourceMap.end())
+	{
+		m_meshData = it->second;
+		m_meshData->AddReference();
+	}
+	else
+	{
+		m_meshData = new MeshData(fileName, loader);
+		s_resourceMap.insert(std::pair<std::string, MeshData*>(fileName, m_meshData));
+	}
+}
 
 Mesh::Mesh(const std::string& meshName, const IndexedModel& model) :
 	m_fileName(meshName)
@@ -237,7 +433,8 @@ Mesh::Mesh(const std::string& meshName, const IndexedModel& model) :
 	}
 	else
 	{
-		m_meshData = new MeshData(model);
+		PackedMesh packedMesh(model, s_vertexFormat, Supports1010102());
+		m_meshData = new MeshData(packedMesh);
 		s_resourceMap.insert(std::pair<std::string, MeshData*>(meshName, m_meshData));
 	}
 }
@@ -254,52 +451,16 @@ Mesh::Mesh(const std::string& fileName) :
 	}
 	else
 	{
-		Assimp::Importer importer;
-		
-		const aiScene* scene = importer.ReadFile(("./res/models/" + fileName).c_str(),
-		                                         aiProcess_Triangulate |
-		                                         aiProcess_GenSmoothNormals | 
-		                                         aiProcess_FlipUVs |
-		                                         aiProcess_CalcTangentSpace);
-		
-		if(!scene)
+		//Converted ahead of time, so the buffers are mapped and uploaded as
+		//they are instead of being imported and optimized on every run.
+		PackedMesh packedMesh("./res/models/" + fileName + ".mesh");
+		if(!packedMesh.IsValid())
 		{
-			std::cout << "Mesh load failed!: " << fileName << std::endl;
+			std::cout << "Mesh load failed!: " << fileName << " (convert it with meshConverter)" << std::endl;
 			assert(0 == 0);
 		}
 		
-		const aiMesh* model = scene->mMeshes[0];
-		
-		std::vector<Vector3f> positions;
-		std::vector<Vector2f> texCoords;
-		std::vector<Vector3f> normals;
-		std::vector<Vector3f> tangents;
-		std::vector<unsigned int> indices;
-
-		const aiVector3D aiZeroVector(0.0f, 0.0f, 0.0f);
-		for(unsigned int i = 0; i < model->mNumVertices; i++) 
-		{
-			const aiVector3D pos = model->mVertices[i];
-			const aiVector3D normal = model->mNormals[i];
-			const aiVector3D texCoord = model->HasTextureCoords(0) ? model->mTextureCoords[0][i] : aiZeroVector;
-			const aiVector3D tangent = model->mTangents[i];
-
-			positions.push_back(Vector3f(pos.x, pos.y, pos.z));
-			texCoords.push_back(Vector2f(texCoord.x, texCoord.y));
-			normals.push_back(Vector3f(normal.x, normal.y, normal.z));
-			tangents.push_back(Vector3f(tangent.x, tangent.y, tangent.z));
-		}
-
-		for(unsigned int i = 0; i < model->mNumFaces; i++)
-		{
-			const aiFace& face = model->mFaces[i];
-			assert(face.mNumIndices == 3);
-			indices.push_back(face.mIndices[0]);
-			indices.push_back(face.mIndices[1]);
-			indices.push_back(face.mIndices[2]);
-		}
-		
-		m_meshData = new MeshData(IndexedModel(indices, positions, texCoords, normals, tangents));
+		m_meshData = new MeshData(packedMesh);
 		s_resourceMap.insert(std::pair<std::string, MeshData*>(fileName, m_meshData));
 	}
 }
@@ -324,6 +485,11 @@ Mesh::~Mesh()
 	}
 }
 
+bool Mesh::SupportsInstancing()
+{
+	return GLEW_VERSION_3_3 || (GLEW_VERSION_3_1 && GLEW_ARB_instanced_arrays);
+}
+
 void Mesh::Draw() const
 {
 	m_meshData->Draw();
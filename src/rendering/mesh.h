@@ -19,75 +19,74 @@
 
 #include "../core/math3d.h"
 #include "../core/referenceCounter.h"
+#include "../core/asyncLoader.h"
+#include "indexedModel.h"
+#include "packedMesh.h"
 
 #include <string>
 #include <vector>
 #include <map>
 #include <GL/glew.h>
 
-class IndexedModel
-{
-public:
-	IndexedModel() {}
-	IndexedModel(const std::vector<unsigned int> indices, const std::vector<Vector3f>& positions, const std::vector<Vector2f>& texCoords,
-		const std::vector<Vector3f>& normals = std::vector<Vector3f>(), const std::vector<Vector3f>& tangents = std::vector<Vector3f>()) :
-			m_indices(indices),
-			m_positions(positions),
-			m_texCoords(texCoords),
-			m_normals(normals),
-			m_tangents(tangents) {}
-
-	bool IsValid() const;
-	void CalcNormals();
-	void CalcTangents();
-
-	IndexedModel Finalize();
-
-	void AddVertex(const Vector3f& vert);
-	inline void AddVertex(float x, float y, float z) { AddVertex(Vector3f(x, y, z)); }
-	
-	void AddTexCoord(const Vector2f& texCoord);
-	inline void AddTexCoord(float x, float y) { AddTexCoord(Vector2f(x, y)); }
-	
-	void AddNormal(const Vector3f& normal);
-	inline void AddNormal(float x, float y, float z) { AddNormal(Vector3f(x, y, z)); }
-	
-	void AddTangent(const Vector3f& tangent);
-	inline void AddTangent(float x, float y, float z) { AddTangent(Vector3f(x, y, z)); }
-	
-	void AddFace(unsigned int vertIndex0, unsigned int vertIndex1, unsigned int vertIndex2);
-
-	inline const std::vector<unsigned int>& GetIndices() const { return m_indices; }
-	inline const std::vector<Vector3f>& GetPositions()   const { return m_positions; }
-	inline const std::vector<Vector2f>& GetTexCoords()   const { return m_texCoords; }
-	inline const std::vector<Vector3f>& GetNormals()     const { return m_normals; }
-	inline const std::vector<Vector3f>& GetTangents()    const { return m_tangents; }
-private:
-	std::vector<unsigned int> m_indices;
-    std::vector<Vector3f> m_positions;
-    std::vector<Vector2f> m_texCoords;
-    std::vector<Vector3f> m_normals;
-    std::vector<Vector3f> m_tangents;  
-};
+class MeshStreamJob;
+class StagingBuffer;
 
 class MeshData : public ReferenceCounter
 {
 public:
-	MeshData(const IndexedModel& model);
+	//Uploads the buffers as they're laid out, with no per vertex work.
+	MeshData(const PackedMesh& packedMesh);
+	//Queues the file to be streamed in by loader. Until it has been, the mesh
+	//has no vertices, so draws nothing, and its extents are empty.
+	MeshData(const std::string& fileName, AsyncLoader* loader);
 	virtual ~MeshData();
 	
 	void Draw() const;
+	//Positions have a buffer of their own, so passes that read nothing else,
+	//like drawing shadow maps, can leave the rest of each vertex unread.
+	void Bind(bool positionsOnly = false) const;
+	//Draws with whatever vertex array is bound, for when Bind has already been
+	//called on this mesh.
+	void DrawBound() const;
+	//Draws one copy of the mesh per transform, passing each one to the shader
+	//as the T_model attribute. Also expects Bind to have been called.
+	void DrawBoundInstanced(const Matrix4f* transforms, unsigned int numInstances) const;
+	inline GLuint GetVertexArrayObject() const { return m_vertexArrayObject; }
+
+	//The corners of the smallest box around every vertex, in model space.
+	inline const Vector3f& GetMinExtents() const { return m_minExtents; }
+	inline const Vector3f& GetMaxExtents() const { return m_maxExtents; }
+
+	//Copies on the CPU, for drawing the mesh as an occluder. They're only read
+	//back from its buffers the first time they're asked for, and are empty
+	//while it's still being streamed in.
+	const std::vector<Vector3f>& GetPositions()   const;
+	const std::vector<unsigned int>& GetIndices() const;
+
+	inline bool IsStreaming() const { return m_streamJob != 0; }
 protected:	
 private:
+	friend class MeshStreamJob;
+
 	MeshData(MeshData& other) {}
 	void operator=(MeshData& other) {}
 
+	void Init(const PackedMesh& packedMesh);
+	//Makes the position, vertex and index buffers, in that order, filled from
+	//data if it's given.
+	void InitBuffers(const unsigned int* sizes, const void* const* data);
+	//Copies size bytes from stagingOffset into a buffer at offset. Buffer is 0
+	//for positions, 1 for vertices and 2 for indices.
+	void CopyToBuffer(int buffer, unsigned int offset, unsigned int size, const StagingBuffer& staging, unsigned int stagingOffset);
+	//Once the buffers are filled, after which the mesh is drawn.
+	void InitVertexArrays(const PackedMesh& packedMesh, bool use1010102);
+	void ReadBackPositionsAndIndices() const;
+
 	enum
 	{
 		POSITION_VB,
-		TEXCOORD_VB,
-		NORMAL_VB,
-		TANGENT_VB,
+		VERTEX_VB,   //Everything else about each vertex, interleaved
+		INSTANCE_VB,
 		
 		INDEX_VB,
 		
@@ -95,22 +94,57 @@ private:
 	};
 	
 	GLuint m_vertexArrayObject;
+	GLuint m_positionArrayObject; //Only reads from the position buffer
 	GLuint m_vertexArrayBuffers[NUM_BUFFERS];
 	int m_drawCount;
+	unsigned int m_numVertices;
+	GLenum m_indexType;           //16 bit when every vertex can be reached with one
+	Vector3f m_minExtents;
+	Vector3f m_maxExtents;
+	mutable std::vector<Vector3f> m_positions;
+	mutable std::vector<unsigned int> m_indices;
+	MeshStreamJob* m_streamJob;   //0 unless it's still being streamed in
 };
 
 class Mesh
 {
 public:
+	//Maps ./res/models/<fileName>.mesh, written from the model by meshConverter.
 	Mesh(const std::string& fileName = "cube.obj");
+	//Returns straight away, with the file loaded on loader's threads and
+	//uploaded by its Update. Nothing is drawn until then.
+	Mesh(const std::string& fileName, AsyncLoader* loader);
 	Mesh(const std::string& meshName, const IndexedModel& model);
 	Mesh(const Mesh& mesh);
 	virtual ~Mesh();
 
 	void Draw() const;
+	inline void Bind(bool positionsOnly = false) const { m_meshData->Bind(positionsOnly); }
+	inline void DrawBound() const { m_meshData->DrawBound(); }
+	inline void DrawBoundInstanced(const Matrix4f* transforms, unsigned int numInstances) const
+	{
+		m_meshData->DrawBoundInstanced(transforms, numInstances);
+	}
+
+	//Whether the OpenGL context can draw instances with per instance attributes.
+	static bool SupportsInstancing();
+	//The format meshes built from an IndexedModel from now on store their
+	//vertices in. Ones loaded from files keep the format they were converted to.
+	inline static void SetVertexFormat(VertexFormat vertexFormat) { s_vertexFormat = vertexFormat; }
+
+	//Different for every mesh that exists at the same time.
+	inline unsigned int GetId() const { return m_meshData->GetVertexArrayObject(); }
+
+	inline const Vector3f& GetMinExtents() const { return m_meshData->GetMinExtents(); }
+	inline const Vector3f& GetMaxExtents() const { return m_meshData->GetMaxExtents(); }
+	inline const std::vector<Vector3f>& GetPositions()   const { return m_meshData->GetPositions(); }
+	inline const std::vector<unsigned int>& GetIndices() const { return m_meshData->GetIndices(); }
+	//Whether the mesh is still being streamed in. Its extents change once it has.
+	inline bool IsStreaming() const { return m_meshData->IsStreaming(); }
 protected:
 private:
 	static std::map<std::string, MeshData*> s_resourceMap;
+	static VertexFormat s_vertexFormat;
 
 	std::string m_fileName;
 	MeshData* m_meshData;
@@ -0,0 +1,620 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "meshOptimizer.h"
+#include "../core/profiling.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+//How Forsyth's algorithm scores vertices. Ones in the cache score more the
+//more recently they were used, and ones with few triangles left to draw get a
+//boost so they're finished off rather than left behind as stragglers.
+static const float CACHE_DECAY_POWER   = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static const unsigned int NO_VERTEX = 0xFFFFFFFF;
+
+static float CalcVertexScore(unsigned int numActiveTriangles, int cachePosition)
+{
+	if(numActiveTriangles == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if(cachePosition >= 0)
+	{
+		//The last triangle's vertices all score the same, so the next triangle
+		//doesn't favour one edge over another.
+		if(cachePosition < 3)
+		{
+			score = LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			float scale = 1.0f / (float)(MeshOptimizer::CACHE_SIZE - 3);
+			score = powf(1.0f - (float)(cachePosition - 3) * scale, CACHE_DECAY_POWER);
+		}
+	}
+
+	return score + VALENCE_BOOST_SCALE * powf((float)numActiveTriangles, -VALENCE_BOOST_POWER);
+}
+
+//Every attribute of a vertex, compared bit for bit.
+struct VertexKey
+{
+	float values[11];
+
+	bool operator<(const VertexKey& other) const { return memcmp(values, other.values, sizeof(values)) < 0; }
+};
+
+MeshOptimizer::Report MeshOptimizer::Optimize(IndexedModel* model)
+{
+	Report report;
+	report.numVerticesBefore = (unsigned int)model->GetPositions().size();
+	report.acmrBefore = CalcACMR(model->GetIndices(), report.numVerticesBefore);
+
+	WeldVertices(model);
+
+	std::vector<unsigned int> indices = model->GetIndices();
+	OptimizeVertexCache(&indices, (unsigned int)model->GetPositions().size());
+	OptimizeOverdraw(model->GetPositions(), &indices);
+	*model = IndexedModel(indices, model->GetPositions(), model->GetTexCoords(), model->GetNormals(), model->GetTangents());
+
+	OptimizeVertexFetch(model);
+
+	report.numVerticesAfter = (unsigned int)model->GetPositions().size();
+	report.acmrAfter = CalcACMR(model->GetIndices(), report.numVerticesAfter);
+	return report;
+}
+
+void MeshOptimizer::WeldVertices(IndexedModel* model)
+{
+	const std::vector<Vector3f>& positions = model->GetPositions();
+	const std::vector<Vector2f>& texCoords = model->GetTexCoords();
+	const std::vector<Vector3f>& normals = model->GetNormals();
+	const std::vector<Vector3f>& tangents = model->GetTangents();
+
+	std::map<VertexKey, unsigned int> uniqueVertices;
+	std::vector<unsigned int> remap(positions.size());
+	std::vector<Vector3f> newPositions;
+	std::vector<Vector2f> newTexCoords;
+	std::vector<Vector3f> newNormals;
+	std::vector<Vector3f> newTangents;
+	for(unsigned int i = 0; i < positions.size(); i++)
+	{
+		//Attributes the model doesn't have yet are left as zero.
+		VertexKey key;
+		memset(key.values, 0, sizeof(key.values));
+		for(int j = 0; j < 3; j++)
+		{
+			key.values[j] = positions[i][j];
+			key.values[5 + j] = i < normals.size() ? normals[i][j] : 0.0f;
+			key.values[8 + j] = i < tangents.size() ? tangents[i][j] : 0.0f;
+		}
+		key.values[3] = i < texCoords.size() ? texCoords[i].GetX() : 0.0f;
+		key.values[4] = i < texCoords.size() ? texCoords[i].GetY() : 0.0f;
+
+		std::map<VertexKey, unsigned int>::const_iterator it = uniqueVertices.find(key);
+		if(it != uniqueVertices.end())
+		{
+			remap[i] = it->second;
+			continue;
+		}
+
+		remap[i] = (unsigned int)newPositions.size();
+		uniqueVertices.insert(std::pair<VertexKey, unsigned int>(key, remap[i]));
+		newPositions.push_back(positions[i]);
+		if(i < texCoords.size()) newTexCoords.push_back(texCoords[i]);
+		if(i < normals.size())   newNormals.push_back(normals[i]);
+		if(i < tangents.size())  newTangents.push_back(tangents[i]);
+	}
+
+	std::vector<unsigned int> indices(model->GetIndices());
+	for(unsigned int i = 0; i < indices.size(); i++)
+	{
+		indices[i] = remap[indices[i]];
+	}
+
+	*model = IndexedModel(indices, newPositions, newTexCoords, newNormals, newTangents);
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>* indices, unsigned int numVertices)
+{
+	unsigned int numTriangles = (unsigned int)indices->size() / 3;
+	const std::vector<unsigned int>& source = *indices;
+
+	//The triangles around each vertex. The first numActiveTriangles of each
+	//vertex's are the ones that haven't been drawn yet.
+	std::vector<unsigned int> firstTriangles(numVertices + 1, 0);
+	for(unsigned int i = 0; i < numTriangles * 3; i++)
+	{
+		firstTriangles[source[i] + 1]++;
+	}
+	for(unsigned int i = 0; i < numVertices; i++)
+	{
+		firstTriangles[i + 1] += firstTriangles[i];
+	}
+
+	std::vector<unsigned int> vertexTriangles(numTriangles * 3);
+	std::vector<unsigned int> numActiveTriangles(numVertices, 0);
+	for(unsigned int i = 0; i < numTriangles * 3; i++)
+	{
+		unsigned int vertex = source[i];
+		vertexTriangles[firstTriangles[vertex] + numActiveTriangles[vertex]++] = i / 3;
+	}
+
+	std::vector<float> vertexScores(numVertices);
+	std::vector<int> cachePositions(numVertices, -1);
+	for(unsigned int i = 0; i < numVertices; i++)
+	{
+		vertexScores[i] = CalcVertexScore(numActiveTriangles[i], -1);
+	}
+
+	std::vector<float> triangleScores(numTriangles);
+	std::vector<bool> isDrawn(numTriangles, false);
+	int bestTriangle = -1;
+	float bestScore = -1.0f;
+	for(unsigned int i = 0; i < numTriangles; i++)
+	{
+		triangleScores[i] = vertexScores[source[i * 3]] + vertexScores[source[i * 3 + 1]] + vertexScores[source[i * 3 + 2]];
+		if(triangleScores[i] > bestScore)
+		{
+			bestScore = triangleScores[i];
+			bestTriangle = (int)i;
+		}
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(numTriangles * 3);
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> newCache;
+	cache.reserve(CACHE_SIZE + 3);
+	newCache.reserve(CACHE_SIZE + 3);
+	unsigned int nextUndrawn = 0;
+
+	for(unsigned int drawn = 0; drawn < numTriangles; drawn++)
+	{
+		//When nothing near the cache is left, carry on from the first triangle
+		//that hasn't been drawn.
+		if(bestTriangle < 0)
+		{
+			while(isDrawn[nextUndrawn])
+			{
+				nextUndrawn++;
+			}
+			bestTriangle = (int)nextUndrawn;
+		}
+
+		unsigned int triangle = (unsigned int)bestTriangle;
+		const unsigned int* triangleVertices = &source[triangle * 3];
+		isDrawn[triangle] = true;
+
+		newCache.clear();
+		for(int i = 0; i < 3; i++)
+		{
+			unsigned int vertex = triangleVertices[i];
+			result.push_back(vertex);
+
+			unsigned int first = firstTriangles[vertex];
+			unsigned int last = first + numActiveTriangles[vertex] - 1;
+			for(unsigned int j = first; j <= last; j++)
+			{
+				if(vertexTriangles[j] == triangle)
+				{
+					std::swap(vertexTriangles[j], vertexTriangles[last]);
+					numActiveTriangles[vertex]--;
+					break;
+				}
+			}
+
+			if(std::find(newCache.begin(), newCache.end(), vertex) == newCache.end())
+			{
+				newCache.push_back(vertex);
+			}
+		}
+
+		for(unsigned int i = 0; i < cache.size(); i++)
+		{
+			if(cache[i] != triangleVertices[0] && cache[i] != triangleVertices[1] && cache[i] != triangleVertices[2])
+			{
+				newCache.push_back(cache[i]);
+			}
+		}
+
+		for(unsigned int i = 0; i < newCache.size(); i++)
+		{
+			int position = i < (unsigned int)CACHE_SIZE ? (int)i : -1;
+			cachePositions[newCache[i]] = position;
+			vertexScores[newCache[i]] = CalcVertexScore(numActiveTriangles[newCache[i]], position);
+		}
+
+		//Only triangles touching the cache, or just pushed out of it, change score.
+		bestTriangle = -1;
+		bestScore = -1.0f;
+		for(unsigned int i = 0; i < newCache.size(); i++)
+		{
+			unsigned int vertex = newCache[i];
+			for(unsigned int j = firstTriangles[vertex]; j < firstTriangles[vertex] + numActiveTriangles[vertex]; j++)
+			{
+				unsigned int other = vertexTriangles[j];
+				float score = vertexScores[source[other * 3]] + vertexScores[source[other * 3 + 1]] + vertexScores[source[other * 3 + 2]];
+				triangleScores[other] = score;
+				if(score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = (int)other;
+				}
+			}
+		}
+
+		if(newCache.size() > (unsigned int)CACHE_SIZE)
+		{
+			newCache.resize(CACHE_SIZE);
+		}
+		cache.swap(newCache);
+	}
+
+	indices->swap(result);
+}
+
+void MeshOptimizer::OptimizeOverdraw(const std::vector<Vector3f>& positions, std::vector<unsigned int>* indices)
+{
+	const std::vector<unsigned int>& source = *indices;
+	unsigned int numTriangles = (unsigned int)source.size() / 3;
+	if(numTriangles == 0)
+	{
+		return;
+	}
+
+	//A run starts wherever a triangle misses the cache on all three vertices,
+	//since nothing before it was being reused anyway.
+	std::vector<unsigned int> runStarts;
+	std::vector<int> cacheTimes(positions.size(), -MEASURED_CACHE_SIZE - 1);
+	int numMisses = 0;
+	for(unsigned int i = 0; i < numTriangles; i++)
+	{
+		int triangleMisses = 0;
+		for(int j = 0; j < 3; j++)
+		{
+			unsigned int vertex = source[i * 3 + j];
+			if(numMisses - cacheTimes[vertex] >= MEASURED_CACHE_SIZE)
+			{
+				cacheTimes[vertex] = numMisses++;
+				triangleMisses++;
+			}
+		}
+
+		if(i == 0 || triangleMisses == 3)
+		{
+			runStarts.push_back(i);
+		}
+	}
+	runStarts.push_back(numTriangles);
+
+	//Each run's area weighted centre and normal.
+	unsigned int numRuns = (unsigned int)runStarts.size() - 1;
+	std::vector<Vector3f> runCentres(numRuns);
+	std::vector<Vector3f> runNormals(numRuns);
+	Vector3f meshCentre(0, 0, 0);
+	float meshArea = 0.0f;
+	for(unsigned int i = 0; i < numRuns; i++)
+	{
+		Vector3f centre(0, 0, 0);
+		Vector3f normal(0, 0, 0);
+		float area = 0.0f;
+		for(unsigned int j = runStarts[i]; j < runStarts[i + 1]; j++)
+		{
+			const Vector3f& p0 = positions[source[j * 3]];
+			const Vector3f& p1 = positions[source[j * 3 + 1]];
+			const Vector3f& p2 = positions[source[j * 3 + 2]];
+			Vector3f cross = Vector3f(p1 - p0).Cross(p2 - p0);
+			float triangleArea = cross.Length() * 0.5f;
+
+			centre += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+
+		meshCentre += centre;
+		meshArea += area;
+		runCentres[i] = area > 0.0f ? Vector3f(centre / area) : positions[source[runStarts[i] * 3]];
+		runNormals[i] = normal;
+	}
+	if(meshArea > 0.0f)
+	{
+		meshCentre = meshCentre / meshArea;
+	}
+
+	//Runs facing out from far from the centre are the ones most likely to be
+	//in front of the rest.
+	std::vector<std::pair<float, unsigned int> > runOrder(numRuns);
+	for(unsigned int i = 0; i < numRuns; i++)
+	{
+		float normalLength = runNormals[i].Length();
+		float occlusion = normalLength > 0.0f ? Vector3f(runCentres[i] - meshCentre).Dot(runNormals[i]) / normalLength : 0.0f;
+		runOrder[i] = std::pair<float, unsigned int>(-occlusion, i);
+	}
+	std::sort(runOrder.begin(), runOrder.end());
+
+	std::vector<unsigned int> result;
+	result.reserve(source.size());
+	for(unsigned int i = 0; i < numRuns; i++)
+	{
+		unsigned int run = runOrder[i].second;
+		result.insert(result.end(), source.begin() + runStarts[run] * 3, source.begin() + runStarts[run + 1] * 3);
+	}
+
+	indices->swap(result);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(IndexedModel* model)
+{
+	const std::vector<Vector3f>& positions = model->GetPositions();
+	const std::vector<Vector2f>& texCoords = model->GetTexCoords();
+	const std::vector<Vector3f>& normals = model->GetNormals();
+	const std::vector<Vector3f>& tangents = model->GetTangents();
+
+	std::vector<unsigned int> remap(positions.size(), NO_VERTEX);
+	std::vector<unsigned int> indices(model->GetIndices());
+	std::vector<Vector3f> newPositions;
+	std::vector<Vector2f> newTexCoords;
+	std::vector<Vector3f> newNormals;
+	std::vector<Vector3f> newTangents;
+	for(unsigned int i = 0; i < indices.size(); i++)
+	{
+		unsigned int vertex = indices[i];
+		if(remap[vertex] == NO_VERTEX)
+		{
+			remap[vertex] = (unsigned int)newPositions.size();
+			newPositions.push_back(positions[vertex]);
+			if(vertex < texCoords.size()) newTexCoords.push_back(texCoords[vertex]);
+			if(vertex < normals.size())   newNormals.push_back(normals[vertex]);
+			if(vertex < tangents.size())  newTangents.push_back(tangents[vertex]);
+		}
+		indices[i] = remap[vertex];
+	}
+
+	*model = IndexedModel(indices, newPositions, newTexCoords, newNormals, newTangents);
+}
+
+float MeshOptimizer::CalcACMR(const std::vector<unsigned int>& indices, unsigned int numVertices, int cacheSize)
+{
+	if(indices.size() < 3)
+	{
+		return 0.0f;
+	}
+
+	//A vertex is still in the FIFO if fewer than cacheSize misses have pushed
+	//vertices in since it went in.
+	std::vector<int> cacheTimes(numVertices, -cacheSize - 1);
+	int numMisses = 0;
+	for(unsigned int i = 0; i < indices.size(); i++)
+	{
+		if(numMisses - cacheTimes[indices[i]] >= cacheSize)
+		{
+			cacheTimes[indices[i]] = numMisses++;
+		}
+	}
+
+	return (float)numMisses / (float)(indices.size() / 3);
+}
+
+//A flat grid of size by size quads, as a model whose vertices are all shared.
+static IndexedModel CreateTestGrid(int size)
+{
+	IndexedModel model;
+	for(int y = 0; y <= size; y++)
+	{
+		for(int x = 0; x <= size; x++)
+		{
+			model.AddVertex((float)x, (float)y, 0.0f);
+			model.AddTexCoord((float)x / (float)size, (float)y / (float)size);
+		}
+	}
+
+	for(int y = 0; y < size; y++)
+	{
+		for(int x = 0; x < size; x++)
+		{
+			unsigned int corner = (unsigned int)(y * (size + 1) + x);
+			model.AddFace(corner, corner + 1, corner + size + 1);
+			model.AddFace(corner + 1, corner + size + 2, corner + size + 1);
+		}
+	}
+	return model;
+}
+
+//The triangles, each rotated to start at its smallest index, in sorted order.
+static std::vector<unsigned int> CalcSortedTriangles(const std::vector<unsigned int>& indices, const std::vector<Vector3f>& positions)
+{
+	std::vector<std::vector<float> > triangles;
+	for(unsigned int i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int start = 0;
+		for(unsigned int j = 1; j < 3; j++)
+		{
+			const Vector3f& candidate = positions[indices[i + j]];
+			const Vector3f& best = positions[indices[i + start]];
+			if(candidate.GetX() < best.GetX() || (candidate.GetX() == best.GetX() && candidate.GetY() < best.GetY()))
+			{
+				start = j;
+			}
+		}
+
+		std::vector<float> triangle;
+		for(unsigned int j = 0; j < 3; j++)
+		{
+			const Vector3f& position = positions[indices[i + (start + j) % 3]];
+			triangle.push_back(position.GetX());
+			triangle.push_back(position.GetY());
+		}
+		triangles.push_back(triangle);
+	}
+	std::sort(triangles.begin(), triangles.end());
+
+	std::vector<unsigned int> result;
+	for(unsigned int i = 0; i < triangles.size(); i++)
+	{
+		for(unsigned int j = 0; j < triangles[i].size(); j++)
+		{
+			result.push_back((unsigned int)triangles[i][j]);
+		}
+	}
+	return result;
+}
+
+static void ShuffleTriangles(std::vector<unsigned int>* indices)
+{
+	unsigned int numTriangles = (unsigned int)indices->size() / 3;
+	for(unsigned int i = numTriangles - 1; i > 0; i--)
+	{
+		unsigned int other = (unsigned int)rand() % (i + 1);
+		for(int j = 0; j < 3; j++)
+		{
+			std::swap((*indices)[i * 3 + j], (*indices)[other * 3 + j]);
+		}
+	}
+}
+
+void MeshOptimizer::Test()
+{
+	//A quad with every corner of both triangles stored separately welds down
+	//to four vertices, and still draws the same triangles.
+	IndexedModel quad;
+	Vector3f corners[] = { Vector3f(0, 0, 0), Vector3f(1, 0, 0), Vector3f(0, 1, 0), Vector3f(1, 0, 0), Vector3f(1, 1, 0), Vector3f(0, 1, 0) };
+	for(unsigned int i = 0; i < 6; i++)
+	{
+		quad.AddVertex(corners[i]);
+		quad.AddTexCoord(corners[i].GetX(), corners[i].GetY());
+	}
+	quad.AddFace(0, 1, 2);
+	quad.AddFace(3, 4, 5);
+	std::vector<unsigned int> quadTriangles = CalcSortedTriangles(quad.GetIndices(), quad.GetPositions());
+	WeldVertices(&quad);
+	assert(quad.GetPositions().size() == 4);
+	assert(quad.GetTexCoords().size() == 4);
+	assert(CalcSortedTriangles(quad.GetIndices(), quad.GetPositions()) == quadTriangles);
+
+	//Vertices that differ in anything but position stay apart.
+	IndexedModel seam;
+	seam.AddVertex(0, 0, 0); seam.AddTexCoord(0, 0);
+	seam.AddVertex(0, 0, 0); seam.AddTexCoord(1, 0);
+	seam.AddVertex(1, 0, 0); seam.AddTexCoord(1, 0);
+	seam.AddFace(0, 1, 2);
+	WeldVertices(&seam);
+	assert(seam.GetPositions().size() == 3);
+
+	//A grid drawn in a random order misses the cache on nearly every vertex,
+	//and after optimizing gets close to the best possible.
+	srand(3);
+	IndexedModel grid = CreateTestGrid(48);
+	std::vector<unsigned int> shuffled = grid.GetIndices();
+	ShuffleTriangles(&shuffled);
+	grid = IndexedModel(shuffled, grid.GetPositions(), grid.GetTexCoords());
+	std::vector<unsigned int> gridTriangles = CalcSortedTriangles(grid.GetIndices(), grid.GetPositions());
+	unsigned int numVertices = (unsigned int)grid.GetPositions().size();
+
+	std::vector<unsigned int> indices = grid.GetIndices();
+	float shuffledACMR = CalcACMR(indices, numVertices);
+	OptimizeVertexCache(&indices, numVertices);
+	float optimizedACMR = CalcACMR(indices, numVertices);
+	assert(shuffledACMR > 1.5f);
+	assert(optimizedACMR < 0.8f);
+	assert(CalcSortedTriangles(indices, grid.GetPositions()) == gridTriangles);
+
+	//Reordering runs for overdraw keeps most of the cache's benefit.
+	OptimizeOverdraw(grid.GetPositions(), &indices);
+	assert(CalcACMR(indices, numVertices) < optimizedACMR * 1.1f);
+	assert(CalcSortedTriangles(indices, grid.GetPositions()) == gridTriangles);
+
+	//After the whole pipeline vertices are numbered in the order they're used.
+	Report report = Optimize(&grid);
+	assert(report.numVerticesBefore == numVertices && report.numVerticesAfter == numVertices);
+	assert(report.acmrAfter < report.acmrBefore);
+	unsigned int nextVertex = 0;
+	for(unsigned int i = 0; i < grid.GetIndices().size(); i++)
+	{
+		assert(grid.GetIndices()[i] <= nextVertex);
+		if(grid.GetIndices()[i] == nextVertex)
+		{
+			nextVertex++;
+		}
+	}
+	assert(nextVertex == numVertices);
+	assert(CalcSortedTriangles(grid.GetIndices(), grid.GetPositions()) == gridTriangles);
+
+	//Normals and tangents come out exactly the same on several threads.
+	IndexedModel serial = CreateTestGrid(72);
+	IndexedModel threaded = serial;
+	serial.CalcNormals();
+	serial.CalcTangents();
+	{
+		ThreadPool threadPool(3);
+		threaded.CalcNormals(&threadPool);
+		threaded.CalcTangents(&threadPool);
+	}
+	assert(serial.GetNormals() == threaded.GetNormals());
+	assert(serial.GetTangents() == threaded.GetTangents());
+	assert(serial.GetNormals()[0] == Vector3f(0, 0, 1));
+	assert(fabsf(serial.GetTangents()[0].GetX() - 1.0f) < 1e-5f);
+}
+
+void MeshOptimizer::Benchmark()
+{
+	srand(5);
+	IndexedModel grid = CreateTestGrid(256);
+	std::vector<unsigned int> shuffled = grid.GetIndices();
+	ShuffleTriangles(&shuffled);
+	grid = IndexedModel(shuffled, grid.GetPositions(), grid.GetTexCoords());
+
+	unsigned int maxThreads = ThreadPool::GetNumCPUs();
+	for(unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		ThreadPool* threadPool = numThreads > 1 ? new ThreadPool(numThreads) : 0;
+		ProfileTimer timer;
+		for(int i = 0; i < 10; i++)
+		{
+			IndexedModel model = grid;
+			timer.StartInvocation();
+			model.CalcNormals(threadPool);
+			model.CalcTangents(threadPool);
+			timer.StopInvocation();
+		}
+		delete threadPool;
+
+		std::ostringstream message;
+		message << "Normals and tangents (131072 triangles, " << numThreads << " threads): ";
+		timer.DisplayAndReset(message.str(), 0, 56);
+	}
+
+	ProfileTimer timer;
+	timer.StartInvocation();
+	Report report = Optimize(&grid);
+	timer.StopInvocation();
+	timer.DisplayAndReset("Mesh optimization (131072 triangles): ", 0, 56);
+	printf("    ACMR %f -> %f, %u -> %u vertices\n", report.acmrBefore, report.acmrAfter,
+		report.numVerticesBefore, report.numVerticesAfter);
+}
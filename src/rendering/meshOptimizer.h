@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "indexedModel.h"
+
+#include <vector>
+
+//Reorders a model as it's imported so the GPU does less work drawing it.
+//Identical vertices are merged, triangles are sorted so vertices are reused
+//from the post-transform cache and so the parts of the mesh most likely to
+//hide others are drawn first, and vertices are sorted into the order they're
+//first used so they're fetched from memory in order.
+class MeshOptimizer
+{
+public:
+	//Vertices in the cache the triangle order is tuned for.
+	static const int CACHE_SIZE = 32;
+	//Vertices in the FIFO cache ACMR is measured with, about what GPUs have.
+	static const int MEASURED_CACHE_SIZE = 16;
+
+	struct Report
+	{
+		unsigned int numVerticesBefore;
+		unsigned int numVerticesAfter;
+		float        acmrBefore;
+		float        acmrAfter;
+	};
+
+	//Runs every step on a model, returning how much it changed.
+	static Report Optimize(IndexedModel* model);
+
+	//Merges vertices that are the same in every attribute.
+	static void WeldVertices(IndexedModel* model);
+	//Tom Forsyth's linear-speed vertex cache optimization.
+	static void OptimizeVertexCache(std::vector<unsigned int>* indices, unsigned int numVertices);
+	//Splits the triangles into runs that each start with a cache miss, so
+	//moving them around doesn't lose the cache order, then draws the runs
+	//facing furthest out from the middle of the mesh first.
+	static void OptimizeOverdraw(const std::vector<Vector3f>& positions, std::vector<unsigned int>* indices);
+	//Renumbers vertices in the order they're first used, dropping unused ones.
+	static void OptimizeVertexFetch(IndexedModel* model);
+
+	//Average cache miss ratio: vertices transformed per triangle drawn, with a
+	//FIFO cache of cacheSize. 3 is the worst, and about 0.5 the best possible.
+	static float CalcACMR(const std::vector<unsigned int>& indices, unsigned int numVertices, int cacheSize = MEASURED_CACHE_SIZE);
+
+	static void Test();
+	static void Benchmark();
+};
+
+#endif
@@ -0,0 +1,806 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "objReader.h"
+#include "../core/mappedFile.h"
+#include "../core/profiling.h"
+#include "../core/util.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+static const unsigned int NO_INDEX = 0xFFFFFFFF;
+
+//Every power of 10 a double holds exactly.
+static const double EXACT_POWERS_OF_10[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//How many of each element a chunk has, or how many come before it.
+struct ElementCounts
+{
+	unsigned int numPositions;
+	unsigned int numTexCoords;
+	unsigned int numNormals;
+	unsigned int numTriangles;
+};
+
+//An o, g or usemtl line, and the first triangle after it.
+struct GroupChange
+{
+	char         type;
+	std::string  name;
+	unsigned int triangle;
+};
+
+//A run of whole lines, which are parsed once to count what's in them so
+//every chunk knows where its elements go, then again to read them.
+struct Chunk
+{
+	const char*              begin;
+	const char*              end;
+	ElementCounts            counts;
+	ElementCounts            offsets;
+	std::vector<GroupChange> groupChanges;
+	bool                     isValid;
+};
+
+//Everything the chunks parse into. A corner is the position, texture
+//coordinate and normal indices of one corner of a triangle.
+struct ParsedElements
+{
+	std::vector<Vector3f>      positions;
+	std::vector<Vector2f>      texCoords;
+	std::vector<Vector3f>      normals;
+	std::vector<unsigned int>  corners;
+	std::vector<unsigned char> isLastOfFace; //Per triangle, whether it's the last one its face was fanned into
+};
+
+static inline bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* SkipSpaces(const char* p, const char* end)
+{
+	while(p < end && IsSpace(*p))
+	{
+		p++;
+	}
+	return p;
+}
+
+static inline const char* SkipLine(const char* p, const char* end)
+{
+	const char* newLine = (const char*)memchr(p, '\n', end - p);
+	return newLine ? newLine + 1 : end;
+}
+
+static inline const char* FindLineEnd(const char* p, const char* end)
+{
+	const char* newLine = (const char*)memchr(p, '\n', end - p);
+	return newLine ? newLine : end;
+}
+
+//Whether the line at p starts with keyword followed by a space.
+static inline bool IsKeyword(const char* p, const char* end, const char* keyword, size_t length)
+{
+	return (size_t)(end - p) > length && memcmp(p, keyword, length) == 0 && IsSpace(p[length]);
+}
+
+static int ParseInt(const char** cursor, const char* end)
+{
+	const char* p = *cursor;
+	bool isNegative = p < end && *p == '-';
+	if(p < end && (*p == '-' || *p == '+'))
+	{
+		p++;
+	}
+
+	int value = 0;
+	while(p < end && *p >= '0' && *p <= '9')
+	{
+		value = value * 10 + (*p - '0');
+		p++;
+	}
+	*cursor = p;
+	return isNegative ? -value : value;
+}
+
+//From an OBJ index, counting from 1 or back from the end if it's negative,
+//to one counting from 0. Returns NO_INDEX for 0, which is never valid.
+static inline unsigned int ResolveIndex(int index, unsigned int numBefore)
+{
+	if(index > 0)
+	{
+		return (unsigned int)(index - 1);
+	}
+	if(index < 0 && (unsigned int)-index <= numBefore)
+	{
+		return numBefore - (unsigned int)-index;
+	}
+	return NO_INDEX;
+}
+
+static unsigned int CountFaceCorners(const char* p, const char* lineEnd)
+{
+	unsigned int numCorners = 0;
+	p = SkipSpaces(p, lineEnd);
+	while(p < lineEnd)
+	{
+		numCorners++;
+		while(p < lineEnd && !IsSpace(*p))
+		{
+			p++;
+		}
+		p = SkipSpaces(p, lineEnd);
+	}
+	return numCorners;
+}
+
+class CountTask : public ThreadPoolTask
+{
+public:
+	CountTask(std::vector<Chunk>* chunks) :
+		m_chunks(chunks) {}
+
+	virtual void Run(unsigned int index)
+	{
+		Chunk& chunk = (*m_chunks)[index];
+		ElementCounts counts = { 0, 0, 0, 0 };
+		const char* p = chunk.begin;
+		while(p < chunk.end)
+		{
+			p = SkipSpaces(p, chunk.end);
+			if(IsKeyword(p, chunk.end, "v", 1))
+			{
+				counts.numPositions++;
+			}
+			else if(IsKeyword(p, chunk.end, "vt", 2))
+			{
+				counts.numTexCoords++;
+			}
+			else if(IsKeyword(p, chunk.end, "vn", 2))
+			{
+				counts.numNormals++;
+			}
+			else if(IsKeyword(p, chunk.end, "f", 1))
+			{
+				unsigned int numCorners = CountFaceCorners(p + 1, FindLineEnd(p, chunk.end));
+				counts.numTriangles += numCorners >= 3 ? numCorners - 2 : 0;
+			}
+			p = SkipLine(p, chunk.end);
+		}
+		chunk.counts = counts;
+	}
+private:
+	std::vector<Chunk>* m_chunks;
+};
+
+class ParseTask : public ThreadPoolTask
+{
+public:
+	ParseTask(std::vector<Chunk>* chunks, ParsedElements* elements) :
+		m_chunks(chunks),
+		m_elements(elements) {}
+
+	virtual void Run(unsigned int index)
+	{
+		Chunk& chunk = (*m_chunks)[index];
+		chunk.isValid = true;
+		ElementCounts next = chunk.offsets;
+		std::vector<unsigned int> faceCorners;
+		const char* p = chunk.begin;
+		while(p < chunk.end)
+		{
+			p = SkipSpaces(p, chunk.end);
+			const char* lineEnd = FindLineEnd(p, chunk.end);
+			if(IsKeyword(p, chunk.end, "v", 1))
+			{
+				p += 1;
+				float values[3];
+				for(int i = 0; i < 3; i++)
+				{
+					p = SkipSpaces(p, lineEnd);
+					values[i] = ObjReader::ParseFloat(&p, lineEnd);
+				}
+				m_elements->positions[next.numPositions++] = Vector3f(values[0], values[1], values[2]);
+			}
+			else if(IsKeyword(p, chunk.end, "vt", 2))
+			{
+				p += 2;
+				p = SkipSpaces(p, lineEnd);
+				float u = ObjReader::ParseFloat(&p, lineEnd);
+				p = SkipSpaces(p, lineEnd);
+				float v = ObjReader::ParseFloat(&p, lineEnd);
+				//Flipped, as aiProcess_FlipUVs does.
+				m_elements->texCoords[next.numTexCoords++] = Vector2f(u, 1.0f - v);
+			}
+			else if(IsKeyword(p, chunk.end, "vn", 2))
+			{
+				p += 2;
+				float values[3];
+				for(int i = 0; i < 3; i++)
+				{
+					p = SkipSpaces(p, lineEnd);
+					values[i] = ObjReader::ParseFloat(&p, lineEnd);
+				}
+				m_elements->normals[next.numNormals++] = Vector3f(values[0], values[1], values[2]);
+			}
+			else if(IsKeyword(p, chunk.end, "f", 1))
+			{
+				ParseFace(p + 1, lineEnd, &next, &faceCorners, &chunk.isValid);
+			}
+			else if(IsKeyword(p, chunk.end, "o", 1) || IsKeyword(p, chunk.end, "g", 1) || IsKeyword(p, chunk.end, "usemtl", 6))
+			{
+				GroupChange change;
+				change.type = *p;
+				change.triangle = next.numTriangles;
+				const char* name = SkipSpaces(p + (*p == 'u' ? 6 : 1), lineEnd);
+				const char* nameEnd = lineEnd;
+				while(nameEnd > name && IsSpace(nameEnd[-1]))
+				{
+					nameEnd--;
+				}
+				change.name.assign(name, nameEnd);
+				chunk.groupChanges.push_back(change);
+			}
+			p = lineEnd < chunk.end ? lineEnd + 1 : chunk.end;
+		}
+	}
+private:
+	std::vector<Chunk>* m_chunks;
+	ParsedElements*     m_elements;
+
+	//Fans the face out into triangles, like aiProcess_Triangulate does with
+	//convex polygons.
+	void ParseFace(const char* p, const char* lineEnd, ElementCounts* next, std::vector<unsigned int>* faceCorners, bool* isValid)
+	{
+		faceCorners->clear();
+		p = SkipSpaces(p, lineEnd);
+		while(p < lineEnd)
+		{
+			unsigned int corner[3] = { NO_INDEX, NO_INDEX, NO_INDEX };
+			corner[0] = ResolveIndex(ParseInt(&p, lineEnd), next->numPositions);
+			for(int i = 1; i < 3 && p < lineEnd && *p == '/'; i++)
+			{
+				p++;
+				if(p < lineEnd && *p != '/' && !IsSpace(*p))
+				{
+					corner[i] = ResolveIndex(ParseInt(&p, lineEnd), i == 1 ? next->numTexCoords : next->numNormals);
+					*isValid = *isValid && corner[i] != NO_INDEX;
+				}
+			}
+			*isValid = *isValid && corner[0] != NO_INDEX;
+			faceCorners->insert(faceCorners->end(), corner, corner + 3);
+
+			while(p < lineEnd && !IsSpace(*p))
+			{
+				p++;
+			}
+			p = SkipSpaces(p, lineEnd);
+		}
+
+		unsigned int numCorners = (unsigned int)faceCorners->size() / 3;
+		for(unsigned int i = 1; i + 1 < numCorners; i++)
+		{
+			unsigned int* dest = &m_elements->corners[next->numTriangles * 9];
+			memcpy(dest, &(*faceCorners)[0], sizeof(unsigned int) * 3);
+			memcpy(dest + 3, &(*faceCorners)[i * 3], sizeof(unsigned int) * 3);
+			memcpy(dest + 6, &(*faceCorners)[i * 3 + 3], sizeof(unsigned int) * 3);
+			m_elements->isLastOfFace[next->numTriangles] = i + 2 == numCorners;
+			next->numTriangles++;
+		}
+	}
+};
+
+//Gives each position the normal aiProcess_GenSmoothNormals would. After
+//triangulating, Assimp gives every corner of a face the normal of the last
+//triangle using it, then adds up the corners at each position. Each corner
+//of a face counts once, so the two corners on a quad's diagonal don't get
+//both of its triangles.
+static void CalcSmoothNormals(const ParsedElements& elements, unsigned int numTriangles, std::vector<Vector3f>* normals)
+{
+	normals->assign(elements.positions.size(), Vector3f(0.0f, 0.0f, 0.0f));
+	for(unsigned int i = 0; i < numTriangles; i++)
+	{
+		const unsigned int* corners = &elements.corners[i * 9];
+		const Vector3f& p0 = elements.positions[corners[0]];
+		Vector3f normal = (elements.positions[corners[3]] - p0).Cross(elements.positions[corners[6]] - p0);
+		float length = normal.Length();
+		if(length > 0.0f)
+		{
+			normal = normal / length;
+		}
+
+		//A face is fanned out from its first corner, so the middle corner of
+		//each triangle is last used by it, and the others only by the face's
+		//last triangle.
+		(*normals)[corners[3]] += normal;
+		if(elements.isLastOfFace[i])
+		{
+			(*normals)[corners[0]] += normal;
+			(*normals)[corners[6]] += normal;
+		}
+	}
+
+	for(unsigned int i = 0; i < normals->size(); i++)
+	{
+		float length = (*normals)[i].Length();
+		if(length > 0.0f)
+		{
+			(*normals)[i] = (*normals)[i] / length;
+		}
+	}
+}
+
+static void RunTask(ThreadPool* threadPool, ThreadPoolTask* task, unsigned int count)
+{
+	if(threadPool)
+	{
+		threadPool->ParallelFor(task, count);
+		return;
+	}
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		task->Run(i);
+	}
+}
+
+//Splits the data into chunks of about chunkSize, each ending after a new line.
+static void SplitIntoChunks(const char* data, size_t size, size_t chunkSize, std::vector<Chunk>* chunks)
+{
+	const char* end = data + size;
+	const char* p = data;
+	while(p < end)
+	{
+		Chunk chunk;
+		chunk.begin = p;
+		chunk.end = (size_t)(end - p) > chunkSize ? SkipLine(p + chunkSize, end) : end;
+		chunk.counts = chunk.offsets = ElementCounts();
+		chunk.isValid = true;
+		chunks->push_back(chunk);
+		p = chunk.end;
+	}
+}
+
+//Turns the o, g and usemtl lines into ranges of triangles, leaving out empty ones.
+static void BuildGroups(const std::vector<Chunk>& chunks, unsigned int numTriangles, std::vector<ObjReader::Group>* groups)
+{
+	groups->clear();
+	ObjReader::Group group;
+	group.firstIndex = 0;
+	group.numIndices = 0;
+	for(unsigned int i = 0; i < chunks.size(); i++)
+	{
+		for(unsigned int j = 0; j < chunks[i].groupChanges.size(); j++)
+		{
+			const GroupChange& change = chunks[i].groupChanges[j];
+			group.numIndices = change.triangle * 3 - group.firstIndex;
+			if(group.numIndices > 0)
+			{
+				groups->push_back(group);
+			}
+
+			if(change.type == 'o')
+			{
+				group.objectName = change.name;
+				group.groupName.clear();
+			}
+			else if(change.type == 'g')
+			{
+				group.groupName = change.name;
+			}
+			else
+			{
+				group.materialName = change.name;
+			}
+			group.firstIndex = change.triangle * 3;
+		}
+	}
+
+	group.numIndices = numTriangles * 3 - group.firstIndex;
+	if(group.numIndices > 0)
+	{
+		groups->push_back(group);
+	}
+}
+
+bool ObjReader::Load(const std::string& fileName, IndexedModel* model, std::vector<Group>* groups, ThreadPool* threadPool)
+{
+	MappedFile file(fileName);
+	if(!file.IsOpen())
+	{
+		return false;
+	}
+	return Parse((const char*)file.GetData(), file.GetSize(), model, groups, threadPool);
+}
+
+bool ObjReader::Parse(const char* data, size_t size, IndexedModel* model, std::vector<Group>* groups, ThreadPool* threadPool,
+	size_t chunkSize)
+{
+	std::vector<Chunk> chunks;
+	SplitIntoChunks(data, size, chunkSize, &chunks);
+	unsigned int numChunks = (unsigned int)chunks.size();
+
+	CountTask countTask(&chunks);
+	RunTask(threadPool, &countTask, numChunks);
+
+	ElementCounts totals = { 0, 0, 0, 0 };
+	for(unsigned int i = 0; i < numChunks; i++)
+	{
+		chunks[i].offsets = totals;
+		totals.numPositions += chunks[i].counts.numPositions;
+		totals.numTexCoords += chunks[i].counts.numTexCoords;
+		totals.numNormals += chunks[i].counts.numNormals;
+		totals.numTriangles += chunks[i].counts.numTriangles;
+	}
+
+	ParsedElements elements;
+	elements.positions.resize(totals.numPositions);
+	elements.texCoords.resize(totals.numTexCoords);
+	elements.normals.resize(totals.numNormals);
+	elements.corners.resize(totals.numTriangles * 9);
+	elements.isLastOfFace.resize(totals.numTriangles);
+	ParseTask parseTask(&chunks, &elements);
+	RunTask(threadPool, &parseTask, numChunks);
+
+	for(unsigned int i = 0; i < numChunks; i++)
+	{
+		if(!chunks[i].isValid)
+		{
+			return false;
+		}
+	}
+
+	//Vertices are shared between corners with the same indices, found by
+	//looking through the ones made so far for the same position.
+	unsigned int numCorners = totals.numTriangles * 3;
+	std::vector<unsigned int> firstVertexAtPosition(totals.numPositions, NO_INDEX);
+	std::vector<unsigned int> nextVertexAtPosition(numCorners);
+	std::vector<unsigned int> vertexCorners(numCorners);
+	std::vector<unsigned int> indices(numCorners);
+	unsigned int numVertices = 0;
+	bool needsSmoothNormals = false;
+	for(unsigned int i = 0; i < numCorners; i++)
+	{
+		const unsigned int* corner = &elements.corners[i * 3];
+		if(corner[0] >= totals.numPositions || (corner[1] != NO_INDEX && corner[1] >= totals.numTexCoords) ||
+			(corner[2] != NO_INDEX && corner[2] >= totals.numNormals))
+		{
+			return false;
+		}
+
+		unsigned int vertex = firstVertexAtPosition[corner[0]];
+		while(vertex != NO_INDEX && memcmp(&elements.corners[vertexCorners[vertex] * 3], corner, sizeof(unsigned int) * 3) != 0)
+		{
+			vertex = nextVertexAtPosition[vertex];
+		}
+
+		if(vertex == NO_INDEX)
+		{
+			vertex = numVertices++;
+			vertexCorners[vertex] = i;
+			nextVertexAtPosition[vertex] = firstVertexAtPosition[corner[0]];
+			firstVertexAtPosition[corner[0]] = vertex;
+			needsSmoothNormals = needsSmoothNormals || corner[2] == NO_INDEX;
+		}
+		indices[i] = vertex;
+	}
+
+	std::vector<Vector3f> smoothNormals;
+	if(needsSmoothNormals)
+	{
+		CalcSmoothNormals(elements, totals.numTriangles, &smoothNormals);
+	}
+
+	std::vector<Vector3f> positions(numVertices);
+	std::vector<Vector2f> texCoords(numVertices);
+	std::vector<Vector3f> normals(numVertices);
+	for(unsigned int i = 0; i < numVertices; i++)
+	{
+		const unsigned int* corner = &elements.corners[vertexCorners[i] * 3];
+		positions[i] = elements.positions[corner[0]];
+		texCoords[i] = corner[1] != NO_INDEX ? elements.texCoords[corner[1]] : Vector2f(0.0f, 0.0f);
+		normals[i] = corner[2] != NO_INDEX ? elements.normals[corner[2]] : smoothNormals[corner[0]];
+	}
+
+	*model = IndexedModel(indices, positions, texCoords, normals);
+	model->CalcTangents(threadPool);
+	if(groups)
+	{
+		BuildGroups(chunks, totals.numTriangles, groups);
+	}
+	return true;
+}
+
+float ObjReader::ParseFloat(const char** cursor, const char* end)
+{
+	const char* p = *cursor;
+	bool isNegative = p < end && *p == '-';
+	if(p < end && (*p == '-' || *p == '+'))
+	{
+		p++;
+	}
+
+	//Digits past the 19th can't change a float, so they only move the exponent.
+	unsigned long long mantissa = 0;
+	int numDigits = 0;
+	int exponent = 0;
+	while(p < end && *p >= '0' && *p <= '9')
+	{
+		if(numDigits < 19)
+		{
+			mantissa = mantissa * 10 + (unsigned long long)(*p - '0');
+			numDigits += mantissa > 0 ? 1 : 0;
+		}
+		else
+		{
+			exponent++;
+		}
+		p++;
+	}
+	if(p < end && *p == '.')
+	{
+		p++;
+		while(p < end && *p >= '0' && *p <= '9')
+		{
+			if(numDigits < 19)
+			{
+				mantissa = mantissa * 10 + (unsigned long long)(*p - '0');
+				numDigits += mantissa > 0 ? 1 : 0;
+				exponent--;
+			}
+			p++;
+		}
+	}
+	if(p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* exponentStart = p + 1;
+		if(exponentStart < end && (*exponentStart == '-' || *exponentStart == '+'))
+		{
+			exponentStart++;
+		}
+		if(exponentStart < end && *exponentStart >= '0' && *exponentStart <= '9')
+		{
+			p++;
+			exponent += ParseInt(&p, end);
+		}
+	}
+	*cursor = p;
+
+	//Exact when the mantissa fits in a double and the power of 10 is one of
+	//the exact ones, which covers every number written out by a modeler.
+	double value = (double)mantissa;
+	int numPowers = (int)(sizeof(EXACT_POWERS_OF_10) / sizeof(EXACT_POWERS_OF_10[0]));
+	if(exponent < 0)
+	{
+		value = -exponent < numPowers ? value / EXACT_POWERS_OF_10[-exponent] : value * pow(10.0, exponent);
+	}
+	else if(exponent > 0)
+	{
+		value = exponent < numPowers ? value * EXACT_POWERS_OF_10[exponent] : value * pow(10.0, exponent);
+	}
+	return (float)(isNegative ? -value : value);
+}
+
+static bool IsWithinAnUlp(float a, float b)
+{
+	return a == b || nextafterf(a, b) == b;
+}
+
+static bool IsSameModel(const IndexedModel& a, const IndexedModel& b)
+{
+	return a.GetIndices() == b.GetIndices() && a.GetPositions().size() == b.GetPositions().size() &&
+		memcmp(&a.GetPositions()[0], &b.GetPositions()[0], a.GetPositions().size() * sizeof(Vector3f)) == 0 &&
+		memcmp(&a.GetTexCoords()[0], &b.GetTexCoords()[0], a.GetTexCoords().size() * sizeof(Vector2f)) == 0 &&
+		memcmp(&a.GetNormals()[0], &b.GetNormals()[0], a.GetNormals().size() * sizeof(Vector3f)) == 0 &&
+		memcmp(&a.GetTangents()[0], &b.GetTangents()[0], a.GetTangents().size() * sizeof(Vector3f)) == 0;
+}
+
+//A wavy grid of size by size quads, with a group for each row.
+static std::string CreateTestObj(int size)
+{
+	std::ostringstream obj;
+	obj << "# Test grid\no Grid\n";
+	for(int y = 0; y <= size; y++)
+	{
+		for(int x = 0; x <= size; x++)
+		{
+			obj << "v " << x * 0.125f << " " << sinf(x * 0.3f) * cosf(y * 0.2f) << " " << y * -0.125f << "\n";
+			obj << "vt " << (float)x / size << " " << (float)y / size << "\n";
+			obj << "vn " << -cosf(x * 0.3f) * 0.3f << " 1 " << sinf(y * 0.2f) * 0.2f << "\n";
+		}
+	}
+	for(int y = 0; y < size; y++)
+	{
+		obj << "g row" << y << "\n";
+		for(int x = 0; x < size; x++)
+		{
+			int corner = y * (size + 1) + x + 1;
+			int corners[4] = { corner, corner + size + 1, corner + size + 2, corner + 1 };
+			obj << "f";
+			for(int i = 0; i < 4; i++)
+			{
+				obj << " " << corners[i] << "/" << corners[i] << "/" << corners[i];
+			}
+			obj << "\n";
+		}
+	}
+	return obj.str();
+}
+
+void ObjReader::Test()
+{
+	//Numbers come out as strtof reads them, give or take a unit in the last place.
+	const char* numbers[] = { "0", "1", "-1", "0.5", "-0.013002", "3.14159265358979", "1e3", "1.5E-3", "-2.5e+2", "+7",
+		"123456789012345678901234", "0.000000000000000000001234", ".25", "5.", "-0", "1e-50", "65504.0001" };
+	for(unsigned int i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++)
+	{
+		const char* p = numbers[i];
+		float value = ParseFloat(&p, p + strlen(p));
+		assert(p == numbers[i] + strlen(numbers[i]));
+		assert(IsWithinAnUlp(value, strtof(numbers[i], 0)));
+	}
+
+	srand(7);
+	for(int i = 0; i < 10000; i++)
+	{
+		char number[64];
+		float random = (float)(rand() - RAND_MAX / 2) / (float)(rand() % 1000 + 1);
+		SNPRINTF(number, sizeof(number), i % 2 == 0 ? "%f" : "%.9g", random);
+		const char* p = number;
+		float value = ParseFloat(&p, p + strlen(p));
+		assert(IsWithinAnUlp(value, strtof(number, 0)));
+	}
+
+	//A quad and a triangle in two objects. The quad is split into two
+	//triangles, and the triangle, which has negative indices and no normal,
+	//gets the normal of the face around it.
+	std::string obj =
+		"# Test\n"
+		"mtllib test.mtl\n"
+		"o First\n"
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+		"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+		"vn 0 0 1\n"
+		"usemtl Red\n"
+		"f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+		"\n"
+		"o Second\n"
+		"v 0 0 1\nv 1 0 1\nv 0 1 1\n"
+		"l 1 2\n"
+		"f -3/1 -2/2 -1/3\n";
+	std::string windowsObj;
+	for(unsigned int i = 0; i < obj.size(); i++)
+	{
+		windowsObj += obj[i] == '\n' ? "\r\n" : std::string(1, obj[i]);
+	}
+
+	for(int lineEnding = 0; lineEnding < 2; lineEnding++)
+	{
+		const std::string& text = lineEnding == 0 ? obj : windowsObj;
+		IndexedModel model;
+		std::vector<Group> groups;
+		bool parsed = Parse(text.c_str(), text.size(), &model, &groups);
+		assert(parsed);
+
+		unsigned int expectedIndices[] = { 0, 1, 2, 0, 2, 3, 4, 5, 6 };
+		assert(model.GetIndices() == std::vector<unsigned int>(expectedIndices, expectedIndices + 9));
+		assert(model.GetPositions().size() == 7);
+		assert((model.GetPositions()[2] - Vector3f(1, 1, 0)).Length() == 0.0f);
+		assert((model.GetPositions()[6] - Vector3f(0, 1, 1)).Length() == 0.0f);
+		assert(model.GetTexCoords()[1].GetX() == 1.0f && model.GetTexCoords()[1].GetY() == 1.0f);
+		assert(model.GetTexCoords()[2].GetX() == 1.0f && model.GetTexCoords()[2].GetY() == 0.0f);
+		assert(model.GetTexCoords()[6].GetX() == 1.0f && model.GetTexCoords()[6].GetY() == 0.0f);
+		for(unsigned int i = 0; i < 7; i++)
+		{
+			assert((model.GetNormals()[i] - Vector3f(0, 0, 1)).Length() < 1e-6f);
+			assert(fabsf(model.GetTangents()[i].Dot(Vector3f(1, 0, 0)) - 1.0f) < 1e-6f);
+		}
+
+		assert(groups.size() == 2);
+		assert(groups[0].objectName == "First" && groups[0].materialName == "Red");
+		assert(groups[0].firstIndex == 0 && groups[0].numIndices == 6);
+		assert(groups[1].objectName == "Second" && groups[1].materialName == "Red");
+		assert(groups[1].firstIndex == 6 && groups[1].numIndices == 3);
+	}
+
+	//A bent quad without normals is split into two triangles facing different
+	//ways. Like with Assimp, the corners on the split get the normal of the
+	//second triangle only, rather than the average of both.
+	const char* bentQuadObj = "v 0 0 0\nv 1 0 0\nv 1 1 1\nv 0 1 0\nf 1 2 3 4\n";
+	IndexedModel bentQuad;
+	bool parsedBentQuad = Parse(bentQuadObj, strlen(bentQuadObj), &bentQuad);
+	assert(parsedBentQuad);
+	Vector3f firstNormal = Vector3f(1, 0, 0).Cross(Vector3f(1, 1, 1)).Normalized();
+	Vector3f secondNormal = Vector3f(1, 1, 1).Cross(Vector3f(0, 1, 0)).Normalized();
+	assert((bentQuad.GetNormals()[0] - secondNormal).Length() < 1e-6f);
+	assert((bentQuad.GetNormals()[1] - firstNormal).Length() < 1e-6f);
+	assert((bentQuad.GetNormals()[2] - secondNormal).Length() < 1e-6f);
+	assert((bentQuad.GetNormals()[3] - secondNormal).Length() < 1e-6f);
+
+	//Faces using vertices that don't exist make the whole file invalid.
+	const char* invalidObjs[] = { "v 0 0 0\nf 1 2 3\n", "v 0 0 0\nv 0 0 0\nv 0 0 0\nf 0 1 2\n", "v 0 0 0\nf -2 -1 1\n",
+		"v 0 0 0\nf 1/2 1/2 1/2\n" };
+	for(unsigned int i = 0; i < sizeof(invalidObjs) / sizeof(invalidObjs[0]); i++)
+	{
+		IndexedModel model;
+		bool parsed = Parse(invalidObjs[i], strlen(invalidObjs[i]), &model);
+		assert(!parsed);
+	}
+	IndexedModel missing;
+	bool loadedMissing = Load("./res/models/doesNotExist.obj", &missing);
+	assert(!loadedMissing);
+
+	//However the file's split up and shared between threads, the model comes
+	//out the same.
+	std::string gridObj = CreateTestObj(40);
+	IndexedModel expected;
+	std::vector<Group> expectedGroups;
+	bool parsedExpected = Parse(gridObj.c_str(), gridObj.size(), &expected, &expectedGroups);
+	assert(parsedExpected);
+	assert(expected.GetPositions().size() == 41 * 41 && expected.GetIndices().size() == 40 * 40 * 6);
+	assert(expectedGroups.size() == 40 && expectedGroups[39].groupName == "row39" && expectedGroups[39].numIndices == 40 * 6);
+
+	ThreadPool threadPool(4);
+	size_t chunkSizes[] = { 1, 100, 4096 };
+	for(unsigned int i = 0; i < sizeof(chunkSizes) / sizeof(chunkSizes[0]); i++)
+	{
+		IndexedModel model;
+		std::vector<Group> groups;
+		bool parsed = Parse(gridObj.c_str(), gridObj.size(), &model, &groups, &threadPool, chunkSizes[i]);
+		assert(parsed);
+		assert(IsSameModel(model, expected));
+		assert(groups.size() == expectedGroups.size());
+		for(unsigned int j = 0; j < groups.size(); j++)
+		{
+			assert(groups[j].groupName == expectedGroups[j].groupName && groups[j].objectName == expectedGroups[j].objectName);
+			assert(groups[j].firstIndex == expectedGroups[j].firstIndex && groups[j].numIndices == expectedGroups[j].numIndices);
+		}
+	}
+}
+
+void ObjReader::Benchmark()
+{
+	std::string obj = CreateTestObj(512);
+	unsigned int maxThreads = ThreadPool::GetNumCPUs();
+	for(unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		ThreadPool* threadPool = numThreads > 1 ? new ThreadPool(numThreads) : 0;
+		ProfileTimer timer;
+		for(int i = 0; i < 5; i++)
+		{
+			IndexedModel model;
+			timer.StartInvocation();
+			Parse(obj.c_str(), obj.size(), &model, 0, threadPool);
+			timer.StopInvocation();
+		}
+		delete threadPool;
+
+		std::ostringstream message;
+		message << "OBJ parsing (" << obj.size() / (1024 * 1024) << " MB, " << numThreads << " threads): ";
+		timer.DisplayAndReset(message.str(), 0, 56);
+	}
+}
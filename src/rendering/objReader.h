@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OBJREADER_H
+#define OBJREADER_H
+
+#include "indexedModel.h"
+#include "../core/threadPool.h"
+
+#include <string>
+#include <vector>
+
+//Reads Wavefront OBJ files much faster than a general importer can. The file
+//is mapped and split into chunks of whole lines, which are parsed in
+//parallel straight into preallocated arrays, then joined into one model.
+//
+//The model matches what Assimp gives with aiProcess_Triangulate,
+//aiProcess_GenSmoothNormals and aiProcess_FlipUVs, except that vertices used
+//by several faces are shared rather than repeated, and that every face is
+//fanned out from its first corner. Assimp starts a quad with a concave corner
+//from that corner instead, which none of the bundled models have. Every
+//object and group in the file is kept, with Groups saying which triangles
+//came from which.
+class ObjReader
+{
+public:
+	//The triangles between one o, g or usemtl line and the next.
+	struct Group
+	{
+		std::string  objectName;
+		std::string  groupName;
+		std::string  materialName;
+		unsigned int firstIndex;
+		unsigned int numIndices;
+	};
+
+	//Returns false if the file can't be read or has a face using a vertex it
+	//doesn't have. groups can be 0 if they aren't needed.
+	static bool Load(const std::string& fileName, IndexedModel* model, std::vector<Group>* groups = 0, ThreadPool* threadPool = 0);
+	static bool Parse(const char* data, size_t size, IndexedModel* model, std::vector<Group>* groups = 0, ThreadPool* threadPool = 0,
+		size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+	//Parses a decimal number like strtof, to within a unit in the last place,
+	//moving cursor past it. Doesn't read past end.
+	static float ParseFloat(const char** cursor, const char* end);
+
+	static void Test();
+	static void Benchmark();
+private:
+	//Bytes each thread parses at a time, give or take a line.
+	static const size_t DEFAULT_CHUNK_SIZE = 256 * 1024;
+};
+
+#endif
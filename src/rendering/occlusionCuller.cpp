@@ -0,0 +1,546 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "occlusionCuller.h"
+#include "../core/profiling.h"
+#include "../staticLibs/simdaccel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+class RasterizeTileTask : public ThreadPoolTask
+{
+public:
+	RasterizeTileTask(OcclusionCuller* culler) :
+		m_culler(culler) {}
+
+	virtual void Run(unsigned int index)
+	{
+		m_culler->RasterizeTile(index);
+	}
+private:
+	OcclusionCuller* m_culler;
+};
+
+OcclusionCuller::OcclusionCuller(unsigned int numThreads) :
+	m_threadPool(numThreads > 1 ? new ThreadPool(numThreads) : 0),
+	m_viewProjection(Matrix4f().InitIdentity()),
+	m_tileTriangles(TILES_X * TILES_Y)
+{
+	for(int level = 0; level == 0 || GetLevelWidth(level - 1) > 1 || GetLevelHeight(level - 1) > 1; level++)
+	{
+		m_minDepths.push_back(std::vector<float>(GetLevelWidth(level) * GetLevelHeight(level), 1.0f));
+		m_maxDepths.push_back(std::vector<float>(GetLevelWidth(level) * GetLevelHeight(level), 1.0f));
+	}
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+	delete m_threadPool;
+}
+
+void OcclusionCuller::Begin(const Matrix4f& viewProjection)
+{
+	m_viewProjection = viewProjection;
+	m_triangles.clear();
+	for(unsigned int i = 0; i < m_tileTriangles.size(); i++)
+	{
+		m_tileTriangles[i].clear();
+	}
+}
+
+void OcclusionCuller::AddOccluder(const Matrix4f& model, const std::vector<Vector3f>& positions, const std::vector<unsigned int>& indices)
+{
+	//Each column of the matrix is scaled by one coordinate, so a vertex is
+	//moved into clip space with 4 multiplies and adds.
+	Matrix4f mvp = m_viewProjection * model;
+	SIMD4f columns[4];
+	for(int i = 0; i < 4; i++)
+	{
+		columns[i].Set(mvp[i]);
+	}
+
+	m_clipPositions.resize(positions.size() * 4);
+	for(unsigned int i = 0; i < positions.size(); i++)
+	{
+		SIMD4f clip = columns[0] * SIMD4f(positions[i].GetX()) + columns[1] * SIMD4f(positions[i].GetY()) +
+			columns[2] * SIMD4f(positions[i].GetZ()) + columns[3];
+		clip.Get(&m_clipPositions[i * 4]);
+	}
+
+	for(unsigned int i = 0; i + 2 < indices.size(); i += 3)
+	{
+		AddTriangle(&m_clipPositions[indices[i] * 4], &m_clipPositions[indices[i + 1] * 4], &m_clipPositions[indices[i + 2] * 4]);
+	}
+}
+
+void OcclusionCuller::AddTriangle(const float* clip0, const float* clip1, const float* clip2)
+{
+	const float* corners[3] = { clip0, clip1, clip2 };
+
+	//Triangles entirely past one side of the view can't hide anything.
+	for(int axis = 0; axis < 3; axis++)
+	{
+		bool isBelow = true;
+		bool isAbove = true;
+		for(int i = 0; i < 3; i++)
+		{
+			isBelow = isBelow && corners[i][axis] < -corners[i][3];
+			isAbove = isAbove && corners[i][axis] > corners[i][3];
+		}
+
+		if(isAbove || (isBelow && axis != 2))
+		{
+			return;
+		}
+	}
+
+	//Only the near plane has to be clipped against. Triangles are cut off at
+	//the edges of the screen as they're drawn.
+	float distances[3];
+	int numInside = 0;
+	for(int i = 0; i < 3; i++)
+	{
+		distances[i] = corners[i][2] + corners[i][3];
+		numInside += distances[i] >= 0.0f ? 1 : 0;
+	}
+
+	if(numInside == 3)
+	{
+		AddScreenTriangle(clip0, clip1, clip2);
+		return;
+	}
+	else if(numInside == 0)
+	{
+		return;
+	}
+
+	float clipped[4][4];
+	int numClipped = 0;
+	for(int i = 0; i < 3; i++)
+	{
+		int next = (i + 1) % 3;
+		if(distances[i] >= 0.0f)
+		{
+			std::copy(corners[i], corners[i] + 4, clipped[numClipped++]);
+		}
+
+		if((distances[i] >= 0.0f) != (distances[next] >= 0.0f))
+		{
+			float t = distances[i] / (distances[i] - distances[next]);
+			for(int j = 0; j < 4; j++)
+			{
+				clipped[numClipped][j] = corners[i][j] + (corners[next][j] - corners[i][j]) * t;
+			}
+			numClipped++;
+		}
+	}
+
+	for(int i = 2; i < numClipped; i++)
+	{
+		AddScreenTriangle(clipped[0], clipped[i - 1], clipped[i]);
+	}
+}
+
+void OcclusionCuller::AddScreenTriangle(const float* clip0, const float* clip1, const float* clip2)
+{
+	const float* corners[3] = { clip0, clip1, clip2 };
+	float screen[9];
+	for(int i = 0; i < 3; i++)
+	{
+		float w = std::max(corners[i][3], 1e-6f);
+		screen[i * 3 + 0] = (corners[i][0] / w * 0.5f + 0.5f) * (float)WIDTH;
+		screen[i * 3 + 1] = (corners[i][1] / w * 0.5f + 0.5f) * (float)HEIGHT;
+		screen[i * 3 + 2] = corners[i][2] / w * 0.5f + 0.5f;
+	}
+
+	float minX = std::min(screen[0], std::min(screen[3], screen[6]));
+	float maxX = std::max(screen[0], std::max(screen[3], screen[6]));
+	float minY = std::min(screen[1], std::min(screen[4], screen[7]));
+	float maxY = std::max(screen[1], std::max(screen[4], screen[7]));
+	float area = (screen[3] - screen[0]) * (screen[7] - screen[1]) - (screen[6] - screen[0]) * (screen[4] - screen[1]);
+	if(maxX < 0.0f || maxY < 0.0f || minX >= (float)WIDTH || minY >= (float)HEIGHT || area == 0.0f)
+	{
+		return;
+	}
+
+	unsigned int triangle = (unsigned int)(m_triangles.size() / 9);
+	m_triangles.insert(m_triangles.end(), screen, screen + 9);
+
+	int minTileX = std::max((int)minX, 0) / TILE_WIDTH;
+	int minTileY = std::max((int)minY, 0) / TILE_HEIGHT;
+	int maxTileX = std::min((int)std::min(maxX, (float)WIDTH) / TILE_WIDTH, (int)TILES_X - 1);
+	int maxTileY = std::min((int)std::min(maxY, (float)HEIGHT) / TILE_HEIGHT, (int)TILES_Y - 1);
+	for(int y = minTileY; y <= maxTileY; y++)
+	{
+		for(int x = minTileX; x <= maxTileX; x++)
+		{
+			m_tileTriangles[y * TILES_X + x].push_back(triangle);
+		}
+	}
+}
+
+void OcclusionCuller::End()
+{
+	RasterizeTileTask task(this);
+	if(m_threadPool)
+	{
+		m_threadPool->ParallelFor(&task, TILES_X * TILES_Y);
+	}
+	else
+	{
+		for(unsigned int i = 0; i < TILES_X * TILES_Y; i++)
+		{
+			task.Run(i);
+		}
+	}
+
+	BuildPyramid();
+}
+
+void OcclusionCuller::RasterizeTile(unsigned int tile)
+{
+	int tileMinX = (int)(tile % TILES_X) * TILE_WIDTH;
+	int tileMinY = (int)(tile / TILES_X) * TILE_HEIGHT;
+	int tileMaxX = tileMinX + TILE_WIDTH - 1;
+	int tileMaxY = tileMinY + TILE_HEIGHT - 1;
+	float* depths = &m_maxDepths[0][0];
+
+	for(int y = tileMinY; y <= tileMaxY; y++)
+	{
+		std::fill(depths + y * WIDTH + tileMinX, depths + y * WIDTH + tileMaxX + 1, 1.0f);
+	}
+
+	const SIMD4f zero(0.0f);
+	const SIMD4f pixelOffsets(0.5f, 1.5f, 2.5f, 3.5f);
+	const std::vector<unsigned int>& triangles = m_tileTriangles[tile];
+	for(unsigned int i = 0; i < triangles.size(); i++)
+	{
+		const float* corners = &m_triangles[triangles[i] * 9];
+
+		//Edge functions, positive inside the triangle whichever way it winds.
+		//Each is also the weight of the corner opposite its edge, which gives
+		//the depth at any pixel.
+		float area = (corners[3] - corners[0]) * (corners[7] - corners[1]) - (corners[6] - corners[0]) * (corners[4] - corners[1]);
+		float sign = area > 0.0f ? 1.0f : -1.0f;
+		float edgeX[3];
+		float edgeY[3];
+		float edgeConstant[3];
+		for(int j = 0; j < 3; j++)
+		{
+			const float* start = corners + ((j + 1) % 3) * 3;
+			const float* end = corners + ((j + 2) % 3) * 3;
+			edgeX[j] = -(end[1] - start[1]) * sign;
+			edgeY[j] = (end[0] - start[0]) * sign;
+			edgeConstant[j] = -(edgeX[j] * start[0] + edgeY[j] * start[1]);
+		}
+
+		float invArea = 1.0f / fabsf(area);
+		float depthX = (edgeX[0] * corners[2] + edgeX[1] * corners[5] + edgeX[2] * corners[8]) * invArea;
+		float depthY = (edgeY[0] * corners[2] + edgeY[1] * corners[5] + edgeY[2] * corners[8]) * invArea;
+		float depthConstant = (edgeConstant[0] * corners[2] + edgeConstant[1] * corners[5] + edgeConstant[2] * corners[8]) * invArea;
+
+		//Rows of 4 pixels are drawn at once, starting on multiples of 4 so
+		//they never cross into the next tile.
+		int minX = std::max((int)floorf(std::min(corners[0], std::min(corners[3], corners[6]))), tileMinX) & ~3;
+		int maxX = std::min((int)ceilf(std::max(corners[0], std::max(corners[3], corners[6]))), tileMaxX);
+		int minY = std::max((int)floorf(std::min(corners[1], std::min(corners[4], corners[7]))), tileMinY);
+		int maxY = std::min((int)ceilf(std::max(corners[1], std::max(corners[4], corners[7]))), tileMaxY);
+
+		SIMD4f edgeX0(edgeX[0]), edgeX1(edgeX[1]), edgeX2(edgeX[2]);
+		SIMD4f simdDepthX(depthX);
+		for(int y = minY; y <= maxY; y++)
+		{
+			float pixelY = (float)y + 0.5f;
+			SIMD4f rowEdge0(edgeY[0] * pixelY + edgeConstant[0]);
+			SIMD4f rowEdge1(edgeY[1] * pixelY + edgeConstant[1]);
+			SIMD4f rowEdge2(edgeY[2] * pixelY + edgeConstant[2]);
+			SIMD4f rowDepth(depthY * pixelY + depthConstant);
+			float* rowDepths = depths + y * WIDTH;
+
+			for(int x = minX; x <= maxX; x += 4)
+			{
+				SIMD4f pixelX = SIMD4f((float)x) + pixelOffsets;
+				SIMD4f inside = ((edgeX0 * pixelX + rowEdge0) >= zero) & ((edgeX1 * pixelX + rowEdge1) >= zero) &
+					((edgeX2 * pixelX + rowEdge2) >= zero);
+				if(inside.GetSignMask() == 0)
+				{
+					continue;
+				}
+
+				SIMD4f current;
+				current.Set(rowDepths + x);
+				SIMD4f depth = simdDepthX * pixelX + rowDepth;
+				inside.Pick(depth.Min(current), current).Get(rowDepths + x);
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildPyramid()
+{
+	m_minDepths[0] = m_maxDepths[0];
+
+	for(unsigned int level = 1; level < m_maxDepths.size(); level++)
+	{
+		int width = GetLevelWidth(level);
+		int height = GetLevelHeight(level);
+		int lastX = GetLevelWidth(level - 1) - 1;
+		int lastY = GetLevelHeight(level - 1) - 1;
+
+		for(int y = 0; y < height; y++)
+		{
+			for(int x = 0; x < width; x++)
+			{
+				int x0 = std::min(x * 2, lastX);
+				int x1 = std::min(x * 2 + 1, lastX);
+				int y0 = std::min(y * 2, lastY);
+				int y1 = std::min(y * 2 + 1, lastY);
+
+				m_minDepths[level][y * width + x] = std::min(std::min(GetMinDepth(level - 1, x0, y0), GetMinDepth(level - 1, x1, y0)),
+					std::min(GetMinDepth(level - 1, x0, y1), GetMinDepth(level - 1, x1, y1)));
+				m_maxDepths[level][y * width + x] = std::max(std::max(GetMaxDepth(level - 1, x0, y0), GetMaxDepth(level - 1, x1, y0)),
+					std::max(GetMaxDepth(level - 1, x0, y1), GetMaxDepth(level - 1, x1, y1)));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::IsOccluded(const Vector3f& minExtents, const Vector3f& maxExtents) const
+{
+	float minX = (float)WIDTH;
+	float minY = (float)HEIGHT;
+	float maxX = 0.0f;
+	float maxY = 0.0f;
+	float nearestDepth = 1.0f;
+
+	for(int i = 0; i < 8; i++)
+	{
+		Vector4f corner((i & 1) ? maxExtents.GetX() : minExtents.GetX(), (i & 2) ? maxExtents.GetY() : minExtents.GetY(),
+			(i & 4) ? maxExtents.GetZ() : minExtents.GetZ(), 1.0f);
+		Vector4f clip = m_viewProjection.Transform(corner);
+		if(clip[3] <= 0.0f || clip[2] < -clip[3])
+		{
+			return false;
+		}
+
+		float screenX = (clip[0] / clip[3] * 0.5f + 0.5f) * (float)WIDTH;
+		float screenY = (clip[1] / clip[3] * 0.5f + 0.5f) * (float)HEIGHT;
+		minX = std::min(minX, screenX);
+		maxX = std::max(maxX, screenX);
+		minY = std::min(minY, screenY);
+		maxY = std::max(maxY, screenY);
+		nearestDepth = std::min(nearestDepth, clip[2] / clip[3] * 0.5f + 0.5f);
+	}
+
+	//Every texel the box touches at all is checked.
+	int pixelMinX = std::max((int)floorf(minX), 0);
+	int pixelMinY = std::max((int)floorf(minY), 0);
+	int pixelMaxX = std::min((int)floorf(maxX), (int)WIDTH - 1);
+	int pixelMaxY = std::min((int)floorf(maxY), (int)HEIGHT - 1);
+	if(pixelMinX > pixelMaxX || pixelMinY > pixelMaxY)
+	{
+		return false;
+	}
+
+	//Starts from the level where the box is at most 2 texels across, and only
+	//looks closer where that can't decide it.
+	int level = 0;
+	while(level < GetNumLevels() - 1 &&
+		((pixelMaxX >> level) - (pixelMinX >> level) > 1 || (pixelMaxY >> level) - (pixelMinY >> level) > 1))
+	{
+		level++;
+	}
+
+	return IsRectOccluded(level, pixelMinX, pixelMinY, pixelMaxX, pixelMaxY, nearestDepth);
+}
+
+bool OcclusionCuller::IsRectOccluded(int level, int minX, int minY, int maxX, int maxY, float depth) const
+{
+	int lastX = GetLevelWidth(level) - 1;
+	int lastY = GetLevelHeight(level) - 1;
+	for(int y = std::min(minY >> level, lastY); y <= std::min(maxY >> level, lastY); y++)
+	{
+		for(int x = std::min(minX >> level, lastX); x <= std::min(maxX >> level, lastX); x++)
+		{
+			if(depth <= GetMaxDepth(level, x, y))
+			{
+				//In front of everything in this texel, or at least part of it.
+				if(level == 0 || depth <= GetMinDepth(level, x, y))
+				{
+					return false;
+				}
+
+				int childMinX = std::max(minX, x << level);
+				int childMinY = std::max(minY, y << level);
+				int childMaxX = std::min(maxX, ((x + 1) << level) - 1);
+				int childMaxY = std::min(maxY, ((y + 1) << level) - 1);
+				if(!IsRectOccluded(level - 1, childMinX, childMinY, childMaxX, childMaxY, depth))
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+static void AddTestQuad(OcclusionCuller* culler, const Vector3f& corner, const Vector3f& edge1, const Vector3f& edge2)
+{
+	std::vector<Vector3f> positions;
+	positions.push_back(corner);
+	positions.push_back(corner + edge1);
+	positions.push_back(corner + edge1 + edge2);
+	positions.push_back(corner + edge2);
+
+	std::vector<unsigned int> indices;
+	unsigned int quadIndices[] = { 0, 1, 2, 0, 2, 3 };
+	indices.assign(quadIndices, quadIndices + 6);
+
+	culler->AddOccluder(Matrix4f().InitIdentity(), positions, indices);
+}
+
+//A box of the given size centered at center.
+static bool IsTestBoxOccluded(const OcclusionCuller& culler, const Vector3f& center, float size)
+{
+	Vector3f halfSize(size * 0.5f, size * 0.5f, size * 0.5f);
+	return culler.IsOccluded(center - halfSize, center + halfSize);
+}
+
+static Matrix4f CreateTestViewProjection()
+{
+	return Matrix4f().InitPerspective(ToRadians(70.0f), 2.0f, 0.1f, 100.0f);
+}
+
+void OcclusionCuller::Test()
+{
+	OcclusionCuller culler;
+
+	//With nothing drawn, nothing is hidden.
+	culler.Begin(CreateTestViewProjection());
+	culler.End();
+	assert(!IsTestBoxOccluded(culler, Vector3f(0.0f, 0.0f, 20.0f), 1.0f));
+
+	//A wall hides what's behind it, but not what's in front, around it, or
+	//through it.
+	culler.Begin(CreateTestViewProjection());
+	AddTestQuad(&culler, Vector3f(-2.0f, -2.0f, 10.0f), Vector3f(4.0f, 0.0f, 0.0f), Vector3f(0.0f, 4.0f, 0.0f));
+	culler.End();
+	assert(IsTestBoxOccluded(culler, Vector3f(0.0f, 0.0f, 20.0f), 1.0f));
+	assert(IsTestBoxOccluded(culler, Vector3f(0.5f, -0.5f, 50.0f), 0.1f));
+	assert(!IsTestBoxOccluded(culler, Vector3f(0.0f, 0.0f, 5.0f), 1.0f));
+	assert(!IsTestBoxOccluded(culler, Vector3f(0.0f, 0.0f, 10.0f), 1.0f));
+	assert(!IsTestBoxOccluded(culler, Vector3f(3.5f, 0.0f, 20.0f), 2.0f));
+	assert(!IsTestBoxOccluded(culler, Vector3f(0.0f, 0.0f, 0.0f), 1.0f));
+
+	//The pyramid's levels bound the ones below them.
+	for(int level = 1; level < culler.GetNumLevels(); level++)
+	{
+		for(int y = 0; y < culler.GetLevelHeight(level); y++)
+		{
+			for(int x = 0; x < culler.GetLevelWidth(level); x++)
+			{
+				int childX = std::min(x * 2, culler.GetLevelWidth(level - 1) - 1);
+				int childY = std::min(y * 2, culler.GetLevelHeight(level - 1) - 1);
+				assert(culler.GetMinDepth(level, x, y) <= culler.GetMinDepth(level - 1, childX, childY));
+				assert(culler.GetMaxDepth(level, x, y) >= culler.GetMaxDepth(level - 1, childX, childY));
+				assert(culler.GetMinDepth(level, x, y) <= culler.GetMaxDepth(level, x, y));
+			}
+		}
+	}
+	assert(culler.GetMinDepth(culler.GetNumLevels() - 1, 0, 0) < 1.0f);
+	assert(culler.GetMaxDepth(culler.GetNumLevels() - 1, 0, 0) == 1.0f);
+
+	//A floor running behind the camera is clipped at the near plane, and still
+	//hides what's under it.
+	culler.Begin(CreateTestViewProjection());
+	AddTestQuad(&culler, Vector3f(-50.0f, -1.0f, -50.0f), Vector3f(0.0f, 0.0f, 100.0f), Vector3f(100.0f, 0.0f, 0.0f));
+	culler.End();
+	assert(IsTestBoxOccluded(culler, Vector3f(0.0f, -3.0f, 10.0f), 1.0f));
+	assert(!IsTestBoxOccluded(culler, Vector3f(0.0f, 1.0f, 10.0f), 1.0f));
+
+	//Drawing tiles on several threads gives exactly the same depths.
+	OcclusionCuller threadedCuller(3);
+	srand(5);
+	culler.Begin(CreateTestViewProjection());
+	threadedCuller.Begin(CreateTestViewProjection());
+	for(int i = 0; i < 50; i++)
+	{
+		Vector3f corner((float)(rand() % 40 - 20), (float)(rand() % 20 - 10), (float)(rand() % 40 - 5));
+		Vector3f edge1((float)(rand() % 10 - 5), (float)(rand() % 10 - 5), (float)(rand() % 10 - 5));
+		Vector3f edge2((float)(rand() % 10 - 5), (float)(rand() % 10 - 5), (float)(rand() % 10 - 5));
+		AddTestQuad(&culler, corner, edge1, edge2);
+		AddTestQuad(&threadedCuller, corner, edge1, edge2);
+	}
+	culler.End();
+	threadedCuller.End();
+	assert(culler.m_maxDepths == threadedCuller.m_maxDepths);
+	assert(culler.m_minDepths == threadedCuller.m_minDepths);
+}
+
+void OcclusionCuller::Benchmark()
+{
+	//Rows of walls, like the rooms of a level, with boxes scattered between
+	//them to check.
+	srand(7);
+	std::vector<Vector3f> boxes;
+	for(int i = 0; i < 10000; i++)
+	{
+		boxes.push_back(Vector3f((float)(rand() % 200 - 100), (float)(rand() % 10), (float)(rand() % 100 + 1)));
+	}
+
+	unsigned int maxThreads = ThreadPool::GetNumCPUs();
+	for(unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		OcclusionCuller culler(numThreads);
+		ProfileTimer drawTimer;
+		ProfileTimer testTimer;
+		unsigned int numOccluded = 0;
+
+		for(int frame = 0; frame < 100; frame++)
+		{
+			drawTimer.StartInvocation();
+			culler.Begin(CreateTestViewProjection());
+			for(int wall = 0; wall < 1000; wall++)
+			{
+				Vector3f corner((float)((wall % 50) * 4 - 100), 0.0f, (float)((wall / 50) * 5 + 3));
+				AddTestQuad(&culler, corner, Vector3f(3.0f, 0.0f, 0.0f), Vector3f(0.0f, 10.0f, 0.0f));
+			}
+			culler.End();
+			drawTimer.StopInvocation();
+
+			testTimer.StartInvocation();
+			numOccluded = 0;
+			for(unsigned int i = 0; i < boxes.size(); i++)
+			{
+				numOccluded += IsTestBoxOccluded(culler, boxes[i], 0.5f) ? 1 : 0;
+			}
+			testTimer.StopInvocation();
+		}
+
+		std::ostringstream message;
+		message << "Occluder drawing (2000 triangles, " << numThreads << " threads): ";
+		drawTimer.DisplayAndReset(message.str(), 0, 56);
+		testTimer.DisplayAndReset("Occlusion tests (10000 boxes): ", 0, 56);
+		printf("    %u boxes occluded\n", numOccluded);
+	}
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include "../core/math3d.h"
+#include "../core/threadPool.h"
+
+#include <vector>
+
+//Finds what's hidden behind a few big meshes chosen as occluders, like the
+//walls of a level. The occluders are drawn into a small depth buffer on the
+//CPU, which is reduced to a pyramid of the nearest and furthest depths in each
+//block of texels, so a box on screen can be checked against it by reading a
+//handful of texels.
+class OcclusionCuller
+{
+public:
+	enum
+	{
+		WIDTH       = 256,
+		HEIGHT      = 128,
+		TILE_WIDTH  = 64,  //Each tile is drawn by one thread. Must be a multiple of 4.
+		TILE_HEIGHT = 32,
+		TILES_X     = WIDTH / TILE_WIDTH,
+		TILES_Y     = HEIGHT / TILE_HEIGHT
+	};
+
+	//With more than one thread, tiles of the depth buffer are drawn in parallel.
+	OcclusionCuller(unsigned int numThreads = 1);
+	virtual ~OcclusionCuller();
+
+	//Starts a new depth buffer, seen through viewProjection.
+	void Begin(const Matrix4f& viewProjection);
+	//Adds a mesh's triangles, as indices into positions in model space, to be
+	//drawn by End.
+	void AddOccluder(const Matrix4f& model, const std::vector<Vector3f>& positions, const std::vector<unsigned int>& indices);
+	//Draws every occluder added since Begin, and builds the depth pyramid.
+	void End();
+
+	//Whether a world space box is entirely behind the occluders. Boxes that
+	//cross the near plane never are.
+	bool IsOccluded(const Vector3f& minExtents, const Vector3f& maxExtents) const;
+
+	//Depths are 0 at the near plane and 1 at the far plane, where nothing was drawn.
+	inline int GetNumLevels()                        const { return (int)m_maxDepths.size(); }
+	inline float GetMinDepth(int level, int x, int y) const { return m_minDepths[level][y * GetLevelWidth(level) + x]; }
+	inline float GetMaxDepth(int level, int x, int y) const { return m_maxDepths[level][y * GetLevelWidth(level) + x]; }
+	inline int GetLevelWidth(int level)               const { return WIDTH >> level > 0 ? WIDTH >> level : 1; }
+	inline int GetLevelHeight(int level)              const { return HEIGHT >> level > 0 ? HEIGHT >> level : 1; }
+
+	static void Test();
+	static void Benchmark();
+
+	//Used by the tasks drawing is split into.
+	void RasterizeTile(unsigned int tile);
+protected:
+private:
+	ThreadPool*                              m_threadPool;     //0 if everything is drawn on the calling thread
+	Matrix4f                                 m_viewProjection;
+	std::vector<float>                       m_clipPositions;  //Reused by AddOccluder to avoid reallocating
+	std::vector<float>                       m_triangles;      //Screen space x, y and depth of each corner of every triangle that's on screen
+	std::vector<std::vector<unsigned int> >  m_tileTriangles;  //The triangles whose bounds touch each tile
+	std::vector<std::vector<float> >         m_minDepths;      //Each level of the pyramid. The first is the depth buffer itself.
+	std::vector<std::vector<float> >         m_maxDepths;
+
+	void AddTriangle(const float* clip0, const float* clip1, const float* clip2);
+	void AddScreenTriangle(const float* clip0, const float* clip1, const float* clip2);
+	void BuildPyramid();
+	bool IsRectOccluded(int level, int minX, int minY, int maxX, int maxY, float depth) const;
+
+	OcclusionCuller(const OcclusionCuller& other) {}
+	void operator=(const OcclusionCuller& other) {}
+};
+
+#endif
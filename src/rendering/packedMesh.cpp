@@ -0,0 +1,545 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "packedMesh.h"
+#include "../core/profiling.h"
+#include "../core/util.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+//Bytes in each vertex of the interleaved buffer, for each VertexFormat.
+static const unsigned int PACKED_VERTEX_SIZE = 12;
+static const unsigned int FLOAT_VERTEX_SIZE = 24;
+
+static const unsigned int FILE_VERSION = 1;
+static const char FILE_MAGIC[4] = { 'M', 'E', 'S', 'H' };
+
+//Everything in a .mesh file before the buffers. Offsets are from the start of
+//the file.
+struct FileHeader
+{
+	char         magic[4];
+	unsigned int version;
+	unsigned int vertexFormat;
+	unsigned int uses1010102;
+	unsigned int vertexSize;
+	unsigned int indexSize;
+	unsigned int numVertices;
+	unsigned int numIndices;
+	float        extents[6];
+	unsigned int positionOffset;
+	unsigned int vertexOffset;
+	unsigned int indexOffset;
+};
+
+static unsigned int AlignUp(unsigned int offset)
+{
+	return (offset + PackedMesh::ALIGNMENT - 1) / PackedMesh::ALIGNMENT * PackedMesh::ALIGNMENT;
+}
+
+//Whether count elements starting at offset fit in the file, without anything
+//overflowing on the way.
+static bool IsInFile(unsigned int offset, unsigned int count, unsigned int elementSize, size_t fileSize)
+{
+	return offset % PackedMesh::ALIGNMENT == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+//Packs an octahedral encoded direction into 4 bytes: 10 bit signed normalized
+//components, or 16 bit ones for contexts that can't read those.
+static void PackDirection(const Vector3f& direction, bool use1010102, unsigned char* dest)
+{
+	Vector2f encoded = PackedMesh::EncodeOctahedral(direction);
+	if(use1010102)
+	{
+		unsigned int x = (unsigned int)(int)floorf(encoded.GetX() * 511.0f + 0.5f) & 0x3FFu;
+		unsigned int y = (unsigned int)(int)floorf(encoded.GetY() * 511.0f + 0.5f) & 0x3FFu;
+		unsigned int packed = x | (y << 10u);
+		memcpy(dest, &packed, sizeof(packed));
+	}
+	else
+	{
+		short packed[2] = { (short)floorf(encoded.GetX() * 32767.0f + 0.5f), (short)floorf(encoded.GetY() * 32767.0f + 0.5f) };
+		memcpy(dest, packed, sizeof(packed));
+	}
+}
+
+PackedMesh::PackedMesh(const IndexedModel& model, VertexFormat vertexFormat, bool use1010102) :
+	m_file(0),
+	m_positions(0),
+	m_vertices(0),
+	m_indices(0),
+	m_vertexFormat(vertexFormat),
+	m_uses1010102(vertexFormat == VERTEX_FORMAT_PACKED && use1010102),
+	m_vertexSize(vertexFormat == VERTEX_FORMAT_PACKED ? PACKED_VERTEX_SIZE : FLOAT_VERTEX_SIZE),
+	m_indexSize(model.GetPositions().size() <= 65536 ? 2 : 4),
+	m_numVertices(0),
+	m_numIndices(0),
+	m_isValid(model.IsValid())
+{
+	if(!m_isValid)
+	{
+		std::cout << "Error: Invalid mesh! Must have same number of positions, texCoords, normals, and tangents! "
+			<< "(Maybe you forgot to Finalize() your IndexedModel?)" << std::endl;
+		assert(0 != 0);
+		return;
+	}
+
+	m_positionData = model.GetPositions();
+	m_numVertices = (unsigned int)m_positionData.size();
+	m_numIndices = (unsigned int)model.GetIndices().size();
+	if(!m_positionData.empty())
+	{
+		m_minExtents = m_positionData[0];
+		m_maxExtents = m_positionData[0];
+	}
+
+	for(unsigned int i = 1; i < m_numVertices; i++)
+	{
+		for(int j = 0; j < 3; j++)
+		{
+			m_minExtents[j] = std::min(m_minExtents[j], m_positionData[i][j]);
+			m_maxExtents[j] = std::max(m_maxExtents[j], m_positionData[i][j]);
+		}
+	}
+
+	const std::vector<Vector2f>& texCoords = model.GetTexCoords();
+	const std::vector<Vector3f>& normals = model.GetNormals();
+	const std::vector<Vector3f>& tangents = model.GetTangents();
+	m_vertexData.resize(m_numVertices * m_vertexSize);
+	for(unsigned int i = 0; i < m_numVertices; i++)
+	{
+		unsigned char* vertex = &m_vertexData[i * m_vertexSize];
+		if(m_vertexFormat == VERTEX_FORMAT_PACKED)
+		{
+			unsigned short texCoord[2] = { FloatToHalf(texCoords[i].GetX()), FloatToHalf(texCoords[i].GetY()) };
+			memcpy(vertex, texCoord, sizeof(texCoord));
+			PackDirection(normals[i], m_uses1010102, vertex + 4);
+			PackDirection(tangents[i], m_uses1010102, vertex + 8);
+		}
+		else
+		{
+			Vector2f normal = EncodeOctahedral(normals[i]);
+			Vector2f tangent = EncodeOctahedral(tangents[i]);
+			float attributes[6] = { texCoords[i].GetX(), texCoords[i].GetY(), normal.GetX(), normal.GetY(), tangent.GetX(), tangent.GetY() };
+			memcpy(vertex, attributes, sizeof(attributes));
+		}
+	}
+
+	//Meshes small enough to be indexed with 16 bits are, halving the index buffer.
+	const std::vector<unsigned int>& indices = model.GetIndices();
+	m_indexData.resize(m_numIndices * m_indexSize);
+	if(m_indexSize == 2)
+	{
+		for(unsigned int i = 0; i < m_numIndices; i++)
+		{
+			unsigned short index = (unsigned short)indices[i];
+			memcpy(&m_indexData[i * 2], &index, sizeof(index));
+		}
+	}
+	else if(m_numIndices > 0)
+	{
+		memcpy(&m_indexData[0], &indices[0], m_indexData.size());
+	}
+
+	m_positions = m_positionData.empty() ? 0 : &m_positionData[0];
+	m_vertices = m_vertexData.empty() ? 0 : &m_vertexData[0];
+	m_indices = m_indexData.empty() ? 0 : &m_indexData[0];
+}
+
+PackedMesh::PackedMesh(const std::string& fileName) :
+	m_file(new MappedFile(fileName)),
+	m_positions(0),
+	m_vertices(0),
+	m_indices(0),
+	m_vertexFormat(VERTEX_FORMAT_PACKED),
+	m_uses1010102(false),
+	m_vertexSize(PACKED_VERTEX_SIZE),
+	m_indexSize(2),
+	m_numVertices(0),
+	m_numIndices(0),
+	m_isValid(false)
+{
+	if(!m_file->IsOpen() || m_file->GetSize() < sizeof(FileHeader))
+	{
+		return;
+	}
+
+	FileHeader header;
+	memcpy(&header, m_file->GetData(), sizeof(header));
+	bool isPacked = header.vertexFormat == VERTEX_FORMAT_PACKED;
+	if(memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != FILE_VERSION ||
+		header.vertexFormat > VERTEX_FORMAT_FLOAT || header.vertexSize != (isPacked ? PACKED_VERTEX_SIZE : FLOAT_VERTEX_SIZE) ||
+		header.uses1010102 > (isPacked ? 1u : 0u) || (header.indexSize != 2 && header.indexSize != 4) ||
+		!IsInFile(header.positionOffset, header.numVertices, sizeof(Vector3f), m_file->GetSize()) ||
+		!IsInFile(header.vertexOffset, header.numVertices, header.vertexSize, m_file->GetSize()) ||
+		!IsInFile(header.indexOffset, header.numIndices, header.indexSize, m_file->GetSize()))
+	{
+		return;
+	}
+
+	m_vertexFormat = (VertexFormat)header.vertexFormat;
+	m_uses1010102 = header.uses1010102 != 0;
+	m_vertexSize = header.vertexSize;
+	m_indexSize = header.indexSize;
+	m_numVertices = header.numVertices;
+	m_numIndices = header.numIndices;
+	m_minExtents = Vector3f(header.extents[0], header.extents[1], header.extents[2]);
+	m_maxExtents = Vector3f(header.extents[3], header.extents[4], header.extents[5]);
+
+	//The buffers are used where they are in the mapping.
+	m_positions = (const Vector3f*)(m_file->GetData() + header.positionOffset);
+	m_vertices = m_file->GetData() + header.vertexOffset;
+	m_indices = m_file->GetData() + header.indexOffset;
+	m_isValid = true;
+}
+
+PackedMesh::~PackedMesh()
+{
+	delete m_file;
+}
+
+bool PackedMesh::Save(const std::string& fileName) const
+{
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+	header.version = FILE_VERSION;
+	header.vertexFormat = m_vertexFormat;
+	header.uses1010102 = m_uses1010102 ? 1 : 0;
+	header.vertexSize = m_vertexSize;
+	header.indexSize = m_indexSize;
+	header.numVertices = m_numVertices;
+	header.numIndices = m_numIndices;
+	for(int i = 0; i < 3; i++)
+	{
+		header.extents[i] = m_minExtents[i];
+		header.extents[i + 3] = m_maxExtents[i];
+	}
+	header.positionOffset = AlignUp(sizeof(header));
+	header.vertexOffset = AlignUp(header.positionOffset + m_numVertices * sizeof(Vector3f));
+	header.indexOffset = AlignUp(header.vertexOffset + m_numVertices * m_vertexSize);
+
+	const char* blobs[3] = { (const char*)m_positions, (const char*)m_vertices, (const char*)m_indices };
+	unsigned int offsets[3] = { header.positionOffset, header.vertexOffset, header.indexOffset };
+	unsigned int sizes[3] = { m_numVertices * (unsigned int)sizeof(Vector3f), m_numVertices * m_vertexSize, m_numIndices * m_indexSize };
+	const char padding[ALIGNMENT] = { 0 };
+
+	bool complete;
+	{
+		std::ofstream file(Util::GetPartialFileName(fileName).c_str(), std::ios::binary);
+		if(!file)
+		{
+			return false;
+		}
+
+		file.write((const char*)&header, sizeof(header));
+		unsigned int position = sizeof(header);
+		for(int i = 0; i < 3; i++)
+		{
+			file.write(padding, offsets[i] - position);
+			if(sizes[i] > 0)
+			{
+				file.write(blobs[i], sizes[i]);
+			}
+			position = offsets[i] + sizes[i];
+		}
+
+		complete = file.good();
+	}
+
+	return Util::CommitPartialFile(fileName, complete);
+}
+
+void PackedMesh::ConvertTo16BitDirections(const unsigned char* vertices, unsigned int numVertices, std::vector<unsigned char>* result)
+{
+	result->assign(vertices, vertices + numVertices * PACKED_VERTEX_SIZE);
+	for(unsigned int i = 0; i < numVertices; i++)
+	{
+		for(unsigned int j = 4; j < PACKED_VERTEX_SIZE; j += 4)
+		{
+			unsigned char* direction = &(*result)[i * PACKED_VERTEX_SIZE + j];
+			unsigned int packed;
+			memcpy(&packed, direction, sizeof(packed));
+
+			//Sign extended from 10 bits, then rescaled to 16.
+			int x = (int)(packed << 22u) >> 22;
+			int y = (int)(packed << 12u) >> 22;
+			short converted[2] = { (short)(std::max(x, -511) * 32767 / 511), (short)(std::max(y, -511) * 32767 / 511) };
+			memcpy(direction, converted, sizeof(converted));
+		}
+	}
+}
+
+Vector2f PackedMesh::EncodeOctahedral(const Vector3f& direction)
+{
+	float length = fabsf(direction.GetX()) + fabsf(direction.GetY()) + fabsf(direction.GetZ());
+	if(length == 0.0f)
+	{
+		return Vector2f(0.0f, 0.0f);
+	}
+
+	float x = direction.GetX() / length;
+	float y = direction.GetY() / length;
+	if(direction.GetZ() < 0.0f)
+	{
+		//The lower half of the octahedron is folded out over the corners.
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	return Vector2f(x, y);
+}
+
+Vector3f PackedMesh::DecodeOctahedral(const Vector2f& encoded)
+{
+	float x = encoded.GetX();
+	float y = encoded.GetY();
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	float fold = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -fold : fold;
+	y += y >= 0.0f ? -fold : fold;
+	return Vector3f(x, y, z).Normalized();
+}
+
+unsigned short PackedMesh::FloatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned int sign = (bits >> 16u) & 0x8000u;
+	int exponent = (int)((bits >> 23u) & 0xFFu) - 127 + 15;
+	unsigned int mantissa = bits & 0x7FFFFFu;
+
+	if(exponent >= 31)
+	{
+		//Too big, infinite, or not a number.
+		bool isNaN = ((bits >> 23u) & 0xFFu) == 0xFFu && mantissa != 0;
+		return (unsigned short)(sign | 0x7C00u | (isNaN ? 0x200u : 0u));
+	}
+	if(exponent <= 0)
+	{
+		if(exponent < -10)
+		{
+			return (unsigned short)sign;
+		}
+
+		//Denormal, with the implied leading 1 made explicit.
+		mantissa |= 0x800000u;
+		unsigned int shift = (unsigned int)(14 - exponent);
+		unsigned int half = mantissa >> shift;
+		if((mantissa >> (shift - 1u)) & 1u)
+		{
+			half++;
+		}
+		return (unsigned short)(sign | half);
+	}
+
+	//Rounding up can carry into the exponent, which is still the right answer.
+	unsigned int half = sign | ((unsigned int)exponent << 10u) | (mantissa >> 13u);
+	if(mantissa & 0x1000u)
+	{
+		half++;
+	}
+	return (unsigned short)half;
+}
+
+float PackedMesh::HalfToFloat(unsigned short value)
+{
+	float sign = (value & 0x8000u) ? -1.0f : 1.0f;
+	int exponent = (value >> 10) & 0x1F;
+	int mantissa = value & 0x3FF;
+	if(exponent == 0)
+	{
+		return sign * ldexpf((float)mantissa, -24);
+	}
+	if(exponent == 31)
+	{
+		return mantissa == 0 ? sign * HUGE_VALF : NAN;
+	}
+	return sign * ldexpf((float)(mantissa | 0x400), exponent - 25);
+}
+
+
+//A bumpy square of size by size quads, with normals and tangents.
+static IndexedModel CreateTestTerrain(int size)
+{
+	IndexedModel model;
+	for(int y = 0; y <= size; y++)
+	{
+		for(int x = 0; x <= size; x++)
+		{
+			model.AddVertex((float)x, (float)(x * y % 7), (float)y);
+			model.AddTexCoord((float)x / (float)size, (float)y / (float)size);
+		}
+	}
+	for(int y = 0; y < size; y++)
+	{
+		for(int x = 0; x < size; x++)
+		{
+			unsigned int corner = (unsigned int)(y * (size + 1) + x);
+			model.AddFace(corner, corner + size + 1, corner + 1);
+			model.AddFace(corner + 1, corner + size + 1, corner + size + 2);
+		}
+	}
+	return model.Finalize();
+}
+
+void PackedMesh::Test()
+{
+	//Halves hold small integers and simple fractions exactly, and everything
+	//else to within their precision.
+	float exactValues[] = { 0.0f, 1.0f, -1.0f, 0.5f, 0.25f, 2.0f, 1024.0f, 65504.0f };
+	for(unsigned int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(exactValues); i++)
+	{
+		assert(HalfToFloat(FloatToHalf(exactValues[i])) == exactValues[i]);
+	}
+	for(int i = 0; i <= 100; i++)
+	{
+		float value = (float)i * 0.0137f - 0.5f;
+		assert(fabsf(HalfToFloat(FloatToHalf(value)) - value) <= fabsf(value) / 1024.0f + 1e-7f);
+	}
+	assert(FloatToHalf(1e6f) == 0x7C00u);
+	assert(FloatToHalf(-1e-10f) == 0x8000u);
+	assert(HalfToFloat(FloatToHalf(1e-6f)) > 0.0f);
+
+	//Directions survive octahedral encoding, even at the poles and folds, and
+	//are still close after the encoding's quantized to 10 bits.
+	Vector3f directions[] = { Vector3f(0, 0, 1), Vector3f(0, 0, -1), Vector3f(1, 0, 0), Vector3f(0, -1, 0),
+		Vector3f(1, 1, 1).Normalized(), Vector3f(-1, 2, -3).Normalized(), Vector3f(0.3f, -0.2f, -0.9f).Normalized() };
+	for(unsigned int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(directions); i++)
+	{
+		Vector2f encoded = EncodeOctahedral(directions[i]);
+		assert(fabsf(encoded.GetX()) <= 1.0f && fabsf(encoded.GetY()) <= 1.0f);
+		assert((DecodeOctahedral(encoded) - directions[i]).Length() < 1e-5f);
+
+		Vector2f quantized(floorf(encoded.GetX() * 511.0f + 0.5f) / 511.0f, floorf(encoded.GetY() * 511.0f + 0.5f) / 511.0f);
+		assert(DecodeOctahedral(quantized).Dot(directions[i]) > 0.9999f);
+	}
+
+	//A mesh written to a file maps back with every buffer byte for byte the
+	//same, and a 32 bit index buffer once there are too many vertices for 16.
+	for(int size = 8; size <= 256; size += 248)
+	{
+		IndexedModel model = CreateTestTerrain(size);
+
+		for(int format = VERTEX_FORMAT_PACKED; format <= VERTEX_FORMAT_FLOAT; format++)
+		{
+			PackedMesh packed(model, (VertexFormat)format);
+			assert(packed.IsValid());
+			assert(packed.GetIndexSize() == (model.GetPositions().size() <= 65536 ? 2u : 4u));
+			for(unsigned int i = 0; i < packed.GetNumIndices(); i++)
+			{
+				assert(packed.GetIndex(i) == model.GetIndices()[i]);
+			}
+
+			std::string fileName = "./packedMeshTest.mesh";
+			bool saved = packed.Save(fileName);
+			assert(saved);
+			PackedMesh loaded(fileName);
+			assert(loaded.IsValid());
+			assert(loaded.GetVertexFormat() == packed.GetVertexFormat() && loaded.Uses1010102() == packed.Uses1010102());
+			assert(loaded.GetNumVertices() == packed.GetNumVertices() && loaded.GetNumIndices() == packed.GetNumIndices());
+			assert(loaded.GetIndexSize() == packed.GetIndexSize());
+			assert((loaded.GetMinExtents() - packed.GetMinExtents()).Length() == 0.0f);
+			assert((loaded.GetMaxExtents() - packed.GetMaxExtents()).Length() == 0.0f);
+			assert((size_t)loaded.GetPositions() % ALIGNMENT == 0 && (size_t)loaded.GetVertices() % ALIGNMENT == 0);
+			assert((size_t)loaded.GetIndices() % ALIGNMENT == 0);
+			assert(memcmp(loaded.GetPositions(), packed.GetPositions(), packed.GetNumVertices() * sizeof(Vector3f)) == 0);
+			assert(memcmp(loaded.GetVertices(), packed.GetVertices(), packed.GetNumVertices() * packed.GetVertexSize()) == 0);
+			assert(memcmp(loaded.GetIndices(), packed.GetIndices(), packed.GetNumIndices() * packed.GetIndexSize()) == 0);
+
+			//Cut short, it's rejected rather than read past its end.
+			std::vector<char> contents;
+			{
+				std::ifstream file(fileName.c_str(), std::ios::binary);
+				contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			}
+			{
+				std::ofstream file(fileName.c_str(), std::ios::binary);
+				file.write(&contents[0], contents.size() - 1);
+			}
+			assert(!PackedMesh(fileName).IsValid());
+			remove(fileName.c_str());
+		}
+
+		//Converting to 16 bit directions gives nearly what packing them as 16
+		//bit in the first place would have.
+		PackedMesh packed(model, VERTEX_FORMAT_PACKED, true);
+		PackedMesh packed16(model, VERTEX_FORMAT_PACKED, false);
+		std::vector<unsigned char> converted;
+		ConvertTo16BitDirections(packed.GetVertices(), packed.GetNumVertices(), &converted);
+		assert(converted.size() == packed.GetNumVertices() * packed.GetVertexSize());
+		for(unsigned int i = 0; i < converted.size(); i += 2)
+		{
+			short a;
+			short b;
+			memcpy(&a, &converted[i], sizeof(a));
+			memcpy(&b, packed16.GetVertices() + i, sizeof(b));
+			if(i % packed.GetVertexSize() < 4)
+			{
+				assert(a == b);
+			}
+			else
+			{
+				assert(abs(a - b) <= 33);
+			}
+		}
+	}
+	assert(!PackedMesh("./res/models/doesNotExist.mesh").IsValid());
+}
+
+void PackedMesh::Benchmark()
+{
+	//Mapping a converted file against packing the model it came from, which is
+	//the least an import has to do after parsing.
+	IndexedModel model = CreateTestTerrain(256);
+	std::string fileName = "./packedMeshBenchmark.mesh";
+	{
+		PackedMesh packed(model);
+		packed.Save(fileName);
+	}
+
+	ProfileTimer packTimer;
+	ProfileTimer mapTimer;
+	unsigned int checksum = 0;
+	for(int i = 0; i < 10; i++)
+	{
+		packTimer.StartInvocation();
+		PackedMesh packed(model);
+		checksum += Util::CalcChecksum(packed.GetVertices(), packed.GetNumVertices() * packed.GetVertexSize());
+		packTimer.StopInvocation();
+
+		//Touching every byte, as uploading it would, so the mapping's pages are
+		//all read in.
+		mapTimer.StartInvocation();
+		PackedMesh loaded(fileName);
+		checksum -= Util::CalcChecksum(loaded.GetVertices(), loaded.GetNumVertices() * loaded.GetVertexSize());
+		mapTimer.StopInvocation();
+	}
+	remove(fileName.c_str());
+	assert(checksum == 0);
+
+	packTimer.DisplayAndReset("Packing a mesh (131072 triangles): ", 0, 56);
+	mapTimer.DisplayAndReset("Mapping a .mesh file (131072 triangles): ", 0, 56);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PACKEDMESH_H
+#define PACKEDMESH_H
+
+#include "../core/math3d.h"
+#include "../core/mappedFile.h"
+#include "indexedModel.h"
+
+#include <string>
+#include <vector>
+
+//How the attributes other than position are stored in each mesh's interleaved
+//vertex buffer. Normals and tangents are octahedral encoded into two components
+//either way, so shaders read them the same way.
+enum VertexFormat
+{
+	VERTEX_FORMAT_PACKED, //Half float texture coordinates, and 4 bytes for each of the normal and tangent
+	VERTEX_FORMAT_FLOAT   //Every component as a float, for when the precision matters more than the size
+};
+
+//A mesh laid out exactly as MeshData uploads it: a buffer of positions, a
+//buffer with the rest of each vertex interleaved, and a buffer of 16 or 32 bit
+//indices. It's either packed from an IndexedModel, or mapped straight from a
+//.mesh file written by Save, in which case nothing is parsed or copied on the
+//way to the GPU.
+//
+//A .mesh file is a fixed header followed by the three buffers, each starting
+//on an ALIGNMENT byte boundary. Everything is stored in the machine's own byte
+//order, which is little endian on everything the engine runs on.
+class PackedMesh
+{
+public:
+	static const unsigned int ALIGNMENT = 16;
+
+	//Directions are stored as 10 bit components unless use1010102 is false, in
+	//which case they're 16 bit ones.
+	PackedMesh(const IndexedModel& model, VertexFormat vertexFormat = VERTEX_FORMAT_PACKED, bool use1010102 = true);
+	//IsValid is false if the file is missing, cut short, or from another version.
+	PackedMesh(const std::string& fileName);
+	virtual ~PackedMesh();
+
+	bool Save(const std::string& fileName) const;
+
+	inline bool IsValid() const                  { return m_isValid; }
+	inline VertexFormat GetVertexFormat() const  { return m_vertexFormat; }
+	inline bool Uses1010102() const              { return m_uses1010102; }
+	inline unsigned int GetVertexSize() const    { return m_vertexSize; }
+	inline unsigned int GetIndexSize() const     { return m_indexSize; }
+	inline unsigned int GetNumVertices() const   { return m_numVertices; }
+	inline unsigned int GetNumIndices() const    { return m_numIndices; }
+
+	inline const Vector3f* GetPositions() const      { return m_positions; }
+	inline const unsigned char* GetVertices() const  { return m_vertices; }
+	inline const unsigned char* GetIndices() const   { return m_indices; }
+	inline unsigned int GetIndex(unsigned int i) const
+	{
+		return m_indexSize == 2 ? ((const unsigned short*)m_indices)[i] : ((const unsigned int*)m_indices)[i];
+	}
+
+	//The corners of the smallest box around every vertex, in model space.
+	inline const Vector3f& GetMinExtents() const { return m_minExtents; }
+	inline const Vector3f& GetMaxExtents() const { return m_maxExtents; }
+
+	//Rewrites packed vertices that use 10 bit directions with 16 bit ones, for
+	//contexts that can't read the former.
+	static void ConvertTo16BitDirections(const unsigned char* vertices, unsigned int numVertices, std::vector<unsigned char>* result);
+
+	//A direction folded onto an octahedron and flattened into a square, from
+	//-1 to 1 on each axis. Its inverse is DecodeOctahedral in common.glh.
+	static Vector2f EncodeOctahedral(const Vector3f& direction);
+	static Vector3f DecodeOctahedral(const Vector2f& encoded);
+	//To the nearest half float, flushing anything too small to zero.
+	static unsigned short FloatToHalf(float value);
+	static float HalfToFloat(unsigned short value);
+
+	static void Test();
+	static void Benchmark();
+protected:
+private:
+	MappedFile*                m_file;         //0 unless loaded from a file
+	std::vector<Vector3f>      m_positionData; //Only used when packed from a model
+	std::vector<unsigned char> m_vertexData;
+	std::vector<unsigned char> m_indexData;
+
+	const Vector3f*      m_positions;
+	const unsigned char* m_vertices;
+	const unsigned char* m_indices;
+
+	VertexFormat m_vertexFormat;
+	bool         m_uses1010102;
+	unsigned int m_vertexSize;
+	unsigned int m_indexSize;
+	unsigned int m_numVertices;
+	unsigned int m_numIndices;
+	Vector3f     m_minExtents;
+	Vector3f     m_maxExtents;
+	bool         m_isValid;
+
+	PackedMesh(const PackedMesh& other) {}
+	void operator=(const PackedMesh& other) {}
+};
+
+#endif
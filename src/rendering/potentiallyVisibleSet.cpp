@@ -0,0 +1,689 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "potentiallyVisibleSet.h"
+#include "../core/profiling.h"
+#include "../core/util.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+//The file a baked set is kept in is tagged with this, and ignored when it's
+//different. Should change whenever the file's layout does.
+static const unsigned int FILE_VERSION = 2;
+static const char FILE_MAGIC[4] = { 'P', 'V', 'S', 'C' };
+
+class BakeCellTask : public ThreadPoolTask
+{
+public:
+	BakeCellTask(PotentiallyVisibleSet* pvs) :
+		m_pvs(pvs) {}
+
+	virtual void Run(unsigned int index)
+	{
+		m_pvs->BakeCell((int)index);
+	}
+private:
+	PotentiallyVisibleSet* m_pvs;
+};
+
+//Radical inverse in any base, for the Halton sequence the rays are spread
+//through each cell with.
+static float CalcRadicalInverse(unsigned int index, unsigned int base)
+{
+	float result = 0.0f;
+	float digitScale = 1.0f / (float)base;
+	while(index > 0)
+	{
+		result += (float)(index % base) * digitScale;
+		index /= base;
+		digitScale /= (float)base;
+	}
+	return result;
+}
+
+PotentiallyVisibleSet::PotentiallyVisibleSet() :
+	m_origin(0.0f, 0.0f, 0.0f),
+	m_cellSize(1.0f, 1.0f, 1.0f),
+	m_rowSize(0),
+	m_positions(0),
+	m_indices(0)
+{
+	m_numCells[0] = m_numCells[1] = m_numCells[2] = 0;
+}
+
+void PotentiallyVisibleSet::Bake(const std::vector<Vector3f>& positions, const std::vector<unsigned int>& indices,
+	const Vector3f& minExtents, const Vector3f& maxExtents, float cellSize, ThreadPool* threadPool)
+{
+	//Cells are stretched a little on each axis to fit the bounds exactly.
+	int numCells[3];
+	Vector3f size;
+	for(int i = 0; i < 3; i++)
+	{
+		float extent = std::max(maxExtents[i] - minExtents[i], 0.0f);
+		numCells[i] = std::max((int)ceilf(extent / cellSize), 1);
+		size[i] = std::max(extent / (float)numCells[i], 1e-6f);
+	}
+	SetGrid(minExtents, size, numCells);
+
+	m_positions = &positions;
+	m_indices = &indices;
+	BinTriangles();
+
+	//Starts and ends are the two halves of one six dimensional Halton
+	//sequence, so every ray joins a different pair of points, and each batch
+	//of rays is spread evenly between the cells.
+	m_rayStarts.resize(MAX_RAYS);
+	m_rayEnds.resize(MAX_RAYS);
+	for(int i = 0; i < MAX_RAYS; i++)
+	{
+		m_rayStarts[i] = Vector3f(CalcRadicalInverse(i + 1, 2), CalcRadicalInverse(i + 1, 3), CalcRadicalInverse(i + 1, 5));
+		m_rayEnds[i] = Vector3f(CalcRadicalInverse(i + 1, 7), CalcRadicalInverse(i + 1, 11), CalcRadicalInverse(i + 1, 13));
+	}
+
+	//Each cell only checks the cells after it, so every pair is checked once
+	//and no two threads write to the same row.
+	BakeCellTask task(this);
+	if(threadPool)
+	{
+		threadPool->ParallelFor(&task, (unsigned int)GetNumCells());
+	}
+	else
+	{
+		for(int i = 0; i < GetNumCells(); i++)
+		{
+			task.Run((unsigned int)i);
+		}
+	}
+
+	for(int i = 0; i < GetNumCells(); i++)
+	{
+		for(int j = i + 1; j < GetNumCells(); j++)
+		{
+			if(IsCellVisible(i, j))
+			{
+				m_visibility[j * m_rowSize + i / 32] |= 1u << (i % 32);
+			}
+		}
+	}
+
+	m_positions = 0;
+	m_indices = 0;
+	m_cellTriangles.clear();
+}
+
+void PotentiallyVisibleSet::BakeCell(int cell)
+{
+	unsigned int* row = &m_visibility[cell * m_rowSize];
+	row[cell / 32] |= 1u << (cell % 32);
+
+	int coords[3];
+	CalcCellCoords(cell, coords);
+
+	for(int other = cell + 1; other < GetNumCells(); other++)
+	{
+		int otherCoords[3];
+		CalcCellCoords(other, otherCoords);
+
+		//Neighbouring cells are always visible, since a camera on the edge of
+		//one can see straight into the other, however the rays happen to fall.
+		bool isNeighbour = abs(otherCoords[0] - coords[0]) <= 1 && abs(otherCoords[1] - coords[1]) <= 1 &&
+			abs(otherCoords[2] - coords[2]) <= 1;
+		if(isNeighbour || IsAnyRayUnblocked(cell, other, 0, MIN_RAYS))
+		{
+			row[other / 32] |= 1u << (other % 32);
+		}
+	}
+
+	//Cells beside ones that can be seen are where small openings are missed,
+	//so they're sampled again with every ray. Anything found that way makes
+	//more cells worth sampling, until nothing more is found.
+	std::vector<bool> isFullySampled(GetNumCells(), false);
+	bool isConverged = false;
+	while(!isConverged)
+	{
+		isConverged = true;
+		for(int other = cell + 1; other < GetNumCells(); other++)
+		{
+			if(isFullySampled[other] || IsCellVisible(cell, other) || !IsBesideVisibleCell(cell, other))
+			{
+				continue;
+			}
+
+			isFullySampled[other] = true;
+			if(IsAnyRayUnblocked(cell, other, MIN_RAYS, MAX_RAYS))
+			{
+				row[other / 32] |= 1u << (other % 32);
+				isConverged = false;
+			}
+		}
+	}
+}
+
+bool PotentiallyVisibleSet::IsAnyRayUnblocked(int fromCell, int toCell, int firstRay, int endRay) const
+{
+	int coords[3];
+	int otherCoords[3];
+	CalcCellCoords(fromCell, coords);
+	CalcCellCoords(toCell, otherCoords);
+	Vector3f cellMin = CalcCellMin(coords);
+	Vector3f otherMin = CalcCellMin(otherCoords);
+
+	for(int i = firstRay; i < endRay; i++)
+	{
+		const Vector3f& startPoint = m_rayStarts[i];
+		const Vector3f& endPoint = m_rayEnds[i];
+		Vector3f start = cellMin + Vector3f(startPoint[0] * m_cellSize[0], startPoint[1] * m_cellSize[1], startPoint[2] * m_cellSize[2]);
+		Vector3f end = otherMin + Vector3f(endPoint[0] * m_cellSize[0], endPoint[1] * m_cellSize[1], endPoint[2] * m_cellSize[2]);
+		if(!IsRayBlocked(start, end))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool PotentiallyVisibleSet::IsBesideVisibleCell(int fromCell, int cell) const
+{
+	//Only fromCell's own row is read, as other threads may be writing the
+	//rest, so only what's been found from it so far counts.
+	int coords[3];
+	CalcCellCoords(cell, coords);
+	for(int z = std::max(coords[2] - 1, 0); z <= std::min(coords[2] + 1, m_numCells[2] - 1); z++)
+	{
+		for(int y = std::max(coords[1] - 1, 0); y <= std::min(coords[1] + 1, m_numCells[1] - 1); y++)
+		{
+			for(int x = std::max(coords[0] - 1, 0); x <= std::min(coords[0] + 1, m_numCells[0] - 1); x++)
+			{
+				int neighbour = x + (y + z * m_numCells[1]) * m_numCells[0];
+				if(neighbour >= fromCell && neighbour != cell && IsCellVisible(fromCell, neighbour))
+				{
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+bool PotentiallyVisibleSet::Load(const std::string& fileName, unsigned int key)
+{
+	std::ifstream file(fileName.c_str(), std::ios::binary);
+	if(!file.is_open())
+	{
+		return false;
+	}
+
+	char magic[sizeof(FILE_MAGIC)];
+	unsigned int version = 0;
+	unsigned int fileKey = 0;
+	int numCells[3];
+	float grid[6];
+	file.read(magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&fileKey, sizeof(fileKey));
+	file.read((char*)numCells, sizeof(numCells));
+	file.read((char*)grid, sizeof(grid));
+	if(!file.good() || memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0 || version != FILE_VERSION || fileKey != key ||
+		numCells[0] <= 0 || numCells[1] <= 0 || numCells[2] <= 0)
+	{
+		return false;
+	}
+
+	//Read into a copy, so a file that was cut short leaves this as it was.
+	unsigned int numWords = (unsigned int)(numCells[0] * numCells[1] * numCells[2]) * (unsigned int)((numCells[0] * numCells[1] * numCells[2] + 31) / 32);
+	std::vector<unsigned int> visibility(numWords);
+	file.read((char*)&visibility[0], numWords * sizeof(unsigned int));
+	if((unsigned int)file.gcount() != numWords * sizeof(unsigned int) || file.peek() != std::ifstream::traits_type::eof())
+	{
+		return false;
+	}
+
+	Vector3f origin(grid[0], grid[1], grid[2]);
+	Vector3f cellSize(grid[3], grid[4], grid[5]);
+	SetGrid(origin, cellSize, numCells);
+	m_visibility.swap(visibility);
+	return true;
+}
+
+bool PotentiallyVisibleSet::Save(const std::string& fileName, unsigned int key) const
+{
+	bool complete;
+	{
+		std::ofstream file(Util::GetPartialFileName(fileName).c_str(), std::ios::binary);
+		if(!file)
+		{
+			return false;
+		}
+
+		float grid[6] = { m_origin[0], m_origin[1], m_origin[2], m_cellSize[0], m_cellSize[1], m_cellSize[2] };
+		file.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+		file.write((const char*)&FILE_VERSION, sizeof(FILE_VERSION));
+		file.write((const char*)&key, sizeof(key));
+		file.write((const char*)m_numCells, sizeof(m_numCells));
+		file.write((const char*)grid, sizeof(grid));
+		if(!m_visibility.empty())
+		{
+			file.write((const char*)&m_visibility[0], m_visibility.size() * sizeof(unsigned int));
+		}
+
+		complete = file.good();
+	}
+
+	return Util::CommitPartialFile(fileName, complete);
+}
+
+int PotentiallyVisibleSet::GetCell(const Vector3f& position) const
+{
+	for(int i = 0; i < 3; i++)
+	{
+		if(position[i] < m_origin[i] || position[i] >= m_origin[i] + m_cellSize[i] * m_numCells[i])
+		{
+			return -1;
+		}
+	}
+
+	int coords[3];
+	CalcCellCoords(position, coords);
+	return coords[0] + (coords[1] + coords[2] * m_numCells[1]) * m_numCells[0];
+}
+
+bool PotentiallyVisibleSet::IsBoxVisible(int fromCell, const Vector3f& minExtents, const Vector3f& maxExtents) const
+{
+	if(fromCell < 0)
+	{
+		return true;
+	}
+
+	for(int i = 0; i < 3; i++)
+	{
+		if(minExtents[i] < m_origin[i] || maxExtents[i] > m_origin[i] + m_cellSize[i] * m_numCells[i])
+		{
+			return true;
+		}
+	}
+
+	int minCoords[3];
+	int maxCoords[3];
+	CalcCellCoords(minExtents, minCoords);
+	CalcCellCoords(maxExtents, maxCoords);
+	for(int z = minCoords[2]; z <= maxCoords[2]; z++)
+	{
+		for(int y = minCoords[1]; y <= maxCoords[1]; y++)
+		{
+			for(int x = minCoords[0]; x <= maxCoords[0]; x++)
+			{
+				if(IsCellVisible(fromCell, x + (y + z * m_numCells[1]) * m_numCells[0]))
+				{
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+void PotentiallyVisibleSet::SetGrid(const Vector3f& origin, const Vector3f& cellSize, const int* numCells)
+{
+	m_origin = origin;
+	m_cellSize = cellSize;
+	m_numCells[0] = numCells[0];
+	m_numCells[1] = numCells[1];
+	m_numCells[2] = numCells[2];
+	m_rowSize = (GetNumCells() + 31) / 32;
+	m_visibility.assign(GetNumCells() * m_rowSize, 0);
+}
+
+void PotentiallyVisibleSet::CalcCellCoords(const Vector3f& position, int* coords) const
+{
+	for(int i = 0; i < 3; i++)
+	{
+		coords[i] = Clamp((int)floorf((position[i] - m_origin[i]) / m_cellSize[i]), 0, m_numCells[i] - 1);
+	}
+}
+
+void PotentiallyVisibleSet::CalcCellCoords(int cell, int* coords) const
+{
+	coords[0] = cell % m_numCells[0];
+	coords[1] = (cell / m_numCells[0]) % m_numCells[1];
+	coords[2] = cell / (m_numCells[0] * m_numCells[1]);
+}
+
+Vector3f PotentiallyVisibleSet::CalcCellMin(const int* coords) const
+{
+	return m_origin + Vector3f(m_cellSize[0] * coords[0], m_cellSize[1] * coords[1], m_cellSize[2] * coords[2]);
+}
+
+void PotentiallyVisibleSet::BinTriangles()
+{
+	m_cellTriangles.assign(GetNumCells(), std::vector<unsigned int>());
+
+	const std::vector<Vector3f>& positions = *m_positions;
+	const std::vector<unsigned int>& indices = *m_indices;
+	for(unsigned int i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const Vector3f& p0 = positions[indices[i]];
+		const Vector3f& p1 = positions[indices[i + 1]];
+		const Vector3f& p2 = positions[indices[i + 2]];
+		Vector3f minExtents(std::min(p0[0], std::min(p1[0], p2[0])), std::min(p0[1], std::min(p1[1], p2[1])),
+			std::min(p0[2], std::min(p1[2], p2[2])));
+		Vector3f maxExtents(std::max(p0[0], std::max(p1[0], p2[0])), std::max(p0[1], std::max(p1[1], p2[1])),
+			std::max(p0[2], std::max(p1[2], p2[2])));
+
+		int minCoords[3];
+		int maxCoords[3];
+		CalcCellCoords(minExtents, minCoords);
+		CalcCellCoords(maxExtents, maxCoords);
+		for(int z = minCoords[2]; z <= maxCoords[2]; z++)
+		{
+			for(int y = minCoords[1]; y <= maxCoords[1]; y++)
+			{
+				for(int x = minCoords[0]; x <= maxCoords[0]; x++)
+				{
+					m_cellTriangles[x + (y + z * m_numCells[1]) * m_numCells[0]].push_back(i / 3);
+				}
+			}
+		}
+	}
+}
+
+bool PotentiallyVisibleSet::IsRayBlocked(const Vector3f& start, const Vector3f& end) const
+{
+	//Steps through the cells the ray crosses in order, checking the triangles
+	//in each. A triangle in several cells may be checked more than once.
+	Vector3f delta = end - start;
+	int coords[3];
+	int endCoords[3];
+	int step[3];
+	float nextT[3];
+	float stepT[3];
+	CalcCellCoords(start, coords);
+	CalcCellCoords(end, endCoords);
+	for(int i = 0; i < 3; i++)
+	{
+		if(delta[i] > 0.0f)
+		{
+			step[i] = 1;
+			nextT[i] = (m_origin[i] + (coords[i] + 1) * m_cellSize[i] - start[i]) / delta[i];
+			stepT[i] = m_cellSize[i] / delta[i];
+		}
+		else if(delta[i] < 0.0f)
+		{
+			step[i] = -1;
+			nextT[i] = (m_origin[i] + coords[i] * m_cellSize[i] - start[i]) / delta[i];
+			stepT[i] = -m_cellSize[i] / delta[i];
+		}
+		else
+		{
+			step[i] = 0;
+			nextT[i] = 2.0f;
+			stepT[i] = 2.0f;
+		}
+	}
+
+	for(;;)
+	{
+		const std::vector<unsigned int>& triangles = m_cellTriangles[coords[0] + (coords[1] + coords[2] * m_numCells[1]) * m_numCells[0]];
+		for(unsigned int i = 0; i < triangles.size(); i++)
+		{
+			if(IsTriangleHit(triangles[i], start, delta))
+			{
+				return true;
+			}
+		}
+
+		if(coords[0] == endCoords[0] && coords[1] == endCoords[1] && coords[2] == endCoords[2])
+		{
+			return false;
+		}
+
+		int axis = nextT[0] < nextT[1] ? (nextT[0] < nextT[2] ? 0 : 2) : (nextT[1] < nextT[2] ? 1 : 2);
+		if(nextT[axis] > 1.0f)
+		{
+			return false;
+		}
+
+		coords[axis] += step[axis];
+		nextT[axis] += stepT[axis];
+		if(coords[axis] < 0 || coords[axis] >= m_numCells[axis])
+		{
+			return false;
+		}
+	}
+}
+
+bool PotentiallyVisibleSet::IsTriangleHit(unsigned int triangle, const Vector3f& start, const Vector3f& delta) const
+{
+	//Moller-Trumbore, from either side, only counting hits between the ends.
+	const Vector3f& p0 = (*m_positions)[(*m_indices)[triangle * 3]];
+	Vector3f edge1 = (*m_positions)[(*m_indices)[triangle * 3 + 1]] - p0;
+	Vector3f edge2 = (*m_positions)[(*m_indices)[triangle * 3 + 2]] - p0;
+
+	Vector3f p = delta.Cross(edge2);
+	float determinant = edge1.Dot(p);
+	if(fabsf(determinant) < 1e-12f)
+	{
+		return false;
+	}
+
+	float inverseDeterminant = 1.0f / determinant;
+	Vector3f toStart = start - p0;
+	float u = toStart.Dot(p) * inverseDeterminant;
+	if(u < 0.0f || u > 1.0f)
+	{
+		return false;
+	}
+
+	Vector3f q = toStart.Cross(edge1);
+	float v = delta.Dot(q) * inverseDeterminant;
+	if(v < 0.0f || u + v > 1.0f)
+	{
+		return false;
+	}
+
+	float t = edge2.Dot(q) * inverseDeterminant;
+	return t > 0.0f && t < 1.0f;
+}
+
+static void AddTestQuad(std::vector<Vector3f>* positions, std::vector<unsigned int>* indices,
+	const Vector3f& corner, const Vector3f& edge1, const Vector3f& edge2)
+{
+	unsigned int first = (unsigned int)positions->size();
+	positions->push_back(corner);
+	positions->push_back(corner + edge1);
+	positions->push_back(corner + edge1 + edge2);
+	positions->push_back(corner + edge2);
+
+	unsigned int quadIndices[] = { 0, 1, 2, 0, 2, 3 };
+	for(int i = 0; i < 6; i++)
+	{
+		indices->push_back(first + quadIndices[i]);
+	}
+}
+
+static bool IsSameVisibility(const PotentiallyVisibleSet& a, const PotentiallyVisibleSet& b)
+{
+	if(a.GetNumCells() != b.GetNumCells())
+	{
+		return false;
+	}
+
+	for(int i = 0; i < a.GetNumCells(); i++)
+	{
+		for(int j = 0; j < a.GetNumCells(); j++)
+		{
+			if(a.IsCellVisible(i, j) != b.IsCellVisible(i, j))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void PotentiallyVisibleSet::Test()
+{
+	//Until something's baked, everything is visible from everywhere.
+	PotentiallyVisibleSet empty;
+	assert(empty.GetCell(Vector3f(0.0f, 0.0f, 0.0f)) == -1);
+	assert(empty.IsBoxVisible(-1, Vector3f(0.0f, 0.0f, 0.0f), Vector3f(1.0f, 1.0f, 1.0f)));
+
+	//A solid wall down the middle of the level splits it into two rooms.
+	std::vector<Vector3f> positions;
+	std::vector<unsigned int> indices;
+	AddTestQuad(&positions, &indices, Vector3f(0.0f, -5.0f, -5.0f), Vector3f(0.0f, 10.0f, 0.0f), Vector3f(0.0f, 0.0f, 10.0f));
+
+	PotentiallyVisibleSet pvs;
+	pvs.Bake(positions, indices, Vector3f(-4.0f, -4.0f, -4.0f), Vector3f(4.0f, 4.0f, 4.0f), 2.0f, 0);
+	assert(pvs.GetNumCells() == 64);
+
+	int left = pvs.GetCell(Vector3f(-3.0f, -3.0f, -3.0f));
+	int right = pvs.GetCell(Vector3f(3.0f, 3.0f, 3.0f));
+	assert(left >= 0 && right >= 0 && left != right);
+	assert(pvs.GetCell(Vector3f(5.0f, 0.0f, 0.0f)) == -1);
+	assert(!pvs.IsCellVisible(left, right));
+	assert(!pvs.IsCellVisible(right, left));
+	assert(pvs.IsCellVisible(left, pvs.GetCell(Vector3f(-3.0f, 3.0f, 3.0f))));
+	assert(pvs.IsCellVisible(pvs.GetCell(Vector3f(-1.0f, 1.0f, 1.0f)), pvs.GetCell(Vector3f(1.0f, 1.0f, 1.0f))));
+
+	assert(!pvs.IsBoxVisible(left, Vector3f(2.5f, 2.5f, 2.5f), Vector3f(3.5f, 3.5f, 3.5f)));
+	assert(pvs.IsBoxVisible(left, Vector3f(-3.5f, 2.5f, 2.5f), Vector3f(3.5f, 3.5f, 3.5f)));
+	assert(pvs.IsBoxVisible(left, Vector3f(2.5f, 2.5f, 2.5f), Vector3f(4.5f, 3.5f, 3.5f)));
+	assert(pvs.IsBoxVisible(-1, Vector3f(2.5f, 2.5f, 2.5f), Vector3f(3.5f, 3.5f, 3.5f)));
+
+	//A doorway in the wall lets the rooms see each other through it, but not
+	//around its edges.
+	positions.clear();
+	indices.clear();
+	AddTestQuad(&positions, &indices, Vector3f(0.0f, -5.0f, -5.0f), Vector3f(0.0f, 4.0f, 0.0f), Vector3f(0.0f, 0.0f, 10.0f));
+	AddTestQuad(&positions, &indices, Vector3f(0.0f, 1.0f, -5.0f), Vector3f(0.0f, 4.0f, 0.0f), Vector3f(0.0f, 0.0f, 10.0f));
+	AddTestQuad(&positions, &indices, Vector3f(0.0f, -1.0f, -5.0f), Vector3f(0.0f, 2.0f, 0.0f), Vector3f(0.0f, 0.0f, 4.0f));
+	AddTestQuad(&positions, &indices, Vector3f(0.0f, -1.0f, 1.0f), Vector3f(0.0f, 2.0f, 0.0f), Vector3f(0.0f, 0.0f, 4.0f));
+	pvs.Bake(positions, indices, Vector3f(-4.0f, -4.0f, -4.0f), Vector3f(4.0f, 4.0f, 4.0f), 2.0f, 0);
+	assert(pvs.IsCellVisible(left, right));
+	assert(pvs.IsCellVisible(pvs.GetCell(Vector3f(-3.0f, -1.0f, -1.0f)), pvs.GetCell(Vector3f(3.0f, -1.0f, -1.0f))));
+	assert(!pvs.IsCellVisible(pvs.GetCell(Vector3f(-3.0f, 3.0f, 3.0f)), right));
+
+	//Seeing is symmetric.
+	for(int i = 0; i < pvs.GetNumCells(); i++)
+	{
+		for(int j = 0; j < pvs.GetNumCells(); j++)
+		{
+			assert(pvs.IsCellVisible(i, j) == pvs.IsCellVisible(j, i));
+		}
+	}
+
+	//Baking on several threads gives the same answer.
+	{
+		ThreadPool threadPool(3);
+		PotentiallyVisibleSet threaded;
+		threaded.Bake(positions, indices, Vector3f(-4.0f, -4.0f, -4.0f), Vector3f(4.0f, 4.0f, 4.0f), 2.0f, &threadPool);
+		assert(IsSameVisibility(pvs, threaded));
+	}
+
+	//A slit too thin for the first rays between two far apart cells to find
+	//still lets them see each other.
+	{
+		std::vector<Vector3f> slitPositions;
+		std::vector<unsigned int> slitIndices;
+		AddTestQuad(&slitPositions, &slitIndices, Vector3f(0.0f, -5.0f, -5.0f), Vector3f(0.0f, 5.998f, 0.0f), Vector3f(0.0f, 0.0f, 10.0f));
+		AddTestQuad(&slitPositions, &slitIndices, Vector3f(0.0f, 1.002f, -5.0f), Vector3f(0.0f, 3.998f, 0.0f), Vector3f(0.0f, 0.0f, 10.0f));
+		PotentiallyVisibleSet slit;
+		slit.Bake(slitPositions, slitIndices, Vector3f(-4.0f, -4.0f, -4.0f), Vector3f(4.0f, 4.0f, 4.0f), 2.0f, 0);
+		int slitLeft = slit.GetCell(Vector3f(-3.0f, 1.0f, -3.0f));
+		int slitRight = slit.GetCell(Vector3f(3.0f, 1.0f, 3.0f));
+		assert(slit.IsCellVisible(slitLeft, slitRight));
+		assert(slit.IsCellVisible(slitRight, slitLeft));
+		assert(!slit.IsCellVisible(slit.GetCell(Vector3f(-3.0f, -3.0f, -3.0f)), slit.GetCell(Vector3f(3.0f, -3.0f, -3.0f))));
+	}
+
+	//What's saved loads back the same, but only with the key it was saved with.
+	std::string fileName = "./pvsTest.pvs";
+	bool saved = pvs.Save(fileName, 1234);
+	assert(saved);
+	PotentiallyVisibleSet loaded;
+	bool loadedWithWrongKey = loaded.Load(fileName, 1235);
+	assert(!loadedWithWrongKey && loaded.GetNumCells() == 0);
+	bool loadedWithKey = loaded.Load(fileName, 1234);
+	assert(loadedWithKey);
+	assert(IsSameVisibility(pvs, loaded));
+	assert(loaded.GetCell(Vector3f(3.0f, 3.0f, 3.0f)) == right);
+	remove(fileName.c_str());
+}
+
+void PotentiallyVisibleSet::Benchmark()
+{
+	//A level of 8 by 8 rooms, each with a doorway into the rooms beside it.
+	std::vector<Vector3f> positions;
+	std::vector<unsigned int> indices;
+	const int numRooms = 8;
+	const float roomSize = 8.0f;
+	const float roomHeight = 4.0f;
+	for(int wall = 1; wall < numRooms; wall++)
+	{
+		for(int room = 0; room < numRooms; room++)
+		{
+			float wallPosition = wall * roomSize;
+			float roomStart = room * roomSize;
+			float doorStart = roomStart + roomSize * 0.5f - 1.0f;
+			float doorEnd = roomStart + roomSize * 0.5f + 1.0f;
+
+			AddTestQuad(&positions, &indices, Vector3f(wallPosition, 0.0f, roomStart),
+				Vector3f(0.0f, roomHeight, 0.0f), Vector3f(0.0f, 0.0f, doorStart - roomStart));
+			AddTestQuad(&positions, &indices, Vector3f(wallPosition, 0.0f, doorEnd),
+				Vector3f(0.0f, roomHeight, 0.0f), Vector3f(0.0f, 0.0f, roomStart + roomSize - doorEnd));
+			AddTestQuad(&positions, &indices, Vector3f(roomStart, 0.0f, wallPosition),
+				Vector3f(0.0f, roomHeight, 0.0f), Vector3f(doorStart - roomStart, 0.0f, 0.0f));
+			AddTestQuad(&positions, &indices, Vector3f(doorEnd, 0.0f, wallPosition),
+				Vector3f(0.0f, roomHeight, 0.0f), Vector3f(roomStart + roomSize - doorEnd, 0.0f, 0.0f));
+		}
+	}
+
+	Vector3f minExtents(0.0f, 0.0f, 0.0f);
+	Vector3f maxExtents(numRooms * roomSize, roomHeight, numRooms * roomSize);
+	unsigned int maxThreads = ThreadPool::GetNumCPUs();
+	for(unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		ThreadPool* threadPool = numThreads > 1 ? new ThreadPool(numThreads) : 0;
+		PotentiallyVisibleSet pvs;
+		ProfileTimer bakeTimer;
+		bakeTimer.StartInvocation();
+		pvs.Bake(positions, indices, minExtents, maxExtents, 4.0f, threadPool);
+		bakeTimer.StopInvocation();
+		delete threadPool;
+
+		unsigned int numVisible = 0;
+		for(int i = 0; i < pvs.GetNumCells(); i++)
+		{
+			for(int j = 0; j < pvs.GetNumCells(); j++)
+			{
+				numVisible += pvs.IsCellVisible(i, j) ? 1 : 0;
+			}
+		}
+
+		std::ostringstream message;
+		message << "PVS baking (" << pvs.GetNumCells() << " cells, " << numThreads << " threads): ";
+		bakeTimer.DisplayAndReset(message.str(), 0, 56);
+		printf("    %u of %u cell pairs visible\n", numVisible, (unsigned int)(pvs.GetNumCells() * pvs.GetNumCells()));
+	}
+}
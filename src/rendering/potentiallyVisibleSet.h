@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef POTENTIALLYVISIBLESET_H
+#define POTENTIALLYVISIBLESET_H
+
+#include "../core/math3d.h"
+#include "../core/threadPool.h"
+
+#include <string>
+#include <vector>
+
+//Which parts of an indoor level can be seen from which others. The level's
+//bounds are split into a grid of cells, and every pair of cells is checked by
+//casting rays between them through the level's triangles. It's slow enough
+//to be baked once and kept in a file beside the level, after which finding
+//whether anything in a box can be seen from a cell is a few bit lookups.
+class PotentiallyVisibleSet
+{
+public:
+	//Rays cast between each pair of cells at first. Pairs that still look
+	//hidden, but are beside a cell that's visible, have up to MAX_RAYS cast,
+	//since that's where openings too small for the first rays to find are.
+	static const int MIN_RAYS = 64;
+	static const int MAX_RAYS = 1024;
+
+	//Until something is baked or loaded, there are no cells and everything is visible.
+	PotentiallyVisibleSet();
+
+	//Splits the box between minExtents and maxExtents into cells about cellSize
+	//across, and works out which can see which through the triangles given as
+	//indices into positions. Each cell's rays are cast by one of threadPool's
+	//threads, or on the calling thread if it's 0.
+	void Bake(const std::vector<Vector3f>& positions, const std::vector<unsigned int>& indices,
+		const Vector3f& minExtents, const Vector3f& maxExtents, float cellSize, ThreadPool* threadPool);
+
+	//The file is tagged with key, and isn't loaded when it's different.
+	bool Load(const std::string& fileName, unsigned int key);
+	bool Save(const std::string& fileName, unsigned int key) const;
+
+	//The cell a point is in, or -1 if it's outside the grid.
+	int GetCell(const Vector3f& position) const;
+	//Whether anything in a box could be seen from inside a cell. Boxes that
+	//reach outside the grid, or seen from outside it, always could.
+	bool IsBoxVisible(int fromCell, const Vector3f& minExtents, const Vector3f& maxExtents) const;
+
+	inline bool IsCellVisible(int fromCell, int toCell) const
+	{
+		return (m_visibility[fromCell * m_rowSize + toCell / 32] & (1u << (toCell % 32))) != 0;
+	}
+
+	inline int GetNumCells()             const { return m_numCells[0] * m_numCells[1] * m_numCells[2]; }
+	inline int GetNumCells(int axis)     const { return m_numCells[axis]; }
+
+	static void Test();
+	static void Benchmark();
+
+	//Used by the tasks baking is split into.
+	void BakeCell(int cell);
+protected:
+private:
+	Vector3f                                m_origin;         //The min extents of the first cell
+	Vector3f                                m_cellSize;
+	int                                     m_numCells[3];
+	int                                     m_rowSize;        //Words in each cell's row of m_visibility
+	std::vector<unsigned int>               m_visibility;     //One bit for each pair of cells, set when the first can see the second
+
+	//Only used while baking.
+	const std::vector<Vector3f>*            m_positions;
+	const std::vector<unsigned int>*        m_indices;
+	std::vector<std::vector<unsigned int> > m_cellTriangles;  //The triangles whose bounds touch each cell
+	std::vector<Vector3f>                   m_rayStarts;      //Where rays start inside a cell, from 0 to 1 across it
+	std::vector<Vector3f>                   m_rayEnds;        //And where they end, in the other cell
+
+	void SetGrid(const Vector3f& origin, const Vector3f& cellSize, const int* numCells);
+	void CalcCellCoords(const Vector3f& position, int* coords) const;
+	void CalcCellCoords(int cell, int* coords) const;
+	Vector3f CalcCellMin(const int* coords) const;
+	void BinTriangles();
+	bool IsAnyRayUnblocked(int fromCell, int toCell, int firstRay, int endRay) const;
+	bool IsBesideVisibleCell(int fromCell, int cell) const;
+	bool IsRayBlocked(const Vector3f& start, const Vector3f& end) const;
+	bool IsTriangleHit(unsigned int triangle, const Vector3f& start, const Vector3f& delta) const;
+
+	PotentiallyVisibleSet(const PotentiallyVisibleSet& other) {}
+	void operator=(const PotentiallyVisibleSet& other) {}
+};
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "renderQueue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+void RenderQueue::Add(const Shader& shader, const Material& material, const Mesh& mesh, const Transform& transform, float depth)
+{
+	DrawCall drawCall;
+	drawCall.shader = &shader;
+	drawCall.material = &material;
+	drawCall.mesh = &mesh;
+	drawCall.transform = &transform;
+
+	SortEntry entry;
+	entry.key = CalcKey(shader.GetProgram(), material.GetId(), mesh.GetId(), depth);
+	entry.drawCall = (unsigned int)m_drawCalls.size();
+
+	m_drawCalls.push_back(drawCall);
+	m_entries.push_back(entry);
+}
+
+void RenderQueue::Flush(const RenderingEngine& renderingEngine, const Camera& camera)
+{
+	RadixSort(&m_entries, &m_scratch);
+
+	//Keys only hold part of each id, so the actual state is compared to
+	//decide what needs to change.
+	bool isFirstDraw = true;
+	int currentProgram = 0;
+	unsigned int currentMaterial = 0;
+	unsigned int currentMesh = 0;
+	bool currentPositionsOnly = false;
+	bool supportsInstancing = Mesh::SupportsInstancing();
+
+	unsigned int runStart = 0;
+	while(runStart < m_entries.size())
+	{
+		const DrawCall& drawCall = m_drawCalls[m_entries[runStart].drawCall];
+
+		unsigned int runEnd = runStart + 1;
+		while(runEnd < m_entries.size())
+		{
+			const DrawCall& next = m_drawCalls[m_entries[runEnd].drawCall];
+			if(next.shader->GetProgram() != drawCall.shader->GetProgram() ||
+				next.material->GetId() != drawCall.material->GetId() ||
+				next.mesh->GetId() != drawCall.mesh->GetId())
+			{
+				break;
+			}
+			runEnd++;
+		}
+
+		bool isInstanced = supportsInstancing && runEnd - runStart >= MIN_INSTANCES && drawCall.shader->HasInstancedVariant();
+		if(!isInstanced)
+		{
+			runEnd = runStart + 1;
+		}
+
+		const Shader& shader = isInstanced ? drawCall.shader->GetInstancedVariant() : *drawCall.shader;
+
+		int uniformGroups = Shader::UNIFORMS_OBJECT;
+		if(isFirstDraw || currentProgram != shader.GetProgram())
+		{
+			shader.Bind();
+			uniformGroups = Shader::UNIFORMS_ALL;
+			currentProgram = shader.GetProgram();
+			currentMaterial = drawCall.material->GetId();
+			m_numStateChanges.Add();
+		}
+		else if(currentMaterial != drawCall.material->GetId())
+		{
+			uniformGroups |= Shader::UNIFORMS_MATERIAL;
+			currentMaterial = drawCall.material->GetId();
+			m_numStateChanges.Add();
+		}
+
+		shader.UpdateUniforms(*drawCall.transform, *drawCall.material, renderingEngine, camera, uniformGroups);
+
+		if(isFirstDraw || currentMesh != drawCall.mesh->GetId() || currentPositionsOnly != shader.ReadsPositionsOnly())
+		{
+			drawCall.mesh->Bind(shader.ReadsPositionsOnly());
+			currentMesh = drawCall.mesh->GetId();
+			currentPositionsOnly = shader.ReadsPositionsOnly();
+			m_numStateChanges.Add();
+		}
+
+		if(isInstanced)
+		{
+			m_instanceTransforms.clear();
+			for(unsigned int i = runStart; i < runEnd; i++)
+			{
+				m_instanceTransforms.push_back(m_drawCalls[m_entries[i].drawCall].transform->GetTransformation());
+			}
+			drawCall.mesh->DrawBoundInstanced(&m_instanceTransforms[0], runEnd - runStart);
+		}
+		else
+		{
+			drawCall.mesh->DrawBound();
+		}
+
+		m_numDrawCalls.Add();
+		isFirstDraw = false;
+		runStart = runEnd;
+	}
+
+	m_drawCalls.clear();
+	m_entries.clear();
+}
+
+void RenderQueue::DisplayStats(double divisor)
+{
+	m_numDrawCalls.DisplayAndReset("Draw Calls: ", divisor);
+	m_numStateChanges.DisplayAndReset("Draw State Changes: ", divisor);
+}
+
+unsigned long long RenderQueue::CalcKey(unsigned int shader, unsigned int material, unsigned int mesh, float depth)
+{
+	//Positive floats sort the same way as their bits do, so the top bits of the
+	//depth are enough to sort by it without knowing its range.
+	unsigned int depthBits = 0;
+	if(depth > 0.0f)
+	{
+		memcpy(&depthBits, &depth, sizeof(depthBits));
+	}
+
+	return ((unsigned long long)(shader & 0xFFFF) << 48) |
+		((unsigned long long)(material & 0xFFFF) << 32) |
+		((unsigned long long)(mesh & 0xFFFF) << 16) |
+		(unsigned long long)(depthBits >> 16);
+}
+
+void RenderQueue::RadixSort(std::vector<SortEntry>* entries, std::vector<SortEntry>* scratch)
+{
+	scratch->resize(entries->size());
+	if(entries->size() <= 1)
+	{
+		return;
+	}
+
+	SortEntry* source = &(*entries)[0];
+	SortEntry* dest = &(*scratch)[0];
+	unsigned int numEntries = (unsigned int)entries->size();
+
+	//Sorts 8 bits at a time from the least significant up. Each pass is
+	//stable, so the order from earlier passes is kept within each bucket.
+	for(unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		unsigned int counts[256];
+		memset(counts, 0, sizeof(counts));
+		for(unsigned int i = 0; i < numEntries; i++)
+		{
+			counts[(source[i].key >> shift) & 0xFF]++;
+		}
+
+		//Most scenes use few shaders, materials and meshes, so plenty of bytes
+		//are the same in every key and don't need a pass.
+		if(counts[(source[0].key >> shift) & 0xFF] == numEntries)
+		{
+			continue;
+		}
+
+		unsigned int offset = 0;
+		for(unsigned int i = 0; i < 256; i++)
+		{
+			unsigned int count = counts[i];
+			counts[i] = offset;
+			offset += count;
+		}
+
+		for(unsigned int i = 0; i < numEntries; i++)
+		{
+			dest[counts[(source[i].key >> shift) & 0xFF]++] = source[i];
+		}
+
+		std::swap(source, dest);
+	}
+
+	if(source != &(*entries)[0])
+	{
+		entries->swap(*scratch);
+	}
+}
+
+static bool CompareKeys(unsigned long long a, unsigned long long b)
+{
+	return a < b;
+}
+
+void RenderQueue::Test()
+{
+	//Depth only affects order among draws that share everything else.
+	assert(CalcKey(1, 2, 3, 100.0f) < CalcKey(1, 2, 4, 1.0f));
+	assert(CalcKey(1, 2, 3, 1.0f) < CalcKey(1, 2, 3, 2.0f));
+	assert(CalcKey(1, 2, 3, 0.5f) < CalcKey(1, 2, 3, 1000.0f));
+	assert(CalcKey(1, 2, 3, -5.0f) == CalcKey(1, 2, 3, 0.0f));
+	assert(CalcKey(1, 3, 0, 0.0f) > CalcKey(1, 2, 0xFFFF, 1000.0f));
+
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+	std::vector<unsigned long long> expected;
+
+	srand(5);
+	for(unsigned int i = 0; i < 1000; i++)
+	{
+		SortEntry entry;
+		entry.key = CalcKey(rand() % 3, rand() % 20, rand() % 50, (float)(rand() % 1000) / 10.0f);
+		entry.drawCall = i;
+		entries.push_back(entry);
+		expected.push_back(entry.key);
+	}
+
+	//Add a run of equal keys to check the sort is stable.
+	for(unsigned int i = 0; i < 10; i++)
+	{
+		SortEntry entry;
+		entry.key = CalcKey(1, 1, 1, 1.0f);
+		entry.drawCall = 1000 + i;
+		entries.push_back(entry);
+		expected.push_back(entry.key);
+	}
+
+	RadixSort(&entries, &scratch);
+	std::sort(expected.begin(), expected.end(), CompareKeys);
+
+	assert(entries.size() == expected.size());
+	unsigned int lastEqual = 0;
+	for(unsigned int i = 0; i < entries.size(); i++)
+	{
+		assert(entries[i].key == expected[i]);
+		if(entries[i].key == CalcKey(1, 1, 1, 1.0f) && entries[i].drawCall >= 1000)
+		{
+			assert(entries[i].drawCall >= lastEqual);
+			lastEqual = entries[i].drawCall;
+		}
+	}
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include "shader.h"
+#include "material.h"
+#include "mesh.h"
+#include "camera.h"
+#include "../core/profiling.h"
+
+#include <vector>
+
+class RenderingEngine;
+
+//Collects the draws for a pass and issues them sorted so that draws sharing a
+//shader, material or mesh end up next to each other. Any state that's already
+//current from the previous draw isn't set again, and runs of draws that share
+//all three are drawn together with instancing when the shader supports it.
+class RenderQueue
+{
+public:
+	RenderQueue() {}
+
+	//Queues a mesh to be drawn. Nothing is copied, so everything passed in must
+	//exist until Flush is called. Draws that share everything else are issued
+	//in order of increasing depth.
+	void Add(const Shader& shader, const Material& material, const Mesh& mesh, const Transform& transform, float depth);
+
+	//Issues and then forgets every queued draw.
+	void Flush(const RenderingEngine& renderingEngine, const Camera& camera);
+
+	//How many times the shader, material or mesh changed between draws.
+	inline unsigned int GetNumStateChanges() const { return m_numStateChanges.GetCount(); }
+	//How many draw calls were actually issued, counting each instanced run once.
+	inline unsigned int GetNumDrawCalls()    const { return m_numDrawCalls.GetCount(); }
+	void DisplayStats(double divisor);
+
+	static void Test();
+protected:
+private:
+	//Runs shorter than this are cheaper to draw one at a time than to upload
+	//an instance buffer for.
+	static const unsigned int MIN_INSTANCES = 4;
+
+	struct DrawCall
+	{
+		const Shader*    shader;
+		const Material*  material;
+		const Mesh*      mesh;
+		const Transform* transform;
+	};
+
+	//From the most to least significant bits, a key holds 16 bits each of the
+	//shader, material, mesh and depth, so sorting by key groups draws by the
+	//most expensive state to change first.
+	struct SortEntry
+	{
+		unsigned long long key;
+		unsigned int       drawCall;
+	};
+
+	std::vector<DrawCall>  m_drawCalls;
+	std::vector<SortEntry> m_entries;
+	std::vector<SortEntry> m_scratch;            //Reused by RadixSort to avoid reallocating
+	std::vector<Matrix4f>  m_instanceTransforms; //Reused by every instanced run
+	ProfileCounter         m_numStateChanges;
+	ProfileCounter         m_numDrawCalls;
+
+	static unsigned long long CalcKey(unsigned int shader, unsigned int material, unsigned int mesh, float depth);
+	static void RadixSort(std::vector<SortEntry>* entries, std::vector<SortEntry>* scratch);
+};
+
+#endif // RENDERQUEUE_H
@@ -16,7 +16,11 @@
  */
 
 #include <cassert>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdio.h>
 
 #include <GL/glew.h>
 
@@ -26,11 +30,16 @@
 #include "shader.h"
 
 #include "../core/entity.h"
+#include "../core/util.h"
+#include "../core/threadPool.h"
+#include "../staticLibs/stb_image.h"
+#include "../components/meshRenderer.h"
 #include "../3DEngine.h"
 
 
 
 
+const unsigned int RenderingEngine::FRAMES_UNTIL_STATIC;
 const Matrix4f RenderingEngine::BIAS_MATRIX = Matrix4f().InitScale(Vector3f(0.5, 0.5, 0.5)) * Matrix4f().InitTranslation(Vector3f(1.0, 1.0, 1.0));
 //Should construct a Matrix like this:
 //     x   y   z   w
@@ -44,8 +53,23 @@ const Matrix4f RenderingEngine::BIAS_MATRIX = Matrix4f().InitScale(Vector3f(0.5,
 //
 //This matrix will convert 3D coordinates from the range (-1, 1) to the range (0, 1).
 
-RenderingEngine::RenderingEngine(const Window& window) :
-    m_irradianceMap(32, 32, NULL, GL_TEXTURE_CUBE_MAP, GL_LINEAR, GL_RGB16F, GL_RGB, GL_FLOAT, true, GL_COLOR_ATTACHMENT0),
+//Moments of 1, the furthest depth there is, so nothing is in shadow.
+static unsigned char NO_SHADOW_MOMENTS[] = { 255, 255, 0, 0 };
+
+//Values for each cascade after the first, as named in LightBlock.
+static const char* const SHADOW_CASCADE_SCALE_NAMES[ShadowInfo::MAX_CASCADES] =
+	{ "", "shadowCascadeScale1", "shadowCascadeScale2", "shadowCascadeScale3" };
+static const char* const SHADOW_CASCADE_OFFSET_NAMES[ShadowInfo::MAX_CASCADES] =
+	{ "", "shadowCascadeOffset1", "shadowCascadeOffset2", "shadowCascadeOffset3" };
+static const char* const SHADOW_CASCADE_TILE_NAMES[ShadowInfo::MAX_CASCADES] =
+	{ "", "shadowCascadeTile1", "shadowCascadeTile2", "shadowCascadeTile3" };
+
+//The environment's irradiance, as named in irradianceSH.glh.
+static const char* const IRRADIANCE_SH_NAMES[EnvironmentBaker::NUM_SH_COEFFICIENTS] =
+	{ "irradianceSH0", "irradianceSH1", "irradianceSH2", "irradianceSH3", "irradianceSH4",
+	  "irradianceSH5", "irradianceSH6", "irradianceSH7", "irradianceSH8" };
+
+RenderingEngine::RenderingEngine(const Window& window, bool bakeEnvironmentOnCpu) :
     m_prefilterMap(128, 128, NULL, GL_TEXTURE_CUBE_MAP, GL_LINEAR_MIPMAP_LINEAR, GL_RGB16F, GL_RGB, GL_FLOAT, true, GL_COLOR_ATTACHMENT0),
     m_brdfLUT(512, 512, NULL, GL_TEXTURE_2D, GL_LINEAR, GL_RGB16F, GL_RG, GL_FLOAT, true, GL_COLOR_ATTACHMENT0),
 	m_plane(Mesh("plane.obj")),
@@ -53,13 +77,12 @@ RenderingEngine::RenderingEngine(const Window& window) :
 	m_tempTarget(window.GetWidth(), window.GetHeight(), 0, GL_TEXTURE_2D, GL_NEAREST, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, false, GL_COLOR_ATTACHMENT0),
 	m_planeMaterial("renderingEngine_filterPlane", m_tempTarget, 1, 8),
     m_skyboxMaterial("skyboxMaterial"),
-    m_environmentMap("newport_loft.hdr", GL_TEXTURE_2D, GL_LINEAR, GL_RGB16F, GL_RGB, GL_FLOAT, false, GL_NONE),
+    m_environmentMap(1, 1, 0, GL_TEXTURE_2D, GL_LINEAR, GL_RGB16F, GL_RGB, GL_FLOAT),
     m_environmentCubeMap(1024, 1024, NULL, GL_TEXTURE_CUBE_MAP, GL_LINEAR, GL_RGB16F, GL_RGB, GL_FLOAT, true, GL_COLOR_ATTACHMENT0),
 	m_defaultShader("pbr-ambient"),
 	m_shadowMapShader("shadowMapGenerator"),
     m_environmentShader("environmentShader"),
 	m_skyboxShader("skybox"),
-    m_irradianceShader("irradianceShader"),
     m_prefilterShader("prefilterShader"),
 	m_brdfShader("brdf"),
 	m_nullFilter("filter-null"),
@@ -68,9 +91,21 @@ RenderingEngine::RenderingEngine(const Window& window) :
 	m_skybox("skybox.obj"),
     m_renderCamera(false),
     m_renderLight(false),
+	m_renderProfileTimer("Render"),
+	m_windowSyncProfileTimer("Window Sync"),
+	m_noShadowMap(1, 1, NO_SHADOW_MOMENTS, GL_TEXTURE_2D, GL_NEAREST, GL_RG32F, GL_RGBA, GL_UNSIGNED_BYTE, true),
+	m_shadowAtlas(new ShadowAtlas()),
     m_skyboxTransform(Vector3f(0,0,0), Quaternion(0,0,0,1), 50),
 	m_altCameraTransform(Vector3f(0,0,0), Quaternion(Vector3f(0,1,0),ToRadians(180.0f))),
-	m_altCamera(Matrix4f().InitIdentity(), &m_altCameraTransform)
+	m_altCamera(Matrix4f().InitIdentity(), &m_altCameraTransform),
+	m_shadowCaching(true),
+	m_occlusionCuller(ThreadPool::GetNumCPUs()),
+	m_occlusionCulling(true),
+	m_asyncLoader(ThreadPool::GetNumCPUs()),
+	m_streamingBudget(DEFAULT_STREAMING_BUDGET),
+	m_clusteredShader("pbr-clustered"),
+	m_clusteredShading(true),
+	m_bakeEnvironmentOnCpu(bakeEnvironmentOnCpu)
 {
 	SetSamplerSlot("diffuse",   0);
 	SetSamplerSlot("normalMap", 1);
@@ -86,11 +121,15 @@ RenderingEngine::RenderingEngine(const Window& window) :
     SetSamplerSlot("roughnessMap", 3);
     SetSamplerSlot("aoMap", 4);
 
-    SetSamplerSlot("E_irradianceMap", 5);
     SetSamplerSlot("E_prefilterMap", 6);
     SetSamplerSlot("E_brdfLUT", 7);
 	
 	SetSamplerSlot("filterTexture", 0);
+
+	SetSamplerSlot("clusterLights", 9);
+	SetSamplerSlot("clusterGrid", 10);
+	SetSamplerSlot("clusterLightIndices", 11);
+	SetVector3f("clusterCounts", Vector3f((float)LightClusters::TILES_X, (float)LightClusters::TILES_Y, (float)LightClusters::SLICES));
 	
 	SetVector3f("ambient", Vector3f(0.2f, 0.2f, 0.2f));
 	
@@ -116,40 +155,94 @@ RenderingEngine::RenderingEngine(const Window& window) :
 	m_planeTransform.Rotate(Quaternion(Vector3f(1,0,0), ToRadians(90.0f)));
 	m_planeTransform.Rotate(Quaternion(Vector3f(0,0,1), ToRadians(180.0f)));
 
-    SetTexture("E_environmentMap", m_environmentMap);
-    PrepareEnvironmentMap();
-    SetTexture("E_environmentCubeMap", m_environmentCubeMap);
-    PreparePrefilterMap();
-	PrepareIrradianceMap();
-    PrepareBrdfLUT();
+	//Drawing the prefilter map takes minutes when OpenGL is emulated in software.
+	const char* glRenderer = (const char*)glGetString(GL_RENDERER);
+	if(glRenderer && (strstr(glRenderer, "llvmpipe") || strstr(glRenderer, "softpipe")))
+	{
+		m_bakeEnvironmentOnCpu = true;
+	}
+
+	PrepareEnvironmentMaps("newport_loft.hdr");
 
-	SetTexture("E_irradianceMap", m_irradianceMap);
 	SetTexture("E_prefilterMap", m_prefilterMap);
 	SetTexture("E_brdfLUT", m_brdfLUT);
 
-	
-	for(int i = 0; i < NUM_SHADOW_MAPS; i++)
+	m_lightMatrix = Matrix4f().InitScale(Vector3f(0,0,0));
+
+	//Every shader that draws the scene declares the same camera block, so any
+	//of them can describe it.
+	const UniformBlockLayout* cameraBlock = m_defaultShader.GetUniformBlock("CameraBlock");
+	assert(cameraBlock != 0);
+	m_mainCameraBuffer = new UniformBuffer(*cameraBlock);
+	m_shadowCameraBuffer = new UniformBuffer(*cameraBlock);
+}
+
+RenderingEngine::~RenderingEngine()
+{
+	for(unsigned int i = 0; i < m_lightBuffers.size(); i++)
 	{
-		int shadowMapSize = 1 << (i + 1);
-		m_shadowMaps[i] = Texture(shadowMapSize, shadowMapSize, 0, GL_TEXTURE_2D, GL_LINEAR, GL_RG32F, GL_RGBA, GL_UNSIGNED_BYTE, true, GL_COLOR_ATTACHMENT0);
-		m_shadowMapTempTargets[i] = Texture(shadowMapSize, shadowMapSize, 0, GL_TEXTURE_2D, GL_LINEAR, GL_RG32F, GL_RGBA, GL_UNSIGNED_BYTE, true, GL_COLOR_ATTACHMENT0);
+		delete m_lightBuffers[i];
 	}
-	
-	m_lightMatrix = Matrix4f().InitScale(Vector3f(0,0,0));
+
+	delete m_shadowAtlas;
+	delete m_mainCameraBuffer;
+	delete m_shadowCameraBuffer;
 }
 
-void RenderingEngine::BlurShadowMap(int shadowMapIndex, float blurAmount)
+void RenderingEngine::AddLight(const BaseLight& light)
 {
-	SetVector3f("blurScale", Vector3f(blurAmount/(m_shadowMaps[shadowMapIndex].GetWidth()), 0.0f, 0.0f));
-	ApplyFilter(m_gausBlurFilter, m_shadowMaps[shadowMapIndex], &m_shadowMapTempTargets[shadowMapIndex]);
-	
-	SetVector3f("blurScale", Vector3f(0.0f, blurAmount/(m_shadowMaps[shadowMapIndex].GetHeight()), 0.0f));
-	ApplyFilter(m_gausBlurFilter, m_shadowMapTempTargets[shadowMapIndex], &m_shadowMaps[shadowMapIndex]); 
+	m_lights.push_back(&light);
+
+	const UniformBlockLayout* lightBlock = light.GetShader().GetUniformBlock("LightBlock");
+	m_lightBuffers.push_back(lightBlock != 0 ? new UniformBuffer(*lightBlock) : 0);
+	m_lightBlockMembers.push_back(std::vector<LightBlockMember>());
+	if(lightBlock != 0)
+	{
+		CompileLightBlockMembers(*m_lightBuffers.back(), &m_lightBlockMembers.back());
+	}
+	m_pointLights.push_back(0);
+	m_firstShadowCaches.push_back((unsigned int)m_shadowCaches.size());
+	m_shadowCaches.resize(m_shadowCaches.size() + light.GetShadowInfo().GetNumCascades());
+}
 
-//	SetVector3f("inverseFilterTextureSize", Vector3f(blurAmount/m_shadowMaps[shadowMapIndex].GetWidth(), blurAmount/m_shadowMaps[shadowMapIndex].GetHeight(), 0.0f));
-//	ApplyFilter(m_fxaaFilter, m_shadowMaps[shadowMapIndex], &m_shadowMapTempTargets[shadowMapIndex]);
-//	
-//	ApplyFilter(m_nullFilter, m_shadowMapTempTargets[shadowMapIndex], &m_shadowMaps[shadowMapIndex]);
+void RenderingEngine::AddPointLight(const PointLight& light)
+{
+	AddLight(light);
+	m_pointLights.back() = &light;
+}
+
+RenderingEngine::ShadowCache::ShadowCache() :
+	hasTiles(false),
+	viewProjection(Matrix4f().InitIdentity()),
+	isStaticMapValid(false),
+	hasMovingCasters(false) {}
+
+void RenderingEngine::SetShadowAtlas(int sizeAsPowerOf2, bool use16BitMoments)
+{
+	for(unsigned int i = 0; i < m_shadowCaches.size(); i++)
+	{
+		FreeShadowTiles(&m_shadowCaches[i]);
+	}
+
+	delete m_shadowAtlas;
+	m_shadowAtlas = new ShadowAtlas(sizeAsPowerOf2, use16BitMoments);
+}
+
+void RenderingEngine::BlurShadowMap(const ShadowAtlas::Tile& tile, float blurAmount)
+{
+	//The shadow map is drawn into the first of the tile targets, then blurred
+	//across into the second, and back down into its tile.
+	const Texture& shadowMap = m_shadowAtlas->GetTileTarget(tile.sizeAsPowerOf2, 0);
+	const Texture& tempTarget = m_shadowAtlas->GetTileTarget(tile.sizeAsPowerOf2, 1);
+
+	SetVector3f("blurScale", Vector3f(blurAmount/(shadowMap.GetWidth()), 0.0f, 0.0f));
+	ApplyFilter(m_gausBlurFilter, shadowMap, &tempTarget);
+	
+	SetVector3f("blurScale", Vector3f(0.0f, blurAmount/(tempTarget.GetHeight()), 0.0f));
+	m_shadowAtlas->GetTexture().BindAsRenderTarget();
+	m_shadowAtlas->BindTile(tile);
+	DrawFilter(m_gausBlurFilter, tempTarget);
+	glDisable(GL_SCISSOR_TEST);
 }
 
 void RenderingEngine::ApplyFilter(const Shader& filter, const Texture& source, const Texture* dest)
@@ -163,7 +256,12 @@ void RenderingEngine::ApplyFilter(const Shader& filter, const Texture& source, c
 	{
 		dest->BindAsRenderTarget();
 	}
-	
+
+	DrawFilter(filter, source);
+}
+
+void RenderingEngine::DrawFilter(const Shader& filter, const Texture& source)
+{
 	SetTexture("filterTexture", source);
 	
 	m_altCamera.SetProjection(Matrix4f().InitIdentity());
@@ -182,101 +280,474 @@ void RenderingEngine::ApplyFilter(const Shader& filter, const Texture& source, c
 	SetTexture("filterTexture", 0);
 }
 
-void RenderingEngine::Render(const Entity& object)
+static void CalcWorldBounds(const MeshRenderer& meshRenderer, Vector3f* minExtents, Vector3f* maxExtents)
 {
-	m_renderProfileTimer.StartInvocation();
-	GetTexture("displayTexture").BindAsRenderTarget();
-	//m_window->BindAsRenderTarget();
-	//m_tempTarget->BindAsRenderTarget();
+	BoundingVolumeHierarchy::TransformAABB(meshRenderer.GetTransform().GetTransformation(),
+		meshRenderer.GetMesh().GetMinExtents(), meshRenderer.GetMesh().GetMaxExtents(), minExtents, maxExtents);
+}
 
-	glClearColor(0.0f,0.0f,0.0f,0.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	object.RenderAll(m_defaultShader, *this, *m_mainCamera);
-	
-	for(unsigned int i = 0; i < m_lights.size(); i++)
-	{
-		m_activeLight = m_lights[i];
-		ShadowInfo shadowInfo = m_activeLight->GetShadowInfo();
+void RenderingEngine::AddMeshRenderer(const MeshRenderer& meshRenderer)
+{
+	Vector3f minExtents;
+	Vector3f maxExtents;
+	CalcWorldBounds(meshRenderer, &minExtents, &maxExtents);
 
-		int shadowMapIndex = 0;
-		if(shadowInfo.GetShadowMapSizeAsPowerOf2() != 0)
-			shadowMapIndex = shadowInfo.GetShadowMapSizeAsPowerOf2() - 1;
+	if(meshRenderer.IsOccluder())
+	{
+		m_occluders.push_back((unsigned int)m_meshRenderers.size());
+	}
 
-		assert(shadowMapIndex >= 0 && shadowMapIndex < NUM_SHADOW_MAPS);
+	m_meshRendererProxies.push_back(m_sceneBounds.AddProxy(minExtents, maxExtents, (unsigned int)m_meshRenderers.size()));
+	m_meshRenderers.push_back(&meshRenderer);
+	m_meshRenderersOccluded.push_back(false);
+	m_meshRenderersStreaming.push_back(meshRenderer.GetMesh().IsStreaming());
+	m_meshRendererBounds.push_back(minExtents);
+	m_meshRendererBounds.push_back(maxExtents);
+	m_meshRendererStillFrames.push_back(FRAMES_UNTIL_STATIC);
+	m_staticChangeBounds.push_back(minExtents);
+	m_staticChangeBounds.push_back(maxExtents);
+}
 
-		SetTexture("shadowMap", m_shadowMaps[shadowMapIndex]);
-		m_shadowMaps[shadowMapIndex].BindAsRenderTarget();
-		glClearColor(1.0f,1.0f,0.0f,0.0f);
-		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+//Takes an index out of a list of them, and renames another index that's been
+//moved into its place.
+static void RemoveIndex(std::vector<unsigned int>* indices, unsigned int removed, unsigned int moved)
+{
+	for(unsigned int i = 0; i < indices->size();)
+	{
+		if((*indices)[i] == removed)
+		{
+			(*indices)[i] = indices->back();
+			indices->pop_back();
+			continue;
+		}
 
-		if(shadowInfo.GetShadowMapSizeAsPowerOf2() != 0)
+		if((*indices)[i] == moved)
 		{
-			m_altCamera.SetProjection(shadowInfo.GetProjection());
-			ShadowCameraTransform shadowCameraTransform = m_activeLight->CalcShadowCameraTransform(m_mainCamera->GetTransform().GetTransformedPos(),
-				m_mainCamera->GetTransform().GetTransformedRot());
-			m_altCamera.GetTransform()->SetPos(shadowCameraTransform.GetPos());
-			m_altCamera.GetTransform()->SetRot(shadowCameraTransform.GetRot());
+			(*indices)[i] = removed;
+		}
+		i++;
+	}
+}
+
+void RenderingEngine::RemoveMeshRenderer(const MeshRenderer& meshRenderer)
+{
+	std::vector<const MeshRenderer*>::iterator it = std::find(m_meshRenderers.begin(), m_meshRenderers.end(), &meshRenderer);
+	if(it == m_meshRenderers.end())
+	{
+		return;
+	}
+
+	unsigned int index = (unsigned int)(it - m_meshRenderers.begin());
+	unsigned int last = (unsigned int)m_meshRenderers.size() - 1;
+
+	//Cached shadow maps it was drawn into have to be drawn again without it.
+	if(m_meshRendererStillFrames[index] >= FRAMES_UNTIL_STATIC)
+	{
+		m_staticChangeBounds.push_back(m_meshRendererBounds[index * 2]);
+		m_staticChangeBounds.push_back(m_meshRendererBounds[index * 2 + 1]);
+	}
+	m_sceneBounds.RemoveProxy(m_meshRendererProxies[index]);
 
-			m_lightMatrix = BIAS_MATRIX * m_altCamera.GetViewProjection();
+	//The last MeshRenderer is moved into its place, so every index stays dense.
+	m_meshRenderers[index] = m_meshRenderers[last];
+	m_meshRendererProxies[index] = m_meshRendererProxies[last];
+	m_meshRendererBounds[index * 2] = m_meshRendererBounds[last * 2];
+	m_meshRendererBounds[index * 2 + 1] = m_meshRendererBounds[last * 2 + 1];
+	m_meshRendererStillFrames[index] = m_meshRendererStillFrames[last];
+	m_meshRenderersOccluded[index] = m_meshRenderersOccluded[last];
+	m_meshRenderersStreaming[index] = m_meshRenderersStreaming[last];
 
-			SetFloat("shadowVarianceMin", shadowInfo.GetMinVariance());
-			SetFloat("shadowLightBleedingReduction", shadowInfo.GetLightBleedReductionAmount());
-			bool flipFaces = shadowInfo.GetFlipFaces();
+	m_meshRenderers.pop_back();
+	m_meshRendererProxies.pop_back();
+	m_meshRendererBounds.resize(last * 2);
+	m_meshRendererStillFrames.pop_back();
+	m_meshRenderersOccluded.pop_back();
+	m_meshRenderersStreaming.pop_back();
 
-//			const Camera* temp = m_mainCamera;
-//			m_mainCamera = m_altCamera;
+	if(index != last)
+	{
+		m_sceneBounds.SetUserData(m_meshRendererProxies[index], index);
+	}
+	RemoveIndex(&m_occluders, index, last);
+	RemoveIndex(&m_movingMeshRenderers, index, last);
+}
 
-			if(flipFaces)
+void RenderingEngine::RemoveUnculledComponent(const EntityComponent& component)
+{
+	std::vector<const EntityComponent*>::iterator it = std::find(m_unculledComponents.begin(), m_unculledComponents.end(), &component);
+	if(it != m_unculledComponents.end())
+	{
+		*it = m_unculledComponents.back();
+		m_unculledComponents.pop_back();
+	}
+}
+
+void RenderingEngine::UpdateSceneBounds()
+{
+	for(unsigned int i = 0; i < m_meshRenderers.size(); i++)
+	{
+		//A mesh that's just been streamed in moves from an empty box to its
+		//real bounds, which is handled like the MeshRenderer moving.
+		bool hasStreamedIn = m_meshRenderersStreaming[i] && !m_meshRenderers[i]->GetMesh().IsStreaming();
+		if(hasStreamedIn)
+		{
+			m_meshRenderersStreaming[i] = false;
+		}
+		
+		if(m_meshRenderers[i]->GetTransform().HasChanged() || hasStreamedIn)
+		{
+			//Static meshes that move are taken out of the cached shadow maps
+			//they were drawn into.
+			if(m_meshRendererStillFrames[i] >= FRAMES_UNTIL_STATIC)
 			{
-				glCullFace(GL_FRONT);
+				m_staticChangeBounds.push_back(m_meshRendererBounds[i * 2]);
+				m_staticChangeBounds.push_back(m_meshRendererBounds[i * 2 + 1]);
+				m_movingMeshRenderers.push_back(i);
 			}
+			m_meshRendererStillFrames[i] = 0;
 
-			glEnable(GL_DEPTH_CLAMP);
-			object.RenderAll(m_shadowMapShader, *this, m_altCamera);
-			glDisable(GL_DEPTH_CLAMP);
+			Vector3f minExtents;
+			Vector3f maxExtents;
+			CalcWorldBounds(*m_meshRenderers[i], &minExtents, &maxExtents);
+			m_sceneBounds.MoveProxy(m_meshRendererProxies[i], minExtents, maxExtents);
+			m_meshRendererBounds[i * 2] = minExtents;
+			m_meshRendererBounds[i * 2 + 1] = maxExtents;
+		}
+	}
+}
 
-			if(flipFaces)
+void RenderingEngine::DisplayDrawStats(double dividend)
+{
+	m_numMeshesDrawn.DisplayAndReset("Meshes Drawn: ", dividend);
+	m_numMeshesCulled.DisplayAndReset("Meshes Culled: ", dividend);
+	m_numMeshesOccluded.DisplayAndReset("Meshes Occluded: ", dividend);
+	m_numLightsCulled.DisplayAndReset("Lights Culled: ", dividend);
+	m_numShadowMapsDrawn.DisplayAndReset("Shadow Maps Drawn: ", dividend);
+	m_numShadowMapsCached.DisplayAndReset("Shadow Maps Cached: ", dividend);
+	m_renderQueue.DisplayStats(dividend);
+}
+
+static void UpdateCameraBuffer(UniformBuffer* cameraBuffer, const Camera& camera)
+{
+	cameraBuffer->SetMatrix4f("T_view", camera.GetView());
+	cameraBuffer->SetMatrix4f("T_projection", camera.GetProjection());
+	cameraBuffer->SetMatrix4f("T_viewProjection", camera.GetViewProjection());
+	cameraBuffer->SetMatrix4f("T_cameraRot", camera.GetCameraRotation());
+	cameraBuffer->SetVector3f("C_eyePos", camera.GetTransform().GetTransformedPos());
+}
+
+void RenderingEngine::CompileLightBlockMembers(const UniformBuffer& lightBuffer, std::vector<LightBlockMember>* result) const
+{
+	//Members are named after the R_ uniforms they replace, and set the same way.
+	const std::vector<TypedData>& members = lightBuffer.GetLayout().GetMembers();
+	for(unsigned int i = 0; i < members.size(); i++)
+	{
+		const std::string& memberName = members[i].GetName();
+		const std::string& memberType = members[i].GetType();
+		std::string unprefixedName = memberName.substr(2, memberName.length());
+
+		LightBlockMember member;
+		member.nameId = GetNameId(unprefixedName);
+		lightBuffer.FindLightOffsets(memberName, memberType, member.offsets);
+
+		if(unprefixedName == "worldLightMatrix")
+			member.source = LightBlockMember::WORLD_LIGHT_MATRIX;
+		else if(memberType == "DirectionalLight")
+			member.source = LightBlockMember::DIRECTIONAL_LIGHT;
+		else if(memberType == "PointLight")
+			member.source = LightBlockMember::POINT_LIGHT;
+		else if(memberType == "SpotLight")
+			member.source = LightBlockMember::SPOT_LIGHT;
+		else if(memberType == "vec3")
+			member.source = LightBlockMember::VECTOR3F;
+		else if(memberType == "float")
+			member.source = LightBlockMember::FLOAT;
+		else
+			throw memberType + " is not supported by the rendering engine";
+
+		if(member.source != LightBlockMember::DIRECTIONAL_LIGHT && member.source != LightBlockMember::POINT_LIGHT && 
+			member.source != LightBlockMember::SPOT_LIGHT)
+		{
+			member.offsets[0] = lightBuffer.GetLayout().GetOffset(memberName);
+		}
+
+		result->push_back(member);
+	}
+}
+
+void RenderingEngine::UpdateLightBuffer(unsigned int light) const
+{
+	UniformBuffer* lightBuffer = m_lightBuffers[light];
+	const std::vector<LightBlockMember>& members = m_lightBlockMembers[light];
+	for(unsigned int i = 0; i < members.size(); i++)
+	{
+		const LightBlockMember& member = members[i];
+		switch(member.source)
+		{
+			case LightBlockMember::WORLD_LIGHT_MATRIX:
+				lightBuffer->SetMatrix4f(member.offsets[0], m_lightMatrix);
+				break;
+			case LightBlockMember::DIRECTIONAL_LIGHT:
+				lightBuffer->SetDirectionalLight(member.offsets, *(const DirectionalLight*)m_activeLight);
+				break;
+			case LightBlockMember::POINT_LIGHT:
+				lightBuffer->SetPointLight(member.offsets, *(const PointLight*)m_activeLight);
+				break;
+			case LightBlockMember::SPOT_LIGHT:
+				lightBuffer->SetSpotLight(member.offsets, *(const SpotLight*)m_activeLight);
+				break;
+			case LightBlockMember::VECTOR3F:
+				lightBuffer->SetVector3f(member.offsets[0], GetVector3f(member.nameId));
+				break;
+			case LightBlockMember::FLOAT:
+				lightBuffer->SetFloat(member.offsets[0], GetFloat(member.nameId));
+				break;
+		}
+	}
+}
+
+void RenderingEngine::RenderVisible(const Shader& shader, const Camera& camera, bool includeDepthPlanes)
+{
+	RenderVisible(shader, camera, Frustum(camera.GetViewProjection(), includeDepthPlanes));
+}
+
+void RenderingEngine::RenderVisible(const Shader& shader, const Camera& camera, const Frustum& frustum)
+{
+	m_sceneBounds.FindVisible(frustum, &m_visibleMeshRenderers);
+
+	//Occlusion is only known for the main camera's view.
+	if(&camera == m_mainCamera)
+	{
+		unsigned int numUnoccluded = 0;
+		for(unsigned int i = 0; i < m_visibleMeshRenderers.size(); i++)
+		{
+			if(!m_meshRenderersOccluded[m_visibleMeshRenderers[i]])
 			{
-				glCullFace(GL_BACK);
+				m_visibleMeshRenderers[numUnoccluded++] = m_visibleMeshRenderers[i];
 			}
+		}
+		m_numMeshesOccluded.Add((unsigned int)m_visibleMeshRenderers.size() - numUnoccluded);
+		m_visibleMeshRenderers.resize(numUnoccluded);
+	}
 
-//			m_mainCamera = temp;
+	Vector3f cameraPos = camera.GetTransform().GetTransformedPos();
+	Vector3f cameraForward = camera.GetTransform().GetTransformedRot().GetForward();
+	for(unsigned int i = 0; i < m_visibleMeshRenderers.size(); i++)
+	{
+		const MeshRenderer& meshRenderer = *m_meshRenderers[m_visibleMeshRenderers[i]];
+		float depth = (meshRenderer.GetTransform().GetTransformedPos() - cameraPos).Dot(cameraForward);
+		m_renderQueue.Add(shader, meshRenderer.GetMaterial(), meshRenderer.GetMesh(), meshRenderer.GetTransform(), depth);
+	}
+	m_renderQueue.Flush(*this, camera);
+
+	for(unsigned int i = 0; i < m_unculledComponents.size(); i++)
+	{
+		m_unculledComponents[i]->Render(shader, *this, camera);
+	}
+
+	m_numMeshesDrawn.Add((unsigned int)m_visibleMeshRenderers.size());
+	m_numMeshesCulled.Add((unsigned int)(m_meshRenderers.size() - m_visibleMeshRenderers.size()));
+}
+
+void RenderingEngine::UpdateOcclusion()
+{
+	std::fill(m_meshRenderersOccluded.begin(), m_meshRenderersOccluded.end(), false);
+	int cameraCell = m_potentiallyVisibleSet.GetCell(m_mainCamera->GetTransform().GetTransformedPos());
+	if(!m_occlusionCulling || (m_occluders.empty() && cameraCell < 0))
+	{
+		return;
+	}
+
+	ProfileZone zone("Occlusion Culling");
+	m_sceneBounds.FindVisible(Frustum(m_mainCamera->GetViewProjection(), true), &m_visibleMeshRenderers);
+
+	//Anything in a part of the level the camera's cell can't see is rejected
+	//before any occluders are drawn.
+	if(cameraCell >= 0)
+	{
+		for(unsigned int i = 0; i < m_visibleMeshRenderers.size(); i++)
+		{
+			unsigned int meshRenderer = m_visibleMeshRenderers[i];
+			m_meshRenderersOccluded[meshRenderer] = !m_potentiallyVisibleSet.IsBoxVisible(cameraCell,
+				m_meshRendererBounds[meshRenderer * 2], m_meshRendererBounds[meshRenderer * 2 + 1]);
+		}
+	}
 
-			float shadowSoftness = shadowInfo.GetShadowSoftness();
-			if(shadowSoftness != 0)
+	if(m_occluders.empty())
+	{
+		return;
+	}
+
+	m_occlusionCuller.Begin(m_mainCamera->GetViewProjection());
+	for(unsigned int i = 0; i < m_occluders.size(); i++)
+	{
+		const MeshRenderer& occluder = *m_meshRenderers[m_occluders[i]];
+		m_occlusionCuller.AddOccluder(occluder.GetTransform().GetTransformation(),
+			occluder.GetMesh().GetPositions(), occluder.GetMesh().GetIndices());
+	}
+	m_occlusionCuller.End();
+
+	//Occluders are never hidden by themselves, since their bounds are never
+	//behind their own surfaces, so they can be tested like anything else.
+	for(unsigned int i = 0; i < m_visibleMeshRenderers.size(); i++)
+	{
+		unsigned int meshRenderer = m_visibleMeshRenderers[i];
+		if(!m_meshRenderersOccluded[meshRenderer])
+		{
+			m_meshRenderersOccluded[meshRenderer] = m_occlusionCuller.IsOccluded(m_meshRendererBounds[meshRenderer * 2],
+				m_meshRendererBounds[meshRenderer * 2 + 1]);
+		}
+	}
+}
+
+void RenderingEngine::LoadPotentiallyVisibleSet(const std::string& levelFileName, float cellSize)
+{
+	std::string path = "./res/models/" + levelFileName;
+	unsigned int key = Util::CalcFileChecksum(path);
+	key = Util::CalcChecksum(&cellSize, sizeof(cellSize), key);
+
+	std::string fileName = path + ".pvs";
+	if(m_potentiallyVisibleSet.Load(fileName, key))
+	{
+		return;
+	}
+
+	Mesh level(levelFileName);
+	ThreadPool threadPool(ThreadPool::GetNumCPUs());
+	m_potentiallyVisibleSet.Bake(level.GetPositions(), level.GetIndices(), level.GetMinExtents(), level.GetMaxExtents(),
+		cellSize, &threadPool);
+
+	if(!m_potentiallyVisibleSet.Save(fileName, key))
+	{
+		fprintf(stderr, "Unable to write potentially visible set: %s\n", fileName.c_str());
+	}
+}
+
+void RenderingEngine::Render()
+{
+	m_renderProfileTimer.StartInvocation();
+	{
+		ProfileZone zone("Streaming");
+		m_asyncLoader.Update(m_streamingBudget);
+	}
+	
+	GetTexture("displayTexture").BindAsRenderTarget();
+	//m_window->BindAsRenderTarget();
+	//m_tempTarget->BindAsRenderTarget();
+
+	glClearColor(0.0f,0.0f,0.0f,0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	UpdateOcclusion();
+
+	UpdateCameraBuffer(m_mainCameraBuffer, *m_mainCamera);
+	m_mainCameraBuffer->Bind();
+	{
+		ProfileZone zone("Ambient Pass");
+		RenderVisible(m_defaultShader, *m_mainCamera, true);
+	}
+	
+	UpdateShadowCaches();
+
+	for(unsigned int i = 0; i < m_lights.size(); i++)
+	{
+		if(m_clusteredShading && m_pointLights[i] != 0)
+		{
+			continue;
+		}
+
+		//Lights that can't reach anything on screen are skipped, shadow map and all.
+		Vector3f lightCenter;
+		float lightRadius;
+		Vector3f minScreenBounds;
+		Vector3f maxScreenBounds;
+		bool isLightBounded = m_lights[i]->CalcBoundingSphere(&lightCenter, &lightRadius);
+		if(isLightBounded && !m_mainCamera->CalcScreenBounds(lightCenter, lightRadius, &minScreenBounds, &maxScreenBounds))
+		{
+			for(int j = 0; j < m_lights[i]->GetShadowInfo().GetNumCascades(); j++)
 			{
-				BlurShadowMap(shadowMapIndex, shadowSoftness);
+				FreeShadowTiles(&m_shadowCaches[m_firstShadowCaches[i] + j]);
 			}
+			m_numLightsCulled.Add();
+			continue;
 		}
-		else
+
+		ProfileZone lightZone("Light");
+		m_activeLight = m_lights[i];
+
+		//Lights that cover less of the screen get smaller shadow maps, and if the
+		//atlas is full, none at all.
+		float importance = 1.0f;
+		if(isLightBounded)
 		{
+			importance = (maxScreenBounds.GetX() - minScreenBounds.GetX()) * (maxScreenBounds.GetY() - minScreenBounds.GetY()) * 0.25f;
+		}
+
+		if(UpdateShadowMaps(i, importance) == 0)
+		{
+			SetTexture("shadowMap", m_noShadowMap);
+			SetVector3f("shadowMapTile", Vector3f(0.0f, 0.0f, 1.0f));
+
 			m_lightMatrix = Matrix4f().InitScale(Vector3f(0,0,0));
 			SetFloat("shadowVarianceMin", 0.00002f);
 			SetFloat("shadowLightBleedingReduction", 0.0f);
 		}
 
-		GetTexture("displayTexture").BindAsRenderTarget();
+		const Texture& displayTexture = GetTexture("displayTexture");
+		displayTexture.BindAsRenderTarget();
 		//m_window->BindAsRenderTarget();
 
-//		glEnable(GL_SCISSOR_TEST);
-//		TODO: Make use of scissor test to limit light area
-//		glScissor(0, 0, 100, 100);
+		//Pixels outside the light's bounds on screen, or with depths it can't
+		//reach, can't be lit by it.
+		if(isLightBounded)
+		{
+			int minX = (int)floorf((minScreenBounds.GetX() * 0.5f + 0.5f) * (float)displayTexture.GetWidth());
+			int minY = (int)floorf((minScreenBounds.GetY() * 0.5f + 0.5f) * (float)displayTexture.GetHeight());
+			int maxX = (int)ceilf((maxScreenBounds.GetX() * 0.5f + 0.5f) * (float)displayTexture.GetWidth());
+			int maxY = (int)ceilf((maxScreenBounds.GetY() * 0.5f + 0.5f) * (float)displayTexture.GetHeight());
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(minX, minY, maxX - minX, maxY - minY);
+
+			if(GLEW_EXT_depth_bounds_test)
+			{
+				glEnable(GL_DEPTH_BOUNDS_TEST_EXT);
+				glDepthBoundsEXT(minScreenBounds.GetZ(), maxScreenBounds.GetZ());
+			}
+		}
 
 		glEnable(GL_BLEND);
 		glBlendFunc(GL_ONE, GL_ONE);
 		glDepthMask(GL_FALSE);
 		glDepthFunc(GL_EQUAL);
 
-		object.RenderAll(m_activeLight->GetShader(), *this, *m_mainCamera);
+		if(m_lightBuffers[i] != 0)
+		{
+			UpdateLightBuffer(i);
+			m_lightBuffers[i]->Bind();
+		}
+		//Only meshes inside both the view and the light's bounds are drawn.
+		Frustum lightFrustum(m_mainCamera->GetViewProjection(), true);
+		m_activeLight->AddBoundingPlanes(&lightFrustum);
+		RenderVisible(m_activeLight->GetShader(), *m_mainCamera, lightFrustum);
 
 		glDepthMask(GL_TRUE);
 		glDepthFunc(GL_LESS);
 		glDisable(GL_BLEND);
 
-//		glDisable(GL_SCISSOR_TEST);
+		if(isLightBounded)
+		{
+			glDisable(GL_SCISSOR_TEST);
+			if(GLEW_EXT_depth_bounds_test)
+			{
+				glDisable(GL_DEPTH_BOUNDS_TEST_EXT);
+			}
+		}
 	}
 
-//    PrepareIrradianceMap();
+	if(m_clusteredShading)
+	{
+		RenderClusteredLights();
+	}
 
 	// render a cube
 //    Material abc("test_material");
@@ -303,7 +774,10 @@ void RenderingEngine::Render(const Entity& object)
 //    m_plane.Draw();
 
 
-    RenderSkybox();
+	{
+		ProfileZone zone("Skybox");
+		RenderSkybox();
+	}
 	
 	float displayTextureAspect = (float)GetTexture("displayTexture").GetWidth()/(float)GetTexture("displayTexture").GetHeight();
 	float displayTextureHeightAdditive = displayTextureAspect * GetFloat("fxaaAspectDistortion");
@@ -319,6 +793,407 @@ void RenderingEngine::Render(const Entity& object)
 	m_windowSyncProfileTimer.StopInvocation();
 }
 
+//Matrices worked out from the same values always come out exactly the same.
+static bool IsSameMatrix(const Matrix4f& a, const Matrix4f& b)
+{
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		for(unsigned int j = 0; j < 4; j++)
+		{
+			if(a[i][j] != b[i][j])
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void RenderingEngine::UpdateShadowCaches()
+{
+	//MeshRenderers that have stayed still for long enough become static, and
+	//are drawn into the cached shadow maps from then on.
+	for(unsigned int i = 0; i < m_movingMeshRenderers.size();)
+	{
+		unsigned int meshRenderer = m_movingMeshRenderers[i];
+		m_meshRendererStillFrames[meshRenderer]++;
+		if(m_meshRendererStillFrames[meshRenderer] < FRAMES_UNTIL_STATIC)
+		{
+			i++;
+			continue;
+		}
+
+		m_staticChangeBounds.push_back(m_meshRendererBounds[meshRenderer * 2]);
+		m_staticChangeBounds.push_back(m_meshRendererBounds[meshRenderer * 2 + 1]);
+		m_movingMeshRenderers[i] = m_movingMeshRenderers.back();
+		m_movingMeshRenderers.pop_back();
+	}
+
+	//Any cached shadow map that could see a static caster being added or taken
+	//away has to be drawn again.
+	for(unsigned int i = 0; i < m_shadowCaches.size(); i++)
+	{
+		ShadowCache* cache = &m_shadowCaches[i];
+		if(!cache->isStaticMapValid)
+		{
+			continue;
+		}
+
+		Frustum frustum(cache->viewProjection, false);
+		for(unsigned int j = 0; j < m_staticChangeBounds.size(); j += 2)
+		{
+			if(frustum.ClassifyAABB(m_staticChangeBounds[j], m_staticChangeBounds[j + 1]) != Frustum::OUTSIDE)
+			{
+				cache->isStaticMapValid = false;
+				break;
+			}
+		}
+	}
+
+	m_staticChangeBounds.clear();
+}
+
+bool RenderingEngine::AllocateShadowTiles(ShadowCache* cache, int sizeAsPowerOf2, float importance)
+{
+	//Halving how wide the light is on screen halves how wide its tile is.
+	int minSize = std::min(sizeAsPowerOf2, (int)MIN_SHADOW_TILE_SIZE_AS_POWER_OF_2);
+	if(importance < 1.0f)
+	{
+		sizeAsPowerOf2 += (int)floorf(0.5f * log2f(std::max(importance, 0.000001f)) + 0.5f);
+	}
+	sizeAsPowerOf2 = std::max(std::min(sizeAsPowerOf2, m_shadowAtlas->GetSizeAsPowerOf2() - 1), minSize);
+
+	ShadowAtlas::Tile staticTile;
+	ShadowAtlas::Tile shadowTile;
+	bool hasNewTiles = false;
+	if(cache->hasTiles)
+	{
+		//Tiles only shrink once they're twice as big as they need to be, so
+		//lights near the edge don't keep being drawn again at a new size. When
+		//there's no room to grow, the light keeps the tiles it has.
+		int currentSize = cache->shadowTile.sizeAsPowerOf2;
+		if(sizeAsPowerOf2 == currentSize || sizeAsPowerOf2 == currentSize - 1)
+		{
+			return true;
+		}
+
+		if(sizeAsPowerOf2 > currentSize)
+		{
+			if(!m_shadowAtlas->Allocate(sizeAsPowerOf2, &staticTile))
+			{
+				return true;
+			}
+			if(!m_shadowAtlas->Allocate(sizeAsPowerOf2, &shadowTile))
+			{
+				m_shadowAtlas->Free(staticTile);
+				return true;
+			}
+
+			hasNewTiles = true;
+		}
+
+		FreeShadowTiles(cache);
+	}
+
+	if(!hasNewTiles)
+	{
+		for(; sizeAsPowerOf2 >= minSize; sizeAsPowerOf2--)
+		{
+			if(!m_shadowAtlas->Allocate(sizeAsPowerOf2, &staticTile))
+			{
+				continue;
+			}
+			if(m_shadowAtlas->Allocate(sizeAsPowerOf2, &shadowTile))
+			{
+				break;
+			}
+			m_shadowAtlas->Free(staticTile);
+		}
+
+		if(sizeAsPowerOf2 < minSize)
+		{
+			return false;
+		}
+	}
+
+	cache->staticTile = staticTile;
+	cache->shadowTile = shadowTile;
+	cache->hasTiles = true;
+	cache->isStaticMapValid = false;
+	cache->hasMovingCasters = false;
+	return true;
+}
+
+void RenderingEngine::FreeShadowTiles(ShadowCache* cache)
+{
+	if(cache->hasTiles)
+	{
+		m_shadowAtlas->Free(cache->staticTile);
+		m_shadowAtlas->Free(cache->shadowTile);
+		cache->hasTiles = false;
+		cache->isStaticMapValid = false;
+		cache->hasMovingCasters = false;
+	}
+}
+
+int RenderingEngine::UpdateShadowMaps(unsigned int light, float importance)
+{
+	const ShadowInfo& shadowInfo = m_lights[light]->GetShadowInfo();
+	ShadowCache* caches = &m_shadowCaches[m_firstShadowCaches[light]];
+	int numCascades = shadowInfo.GetNumCascades();
+
+	//Points are never in the cascades that aren't drawn.
+	for(int i = 1; i < ShadowInfo::MAX_CASCADES; i++)
+	{
+		SetFloat(SHADOW_CASCADE_SCALE_NAMES[i], 0.0f);
+		SetVector3f(SHADOW_CASCADE_OFFSET_NAMES[i], Vector3f(-1.0f, -1.0f, -1.0f));
+	}
+
+	//Shaders pick the cascade by how far in front of the camera a point is, and
+	//the last one drawn is used for everything past the ones before it.
+	float cascadeSplits[ShadowInfo::MAX_CASCADES - 1];
+	for(int i = 0; i < ShadowInfo::MAX_CASCADES - 1; i++)
+	{
+		cascadeSplits[i] = std::numeric_limits<float>::max();
+	}
+
+	int numCascadesDrawn = 0;
+	if(shadowInfo.GetShadowMapSizeAsPowerOf2() != 0)
+	{
+		SetFloat("shadowVarianceMin", shadowInfo.GetMinVariance());
+		SetFloat("shadowLightBleedingReduction", shadowInfo.GetLightBleedReductionAmount());
+
+		Matrix4f firstProjection;
+		Vector3f firstPos;
+		for(; numCascadesDrawn < numCascades; numCascadesDrawn++)
+		{
+			ShadowCache* cache = &caches[numCascadesDrawn];
+			if(!AllocateShadowTiles(cache, shadowInfo.GetShadowMapSizeAsPowerOf2(), importance))
+			{
+				break;
+			}
+
+			m_lights[light]->CalcShadowCamera(*m_mainCamera, numCascadesDrawn, cache->shadowTile.sizeAsPowerOf2, &m_altCamera);
+			UpdateShadowMap(cache, shadowInfo);
+
+			Matrix4f lightMatrix = BIAS_MATRIX * m_altCamera.GetViewProjection();
+			Vector3f tileBounds = m_shadowAtlas->GetTileBounds(cache->shadowTile);
+			if(numCascadesDrawn == 0)
+			{
+				m_lightMatrix = lightMatrix;
+				SetVector3f("shadowMapTile", tileBounds);
+				firstProjection = m_altCamera.GetProjection();
+				firstPos = m_altCamera.GetTransform()->GetTransformedPos();
+				continue;
+			}
+
+			//Cascades are the same view of the scene at different scales and
+			//positions, so where a point is in a cascade's shadow map is just a
+			//scaled and moved version of where it is in the first one, whose
+			//center is at 0.5.
+			cascadeSplits[numCascadesDrawn - 1] = m_lights[light]->CalcCascadeFar(*m_mainCamera, numCascadesDrawn - 1);
+			float scale = m_altCamera.GetProjection()[0][0] / firstProjection[0][0];
+			SetFloat(SHADOW_CASCADE_SCALE_NAMES[numCascadesDrawn], scale);
+			SetVector3f(SHADOW_CASCADE_OFFSET_NAMES[numCascadesDrawn], Vector3f(lightMatrix.Transform(firstPos)) - Vector3f(0.5f, 0.5f, 0.5f) * scale);
+			SetVector3f(SHADOW_CASCADE_TILE_NAMES[numCascadesDrawn], tileBounds);
+		}
+
+		if(numCascadesDrawn != 0)
+		{
+			SetTexture("shadowMap", m_shadowAtlas->GetTexture());
+		}
+	}
+
+	SetVector3f("shadowCascadeSplits", Vector3f(cascadeSplits[0], cascadeSplits[1], cascadeSplits[2]));
+
+	//Tiles of cascades that weren't drawn are left for other lights.
+	for(int i = numCascadesDrawn; i < numCascades; i++)
+	{
+		FreeShadowTiles(&caches[i]);
+	}
+
+	return numCascadesDrawn;
+}
+
+void RenderingEngine::UpdateShadowMap(ShadowCache* cache, const ShadowInfo& shadowInfo)
+{
+	Matrix4f viewProjection = m_altCamera.GetViewProjection();
+	Frustum frustum(viewProjection, false);
+	if(!IsSameMatrix(viewProjection, cache->viewProjection))
+	{
+		cache->isStaticMapValid = false;
+	}
+
+	m_shadowCasters.clear();
+	if(m_shadowCaching)
+	{
+		for(unsigned int i = 0; i < m_movingMeshRenderers.size(); i++)
+		{
+			unsigned int meshRenderer = m_movingMeshRenderers[i];
+			if(frustum.ClassifyAABB(m_meshRendererBounds[meshRenderer * 2], m_meshRendererBounds[meshRenderer * 2 + 1]) != Frustum::OUTSIDE)
+			{
+				m_shadowCasters.push_back(meshRenderer);
+			}
+		}
+
+		//Moving casters that have left still need to be erased.
+		if(cache->isStaticMapValid && m_shadowCasters.empty() && !cache->hasMovingCasters)
+		{
+			m_numShadowMapsCached.Add();
+			return;
+		}
+	}
+
+	ProfileZone zone("Shadow Map");
+	bool flipFaces = shadowInfo.GetFlipFaces();
+	if(flipFaces)
+	{
+		glCullFace(GL_FRONT);
+	}
+
+	//Depth is clamped rather than clipped, so objects in front of the
+	//near plane still cast shadows and only the sides of the view can cull.
+	glEnable(GL_DEPTH_CLAMP);
+	UpdateCameraBuffer(m_shadowCameraBuffer, m_altCamera);
+	m_shadowCameraBuffer->Bind();
+
+	const Texture& atlas = m_shadowAtlas->GetTexture();
+	const Texture& shadowMap = m_shadowAtlas->GetTileTarget(cache->shadowTile.sizeAsPowerOf2, 0);
+	int size = 1 << cache->shadowTile.sizeAsPowerOf2;
+
+	//Without caching, everything is static and drawn straight into the
+	//shadow map, every frame.
+	if(!cache->isStaticMapValid || !m_shadowCaching)
+	{
+		if(m_shadowCaching)
+		{
+			atlas.BindAsRenderTarget();
+			m_shadowAtlas->BindTile(cache->staticTile);
+		}
+		else
+		{
+			shadowMap.BindAsRenderTarget();
+		}
+
+		glClearColor(1.0f,1.0f,0.0f,0.0f);
+		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+		m_sceneBounds.FindVisible(frustum, &m_visibleMeshRenderers);
+		unsigned int numStatic = 0;
+		for(unsigned int i = 0; i < m_visibleMeshRenderers.size(); i++)
+		{
+			if(!m_shadowCaching || m_meshRendererStillFrames[m_visibleMeshRenderers[i]] >= FRAMES_UNTIL_STATIC)
+			{
+				m_visibleMeshRenderers[numStatic++] = m_visibleMeshRenderers[i];
+			}
+		}
+		m_visibleMeshRenderers.resize(numStatic);
+
+		RenderShadowCasters(m_shadowMapShader, m_altCamera, m_visibleMeshRenderers);
+		for(unsigned int i = 0; i < m_unculledComponents.size(); i++)
+		{
+			m_unculledComponents[i]->Render(m_shadowMapShader, *this, m_altCamera);
+		}
+
+		glDisable(GL_SCISSOR_TEST);
+		cache->viewProjection = viewProjection;
+		cache->isStaticMapValid = m_shadowCaching;
+	}
+
+	if(m_shadowCaching)
+	{
+		atlas.CopyTo(shadowMap, cache->staticTile.x, cache->staticTile.y, 0, 0, size, size, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		RenderShadowCasters(m_shadowMapShader, m_altCamera, m_shadowCasters);
+		cache->hasMovingCasters = !m_shadowCasters.empty();
+	}
+
+	m_mainCameraBuffer->Bind();
+	glDisable(GL_DEPTH_CLAMP);
+
+	if(flipFaces)
+	{
+		glCullFace(GL_BACK);
+	}
+
+	float shadowSoftness = shadowInfo.GetShadowSoftness();
+	if(shadowSoftness != 0)
+	{
+		BlurShadowMap(cache->shadowTile, shadowSoftness);
+	}
+	else
+	{
+		shadowMap.CopyTo(atlas, 0, 0, cache->shadowTile.x, cache->shadowTile.y, size, size, GL_COLOR_BUFFER_BIT);
+	}
+
+	m_numShadowMapsDrawn.Add();
+}
+
+void RenderingEngine::RenderShadowCasters(const Shader& shader, const Camera& camera, const std::vector<unsigned int>& meshRenderers)
+{
+	Vector3f cameraPos = camera.GetTransform().GetTransformedPos();
+	Vector3f cameraForward = camera.GetTransform().GetTransformedRot().GetForward();
+	for(unsigned int i = 0; i < meshRenderers.size(); i++)
+	{
+		const MeshRenderer& meshRenderer = *m_meshRenderers[meshRenderers[i]];
+		float depth = (meshRenderer.GetTransform().GetTransformedPos() - cameraPos).Dot(cameraForward);
+		m_renderQueue.Add(shader, meshRenderer.GetMaterial(), meshRenderer.GetMesh(), meshRenderer.GetTransform(), depth);
+	}
+	m_renderQueue.Flush(*this, camera);
+
+	m_numMeshesDrawn.Add((unsigned int)meshRenderers.size());
+}
+
+void RenderingEngine::RenderClusteredLights()
+{
+	m_clusterLights.clear();
+	for(unsigned int i = 0; i < m_pointLights.size(); i++)
+	{
+		const PointLight* pointLight = m_pointLights[i];
+		if(pointLight == 0)
+		{
+			continue;
+		}
+
+		LightClusters::Light light;
+		light.position = pointLight->GetTransform().GetTransformedPos();
+		light.range = pointLight->GetRange();
+		light.color = pointLight->GetColor() * pointLight->GetIntensity();
+		light.attenuation = Vector3f(pointLight->GetAttenuation().GetConstant(),
+			pointLight->GetAttenuation().GetLinear(), pointLight->GetAttenuation().GetExponent());
+		m_clusterLights.push_back(light);
+	}
+
+	if(m_clusterLights.empty())
+	{
+		return;
+	}
+
+	ProfileZone zone("Clustered Lights");
+	m_lightClusters.Build(m_clusterLights, m_mainCamera->GetView(), m_mainCamera->GetProjection());
+	m_lightClusters.Upload();
+	m_lightClusters.Bind(GetSamplerSlot("clusterLights"), GetSamplerSlot("clusterGrid"), GetSamplerSlot("clusterLightIndices"));
+
+	const Texture& displayTexture = GetTexture("displayTexture");
+	SetVector3f("clusterTileScale", Vector3f((float)LightClusters::TILES_X / (float)displayTexture.GetWidth(),
+		(float)LightClusters::TILES_Y / (float)displayTexture.GetHeight(), 0.0f));
+	SetFloat("clusterSliceScale", m_lightClusters.GetSliceScale());
+	SetFloat("clusterSliceBias", m_lightClusters.GetSliceBias());
+
+	displayTexture.BindAsRenderTarget();
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_EQUAL);
+
+	RenderVisible(m_clusteredShader, *m_mainCamera, true);
+
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+	glDisable(GL_BLEND);
+}
+
 void RenderingEngine::RenderSkybox()
 {
     m_skyboxShader.Bind();
@@ -326,6 +1201,234 @@ void RenderingEngine::RenderSkybox()
     m_skybox.Draw();
 }
 
+//Identifies environment cache files.
+static const char ENVIRONMENT_CACHE_MAGIC[4] = { 'I', 'B', 'L', 'C' };
+
+void RenderingEngine::PrepareEnvironmentMaps(const std::string& environmentFileName)
+{
+	ProfileZone zone("Prepare Environment Maps");
+	SetTexture("E_environmentCubeMap", m_environmentCubeMap);
+
+	//Working the maps out takes much longer than reading them back, so they're
+	//kept in a file beside the environment until it, or the shaders that work
+	//them out, change.
+	std::vector<CachedImage> images;
+	FindEnvironmentImages(&images);
+	std::string cacheFileName = "./res/textures/" + environmentFileName + ".ibl";
+	unsigned int key = CalcEnvironmentCacheKey(environmentFileName, images);
+	if(LoadEnvironmentMaps(cacheFileName, key, images))
+	{
+		return;
+	}
+
+	//A failed bake leaves the maps empty, which mustn't be cached as if they
+	//were right for this environment.
+	if(!BakeEnvironmentMaps(environmentFileName))
+	{
+		return;
+	}
+
+	if(!SaveEnvironmentMaps(cacheFileName, key, images))
+	{
+		fprintf(stderr, "Unable to write environment cache: %s\n", cacheFileName.c_str());
+	}
+}
+
+unsigned int RenderingEngine::CalcEnvironmentCacheKey(const std::string& environmentFileName, const std::vector<CachedImage>& images) const
+{
+	unsigned int key = Util::CalcFileChecksum("./res/textures/" + environmentFileName);
+
+	unsigned int shaderChecksums[] = { m_environmentShader.GetSourceChecksum(), m_prefilterShader.GetSourceChecksum(),
+		m_brdfShader.GetSourceChecksum() };
+	key = Util::CalcChecksum(shaderChecksums, sizeof(shaderChecksums), key);
+
+	//The two ways of working out the prefilter map don't give exactly the same
+	//result, so switching between them misses the cache too.
+	unsigned int bakeOnCpu = m_bakeEnvironmentOnCpu ? 1 : 0;
+	key = Util::CalcChecksum(&bakeOnCpu, sizeof(bakeOnCpu), key);
+
+	//So resizing any of the maps also misses the cache.
+	for(unsigned int i = 0; i < images.size(); i++)
+	{
+		key = Util::CalcChecksum(&images[i].size, sizeof(images[i].size), key);
+	}
+
+	return key;
+}
+
+void RenderingEngine::FindEnvironmentImages(std::vector<CachedImage>* images) const
+{
+	//Every map is stored as half float RGB, whatever its format. Only the
+	//prefilter map has mip levels, one for each roughness, down to 1x1.
+	const Texture* cubeMaps[] = { &m_environmentCubeMap, &m_prefilterMap };
+	const bool hasMipLevels[] = { false, true };
+	for(unsigned int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(cubeMaps); i++)
+	{
+		for(int mipLevel = 0; mipLevel == 0 || (hasMipLevels[i] && (cubeMaps[i]->GetWidth() >> mipLevel) > 0); mipLevel++)
+		{
+			unsigned int width = (unsigned int)std::max(cubeMaps[i]->GetWidth() >> mipLevel, 1);
+			unsigned int height = (unsigned int)std::max(cubeMaps[i]->GetHeight() >> mipLevel, 1);
+			for(int face = 0; face < 6; face++)
+			{
+				CachedImage image = { cubeMaps[i], (GLenum)(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face), mipLevel, width * height * 3 * 2 };
+				images->push_back(image);
+			}
+		}
+	}
+
+	CachedImage brdfLUT = { &m_brdfLUT, GL_TEXTURE_2D, 0, (unsigned int)(m_brdfLUT.GetWidth() * m_brdfLUT.GetHeight() * 3 * 2) };
+	images->push_back(brdfLUT);
+}
+
+bool RenderingEngine::LoadEnvironmentMaps(const std::string& fileName, unsigned int key, const std::vector<CachedImage>& images)
+{
+	std::ifstream file(fileName.c_str(), std::ios::binary);
+	if(!file.is_open())
+	{
+		return false;
+	}
+
+	char magic[sizeof(ENVIRONMENT_CACHE_MAGIC)];
+	unsigned int version = 0;
+	unsigned int fileKey = 0;
+	file.read(magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&fileKey, sizeof(fileKey));
+	if(!file.good() || memcmp(magic, ENVIRONMENT_CACHE_MAGIC, sizeof(magic)) != 0 ||
+		version != ENVIRONMENT_CACHE_VERSION || fileKey != key)
+	{
+		return false;
+	}
+
+	float irradianceSH[EnvironmentBaker::NUM_SH_COEFFICIENTS * 3];
+	file.read((char*)irradianceSH, sizeof(irradianceSH));
+
+	//Everything is read before anything is uploaded, so a file that was cut
+	//short leaves the maps to be worked out again from scratch.
+	unsigned int totalSize = 0;
+	for(unsigned int i = 0; i < images.size(); i++)
+	{
+		totalSize += images[i].size;
+	}
+
+	std::vector<unsigned char> pixels(totalSize);
+	file.read((char*)&pixels[0], totalSize);
+	if((unsigned int)file.gcount() != totalSize || file.peek() != std::ifstream::traits_type::eof())
+	{
+		return false;
+	}
+
+	unsigned int offset = 0;
+	for(unsigned int i = 0; i < images.size(); i++)
+	{
+		images[i].texture->SetImage(images[i].image, images[i].mipLevel, GL_RGB, GL_HALF_FLOAT, &pixels[offset]);
+		offset += images[i].size;
+	}
+
+	for(int i = 0; i < EnvironmentBaker::NUM_SH_COEFFICIENTS; i++)
+	{
+		SetVector3f(IRRADIANCE_SH_NAMES[i], Vector3f(irradianceSH[i * 3], irradianceSH[i * 3 + 1], irradianceSH[i * 3 + 2]));
+	}
+
+	return true;
+}
+
+bool RenderingEngine::SaveEnvironmentMaps(const std::string& fileName, unsigned int key, const std::vector<CachedImage>& images) const
+{
+	bool complete;
+	{
+		std::ofstream file(Util::GetPartialFileName(fileName).c_str(), std::ios::binary);
+		if(!file)
+		{
+			return false;
+		}
+
+		unsigned int version = ENVIRONMENT_CACHE_VERSION;
+		file.write(ENVIRONMENT_CACHE_MAGIC, sizeof(ENVIRONMENT_CACHE_MAGIC));
+		file.write((const char*)&version, sizeof(version));
+		file.write((const char*)&key, sizeof(key));
+
+		float irradianceSH[EnvironmentBaker::NUM_SH_COEFFICIENTS * 3];
+		for(int i = 0; i < EnvironmentBaker::NUM_SH_COEFFICIENTS; i++)
+		{
+			Vector3f coefficient = GetVector3f(IRRADIANCE_SH_NAMES[i]);
+			irradianceSH[i * 3 + 0] = coefficient.GetX();
+			irradianceSH[i * 3 + 1] = coefficient.GetY();
+			irradianceSH[i * 3 + 2] = coefficient.GetZ();
+		}
+		file.write((const char*)irradianceSH, sizeof(irradianceSH));
+
+		std::vector<unsigned char> pixels;
+		for(unsigned int i = 0; i < images.size(); i++)
+		{
+			pixels.resize(images[i].size);
+			images[i].texture->GetImage(images[i].image, images[i].mipLevel, GL_RGB, GL_HALF_FLOAT, &pixels[0]);
+			file.write((const char*)&pixels[0], pixels.size());
+		}
+
+		complete = file.good();
+	}
+
+	return Util::CommitPartialFile(fileName, complete);
+}
+
+bool RenderingEngine::BakeEnvironmentMaps(const std::string& environmentFileName)
+{
+	std::string path = "./res/textures/" + environmentFileName;
+	int width, height, numComponents;
+	float* pixels = stbi_loadf(path.c_str(), &width, &height, &numComponents, 3);
+	if(!pixels)
+	{
+		fprintf(stderr, "Unable to load environment: %s\n", path.c_str());
+		return false;
+	}
+
+	m_environmentMap = Texture(width, height, pixels, GL_TEXTURE_2D, GL_LINEAR, GL_RGB16F, GL_RGB, GL_FLOAT, false, GL_NONE);
+	SetTexture("E_environmentMap", m_environmentMap);
+
+	ThreadPool threadPool(ThreadPool::GetNumCPUs());
+	EnvironmentBaker baker(pixels, width, height, &threadPool);
+
+	Vector3f irradianceSH[EnvironmentBaker::NUM_SH_COEFFICIENTS];
+	baker.CalcIrradianceSH(irradianceSH);
+	for(int i = 0; i < EnvironmentBaker::NUM_SH_COEFFICIENTS; i++)
+	{
+		SetVector3f(IRRADIANCE_SH_NAMES[i], irradianceSH[i]);
+	}
+
+	PrepareEnvironmentMap();
+	if(m_bakeEnvironmentOnCpu)
+	{
+		BakePrefilterMap(&baker);
+	}
+	else
+	{
+		PreparePrefilterMap();
+	}
+	PrepareBrdfLUT();
+
+	stbi_image_free(pixels);
+	return true;
+}
+
+void RenderingEngine::BakePrefilterMap(EnvironmentBaker* baker)
+{
+	//Every level is filled in, so the ones past the roughest are fully rough
+	//too, rather than left undefined.
+	std::vector<float> pixels;
+	for(int mip = 0; (m_prefilterMap.GetWidth() >> mip) > 0; mip++)
+	{
+		int size = m_prefilterMap.GetWidth() >> mip;
+		float roughness = std::min((float)mip / (float)(NUM_PREFILTER_ROUGHNESS_LEVELS - 1), 1.0f);
+		baker->CalcPrefilteredCubeMap(size, roughness, &pixels);
+
+		for(int face = 0; face < 6; face++)
+		{
+			m_prefilterMap.SetImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGB, GL_FLOAT, &pixels[face * size * size * 3]);
+		}
+	}
+}
+
 void RenderingEngine::PrepareEnvironmentMap()
 {
     Material material("environment");
@@ -341,39 +1444,18 @@ void RenderingEngine::PrepareEnvironmentMap()
     m_window->BindAsRenderTarget();
 }
 
-void RenderingEngine::PrepareIrradianceMap()
-{
-    Material irradiance_material("irradiance");
-
-    m_irradianceMap.BindAsRenderTarget();
-    for(unsigned int i = 0; i < 6; i++)
-    {
-        m_irradianceMap.BindCubeMapUnit(i);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        m_irradianceShader.Bind();
-        m_irradianceShader.UpdateUniforms(m_skyboxTransform, irradiance_material, *this, Camera::GetCubeCamera(i));
-        m_skybox.Draw();
-    }
-    m_window->BindAsRenderTarget();
-}
-
 void RenderingEngine::PreparePrefilterMap()
 {
     Material prefilter_material("prefilter");
 
-    unsigned int maxMipLevels = 5;
-    unsigned int mipWidth = 256;
-    unsigned int mipHeight = 256;
-
     m_prefilterMap.BindAsRenderTarget();
-    for(unsigned int mip = 0; mip < maxMipLevels; ++mip)
+    for(int mip = 0; mip < NUM_PREFILTER_ROUGHNESS_LEVELS; ++mip)
     {
-        mipWidth /= 2;
-        mipHeight /= 2;
-        glRenderbufferStorage(GL_FRAMEBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
+        int mipWidth = std::max(m_prefilterMap.GetWidth() >> mip, 1);
+        int mipHeight = std::max(m_prefilterMap.GetHeight() >> mip, 1);
         glViewport(0, 0, mipWidth, mipHeight);
 
-        float roughness = (float)mip / (float)(maxMipLevels - 1);
+        float roughness = (float)mip / (float)(NUM_PREFILTER_ROUGHNESS_LEVELS - 1);
         prefilter_material.SetFloat("roughness", roughness);
         for(unsigned int i = 0; i < 6; i++)
         {
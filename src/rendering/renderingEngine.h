@@ -23,7 +23,16 @@
 #include "material.h"
 #include "mesh.h"
 #include "window.h"
+#include "boundingVolumeHierarchy.h"
+#include "renderQueue.h"
+#include "uniformBuffer.h"
+#include "lightClusters.h"
+#include "shadowAtlas.h"
+#include "environmentBaker.h"
+#include "occlusionCuller.h"
+#include "potentiallyVisibleSet.h"
 
+#include "../core/asyncLoader.h"
 #include "../core/mappedValues.h"
 #include "../core/profiling.h"
 #include "../3DEngine.h"
@@ -31,51 +40,162 @@
 #include <vector>
 #include <map>
 class Entity;
+class MeshRenderer;
 
 class RenderingEngine : public MappedValues
 {
 public:
-	RenderingEngine(const Window& window);
-	virtual ~RenderingEngine() {}
+	//Environment lighting is worked out on the CPU if bakeEnvironmentOnCpu is
+	//set, or OpenGL is emulated in software, and otherwise by drawing with
+	//shaders, except for the irradiance, which is always cheapest on the CPU.
+	RenderingEngine(const Window& window, bool bakeEnvironmentOnCpu = false);
+	virtual ~RenderingEngine();
 	
-	void Render(const Entity& object);
+	void Render();
 
     void RenderSkybox();
 
     void PrepareEnvironmentMap();
 
-    void PrepareIrradianceMap();
-
     void PreparePrefilterMap();
 
     void PrepareBrdfLUT();
 	
-	inline void AddLight(const BaseLight& light) { m_lights.push_back(&light); }
+	void AddLight(const BaseLight& light);
+	void AddPointLight(const PointLight& light);
 	inline void SetMainCamera(const Camera& camera) { m_mainCamera = &camera; }
+
+	//MeshRenderers are only drawn in passes where they're inside the camera's view.
+	//They have to be removed before they're destroyed.
+	void AddMeshRenderer(const MeshRenderer& meshRenderer);
+	void RemoveMeshRenderer(const MeshRenderer& meshRenderer);
+	//Components drawn in every pass without being culled, such as the debug views
+	//of lights and cameras.
+	inline void AddUnculledComponent(const EntityComponent& component) { m_unculledComponents.push_back(&component); }
+	void RemoveUnculledComponent(const EntityComponent& component);
 	
+	//Moves the bounds of every MeshRenderer whose transform has changed, or whose
+	//mesh has just been streamed in. This needs to be called after every update,
+	//since transforms only report changes made since the last one.
+	void UpdateSceneBounds();
+	
+	//Sets a uniform struct the engine doesn't know about. memberLocations holds
+	//where each of its members is, in alphabetical order of their names, like
+	//"R_foo.bar" before "R_foo.baz".
 	virtual void UpdateUniformStruct(const Transform& transform, const Material& material, const Shader& shader, 
-		const std::string& uniformName, const std::string& uniformType) const
+		const std::string& uniformType, const int* memberLocations) const
 	{
 		throw uniformType + " is not supported by the rendering engine";
 	}
 	
 	inline double DisplayRenderTime(double dividend) { return m_renderProfileTimer.DisplayAndReset("Render Time: ", dividend); }
 	inline double DisplayWindowSyncTime(double dividend) { return m_windowSyncProfileTimer.DisplayAndReset("Window Sync Time: ", dividend); }
+	inline double GetRenderTimeAndReset() { return m_renderProfileTimer.GetTimeAndReset(); }
+	inline double GetWindowSyncTimeAndReset() { return m_windowSyncProfileTimer.GetTimeAndReset(); }
+	void DisplayDrawStats(double dividend);
 	
+	//With clustered shading, every point light is shaded by one pass using the
+	//PBR model, whatever shader it was given, rather than a pass for each light.
+	inline void SetClusteredShading(bool value)                              { m_clusteredShading = value; }
+	inline bool IsClusteredShading()                                   const { return m_clusteredShading; }
+	//With shadow caching, a light's shadow map is only drawn again when the light
+	//or a static mesh in its view changes, and meshes that are moving are drawn
+	//over a copy of it.
+	inline void SetShadowCaching(bool value)                                 { m_shadowCaching = value; }
+	inline bool IsShadowCaching()                                      const { return m_shadowCaching; }
+	//With occlusion culling, MeshRenderers hidden behind occluders from the main
+	//camera, or in parts of the level it can't see, are left out of every pass
+	//it draws. Shadow maps still draw them.
+	inline void SetOcclusionCulling(bool value)                              { m_occlusionCulling = value; }
+	inline bool IsOcclusionCulling()                                   const { return m_occlusionCulling; }
+	//Loads which parts of a level can see which from beside its model, baking
+	//and saving them there first if the model has changed since. The level is
+	//split into cells about cellSize across, and is taken to be drawn where it
+	//is in the file.
+	void LoadPotentiallyVisibleSet(const std::string& levelFileName, float cellSize = 4.0f);
+	//Textures and meshes streamed in through the loader are read on a thread of
+	//its own, and uploaded at the start of every frame, until the streaming
+	//budget in bytes has been used up. Whatever mip level or mesh goes over it
+	//is still finished.
+	inline AsyncLoader* GetAsyncLoader()                                     { return &m_asyncLoader; }
+	inline void SetStreamingBudget(unsigned int bytesPerFrame)               { m_streamingBudget = bytesPerFrame; }
+	//Replaces the atlas every light's shadow map is a tile of, which is 2^sizeAsPowerOf2
+	//texels across. Every shadow map is drawn again in the new one.
+	void SetShadowAtlas(int sizeAsPowerOf2, bool use16BitMoments);
+
 	inline const BaseLight& GetActiveLight()                           const { return *m_activeLight; }
-	inline unsigned int GetSamplerSlot(const std::string& samplerName) const { return m_samplerMap.find(samplerName)->second; }
+	inline unsigned int GetSamplerSlot(const std::string& samplerName) const { return GetSamplerSlot(GetNameId(samplerName)); }
+	inline unsigned int GetSamplerSlot(unsigned int samplerNameId)     const { return m_samplerMap.find(samplerNameId)->second; }
 	inline const Matrix4f& GetLightMatrix()                            const { return m_lightMatrix; }
 protected:
-	inline void SetSamplerSlot(const std::string& name, unsigned int value) { m_samplerMap[name] = value; }
+	inline void SetSamplerSlot(const std::string& name, unsigned int value) { m_samplerMap[GetNameId(name)] = value; }
 
 public:
     bool 							    m_renderCamera;
     bool 								m_renderLight;
 
 private:
-	static const int NUM_SHADOW_MAPS = 10;
+	//Lights that cover less of the screen get smaller tiles of the shadow atlas,
+	//but never smaller than this, unless they asked for one.
+	static const int MIN_SHADOW_TILE_SIZE_AS_POWER_OF_2 = 5;
+	//How many frames a MeshRenderer has to stay still before it's drawn into
+	//cached shadow maps rather than over them.
+	static const unsigned int FRAMES_UNTIL_STATIC = 30;
+	//Enough for a 1024x1024 BC1 texture with its mips each frame.
+	static const unsigned int DEFAULT_STREAMING_BUDGET = 2 * 1024 * 1024;
 	static const Matrix4f BIAS_MATRIX;
 
+	//The file the environment maps are kept in is tagged with this, and ignored
+	//when it's different. Should change whenever the file's layout does.
+	static const unsigned int ENVIRONMENT_CACHE_VERSION = 2;
+	//Mip levels of the prefilter map from a mirror to fully rough. pbr-ambient's
+	//MAX_REFLECTION_LOD is one less.
+	static const int NUM_PREFILTER_ROUGHNESS_LEVELS = 5;
+
+	//One mip level of one image of an environment map, as kept in the cache.
+	struct CachedImage
+	{
+		const Texture* texture;
+		GLenum         image;    //The cube map face, or GL_TEXTURE_2D
+		int            mipLevel;
+		unsigned int   size;     //In bytes
+	};
+
+	//A light's tiles of the shadow atlas, kept from one frame to the next.
+	//Static casters are only drawn into staticTile when something about them
+	//changes, and moving ones are drawn over a copy of it, which is blurred into
+	//shadowTile.
+	struct ShadowCache
+	{
+		ShadowCache();
+
+		ShadowAtlas::Tile staticTile;
+		ShadowAtlas::Tile shadowTile;
+		bool              hasTiles;
+		Matrix4f          viewProjection;   //The light's view of the scene when staticTile was drawn
+		bool              isStaticMapValid;
+		bool              hasMovingCasters; //If shadowTile has moving casters that need erasing when they leave
+	};
+
+	//Where one member of a light's uniform block is set from. These are found
+	//when the light is added, so no names are built to update it every frame.
+	struct LightBlockMember
+	{
+		enum Source
+		{
+			WORLD_LIGHT_MATRIX,
+			DIRECTIONAL_LIGHT,
+			POINT_LIGHT,
+			SPOT_LIGHT,
+			VECTOR3F,
+			FLOAT
+		};
+
+		Source       source;
+		unsigned int nameId;                                           //For VECTOR3F and FLOAT
+		int          offsets[ShaderData::UniformBinding::MAX_MEMBERS]; //Of each member of a light, or just the first for anything else
+	};
+
 	ProfileTimer                        m_renderProfileTimer;
 	ProfileTimer                        m_windowSyncProfileTimer;
 	Transform                           m_planeTransform;
@@ -85,11 +205,10 @@ private:
 	Texture                             m_tempTarget;
 	Material                            m_planeMaterial;
     Material                            m_skyboxMaterial;
-    Texture                             m_environmentMap;
+    Texture                             m_environmentMap;       //Only loaded when the environment cache is out of date
     Texture                             m_environmentCubeMap;
-	Texture                             m_shadowMaps[NUM_SHADOW_MAPS];
-	Texture                             m_shadowMapTempTargets[NUM_SHADOW_MAPS];
-    Texture                             m_irradianceMap;
+	Texture                             m_noShadowMap;          //Bound for lights without shadows
+	ShadowAtlas*                        m_shadowAtlas;
     Texture                             m_prefilterMap;
     Texture                             m_brdfLUT;
 	
@@ -97,7 +216,6 @@ private:
 	Shader                              m_shadowMapShader;
     Shader                              m_environmentShader;
 	Shader								m_skyboxShader;
-    Shader                              m_irradianceShader;
     Shader                              m_prefilterShader;
     Shader                              m_brdfShader;
 	Shader                              m_nullFilter;
@@ -113,10 +231,71 @@ private:
 	const Camera*                       m_mainCamera;
 	const BaseLight*                    m_activeLight;
 	std::vector<const BaseLight*>       m_lights;
-	std::map<std::string, unsigned int> m_samplerMap;
+	std::vector<UniformBuffer*>         m_lightBuffers;         //For each light, or 0 if its shader has no light block
+	std::vector<std::vector<LightBlockMember> > m_lightBlockMembers; //For each light's buffer
+	std::vector<const PointLight*>      m_pointLights;          //For each light, or 0 if it isn't a point light
+	std::vector<ShadowCache>            m_shadowCaches;         //For each cascade of each light
+	std::vector<unsigned int>           m_firstShadowCaches;    //Where each light's cascades start in m_shadowCaches
+	UniformBuffer*                      m_mainCameraBuffer;
+	UniformBuffer*                      m_shadowCameraBuffer;
+	std::map<unsigned int, unsigned int> m_samplerMap;
+
+	BoundingVolumeHierarchy             m_sceneBounds;
+	std::vector<const MeshRenderer*>    m_meshRenderers;
+	std::vector<unsigned int>           m_meshRendererProxies;  //Each MeshRenderer's proxy in m_sceneBounds
+	std::vector<Vector3f>               m_meshRendererBounds;   //Each MeshRenderer's world space min and max extents
+	std::vector<unsigned int>           m_meshRendererStillFrames; //Frames since each MeshRenderer last moved, up to FRAMES_UNTIL_STATIC
+	std::vector<unsigned int>           m_movingMeshRenderers;  //Every MeshRenderer that has moved recently enough to not be static
+	std::vector<Vector3f>               m_staticChangeBounds;   //Min and max extents of static casters added or removed since the last frame
+	std::vector<unsigned int>           m_shadowCasters;        //Reused by shadow passes to avoid reallocating
+	std::vector<unsigned int>           m_visibleMeshRenderers; //Reused by every pass to avoid reallocating
+	std::vector<unsigned int>           m_occluders;            //Every MeshRenderer that's an occluder
+	std::vector<bool>                   m_meshRenderersOccluded; //For each MeshRenderer, whether it's hidden from the main camera this frame
+	std::vector<bool>                   m_meshRenderersStreaming; //For each MeshRenderer, whether its bounds are from before its mesh was streamed in
+	RenderQueue                         m_renderQueue;
+	std::vector<const EntityComponent*> m_unculledComponents;
+	ProfileCounter                      m_numMeshesDrawn;       //Totals across every pass since the stats were last displayed
+	ProfileCounter                      m_numMeshesCulled;
+	ProfileCounter                      m_numMeshesOccluded;    //Included in the meshes culled
+	ProfileCounter                      m_numLightsCulled;      //Lights skipped for not reaching anything on screen
+	ProfileCounter                      m_numShadowMapsDrawn;
+	ProfileCounter                      m_numShadowMapsCached;
+	bool                                m_shadowCaching;
+	OcclusionCuller                     m_occlusionCuller;
+	bool                                m_occlusionCulling;
+	PotentiallyVisibleSet               m_potentiallyVisibleSet; //Empty until a level's is loaded
+	AsyncLoader                         m_asyncLoader;
+	unsigned int                        m_streamingBudget;
+
+	Shader                              m_clusteredShader;
+	LightClusters                       m_lightClusters;
+	std::vector<LightClusters::Light>   m_clusterLights;        //Reused every frame to avoid reallocating
+	bool                                m_clusteredShading;
+	bool                                m_bakeEnvironmentOnCpu;
 	
-	void BlurShadowMap(int shadowMapIndex, float blurAmount);
+	void PrepareEnvironmentMaps(const std::string& environmentFileName);
+	unsigned int CalcEnvironmentCacheKey(const std::string& environmentFileName, const std::vector<CachedImage>& images) const;
+	void FindEnvironmentImages(std::vector<CachedImage>* images) const;
+	bool LoadEnvironmentMaps(const std::string& fileName, unsigned int key, const std::vector<CachedImage>& images);
+	bool SaveEnvironmentMaps(const std::string& fileName, unsigned int key, const std::vector<CachedImage>& images) const;
+	//Returns false, leaving the maps empty, if the environment can't be loaded.
+	bool BakeEnvironmentMaps(const std::string& environmentFileName);
+	void BakePrefilterMap(EnvironmentBaker* baker);
+	void RenderClusteredLights();
+	void UpdateOcclusion();
+	void UpdateShadowCaches();
+	bool AllocateShadowTiles(ShadowCache* cache, int sizeAsPowerOf2, float importance);
+	void FreeShadowTiles(ShadowCache* cache);
+	int UpdateShadowMaps(unsigned int light, float importance);
+	void UpdateShadowMap(ShadowCache* cache, const ShadowInfo& shadowInfo);
+	void RenderShadowCasters(const Shader& shader, const Camera& camera, const std::vector<unsigned int>& meshRenderers);
+	void RenderVisible(const Shader& shader, const Camera& camera, bool includeDepthPlanes);
+	void RenderVisible(const Shader& shader, const Camera& camera, const Frustum& frustum);
+	void CompileLightBlockMembers(const UniformBuffer& lightBuffer, std::vector<LightBlockMember>* result) const;
+	void UpdateLightBuffer(unsigned int light) const;
+	void BlurShadowMap(const ShadowAtlas::Tile& tile, float blurAmount);
 	void ApplyFilter(const Shader& filter, const Texture& source, const Texture* dest);
+	void DrawFilter(const Shader& filter, const Texture& source);
 	
 	RenderingEngine(const RenderingEngine& other) :
 		    m_altCamera(Matrix4f(),0) {}
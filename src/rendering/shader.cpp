@@ -45,11 +45,31 @@ static std::vector<UniformStruct> FindUniformStructs(const std::string& shaderTe
 static std::string FindUniformStructName(const std::string& structStartToOpeningBrace);
 static std::vector<TypedData> FindUniformStructComponents(const std::string& openingBraceToClosingBrace);
 static std::string LoadShader(const std::string& fileName);
+static int FindUniformGroup(const std::string& uniformName);
+static unsigned int RoundUpToMultiple(unsigned int value, unsigned int multiple);
+static int FindUniformLocation(const std::map<std::string, unsigned int>& uniformMap, const std::string& uniformName);
+static void FindMemberLocations(const std::map<std::string, unsigned int>& uniformMap, const std::string& uniformName,
+	const char* const* memberNames, unsigned int numMembers, int* memberLocations);
+static void FindStructMemberLocations(const std::map<std::string, unsigned int>& uniformMap, const std::string& uniformName,
+	int* memberLocations);
+
+//--------------------------------------------------------------------------------
+// Light struct members, in the order Shader and UniformBuffer set them
+//--------------------------------------------------------------------------------
+static const char* const DIRECTIONAL_LIGHT_MEMBERS[] = { ".direction", ".base.color", ".base.intensity" };
+static const char* const POINT_LIGHT_MEMBERS[] = { ".base.color", ".base.intensity", ".atten.constant", ".atten.linear",
+	".atten.exponent", ".position", ".range" };
+static const char* const SPOT_LIGHT_MEMBERS[] = { ".pointLight.base.color", ".pointLight.base.intensity",
+	".pointLight.atten.constant", ".pointLight.atten.linear", ".pointLight.atten.exponent", ".pointLight.position",
+	".pointLight.range", ".direction", ".cutoff" };
+static const unsigned int NUM_DIRECTIONAL_LIGHT_MEMBERS = sizeof(DIRECTIONAL_LIGHT_MEMBERS) / sizeof(DIRECTIONAL_LIGHT_MEMBERS[0]);
+static const unsigned int NUM_POINT_LIGHT_MEMBERS = sizeof(POINT_LIGHT_MEMBERS) / sizeof(POINT_LIGHT_MEMBERS[0]);
+static const unsigned int NUM_SPOT_LIGHT_MEMBERS = sizeof(SPOT_LIGHT_MEMBERS) / sizeof(SPOT_LIGHT_MEMBERS[0]);
 
 //--------------------------------------------------------------------------------
 // Constructors/Destructors
 //--------------------------------------------------------------------------------
-ShaderData::ShaderData(const std::string& fileName)
+ShaderData::ShaderData(const std::string& fileName, const std::string& variant)
 {
 	std::string actualFileName = fileName;
 	#if PROFILING_DISABLE_SHADING != 0
@@ -109,9 +129,13 @@ ShaderData::ShaderData(const std::string& fileName)
 	}
     
 	std::string shaderText = LoadShader(actualFileName + ".glsl");
+	m_hasVariants = shaderText.find("INSTANCED") != std::string::npos;
+	m_hasInstancedVariant = m_hasVariants && variant.empty();
+	m_sourceChecksum = Util::CalcChecksum(shaderText.c_str(), (unsigned int)shaderText.length());
 
-	std::string vertexShaderText = "#version " + s_glslVersion + "\n#define VS_BUILD\n#define GLSL_VERSION " + s_glslVersion + "\n" + shaderText;
-	std::string fragmentShaderText = "#version " + s_glslVersion + "\n#define FS_BUILD\n#define GLSL_VERSION " + s_glslVersion + "\n" + shaderText;
+	std::string variantDefine = variant.empty() ? "" : "#define " + variant + "\n";
+	std::string vertexShaderText = "#version " + s_glslVersion + "\n#define VS_BUILD\n#define GLSL_VERSION " + s_glslVersion + "\n" + variantDefine + shaderText;
+	std::string fragmentShaderText = "#version " + s_glslVersion + "\n#define FS_BUILD\n#define GLSL_VERSION " + s_glslVersion + "\n" + variantDefine + shaderText;
     
     AddVertexShader(vertexShaderText);
 	AddFragmentShader(fragmentShaderText);
@@ -120,8 +144,33 @@ ShaderData::ShaderData(const std::string& fileName)
 	AddAllAttributes(vertexShaderText, attributeKeyword);
 	
 	CompileShader();
+
+	//Attributes that are declared but never read aren't active after linking.
+	m_readsPositionsOnly = glGetAttribLocation(m_program, "texCoord") < 0 && glGetAttribLocation(m_program, "normal") < 0 &&
+		glGetAttribLocation(m_program, "tangent") < 0;
 	
 	AddShaderUniforms(shaderText);
+	m_uniformBindings = CompileUniformBindings(m_uniformNames, m_uniformTypes, m_uniformMap);
+
+	for(unsigned int i = 0; i < m_uniformBlocks.size(); i++)
+	{
+		if(m_uniformBlocks[i].GetBindingPoint() != UniformBlockLayout::MATERIAL_BLOCK)
+			continue;
+
+		//The engine binds the other blocks once per pass, but materials change
+		//between draws.
+		UniformBinding binding;
+		binding.source = UniformBinding::MATERIAL_BLOCK;
+		binding.group = Shader::UNIFORMS_MATERIAL;
+		binding.location = -1;
+		binding.nameId = 0;
+		binding.uniformIndex = i;
+		for(unsigned int j = 0; j < UniformBinding::MAX_MEMBERS; j++)
+		{
+			binding.members[j] = -1;
+		}
+		m_uniformBindings.push_back(binding);
+	}
 }
 
 ShaderData::~ShaderData()
@@ -134,32 +183,30 @@ ShaderData::~ShaderData()
 	glDeleteProgram(m_program);
 }
 
-Shader::Shader(const std::string& fileName)
+Shader::Shader(const std::string& fileName) :
+	m_instancedVariant(0)
 {
-	m_fileName = fileName;
+	Load(fileName, "");
+}
 
-	std::map<std::string, ShaderData*>::const_iterator it = s_resourceMap.find(fileName);
-	if(it != s_resourceMap.end())
-	{
-		m_shaderData = it->second;
-		m_shaderData->AddReference();
-	}
-	else
-	{
-		m_shaderData = new ShaderData(fileName);
-		s_resourceMap.insert(std::pair<std::string, ShaderData*>(fileName, m_shaderData));
-	}
+Shader::Shader(const std::string& fileName, const std::string& variant) :
+	m_instancedVariant(0)
+{
+	Load(fileName, variant);
 }
 
 Shader::Shader(const Shader& other) :
 	m_shaderData(other.m_shaderData),
-	m_fileName(other.m_fileName)
+	m_fileName(other.m_fileName),
+	m_instancedVariant(0)
 {
 	m_shaderData->AddReference();
 }
 
 Shader::~Shader()
 {
+	delete m_instancedVariant;
+
 	if(m_shaderData && m_shaderData->RemoveReference())
 	{
 		if(m_fileName.length() > 0)
@@ -169,150 +216,334 @@ Shader::~Shader()
 	}
 }
 
+void Shader::Load(const std::string& fileName, const std::string& variant)
+{
+	//Each variant is a separate program, so it's stored separately too.
+	m_fileName = variant.empty() ? fileName : fileName + ":" + variant;
+
+	std::map<std::string, ShaderData*>::const_iterator it = s_resourceMap.find(m_fileName);
+	if(it != s_resourceMap.end())
+	{
+		m_shaderData = it->second;
+		m_shaderData->AddReference();
+	}
+	else
+	{
+		m_shaderData = new ShaderData(fileName, variant);
+		s_resourceMap.insert(std::pair<std::string, ShaderData*>(m_fileName, m_shaderData));
+	}
+}
+
 //--------------------------------------------------------------------------------
 // Member Function Implementation
 //--------------------------------------------------------------------------------
+const Shader& Shader::GetInstancedVariant() const
+{
+	assert(HasInstancedVariant());
+
+	if(m_instancedVariant == 0)
+	{
+		m_instancedVariant = new Shader(m_fileName, "INSTANCED");
+	}
+
+	return *m_instancedVariant;
+}
+
+const UniformBlockLayout* Shader::GetUniformBlock(const std::string& blockName) const
+{
+	const std::vector<UniformBlockLayout>& blocks = m_shaderData->GetUniformBlocks();
+	for(unsigned int i = 0; i < blocks.size(); i++)
+	{
+		if(blocks[i].GetName() == blockName)
+		{
+			return &blocks[i];
+		}
+	}
+
+	return 0;
+}
+
 void Shader::Bind() const
 {
 	glUseProgram(m_shaderData->GetProgram());
 }
 
-void Shader::UpdateUniforms(const Transform& transform, const Material& material, const RenderingEngine& renderingEngine, const Camera& camera) const
+void Shader::UpdateUniforms(const Transform& transform, const Material& material, const RenderingEngine& renderingEngine, const Camera& camera,
+	int uniformGroups) const
 {
-	Matrix4f worldMatrix = transform.GetTransformation();
-	Matrix4f projectedMatrix = camera.GetViewProjection() * worldMatrix;
+	Matrix4f worldMatrix;
+	Matrix4f projectedMatrix;
+	if(uniformGroups & UNIFORMS_OBJECT)
+	{
+		worldMatrix = transform.GetTransformation();
+		projectedMatrix = camera.GetViewProjection() * worldMatrix;
+	}
 	
-	for(unsigned int i = 0; i < m_shaderData->GetUniformNames().size(); i++)
+	const std::vector<ShaderData::UniformBinding>& bindings = m_shaderData->GetUniformBindings();
+	for(unsigned int i = 0; i < bindings.size(); i++)
+	{
+		const ShaderData::UniformBinding& binding = bindings[i];
+
+		if(!(uniformGroups & binding.group))
+		{
+			continue;
+		}
+
+		switch(binding.source)
+		{
+			case ShaderData::UniformBinding::ENGINE_TEXTURE:
+			{
+				unsigned int samplerSlot = renderingEngine.GetSamplerSlot(binding.nameId);
+				renderingEngine.GetTexture(binding.nameId).Bind(samplerSlot);
+				glUniform1i(binding.location, samplerSlot);
+				break;
+			}
+			case ShaderData::UniformBinding::ENGINE_SAMPLER_SLOT:
+				glUniform1i(binding.location, renderingEngine.GetSamplerSlot(binding.nameId));
+				break;
+			case ShaderData::UniformBinding::ENGINE_VECTOR3F:
+				SetUniformVector3f(binding.location, renderingEngine.GetVector3f(binding.nameId));
+				break;
+			case ShaderData::UniformBinding::ENGINE_FLOAT:
+				glUniform1f(binding.location, renderingEngine.GetFloat(binding.nameId));
+				break;
+			case ShaderData::UniformBinding::ENGINE_STRUCT:
+				renderingEngine.UpdateUniformStruct(transform, material, *this, 
+					m_shaderData->GetUniformTypes()[binding.uniformIndex], binding.members);
+				break;
+			case ShaderData::UniformBinding::LIGHT_MATRIX:
+				SetUniformMatrix4f(binding.location, renderingEngine.GetLightMatrix() * worldMatrix);
+				break;
+			case ShaderData::UniformBinding::WORLD_LIGHT_MATRIX:
+				SetUniformMatrix4f(binding.location, renderingEngine.GetLightMatrix());
+				break;
+			case ShaderData::UniformBinding::DIRECTIONAL_LIGHT:
+				SetUniformDirectionalLight(binding.members, *(const DirectionalLight*)&renderingEngine.GetActiveLight());
+				break;
+			case ShaderData::UniformBinding::POINT_LIGHT:
+				SetUniformPointLight(binding.members, *(const PointLight*)&renderingEngine.GetActiveLight());
+				break;
+			case ShaderData::UniformBinding::SPOT_LIGHT:
+				SetUniformSpotLight(binding.members, *(const SpotLight*)&renderingEngine.GetActiveLight());
+				break;
+			case ShaderData::UniformBinding::MATERIAL_TEXTURE:
+			{
+				unsigned int samplerSlot = renderingEngine.GetSamplerSlot(binding.nameId);
+				material.GetTexture(binding.nameId).Bind(samplerSlot);
+				glUniform1i(binding.location, samplerSlot);
+				break;
+			}
+			case ShaderData::UniformBinding::MATERIAL_VECTOR3F:
+				SetUniformVector3f(binding.location, material.GetVector3f(binding.nameId));
+				break;
+			case ShaderData::UniformBinding::MATERIAL_FLOAT:
+				glUniform1f(binding.location, material.GetFloat(binding.nameId));
+				break;
+			case ShaderData::UniformBinding::MVP:
+				SetUniformMatrix4f(binding.location, projectedMatrix);
+				break;
+			case ShaderData::UniformBinding::MODEL:
+				SetUniformMatrix4f(binding.location, worldMatrix);
+				break;
+			case ShaderData::UniformBinding::VIEW_PROJECTION:
+				SetUniformMatrix4f(binding.location, camera.GetViewProjection());
+				break;
+			case ShaderData::UniformBinding::PROJECTION:
+				SetUniformMatrix4f(binding.location, camera.GetProjection());
+				break;
+			case ShaderData::UniformBinding::CAMERA_ROTATION:
+				SetUniformMatrix4f(binding.location, camera.GetCameraRotation());
+				break;
+			case ShaderData::UniformBinding::VIEW:
+				SetUniformMatrix4f(binding.location, camera.GetView());
+				break;
+			case ShaderData::UniformBinding::EYE_POS:
+				SetUniformVector3f(binding.location, camera.GetTransform().GetTransformedPos());
+				break;
+			case ShaderData::UniformBinding::MATERIAL_BLOCK:
+				material.BindUniformBuffer(m_shaderData->GetUniformBlocks()[binding.uniformIndex]);
+				break;
+		}
+	}
+}
+
+void Shader::SetUniformi(const std::string& uniformName, int value) const
+{
+	glUniform1i(m_shaderData->GetUniformMap().at(uniformName), value);
+}
+
+void Shader::SetUniformf(const std::string& uniformName, float value) const
+{
+	glUniform1f(m_shaderData->GetUniformMap().at(uniformName), value);
+}
+
+void Shader::SetUniformVector3f(const std::string& uniformName, const Vector3f& value) const
+{
+	SetUniformVector3f(m_shaderData->GetUniformMap().at(uniformName), value);
+}
+
+void Shader::SetUniformMatrix4f(const std::string& uniformName, const Matrix4f& value) const
+{
+	SetUniformMatrix4f(m_shaderData->GetUniformMap().at(uniformName), value);
+}
+
+void Shader::SetUniformVector3f(int location, const Vector3f& value)
+{
+	glUniform3f(location, value.GetX(), value.GetY(), value.GetZ());
+}
+
+void Shader::SetUniformMatrix4f(int location, const Matrix4f& value)
+{
+	glUniformMatrix4fv(location, 1, GL_FALSE, &(value[0][0]));
+}
+
+void Shader::SetUniformDirectionalLight(const int* memberLocations, const DirectionalLight& directionalLight)
+{
+	SetUniformVector3f(memberLocations[0], directionalLight.GetTransform().GetTransformedRot().GetForward());
+	SetUniformVector3f(memberLocations[1], directionalLight.GetColor());
+	glUniform1f(memberLocations[2], directionalLight.GetIntensity());
+}
+
+void Shader::SetUniformPointLight(const int* memberLocations, const PointLight& pointLight)
+{
+	SetUniformVector3f(memberLocations[0], pointLight.GetColor());
+	glUniform1f(memberLocations[1], pointLight.GetIntensity());
+	glUniform1f(memberLocations[2], pointLight.GetAttenuation().GetConstant());
+	glUniform1f(memberLocations[3], pointLight.GetAttenuation().GetLinear());
+	glUniform1f(memberLocations[4], pointLight.GetAttenuation().GetExponent());
+	SetUniformVector3f(memberLocations[5], pointLight.GetTransform().GetTransformedPos());
+	glUniform1f(memberLocations[6], pointLight.GetRange());
+}
+
+void Shader::SetUniformSpotLight(const int* memberLocations, const SpotLight& spotLight)
+{
+	SetUniformPointLight(memberLocations, spotLight);
+	SetUniformVector3f(memberLocations[7], spotLight.GetTransform().GetTransformedRot().GetForward());
+	glUniform1f(memberLocations[8], spotLight.GetCutoff());
+}
+
+std::vector<ShaderData::UniformBinding> ShaderData::CompileUniformBindings(const std::vector<std::string>& uniformNames,
+	const std::vector<std::string>& uniformTypes, const std::map<std::string, unsigned int>& uniformMap)
+{
+	std::vector<UniformBinding> result;
+
+	for(unsigned int i = 0; i < uniformNames.size(); i++)
 	{
-		std::string uniformName = m_shaderData->GetUniformNames()[i];
-		std::string uniformType = m_shaderData->GetUniformTypes()[i];
+		const std::string& uniformName = uniformNames[i];
+		const std::string& uniformType = uniformTypes[i];
+		std::string prefix = uniformName.substr(0, 2);
+
+		UniformBinding binding;
+		binding.group = FindUniformGroup(uniformName);
+		binding.location = FindUniformLocation(uniformMap, uniformName);
+		binding.nameId = MappedValues::GetNameId(uniformName);
+		binding.uniformIndex = i;
+		for(unsigned int j = 0; j < UniformBinding::MAX_MEMBERS; j++)
+		{
+			binding.members[j] = -1;
+		}
 		
-		if(uniformName.substr(0, 2) == "R_")
+		if(prefix == "R_")
 		{
 			std::string unprefixedName = uniformName.substr(2, uniformName.length());
+			binding.nameId = MappedValues::GetNameId(unprefixedName);
 			
 			if(unprefixedName == "lightMatrix")
-				SetUniformMatrix4f(uniformName, renderingEngine.GetLightMatrix() * worldMatrix);
+				binding.source = UniformBinding::LIGHT_MATRIX;
+			else if(unprefixedName == "worldLightMatrix")
+				binding.source = UniformBinding::WORLD_LIGHT_MATRIX;
 			else if(uniformType == "sampler2D")
-			{
-				int samplerSlot = renderingEngine.GetSamplerSlot(unprefixedName);
-				renderingEngine.GetTexture(unprefixedName).Bind(samplerSlot);
-				SetUniformi(uniformName, samplerSlot);
-			}
+				binding.source = UniformBinding::ENGINE_TEXTURE;
+			else if(uniformType == "samplerBuffer" || uniformType == "usamplerBuffer")
+				binding.source = UniformBinding::ENGINE_SAMPLER_SLOT;
 			else if(uniformType == "vec3")
-				SetUniformVector3f(uniformName, renderingEngine.GetVector3f(unprefixedName));
+				binding.source = UniformBinding::ENGINE_VECTOR3F;
 			else if(uniformType == "float")
-				SetUniformf(uniformName, renderingEngine.GetFloat(unprefixedName));
+				binding.source = UniformBinding::ENGINE_FLOAT;
 			else if(uniformType == "DirectionalLight")
-				SetUniformDirectionalLight(uniformName, *(const DirectionalLight*)&renderingEngine.GetActiveLight());
+			{
+				binding.source = UniformBinding::DIRECTIONAL_LIGHT;
+				FindMemberLocations(uniformMap, uniformName, DIRECTIONAL_LIGHT_MEMBERS, NUM_DIRECTIONAL_LIGHT_MEMBERS, binding.members);
+			}
 			else if(uniformType == "PointLight")
-				SetUniformPointLight(uniformName, *(const PointLight*)&renderingEngine.GetActiveLight());
+			{
+				binding.source = UniformBinding::POINT_LIGHT;
+				FindMemberLocations(uniformMap, uniformName, POINT_LIGHT_MEMBERS, NUM_POINT_LIGHT_MEMBERS, binding.members);
+			}
 			else if(uniformType == "SpotLight")
-				SetUniformSpotLight(uniformName, *(const SpotLight*)&renderingEngine.GetActiveLight());
+			{
+				binding.source = UniformBinding::SPOT_LIGHT;
+				FindMemberLocations(uniformMap, uniformName, SPOT_LIGHT_MEMBERS, NUM_SPOT_LIGHT_MEMBERS, binding.members);
+			}
 			else
-				renderingEngine.UpdateUniformStruct(transform, material, *this, uniformName, uniformType);
-		}
-		else if(uniformName.substr(0, 2) == "E_")
-		{
-			int samplerSlot = renderingEngine.GetSamplerSlot(uniformName);
-            renderingEngine.GetTexture(uniformName).Bind(samplerSlot);
-            SetUniformi(uniformName, samplerSlot);
-		}
-		else if(uniformType == "sampler2D")
-		{
-			int samplerSlot = renderingEngine.GetSamplerSlot(uniformName);
-			material.GetTexture(uniformName).Bind(samplerSlot);
-			SetUniformi(uniformName, samplerSlot);
-		}
-		else if(uniformType == "samplerCube")
-		{
-			int samplerSlot = renderingEngine.GetSamplerSlot(uniformName);
-			material.GetTexture(uniformName).Bind(samplerSlot);
-			SetUniformi(uniformName, samplerSlot);
+			{
+				binding.source = UniformBinding::ENGINE_STRUCT;
+				FindStructMemberLocations(uniformMap, uniformName, binding.members);
+			}
 		}
-		else if(uniformName.substr(0, 2) == "T_")
+		else if(prefix == "E_")
+			binding.source = UniformBinding::ENGINE_TEXTURE;
+		else if(uniformType == "sampler2D" || uniformType == "samplerCube")
+			binding.source = UniformBinding::MATERIAL_TEXTURE;
+		else if(prefix == "T_")
 		{
 			if(uniformName == "T_MVP")
-				SetUniformMatrix4f(uniformName, projectedMatrix);
+				binding.source = UniformBinding::MVP;
 			else if(uniformName == "T_model")
-				SetUniformMatrix4f(uniformName, worldMatrix);
+				binding.source = UniformBinding::MODEL;
+			else if(uniformName == "T_viewProjection")
+				binding.source = UniformBinding::VIEW_PROJECTION;
 			else if(uniformName == "T_projection")
-				SetUniformMatrix4f(uniformName, camera.GetProjection());
+				binding.source = UniformBinding::PROJECTION;
 			else if(uniformName == "T_cameraRot")
-				SetUniformMatrix4f(uniformName, camera.GetCameraRotation());
+				binding.source = UniformBinding::CAMERA_ROTATION;
 			else if(uniformName == "T_view")
-				SetUniformMatrix4f(uniformName, camera.GetView());
+				binding.source = UniformBinding::VIEW;
 			else
 				throw "Invalid Transform Uniform: " + uniformName;
 		}
-		else if(uniformName.substr(0, 2) == "C_")
+		else if(prefix == "C_")
 		{
 			if(uniformName == "C_eyePos")
-				SetUniformVector3f(uniformName, camera.GetTransform().GetTransformedPos());
+				binding.source = UniformBinding::EYE_POS;
 			else
 				throw "Invalid Camera Uniform: " + uniformName;
 		}
 		else
 		{
 			if(uniformType == "vec3")
-				SetUniformVector3f(uniformName, material.GetVector3f(uniformName));
+				binding.source = UniformBinding::MATERIAL_VECTOR3F;
 			else if(uniformType == "float")
-				SetUniformf(uniformName, material.GetFloat(uniformName));
+				binding.source = UniformBinding::MATERIAL_FLOAT;
 			else
 				throw uniformType + " is not supported by the Material class";
 		}
-	}
-}
-
-void Shader::SetUniformi(const std::string& uniformName, int value) const
-{
-	glUniform1i(m_shaderData->GetUniformMap().at(uniformName), value);
-}
-
-void Shader::SetUniformf(const std::string& uniformName, float value) const
-{
-	glUniform1f(m_shaderData->GetUniformMap().at(uniformName), value);
-}
-
-void Shader::SetUniformVector3f(const std::string& uniformName, const Vector3f& value) const
-{
-	glUniform3f(m_shaderData->GetUniformMap().at(uniformName), value.GetX(), value.GetY(), value.GetZ());
-}
 
-void Shader::SetUniformMatrix4f(const std::string& uniformName, const Matrix4f& value) const
-{
-	glUniformMatrix4fv(m_shaderData->GetUniformMap().at(uniformName), 1, GL_FALSE, &(value[0][0]));
-}
+		result.push_back(binding);
+	}
 
-void Shader::SetUniformDirectionalLight(const std::string& uniformName, const DirectionalLight& directionalLight) const
-{
-	SetUniformVector3f(uniformName + ".direction", directionalLight.GetTransform().GetTransformedRot().GetForward());
-	SetUniformVector3f(uniformName + ".base.color", directionalLight.GetColor());
-	SetUniformf(uniformName + ".base.intensity", directionalLight.GetIntensity());
+	return result;
 }
 
-void Shader::SetUniformPointLight(const std::string& uniformName, const PointLight& pointLight) const
+unsigned int ShaderData::FindLightMembers(const std::string& lightType, const char* const** memberNames)
 {
-	SetUniformVector3f(uniformName + ".base.color", pointLight.GetColor());
-	SetUniformf(uniformName + ".base.intensity", pointLight.GetIntensity());
-	SetUniformf(uniformName + ".atten.constant", pointLight.GetAttenuation().GetConstant());
-	SetUniformf(uniformName + ".atten.linear", pointLight.GetAttenuation().GetLinear());
-	SetUniformf(uniformName + ".atten.exponent", pointLight.GetAttenuation().GetExponent());
-	SetUniformVector3f(uniformName + ".position", pointLight.GetTransform().GetTransformedPos());
-	SetUniformf(uniformName + ".range", pointLight.GetRange());
-}
+	if(lightType == "DirectionalLight")
+	{
+		*memberNames = DIRECTIONAL_LIGHT_MEMBERS;
+		return NUM_DIRECTIONAL_LIGHT_MEMBERS;
+	}
+	else if(lightType == "PointLight")
+	{
+		*memberNames = POINT_LIGHT_MEMBERS;
+		return NUM_POINT_LIGHT_MEMBERS;
+	}
+	else if(lightType == "SpotLight")
+	{
+		*memberNames = SPOT_LIGHT_MEMBERS;
+		return NUM_SPOT_LIGHT_MEMBERS;
+	}
 
-void Shader::SetUniformSpotLight(const std::string& uniformName, const SpotLight& spotLight) const
-{
-	SetUniformVector3f(uniformName + ".pointLight.base.color", spotLight.GetColor());
-	SetUniformf(uniformName + ".pointLight.base.intensity", spotLight.GetIntensity());
-	SetUniformf(uniformName + ".pointLight.atten.constant", spotLight.GetAttenuation().GetConstant());
-	SetUniformf(uniformName + ".pointLight.atten.linear", spotLight.GetAttenuation().GetLinear());
-	SetUniformf(uniformName + ".pointLight.atten.exponent", spotLight.GetAttenuation().GetExponent());
-	SetUniformVector3f(uniformName + ".pointLight.position", spotLight.GetTransform().GetTransformedPos());
-	SetUniformf(uniformName + ".pointLight.range", spotLight.GetRange());
-	SetUniformVector3f(uniformName + ".direction", spotLight.GetTransform().GetTransformedRot().GetForward());
-	SetUniformf(uniformName + ".cutoff", spotLight.GetCutoff());
+	return 0;
 }
 
 void ShaderData::AddVertexShader(const std::string& text)
@@ -409,6 +640,7 @@ void ShaderData::AddShaderUniforms(const std::string& shaderText)
 	{
 		bool isCommented = false;
 		size_t lastLineEnd = shaderText.rfind("\n", uniformLocation);
+		size_t nextSearchLocation = uniformLocation + UNIFORM_KEY.length();
 		
 		if(lastLineEnd != std::string::npos)
 		{
@@ -422,22 +654,59 @@ void ShaderData::AddShaderUniforms(const std::string& shaderText)
 			size_t end = shaderText.find(";", begin);
 			
 			std::string uniformLine = shaderText.substr(begin + 1, end-begin - 1);
-			
-			begin = uniformLine.find(" ");
-			std::string uniformName = uniformLine.substr(begin + 1);
-			std::string uniformType = uniformLine.substr(0, begin);
-			
-			m_uniformNames.push_back(uniformName);
-			m_uniformTypes.push_back(uniformType);
-			AddUniform(uniformName, uniformType, structs);
+			size_t braceOpening = uniformLine.find("{");
+
+			if(braceOpening != std::string::npos)
+			{
+				//A uniform block, whose members are read from a buffer rather
+				//than set one at a time.
+				braceOpening += begin + 1;
+				size_t braceClosing = shaderText.find("}", braceOpening);
+
+				AddUniformBlock(UniformBlockLayout(
+					FindUniformStructName(shaderText.substr(begin + 1, braceOpening - begin - 1)),
+					FindUniformStructComponents(shaderText.substr(braceOpening, braceClosing - braceOpening)),
+					structs));
+
+				nextSearchLocation = braceClosing;
+			}
+			else
+			{
+				begin = uniformLine.find(" ");
+				std::string uniformName = uniformLine.substr(begin + 1);
+				std::string uniformType = uniformLine.substr(0, begin);
+				
+				if(AddUniform(uniformName, uniformType, structs))
+				{
+					m_uniformNames.push_back(uniformName);
+					m_uniformTypes.push_back(uniformType);
+				}
+			}
 		}
-		uniformLocation = shaderText.find(UNIFORM_KEY, uniformLocation + UNIFORM_KEY.length());
+		uniformLocation = shaderText.find(UNIFORM_KEY, nextSearchLocation);
 	}
 }
 
-void ShaderData::AddUniform(const std::string& uniformName, const std::string& uniformType, const std::vector<UniformStruct>& structs)
+void ShaderData::AddUniformBlock(const UniformBlockLayout& layout)
+{
+	unsigned int blockIndex = glGetUniformBlockIndex(m_program, layout.GetName().c_str());
+
+	//Blocks that are declared but never read are compiled out.
+	if(blockIndex == GL_INVALID_INDEX)
+		return;
+
+	GLint dataSize = 0;
+	glGetActiveUniformBlockiv(m_program, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+	assert((unsigned int)dataSize <= layout.GetSize());
+
+	glUniformBlockBinding(m_program, blockIndex, layout.GetBindingPoint());
+	m_uniformBlocks.push_back(layout);
+}
+
+bool ShaderData::AddUniform(const std::string& uniformName, const std::string& uniformType, const std::vector<UniformStruct>& structs)
 {
 	bool addThis = true;
+	bool foundMember = false;
 
 	for(unsigned int i = 0; i < structs.size(); i++)
 	{
@@ -446,19 +715,28 @@ void ShaderData::AddUniform(const std::string& uniformName, const std::string& u
 			addThis = false;
 			for(unsigned int j = 0; j < structs[i].GetMemberNames().size(); j++)
 			{
-				AddUniform(uniformName + "." + structs[i].GetMemberNames()[j].GetName(), structs[i].GetMemberNames()[j].GetType(), structs);
+				if(AddUniform(uniformName + "." + structs[i].GetMemberNames()[j].GetName(), structs[i].GetMemberNames()[j].GetType(), structs))
+				{
+					foundMember = true;
+				}
 			}
 		}
 	}
 
 	if(!addThis)
-		return;
+		return foundMember;
 
 	unsigned int location = glGetUniformLocation(m_program, uniformName.c_str());
 
+	//Files with variants declare the uniforms of every variant, and the ones
+	//for other variants have been compiled out.
+	if(location == INVALID_VALUE && m_hasVariants)
+		return false;
+
 	assert(location != INVALID_VALUE);
 
 	m_uniformMap.insert(std::pair<std::string, unsigned int>(uniformName, location));
+	return true;
 }
 
 void ShaderData::CompileShader() const
@@ -470,6 +748,104 @@ void ShaderData::CompileShader() const
 	CheckShaderError(m_program, GL_VALIDATE_STATUS, true, "Invalid shader program");
 }
 
+UniformBlockLayout::UniformBlockLayout(const std::string& name, const std::vector<TypedData>& members, const std::vector<UniformStruct>& structs) :
+	m_name(name),
+	m_members(members),
+	m_size(0)
+{
+	if(name == "CameraBlock")
+		m_bindingPoint = CAMERA_BLOCK;
+	else if(name == "LightBlock")
+		m_bindingPoint = LIGHT_BLOCK;
+	else if(name == "MaterialBlock")
+		m_bindingPoint = MATERIAL_BLOCK;
+	else
+		throw "Unknown Uniform Block: " + name;
+
+	for(unsigned int i = 0; i < members.size(); i++)
+	{
+		AddMember(members[i].GetName(), members[i].GetType(), structs, &m_size);
+	}
+	m_size = RoundUpToMultiple(m_size, 16);
+
+	std::ostringstream signature;
+	signature << m_name;
+	for(std::map<std::string, unsigned int>::const_iterator it = m_offsets.begin(); it != m_offsets.end(); ++it)
+	{
+		signature << " " << it->first << "@" << it->second;
+	}
+	m_id = MappedValues::GetNameId(signature.str());
+}
+
+int UniformBlockLayout::GetOffset(const std::string& memberName) const
+{
+	std::map<std::string, unsigned int>::const_iterator it = m_offsets.find(memberName);
+	if(it != m_offsets.end())
+	{
+		return it->second;
+	}
+
+	return -1;
+}
+
+void UniformBlockLayout::AddMember(const std::string& memberName, const std::string& memberType, const std::vector<UniformStruct>& structs, unsigned int* offset)
+{
+	for(unsigned int i = 0; i < structs.size(); i++)
+	{
+		if(structs[i].GetName() == memberType)
+		{
+			//Structs start and end on a vec4 boundary.
+			*offset = RoundUpToMultiple(*offset, 16);
+			for(unsigned int j = 0; j < structs[i].GetMemberNames().size(); j++)
+			{
+				AddMember(memberName + "." + structs[i].GetMemberNames()[j].GetName(), structs[i].GetMemberNames()[j].GetType(), structs, offset);
+			}
+			*offset = RoundUpToMultiple(*offset, 16);
+			return;
+		}
+	}
+
+	unsigned int alignment;
+	unsigned int size;
+	if(memberType == "float" || memberType == "int" || memberType == "uint" || memberType == "bool")
+	{
+		alignment = 4;
+		size = 4;
+	}
+	else if(memberType == "vec2")
+	{
+		alignment = 8;
+		size = 8;
+	}
+	else if(memberType == "vec3")
+	{
+		alignment = 16;
+		size = 12;
+	}
+	else if(memberType == "vec4")
+	{
+		alignment = 16;
+		size = 16;
+	}
+	else if(memberType == "mat3")
+	{
+		//Stored as three vec4 columns.
+		alignment = 16;
+		size = 48;
+	}
+	else if(memberType == "mat4")
+	{
+		alignment = 16;
+		size = 64;
+	}
+	else
+		throw memberType + " is not supported in uniform blocks";
+
+	*offset = RoundUpToMultiple(*offset, alignment);
+	m_offsets.insert(std::pair<std::string, unsigned int>(memberName, *offset));
+	*offset += size;
+}
+
 //--------------------------------------------------------------------------------
 // Static Function Implementations
 //--------------------------------------------------------------------------------
@@ -528,6 +904,67 @@ static std::string LoadShader(const std::string& fileName)
 	return output;
 };
 
+static unsigned int RoundUpToMultiple(unsigned int value, unsigned int multiple)
+{
+	return (value + multiple - 1) / multiple * multiple;
+}
+
+static int FindUniformGroup(const std::string& uniformName)
+{
+	if(uniformName == "T_MVP" || uniformName == "T_model" || uniformName == "R_lightMatrix")
+	{
+		return Shader::UNIFORMS_OBJECT;
+	}
+
+	std::string prefix = uniformName.substr(0, 2);
+	if(prefix == "R_" || prefix == "E_" || prefix == "T_" || prefix == "C_")
+	{
+		return Shader::UNIFORMS_PASS;
+	}
+
+	return Shader::UNIFORMS_MATERIAL;
+}
+
+static int FindUniformLocation(const std::map<std::string, unsigned int>& uniformMap, const std::string& uniformName)
+{
+	std::map<std::string, unsigned int>::const_iterator it = uniformMap.find(uniformName);
+	if(it != uniformMap.end())
+	{
+		return it->second;
+	}
+
+	//Setting location -1 is silently ignored by OpenGL.
+	return -1;
+}
+
+static void FindMemberLocations(const std::map<std::string, unsigned int>& uniformMap, const std::string& uniformName,
+	const char* const* memberNames, unsigned int numMembers, int* memberLocations)
+{
+	for(unsigned int i = 0; i < numMembers; i++)
+	{
+		memberLocations[i] = FindUniformLocation(uniformMap, uniformName + memberNames[i]);
+	}
+}
+
+static void FindStructMemberLocations(const std::map<std::string, unsigned int>& uniformMap, const std::string& uniformName,
+	int* memberLocations)
+{
+	std::string prefix = uniformName + ".";
+	unsigned int numMembers = 0;
+
+	//The map is sorted by name, so the members are found in alphabetical order.
+	for(std::map<std::string, unsigned int>::const_iterator it = uniformMap.lower_bound(prefix); 
+		it != uniformMap.end() && it->first.compare(0, prefix.length(), prefix) == 0; ++it)
+	{
+		if(numMembers == ShaderData::UniformBinding::MAX_MEMBERS)
+		{
+			throw uniformName + " has too many members to be set by the rendering engine";
+		}
+		
+		memberLocations[numMembers++] = it->second;
+	}
+}
+
 static std::vector<TypedData> FindUniformStructComponents(const std::string& openingBraceToClosingBrace)
 {
 	static const char charsToIgnore[] = {' ', '\n', '\t', '{'};
@@ -606,3 +1043,173 @@ static std::vector<UniformStruct> FindUniformStructs(const std::string& shaderTe
 
 	return result;
 }
+
+//--------------------------------------------------------------------------------
+// Tests
+//--------------------------------------------------------------------------------
+void UniformBlockLayout::Test()
+{
+	std::vector<UniformStruct> structs = FindUniformStructs(
+		"struct BaseLight\n{\n    vec3 color;\n    float intensity;\n};\n"
+		"struct Attenuation\n{\n    float constant;\n    float linear;\n    float exponent;\n};\n"
+		"struct PointLight\n{\n    BaseLight base;\n    Attenuation atten;\n    vec3 position;\n    float range;\n};\n"
+		"struct SpotLight\n{\n    PointLight pointLight;\n    vec3 direction;\n    float cutoff;\n};\n");
+
+	std::string lightBlockText = "{\n    SpotLight R_spotLight;\n    mat4 R_worldLightMatrix;\n"
+		"    float R_shadowVarianceMin;\n    vec3 R_ambient;\n";
+	UniformBlockLayout lightBlock("LightBlock", FindUniformStructComponents(lightBlockText), structs);
+
+	assert(lightBlock.GetBindingPoint() == LIGHT_BLOCK);
+	assert(lightBlock.GetMembers().size() == 4);
+	assert(lightBlock.GetOffset("R_spotLight.pointLight.base.color") == 0);
+	assert(lightBlock.GetOffset("R_spotLight.pointLight.base.intensity") == 12);
+	//Attenuation is a struct, so it starts on the next vec4.
+	assert(lightBlock.GetOffset("R_spotLight.pointLight.atten.constant") == 16);
+	assert(lightBlock.GetOffset("R_spotLight.pointLight.atten.exponent") == 24);
+	assert(lightBlock.GetOffset("R_spotLight.pointLight.position") == 32);
+	assert(lightBlock.GetOffset("R_spotLight.pointLight.range") == 44);
+	assert(lightBlock.GetOffset("R_spotLight.direction") == 48);
+	assert(lightBlock.GetOffset("R_spotLight.cutoff") == 60);
+	assert(lightBlock.GetOffset("R_worldLightMatrix") == 64);
+	assert(lightBlock.GetOffset("R_shadowVarianceMin") == 128);
+	//vec3s are aligned like vec4s.
+	assert(lightBlock.GetOffset("R_ambient") == 144);
+	assert(lightBlock.GetOffset("R_spotLight") == -1);
+	assert(lightBlock.GetSize() == 160);
+
+	std::string materialBlockText = "{\n    float specularIntensity;\n    vec2 scale;\n    float specularPower;\n";
+	UniformBlockLayout materialBlock("MaterialBlock", FindUniformStructComponents(materialBlockText), structs);
+	UniformBlockLayout sameMaterialBlock("MaterialBlock", FindUniformStructComponents(materialBlockText), structs);
+
+	assert(materialBlock.GetBindingPoint() == MATERIAL_BLOCK);
+	assert(materialBlock.GetOffset("specularIntensity") == 0);
+	assert(materialBlock.GetOffset("scale") == 8);
+	assert(materialBlock.GetOffset("specularPower") == 16);
+	assert(materialBlock.GetSize() == 32);
+	assert(materialBlock.GetId() == sameMaterialBlock.GetId());
+	assert(materialBlock.GetId() != lightBlock.GetId());
+}
+
+void ShaderData::Test()
+{
+	std::vector<std::string> uniformNames;
+	std::vector<std::string> uniformTypes;
+	std::map<std::string, unsigned int> uniformMap;
+
+	uniformNames.push_back("R_fog");
+	uniformTypes.push_back("Fog");
+	uniformMap["R_fog.density"] = 3;
+	uniformMap["R_fog.color"] = 4;
+	uniformMap["R_fogStart"] = 5;
+
+	uniformNames.push_back("R_directionalLight");
+	uniformTypes.push_back("DirectionalLight");
+	uniformMap["R_directionalLight.direction"] = 6;
+	uniformMap["R_directionalLight.base.color"] = 7;
+
+	std::vector<UniformBinding> bindings = CompileUniformBindings(uniformNames, uniformTypes, uniformMap);
+
+	assert(bindings.size() == 2);
+	assert(bindings[0].source == UniformBinding::ENGINE_STRUCT);
+	assert(bindings[0].members[0] == 4);
+	assert(bindings[0].members[1] == 3);
+	assert(bindings[0].members[2] == -1);
+	assert(bindings[1].source == UniformBinding::DIRECTIONAL_LIGHT);
+	assert(bindings[1].members[0] == 6);
+	assert(bindings[1].members[1] == 7);
+	//Compiled out members are left for OpenGL to ignore.
+	assert(bindings[1].members[2] == -1);
+}
+
+//--------------------------------------------------------------------------------
+// Benchmarks
+//--------------------------------------------------------------------------------
+//How many uniform values a draw with these bindings sets. A light or struct
+//counts each of its members, and the material block each of its members.
+static unsigned int CountUniformsSet(const ShaderData& shaderData)
+{
+	const std::vector<ShaderData::UniformBinding>& bindings = shaderData.GetUniformBindings();
+	unsigned int result = 0;
+	for(unsigned int i = 0; i < bindings.size(); i++)
+	{
+		const ShaderData::UniformBinding& binding = bindings[i];
+		switch(binding.source)
+		{
+			case ShaderData::UniformBinding::ENGINE_STRUCT:
+			case ShaderData::UniformBinding::DIRECTIONAL_LIGHT:
+			case ShaderData::UniformBinding::POINT_LIGHT:
+			case ShaderData::UniformBinding::SPOT_LIGHT:
+				for(unsigned int j = 0; j < ShaderData::UniformBinding::MAX_MEMBERS; j++)
+				{
+					if(binding.members[j] != -1)
+					{
+						result++;
+					}
+				}
+				break;
+			case ShaderData::UniformBinding::MATERIAL_BLOCK:
+				result += (unsigned int)shaderData.GetUniformBlocks()[binding.uniformIndex].GetMembers().size();
+				break;
+			default:
+				result++;
+				break;
+		}
+	}
+	return result;
+}
+
+void Shader::Benchmark(const RenderingEngine& renderingEngine)
+{
+	static const unsigned int NUM_DRAWS = 20000;
+
+	//pbr-directional is the shader most meshes are drawn with.
+	Shader shader("pbr-directional");
+	Material material("shaderBenchmark");
+	material.SetTexture("albedoMap", Texture("test.png"));
+	material.SetTexture("normalMap", Texture("default_normal.jpg"));
+	material.SetTexture("metallicMap", Texture("black.png"));
+	material.SetTexture("roughnessMap", Texture("white.png"));
+	Transform transform(Vector3f(1.0f, 2.0f, 3.0f));
+	Transform cameraTransform;
+	Camera camera(Matrix4f().InitPerspective(ToRadians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f), &cameraTransform);
+
+	const ShaderData& shaderData = *shader.m_shaderData;
+	const unsigned int uniformsPerDraw = CountUniformsSet(shaderData);
+
+	ProfileTimer byNameTimer;
+	ProfileTimer bindingsTimer;
+	shader.Bind();
+	
+	//Before the binding table, every draw worked out where each uniform came
+	//from by its name and type. Compiling the table every draw does the same
+	//string compares and lookups, then sets the same values.
+	glFinish();
+	byNameTimer.StartInvocation();
+	for(unsigned int i = 0; i < NUM_DRAWS; i++)
+	{
+		ShaderData::CompileUniformBindings(shaderData.GetUniformNames(),
+			shaderData.GetUniformTypes(), shaderData.GetUniformMap());
+		shader.UpdateUniforms(transform, material, renderingEngine, camera);
+	}
+	glFinish();
+	byNameTimer.StopInvocation();
+
+	bindingsTimer.StartInvocation();
+	for(unsigned int i = 0; i < NUM_DRAWS; i++)
+	{
+		shader.UpdateUniforms(transform, material, renderingEngine, camera);
+	}
+	glFinish();
+	bindingsTimer.StopInvocation();
+
+	ProfileCounter uniformsSet;
+	double byNameSeconds = byNameTimer.GetTimeAndReset(1) / 1000.0;
+	double bindingsSeconds = bindingsTimer.GetTimeAndReset(1) / 1000.0;
+
+	std::ostringstream message;
+	message << "Uniforms per second (" << uniformsPerDraw << " per draw, ";
+	uniformsSet.Add(uniformsPerDraw * NUM_DRAWS);
+	uniformsSet.DisplayAndReset(message.str() + "looked up by name): ", byNameSeconds, 56);
+	uniformsSet.Add(uniformsPerDraw * NUM_DRAWS);
+	uniformsSet.DisplayAndReset(message.str() + "binding table): ", bindingsSeconds, 56);
+}
@@ -60,10 +60,91 @@ private:
 	std::vector<TypedData> m_memberNames;
 };
 
+//Where each member of a std140 uniform block is, worked out from the block's
+//declaration by the same rules OpenGL uses, so a buffer for the block can be
+//filled in without asking OpenGL where anything goes.
+class UniformBlockLayout
+{
+public:
+	//Each kind of block has a fixed binding point, so a buffer bound there is
+	//used by every program that declares the block.
+	enum
+	{
+		CAMERA_BLOCK   = 0, //The camera drawing the current pass
+		LIGHT_BLOCK    = 1, //The light being drawn, and its shadow settings
+		MATERIAL_BLOCK = 2  //The values of the material being drawn
+	};
+
+	UniformBlockLayout(const std::string& name, const std::vector<TypedData>& members, const std::vector<UniformStruct>& structs);
+
+	//Members of structs are named as they are in GLSL, like "light.base.color".
+	//Returns -1 if the block has no such member.
+	int GetOffset(const std::string& memberName) const;
+
+	inline const std::string& GetName()               const { return m_name; }
+	inline const std::vector<TypedData>& GetMembers() const { return m_members; }
+	inline unsigned int GetSize()                     const { return m_size; }
+	inline int GetBindingPoint()                      const { return m_bindingPoint; }
+	//The same for any two layouts with the same members in the same places.
+	inline unsigned int GetId()                       const { return m_id; }
+
+	static void Test();
+private:
+	std::string                         m_name;
+	std::vector<TypedData>              m_members; //Just the top level ones
+	std::map<std::string, unsigned int> m_offsets;
+	unsigned int                        m_size;
+	int                                 m_bindingPoint;
+	unsigned int                        m_id;
+
+	void AddMember(const std::string& memberName, const std::string& memberType, const std::vector<UniformStruct>& structs, unsigned int* offset);
+};
+
 class ShaderData : public ReferenceCounter
 {
 public:
-	ShaderData(const std::string& fileName);
+	//One step of Shader::UpdateUniforms. The table of these is built once when
+	//the program is linked, so drawing never has to look at a uniform's name.
+	struct UniformBinding
+	{
+		enum Source
+		{
+			ENGINE_TEXTURE,
+			ENGINE_SAMPLER_SLOT, //The rendering engine binds the texture itself, like buffer textures
+			ENGINE_VECTOR3F,
+			ENGINE_FLOAT,
+			ENGINE_STRUCT,      //Set by RenderingEngine::UpdateUniformStruct
+			LIGHT_MATRIX,
+			WORLD_LIGHT_MATRIX,
+			DIRECTIONAL_LIGHT,
+			POINT_LIGHT,
+			SPOT_LIGHT,
+			MATERIAL_TEXTURE,
+			MATERIAL_VECTOR3F,
+			MATERIAL_FLOAT,
+			MVP,
+			MODEL,
+			VIEW_PROJECTION,
+			PROJECTION,
+			CAMERA_ROTATION,
+			VIEW,
+			EYE_POS,
+			MATERIAL_BLOCK      //Binds the material's uniform buffer
+		};
+
+		enum { MAX_MEMBERS = 9 };
+
+		Source       source;
+		int          group;                //Shader::UNIFORMS_ group
+		int          location;
+		unsigned int nameId;               //For MappedValues and sampler slot lookups
+		unsigned int uniformIndex;         //Into the uniform names and types, or uniform blocks for MATERIAL_BLOCK
+		int          members[MAX_MEMBERS]; //Locations of a light's members in the order they're set, or a struct's in alphabetical order
+	};
+
+	//variant is the name of a macro to define while compiling, to select one of
+	//several versions of the shader in the same file, or empty for the default.
+	ShaderData(const std::string& fileName, const std::string& variant = "");
 	virtual ~ShaderData();
 	
 	inline int GetProgram()                                           const { return m_program; }
@@ -71,6 +152,21 @@ public:
 	inline const std::vector<std::string>& GetUniformNames()          const { return m_uniformNames; }
 	inline const std::vector<std::string>& GetUniformTypes()          const { return m_uniformTypes; }
 	inline const std::map<std::string, unsigned int>& GetUniformMap() const { return m_uniformMap; }
+	inline const std::vector<UniformBinding>& GetUniformBindings()    const { return m_uniformBindings; }
+	inline const std::vector<UniformBlockLayout>& GetUniformBlocks()  const { return m_uniformBlocks; }
+	inline bool HasInstancedVariant()                                 const { return m_hasInstancedVariant; }
+	inline unsigned int GetSourceChecksum()                           const { return m_sourceChecksum; }
+	inline bool ReadsPositionsOnly()                                  const { return m_readsPositionsOnly; }
+
+	//Works out where each uniform's value comes from. Throws if a uniform
+	//can't be set by anything.
+	static std::vector<UniformBinding> CompileUniformBindings(const std::vector<std::string>& uniformNames,
+		const std::vector<std::string>& uniformTypes, const std::map<std::string, unsigned int>& uniformMap);
+	//Finds the members of a light struct, like ".base.color", in the order
+	//they're set. Returns how many there are, or 0 if lightType isn't a light.
+	static unsigned int FindLightMembers(const std::string& lightType, const char* const** memberNames);
+
+	static void Test();
 private:
 	void AddVertexShader(const std::string& text);
 	void AddGeometryShader(const std::string& text);
@@ -79,7 +175,8 @@ private:
 	
 	void AddAllAttributes(const std::string& vertexShaderText, const std::string& attributeKeyword);
 	void AddShaderUniforms(const std::string& shaderText);
-	void AddUniform(const std::string& uniformName, const std::string& uniformType, const std::vector<UniformStruct>& structs);
+	bool AddUniform(const std::string& uniformName, const std::string& uniformType, const std::vector<UniformStruct>& structs);
+	void AddUniformBlock(const UniformBlockLayout& layout);
 	void CompileShader() const;
 
 	static int s_supportedOpenGLLevel;
@@ -89,32 +186,76 @@ private:
 	std::vector<std::string>            m_uniformNames;
 	std::vector<std::string>            m_uniformTypes;
 	std::map<std::string, unsigned int> m_uniformMap;
+	std::vector<UniformBinding>         m_uniformBindings;
+	std::vector<UniformBlockLayout>     m_uniformBlocks;       //Only the ones this program uses
+	bool                                m_hasVariants;         //Uniforms for other variants are compiled out, so may not exist
+	bool                                m_hasInstancedVariant;
+	unsigned int                        m_sourceChecksum;      //Of the text after includes are expanded
+	bool                                m_readsPositionsOnly;  //No vertex attribute but position or T_model is used
 };
 
 class Shader
 {
 public:
+	//Groups of uniforms that change at different rates. A program keeps its
+	//uniform values between draws, so when the same program draws several
+	//times in a row, only the groups that changed need to be set again.
+	enum
+	{
+		UNIFORMS_OBJECT   = 1, //Anything that depends on the transform
+		UNIFORMS_MATERIAL = 2, //Material values and textures
+		UNIFORMS_PASS     = 4, //The camera and rendering engine
+		UNIFORMS_ALL      = UNIFORMS_OBJECT | UNIFORMS_MATERIAL | UNIFORMS_PASS
+	};
+
 	Shader(const std::string& fileName = "basicShader");
 	Shader(const Shader& other);
 	virtual ~Shader();
 
 	void Bind() const;
-	virtual void UpdateUniforms(const Transform& transform, const Material& material, const RenderingEngine& renderingEngine, const Camera& camera) const;
+	virtual void UpdateUniforms(const Transform& transform, const Material& material, const RenderingEngine& renderingEngine, const Camera& camera,
+		int uniformGroups = UNIFORMS_ALL) const;
+
+	//Different for every shader that exists at the same time.
+	inline int GetProgram() const { return m_shaderData->GetProgram(); }
+
+	//Shaders with an instanced variant can draw many copies of a mesh at once,
+	//reading T_model from a per instance attribute rather than a uniform.
+	inline bool HasInstancedVariant() const { return m_shaderData->HasInstancedVariant(); }
+	const Shader& GetInstancedVariant() const;
+	//Changes whenever the shader's file, or any file it includes, does.
+	inline unsigned int GetSourceChecksum() const { return m_shaderData->GetSourceChecksum(); }
+	//Shaders that only read positions, like depth only ones, can draw meshes
+	//bound with just their position buffer.
+	inline bool ReadsPositionsOnly() const { return m_shaderData->ReadsPositionsOnly(); }
+
+	//Returns 0 if the program doesn't use a block called blockName.
+	const UniformBlockLayout* GetUniformBlock(const std::string& blockName) const;
 
 	void SetUniformi(const std::string& uniformName, int value) const;
 	void SetUniformf(const std::string& uniformName, float value) const;
 	void SetUniformMatrix4f(const std::string& uniformName, const Matrix4f& value) const;
 	void SetUniformVector3f(const std::string& uniformName, const Vector3f& value) const;
+
+	//Needs an OpenGL context, so renderingEngine must exist before this is called.
+	static void Benchmark(const RenderingEngine& renderingEngine);
 protected:
 private:
 	static std::map<std::string, ShaderData*> s_resourceMap;
 
 	ShaderData* m_shaderData;
 	std::string m_fileName;
+	mutable Shader* m_instancedVariant; //Created the first time it's needed
 	
-	void SetUniformDirectionalLight(const std::string& uniformName, const DirectionalLight& value) const;
-	void SetUniformPointLight(const std::string& uniformName, const PointLight& value) const;
-	void SetUniformSpotLight(const std::string& uniformName, const SpotLight& value) const;
+	Shader(const std::string& fileName, const std::string& variant);
+	void Load(const std::string& fileName, const std::string& variant);
+
+	static void SetUniformVector3f(int location, const Vector3f& value);
+	static void SetUniformMatrix4f(int location, const Matrix4f& value);
+	static void SetUniformDirectionalLight(const int* memberLocations, const DirectionalLight& value);
+	static void SetUniformPointLight(const int* memberLocations, const PointLight& value);
+	static void SetUniformSpotLight(const int* memberLocations, const SpotLight& value);
+
 	
 	void operator=(const Shader& other) {}
 };
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "shadowAtlas.h"
+
+#include <GL/glew.h>
+#include <cassert>
+#include <cstdlib>
+
+ShadowAtlas::ShadowAtlas(int sizeAsPowerOf2, bool use16BitMoments) :
+	m_sizeAsPowerOf2(sizeAsPowerOf2),
+	m_use16BitMoments(use16BitMoments),
+	m_texture(0),
+	m_tileTargets((sizeAsPowerOf2 + 1) * 2, (Texture*)0),
+	m_freeTiles(sizeAsPowerOf2 + 1)
+{
+	Tile tile;
+	tile.x = 0;
+	tile.y = 0;
+	tile.sizeAsPowerOf2 = sizeAsPowerOf2;
+	m_freeTiles[sizeAsPowerOf2].push_back(tile);
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+	delete m_texture;
+	for(unsigned int i = 0; i < m_tileTargets.size(); i++)
+	{
+		delete m_tileTargets[i];
+	}
+}
+
+bool ShadowAtlas::Allocate(int sizeAsPowerOf2, Tile* tile)
+{
+	if(sizeAsPowerOf2 < 0 || sizeAsPowerOf2 > m_sizeAsPowerOf2)
+	{
+		return false;
+	}
+
+	//Uses the smallest free tile that's big enough, to keep big ones whole.
+	int freeSize = sizeAsPowerOf2;
+	while(freeSize <= m_sizeAsPowerOf2 && m_freeTiles[freeSize].empty())
+	{
+		freeSize++;
+	}
+
+	if(freeSize > m_sizeAsPowerOf2)
+	{
+		return false;
+	}
+
+	Tile result = m_freeTiles[freeSize].back();
+	m_freeTiles[freeSize].pop_back();
+
+	//Keeps the first quarter of the tile until it's the right size, freeing
+	//the other three.
+	while(result.sizeAsPowerOf2 > sizeAsPowerOf2)
+	{
+		result.sizeAsPowerOf2--;
+		int halfSize = 1 << result.sizeAsPowerOf2;
+		for(int i = 1; i < 4; i++)
+		{
+			Tile quarter = result;
+			quarter.x += (i & 1) * halfSize;
+			quarter.y += (i >> 1) * halfSize;
+			m_freeTiles[result.sizeAsPowerOf2].push_back(quarter);
+		}
+	}
+
+	*tile = result;
+	return true;
+}
+
+void ShadowAtlas::Free(const Tile& tile)
+{
+	Tile current = tile;
+
+	//While the other three quarters of the tile's parent are free too, they're
+	//merged back into the parent.
+	while(current.sizeAsPowerOf2 < m_sizeAsPowerOf2)
+	{
+		int parentMask = ~((1 << (current.sizeAsPowerOf2 + 1)) - 1);
+		int parentX = current.x & parentMask;
+		int parentY = current.y & parentMask;
+
+		std::vector<Tile>& freeTiles = m_freeTiles[current.sizeAsPowerOf2];
+		int numFreeQuarters = 0;
+		for(unsigned int i = 0; i < freeTiles.size(); i++)
+		{
+			assert(freeTiles[i].x != current.x || freeTiles[i].y != current.y);
+			if((freeTiles[i].x & parentMask) == parentX && (freeTiles[i].y & parentMask) == parentY)
+			{
+				numFreeQuarters++;
+			}
+		}
+
+		if(numFreeQuarters < 3)
+		{
+			break;
+		}
+
+		for(unsigned int i = (unsigned int)freeTiles.size(); i-- > 0;)
+		{
+			if((freeTiles[i].x & parentMask) == parentX && (freeTiles[i].y & parentMask) == parentY)
+			{
+				freeTiles[i] = freeTiles.back();
+				freeTiles.pop_back();
+			}
+		}
+
+		current.x = parentX;
+		current.y = parentY;
+		current.sizeAsPowerOf2++;
+	}
+
+	m_freeTiles[current.sizeAsPowerOf2].push_back(current);
+}
+
+Vector3f ShadowAtlas::GetTileBounds(const Tile& tile) const
+{
+	float atlasSize = (float)(1 << m_sizeAsPowerOf2);
+	return Vector3f((float)tile.x / atlasSize, (float)tile.y / atlasSize, (float)(1 << tile.sizeAsPowerOf2) / atlasSize);
+}
+
+void ShadowAtlas::BindTile(const Tile& tile) const
+{
+	int size = 1 << tile.sizeAsPowerOf2;
+	glViewport(tile.x, tile.y, size, size);
+	glScissor(tile.x, tile.y, size, size);
+	glEnable(GL_SCISSOR_TEST);
+}
+
+Texture* ShadowAtlas::CreateTarget(int sizeAsPowerOf2) const
+{
+	int size = 1 << sizeAsPowerOf2;
+	return new Texture(size, size, 0, GL_TEXTURE_2D, GL_LINEAR, m_use16BitMoments ? GL_RG16F : GL_RG32F, GL_RGBA, GL_UNSIGNED_BYTE,
+		true, GL_COLOR_ATTACHMENT0);
+}
+
+const Texture& ShadowAtlas::GetTexture()
+{
+	if(m_texture == 0)
+	{
+		m_texture = CreateTarget(m_sizeAsPowerOf2);
+	}
+
+	return *m_texture;
+}
+
+const Texture& ShadowAtlas::GetTileTarget(int sizeAsPowerOf2, int index)
+{
+	assert(sizeAsPowerOf2 >= 0 && sizeAsPowerOf2 <= m_sizeAsPowerOf2 && index >= 0 && index < 2);
+	Texture*& target = m_tileTargets[sizeAsPowerOf2 * 2 + index];
+	if(target == 0)
+	{
+		target = CreateTarget(sizeAsPowerOf2);
+	}
+
+	return *target;
+}
+
+unsigned int ShadowAtlas::GetFreeArea() const
+{
+	unsigned int result = 0;
+	for(unsigned int i = 0; i < m_freeTiles.size(); i++)
+	{
+		result += (unsigned int)m_freeTiles[i].size() << (i * 2);
+	}
+
+	return result;
+}
+
+void ShadowAtlas::Test()
+{
+	ShadowAtlas atlas(6);
+	Tile tiles[5];
+
+	//4 quarters fill the atlas, and merge back into one when they're freed.
+	for(int i = 0; i < 4; i++)
+	{
+		bool allocated = atlas.Allocate(5, &tiles[i]);
+		assert(allocated);
+	}
+	bool allocatedWhenFull = atlas.Allocate(5, &tiles[4]);
+	bool allocatedSmallestWhenFull = atlas.Allocate(0, &tiles[4]);
+	assert(!allocatedWhenFull && !allocatedSmallestWhenFull);
+	assert(atlas.GetFreeArea() == 0);
+
+	for(int i = 0; i < 4; i++)
+	{
+		atlas.Free(tiles[i]);
+	}
+	assert(atlas.GetFreeArea() == 64 * 64);
+	bool allocatedWhole = atlas.Allocate(6, &tiles[0]);
+	bool allocatedTooLarge = atlas.Allocate(7, &tiles[1]);
+	assert(allocatedWhole && !allocatedTooLarge);
+	atlas.Free(tiles[0]);
+
+	Vector3f bounds = atlas.GetTileBounds(tiles[0]);
+	assert(bounds.GetX() == 0.0f && bounds.GetY() == 0.0f && bounds.GetZ() == 1.0f);
+
+	//Tiles of any mix of sizes never overlap, and everything freed can be
+	//used again.
+	std::vector<Tile> allocated;
+	std::vector<int> owners(64 * 64, -1);
+	for(int i = 0; i < 2000; i++)
+	{
+		if(!allocated.empty() && rand() % 2 == 0)
+		{
+			unsigned int index = (unsigned int)rand() % allocated.size();
+			Tile tile = allocated[index];
+			int size = 1 << tile.sizeAsPowerOf2;
+			for(int y = tile.y; y < tile.y + size; y++)
+			{
+				for(int x = tile.x; x < tile.x + size; x++)
+				{
+					owners[y * 64 + x] = -1;
+				}
+			}
+
+			atlas.Free(tile);
+			allocated[index] = allocated.back();
+			allocated.pop_back();
+			continue;
+		}
+
+		Tile tile;
+		if(!atlas.Allocate(rand() % 5 + 1, &tile))
+		{
+			continue;
+		}
+
+		int size = 1 << tile.sizeAsPowerOf2;
+		assert(tile.x % size == 0 && tile.y % size == 0 && tile.x + size <= 64 && tile.y + size <= 64);
+		for(int y = tile.y; y < tile.y + size; y++)
+		{
+			for(int x = tile.x; x < tile.x + size; x++)
+			{
+				assert(owners[y * 64 + x] == -1);
+				owners[y * 64 + x] = i;
+			}
+		}
+		allocated.push_back(tile);
+	}
+
+	unsigned int usedArea = 0;
+	for(unsigned int i = 0; i < allocated.size(); i++)
+	{
+		usedArea += 1 << (allocated[i].sizeAsPowerOf2 * 2);
+	}
+	assert(usedArea + atlas.GetFreeArea() == 64 * 64);
+
+	for(unsigned int i = 0; i < allocated.size(); i++)
+	{
+		atlas.Free(allocated[i]);
+	}
+	assert(atlas.GetFreeArea() == 64 * 64);
+	allocatedWhole = atlas.Allocate(6, &tiles[0]);
+	assert(allocatedWhole);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SHADOWATLAS_H
+#define SHADOWATLAS_H
+
+#include "texture.h"
+#include "../core/math3d.h"
+
+#include <vector>
+
+//One big render target that every light's shadow map is a tile of. Tiles are
+//squares with power of 2 sizes, allocated by splitting bigger tiles into
+//quarters, and merged back together when all four quarters are free, so any
+//mix of sizes can come and go without the atlas filling up with gaps.
+class ShadowAtlas
+{
+public:
+	//Where a tile is in the atlas, in texels.
+	struct Tile
+	{
+		int x;
+		int y;
+		int sizeAsPowerOf2;
+	};
+
+	//The atlas is 2^sizeAsPowerOf2 texels across. None of its textures are
+	//created until they're first used. 16 bit moments take half the memory,
+	//but show more light bleeding.
+	ShadowAtlas(int sizeAsPowerOf2 = 11, bool use16BitMoments = false);
+	virtual ~ShadowAtlas();
+
+	//Finds space for a tile 2^sizeAsPowerOf2 texels across. Returns false if
+	//there isn't a big enough space left.
+	bool Allocate(int sizeAsPowerOf2, Tile* tile);
+	void Free(const Tile& tile);
+
+	//The tile's corner and width as fractions of the atlas.
+	Vector3f GetTileBounds(const Tile& tile) const;
+	//Sets the viewport and scissor to the tile, so nothing outside it is drawn
+	//or cleared. The atlas has to be bound as the render target first.
+	void BindTile(const Tile& tile) const;
+
+	const Texture& GetTexture();
+	//Render targets the size of a tile, with the same format as the atlas, for
+	//drawing a shadow map before it's copied into its tile. There are 2 of each
+	//size, so one can be blurred into the other.
+	const Texture& GetTileTarget(int sizeAsPowerOf2, int index);
+
+	inline int GetSizeAsPowerOf2() const { return m_sizeAsPowerOf2; }
+	//How many texels aren't in any tile.
+	unsigned int GetFreeArea() const;
+
+	static void Test();
+protected:
+private:
+	int                              m_sizeAsPowerOf2;
+	bool                             m_use16BitMoments;
+	Texture*                         m_texture;
+	std::vector<Texture*>            m_tileTargets; //2 for each size, or 0 until they're used
+	std::vector<std::vector<Tile> >  m_freeTiles;   //By size
+
+	Texture* CreateTarget(int sizeAsPowerOf2) const;
+
+	ShadowAtlas(const ShadowAtlas& other) {}
+	void operator=(const ShadowAtlas& other) {}
+};
+
+#endif
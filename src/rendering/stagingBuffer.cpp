@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "stagingBuffer.h"
+
+#include <cassert>
+
+StagingBuffer::StagingBuffer() :
+	m_buffer(0),
+	m_data(0) {}
+
+StagingBuffer::~StagingBuffer()
+{
+	//Deleting a buffer unmaps it too.
+	if(m_buffer) glDeleteBuffers(1, &m_buffer);
+}
+
+void StagingBuffer::Map(unsigned int size)
+{
+	assert(m_buffer == 0 && m_data == 0);
+
+	//Mapped through the copy read binding, since nothing else uses it between
+	//uploads, rather than the unpack binding that every texture upload reads.
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+	glBufferData(GL_COPY_READ_BUFFER, size, 0, GL_STREAM_DRAW);
+	if(size > 0)
+	{
+		m_data = (unsigned char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	if(m_data == 0)
+	{
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+		m_memory.resize(size);
+		m_data = m_memory.empty() ? 0 : &m_memory[0];
+	}
+}
+
+bool StagingBuffer::Unmap()
+{
+	if(m_buffer == 0)
+	{
+		return true;
+	}
+
+	m_data = 0;
+	glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+	bool isIntact = glUnmapBuffer(GL_COPY_READ_BUFFER) == GL_TRUE;
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	return isIntact;
+}
+
+const void* StagingBuffer::BindPixels(unsigned int offset) const
+{
+	assert(m_data == 0 || m_buffer == 0);
+	if(m_buffer == 0)
+	{
+		return &m_memory[0] + offset;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+	return (const void*)(size_t)offset;
+}
+
+void StagingBuffer::UnbindPixels() const
+{
+	if(m_buffer) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void StagingBuffer::CopyToBuffer(unsigned int offset, unsigned int writeOffset, unsigned int size) const
+{
+	assert(m_data == 0 || m_buffer == 0);
+	if(m_buffer == 0)
+	{
+		glBufferSubData(GL_COPY_WRITE_BUFFER, writeOffset, size, &m_memory[0] + offset);
+		return;
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, writeOffset, size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STAGINGBUFFER_H
+#define STAGINGBUFFER_H
+
+#include <GL/glew.h>
+#include <vector>
+
+//A mapped buffer that a loader thread writes into, so the data can be copied
+//from it into textures and vertex buffers on the thread with the OpenGL
+//context, a little at a time. When the buffer can't be mapped, ordinary
+//memory is written into instead, and uploaded from there.
+class StagingBuffer
+{
+public:
+	StagingBuffer();
+	virtual ~StagingBuffer();
+
+	//Makes a buffer of size bytes and maps it to be written to. Needs the
+	//OpenGL context.
+	void Map(unsigned int size);
+	//Where to write, from any thread, until Unmap is called.
+	inline unsigned char* GetData() { return m_data; }
+	//Needs the OpenGL context. Returns false if what was written has been lost,
+	//which OpenGL allows for when, say, the display mode changes.
+	bool Unmap();
+
+	//Binds the buffer as the pixel unpack buffer, and returns what to pass as
+	//the pixels of glTexImage2D and the like to read from offset. Unbind
+	//before uploading anything that isn't staged.
+	const void* BindPixels(unsigned int offset) const;
+	void UnbindPixels() const;
+	//Copies size bytes from offset into the buffer bound to
+	//GL_COPY_WRITE_BUFFER, at writeOffset.
+	void CopyToBuffer(unsigned int offset, unsigned int writeOffset, unsigned int size) const;
+protected:
+private:
+	GLuint                     m_buffer;
+	unsigned char*             m_data;
+	std::vector<unsigned char> m_memory; //Written to instead if the buffer couldn't be mapped
+
+	StagingBuffer(const StagingBuffer& other) {}
+	void operator=(const StagingBuffer& other) {}
+};
+
+#endif
@@ -16,12 +16,14 @@
  */
 
 #include "texture.h"
+#include "stagingBuffer.h"
 
 #include "../core/math3d.h"
 #include "../core/profiling.h"
 
 #include "../staticLibs/stb_image.h"
 
+#include <algorithm>
 #include <iostream>
 #include <cassert>
 #include <cstring>
@@ -29,8 +31,352 @@
 
 std::map<std::string, TextureData*> Texture::s_resourceMap;
 
+static bool IsMipmapped(GLfloat filter)
+{
+	return filter == GL_NEAREST_MIPMAP_NEAREST ||
+		filter == GL_NEAREST_MIPMAP_LINEAR ||
+		filter == GL_LINEAR_MIPMAP_NEAREST ||
+		filter == GL_LINEAR_MIPMAP_LINEAR;
+}
+
+//Magnification never reads a mip, so a mipmapped min filter is invalid there.
+static GLfloat GetMagFilter(GLfloat filter)
+{
+	if(filter == GL_NEAREST_MIPMAP_NEAREST || filter == GL_NEAREST_MIPMAP_LINEAR)
+		return GL_NEAREST;
+	if(filter == GL_LINEAR_MIPMAP_NEAREST || filter == GL_LINEAR_MIPMAP_LINEAR)
+		return GL_LINEAR;
+	return filter;
+}
+
+//Whether the context can read a compressed format directly.
+static bool SupportsCompression(TextureCompression compression)
+{
+	if(compression == TEXTURE_COMPRESSION_BC5)
+		return GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc || GLEW_EXT_texture_compression_rgtc;
+	
+	return GLEW_EXT_texture_compression_s3tc != 0;
+}
+
+//Which of a cooked texture's mips are used: all of them with a mipmapped
+//filter, and otherwise just the biggest.
+static void CalcMipRange(const CompressedTexture& compressedTexture, GLfloat filter, int* firstMip, int* lastMip)
+{
+	*firstMip = 0;
+	#if PROFILING_SET_2x2_TEXTURE != 0
+		while(*firstMip < compressedTexture.GetNumMips() - 1 &&
+			(compressedTexture.GetMipWidth(*firstMip) > 2 || compressedTexture.GetMipHeight(*firstMip) > 2))
+		{
+			(*firstMip)++;
+		}
+	#endif
+	*lastMip = IsMipmapped(filter) ? compressedTexture.GetNumMips() - 1 : *firstMip;
+}
+
+static int CalcNumMips(int width, int height)
+{
+	int numMips = 1;
+	while((width >> numMips) > 0 || (height >> numMips) > 0)
+	{
+		numMips++;
+	}
+	return numMips;
+}
+
+//Uploads one mip of a cooked texture into a level of the bound texture,
+//straight from where it's mapped. Contexts that can't read the format get it
+//decompressed.
+static void UploadCompressedMip(const CompressedTexture& compressedTexture, int mip, int level)
+{
+	int width = compressedTexture.GetMipWidth(mip);
+	int height = compressedTexture.GetMipHeight(mip);
+	if(!SupportsCompression(compressedTexture.GetCompression()))
+	{
+		std::vector<unsigned char> pixels(width * height * 4);
+		CompressedTexture::Decompress(compressedTexture.GetCompression(), compressedTexture.GetMipData(mip), width, height, &pixels[0]);
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	}
+	else
+	{
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, compressedTexture.GetInternalFormat(), width, height, 0,
+			compressedTexture.GetMipSize(mip), compressedTexture.GetMipData(mip));
+	}
+}
+
+//Reads a texture on a loader thread, into a buffer that's mapped for it on
+//the thread that draws, then uploads it from there a mip level at a time,
+//smallest first, so it can be drawn blurry before all of it is there.
+//Textures that haven't been cooked are decoded into the buffer instead, and
+//uploaded a few rows at a time, with their mips generated once the rows are
+//all there.
+class TextureStreamJob : public AsyncLoadJob
+{
+public:
+	TextureStreamJob(TextureData* textureData, const std::string& fileName, GLfloat filter, bool clamp) :
+		m_textureData(textureData),
+		m_fileName(fileName),
+		m_filter(filter),
+		m_clamp(clamp),
+		m_compressedTexture(0),
+		m_isDecompressed(false),
+		m_width(0),
+		m_height(0),
+		m_isFilled(false),
+		m_hasStarted(false),
+		m_firstMip(0),
+		m_lastMip(0),
+		m_nextMip(0),
+		m_nextRow(0) {}
+	virtual ~TextureStreamJob();
+
+	virtual void Load();
+	virtual void Prepare();
+	virtual void Fill();
+	virtual bool Upload(unsigned int* budget);
+
+	//For when the texture is deleted before it's been streamed in.
+	inline void Cancel() { m_textureData = 0; }
+private:
+	TextureData*              m_textureData;
+	std::string               m_fileName;
+	GLfloat                   m_filter;
+	bool                      m_clamp;
+	CompressedTexture*        m_compressedTexture; //0 unless the texture was cooked
+	bool                      m_isDecompressed;    //When the context can't read its format
+	int                       m_width;             //Of the image otherwise
+	int                       m_height;
+	StagingBuffer             m_staging;
+	std::vector<unsigned int> m_mipOffsets;        //Where each used mip is staged, from m_firstMip
+	bool                      m_isFilled;          //Whether everything was staged
+	bool                      m_hasStarted;        //Whether anything's been uploaded yet
+	int                       m_firstMip;
+	int                       m_lastMip;
+	int                       m_nextMip;           //Counts down to m_firstMip as each is uploaded
+	int                       m_nextRow;           //Of an image that wasn't cooked
+
+	bool UploadCompressed(unsigned int* budget);
+	bool UploadImage(unsigned int* budget);
+	void StopProxying();
+
+	TextureStreamJob(const TextureStreamJob& other) {}
+	void operator=(const TextureStreamJob& other) {}
+};
+
+TextureStreamJob::~TextureStreamJob()
+{
+	if(m_textureData) m_textureData->m_streamJob = 0;
+	delete m_compressedTexture;
+}
+
+void TextureStreamJob::Load()
+{
+	//Only the job's own members are touched here, since the texture belongs
+	//to the thread that draws.
+	m_compressedTexture = new CompressedTexture("./res/textures/" + m_fileName + ".ktx");
+	if(m_compressedTexture->IsValid())
+	{
+		CalcMipRange(*m_compressedTexture, m_filter, &m_firstMip, &m_lastMip);
+		return;
+	}
+	
+	delete m_compressedTexture;
+	m_compressedTexture = 0;
+	
+	//Only the size is read for now. The image is decoded once there's
+	//somewhere to put it.
+	int bytesPerPixel;
+	if(!stbi_info(("./res/textures/" + m_fileName).c_str(), &m_width, &m_height, &bytesPerPixel))
+	{
+		m_width = 0;
+		m_height = 0;
+	}
+}
+
+void TextureStreamJob::Prepare()
+{
+	if(m_textureData == 0)
+	{
+		return;
+	}
+
+	if(m_compressedTexture)
+	{
+		m_isDecompressed = !SupportsCompression(m_compressedTexture->GetCompression());
+		unsigned int size = 0;
+		for(int mip = m_firstMip; mip <= m_lastMip; mip++)
+		{
+			m_mipOffsets.push_back(size);
+			size += m_isDecompressed ? m_compressedTexture->GetMipWidth(mip) * m_compressedTexture->GetMipHeight(mip) * 4 :
+				m_compressedTexture->GetMipSize(mip);
+		}
+		m_staging.Map(size);
+	}
+	else if(m_width > 0 && m_height > 0)
+	{
+		m_staging.Map(m_width * m_height * 4);
+	}
+}
+
+void TextureStreamJob::Fill()
+{
+	unsigned char* data = m_staging.GetData();
+	if(data == 0)
+	{
+		return;
+	}
+
+	if(m_compressedTexture)
+	{
+		//Contexts that can't read the format have it decompressed here, rather
+		//than on the thread that draws.
+		for(int mip = m_firstMip; mip <= m_lastMip; mip++)
+		{
+			unsigned char* mipData = data + m_mipOffsets[mip - m_firstMip];
+			if(m_isDecompressed)
+			{
+				CompressedTexture::Decompress(m_compressedTexture->GetCompression(), m_compressedTexture->GetMipData(mip),
+					m_compressedTexture->GetMipWidth(mip), m_compressedTexture->GetMipHeight(mip), mipData);
+			}
+			else
+			{
+				memcpy(mipData, m_compressedTexture->GetMipData(mip), m_compressedTexture->GetMipSize(mip));
+			}
+		}
+		m_isFilled = true;
+		return;
+	}
+
+	int width, height, bytesPerPixel;
+	unsigned char* pixels = stbi_load(("./res/textures/" + m_fileName).c_str(), &width, &height, &bytesPerPixel, 4);
+	if(pixels && width == m_width && height == m_height)
+	{
+		memcpy(data, pixels, m_width * m_height * 4);
+		m_isFilled = true;
+	}
+	if(pixels) stbi_image_free(pixels);
+}
+
+bool TextureStreamJob::Upload(unsigned int* budget)
+{
+	if(m_textureData == 0)
+	{
+		return true;
+	}
+	
+	if(!m_hasStarted)
+	{
+		m_hasStarted = true;
+		bool isIntact = m_staging.Unmap();
+		if(!m_isFilled || !isIntact)
+		{
+			std::cerr << "Unable to load texture: " << m_fileName << std::endl;
+			return true;
+		}
+
+		if(m_compressedTexture)
+		{
+			m_nextMip = m_lastMip;
+			m_textureData->m_width = m_compressedTexture->GetMipWidth(m_firstMip);
+			m_textureData->m_height = m_compressedTexture->GetMipHeight(m_firstMip);
+			m_textureData->InitSampling(m_filter, m_clamp, m_lastMip - m_firstMip + 1);
+		}
+		else
+		{
+			#if PROFILING_SET_2x2_TEXTURE == 0
+				m_textureData->m_width = m_width;
+				m_textureData->m_height = m_height;
+			#else
+				m_textureData->m_width = 2;
+				m_textureData->m_height = 2;
+			#endif
+			int width = m_textureData->m_width;
+			int height = m_textureData->m_height;
+			m_textureData->InitSampling(m_filter, m_clamp, IsMipmapped(m_filter) ? CalcNumMips(width, height) : 1);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		}
+	}
+	
+	glBindTexture(GL_TEXTURE_2D, m_textureData->m_textureID[0]);
+	bool isDone = m_compressedTexture ? UploadCompressed(budget) : UploadImage(budget);
+	m_staging.UnbindPixels();
+	return isDone;
+}
+
+bool TextureStreamJob::UploadCompressed(unsigned int* budget)
+{
+	while(m_nextMip >= m_firstMip && *budget > 0)
+	{
+		int width = m_compressedTexture->GetMipWidth(m_nextMip);
+		int height = m_compressedTexture->GetMipHeight(m_nextMip);
+		int level = m_nextMip - m_firstMip;
+		const void* pixels = m_staging.BindPixels(m_mipOffsets[level]);
+		if(m_isDecompressed)
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+			*budget -= std::min(*budget, (unsigned int)(width * height * 4));
+		}
+		else
+		{
+			unsigned int size = m_compressedTexture->GetMipSize(m_nextMip);
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, m_compressedTexture->GetInternalFormat(), width, height, 0, size, pixels);
+			*budget -= std::min(*budget, size);
+		}
+
+		//Only the levels from the base up are sampled, so the texture can be
+		//drawn with as soon as the smallest one is there.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+		m_nextMip--;
+	}
+	
+	StopProxying();
+	return m_nextMip < m_firstMip;
+}
+
+bool TextureStreamJob::UploadImage(unsigned int* budget)
+{
+	//The rows are read from the image as it was decoded, which is only wider
+	//than the texture when it's been shrunk for profiling.
+	int width = m_textureData->m_width;
+	int height = m_textureData->m_height;
+	unsigned int rowSize = width * 4;
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, m_width);
+	while(m_nextRow < height && *budget > 0)
+	{
+		int numRows = std::min(height - m_nextRow, (int)std::max(1u, *budget / rowSize));
+		const void* pixels = m_staging.BindPixels(m_nextRow * m_width * 4);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, m_nextRow, width, numRows, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		*budget -= std::min(*budget, numRows * rowSize);
+		m_nextRow += numRows;
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	
+	//It isn't drawn until it's all there, mips included. Generating them is
+	//counted as a third as much again, like uploading them would be.
+	if(m_nextRow < height || (IsMipmapped(m_filter) && *budget == 0))
+	{
+		return false;
+	}
+	
+	if(IsMipmapped(m_filter))
+	{
+		glGenerateMipmap(GL_TEXTURE_2D);
+		*budget -= std::min(*budget, height * rowSize / 3);
+	}
+	
+	StopProxying();
+	return true;
+}
+
+void TextureStreamJob::StopProxying()
+{
+	delete m_textureData->m_proxy;
+	m_textureData->m_proxy = 0;
+}
+
 TextureData::TextureData(GLenum textureTarget, int width, int height, int numTextures, void** data, GLfloat* filters, GLenum* internalFormat, GLenum* format, GLenum* type, bool clamp, GLenum* attachments)
 {
+	m_proxy = 0;
+	m_streamJob = 0;
 	m_textureID = new GLuint[numTextures];
 	m_textureTarget = textureTarget;
 	m_numTextures = numTextures;
@@ -49,8 +395,40 @@ TextureData::TextureData(GLenum textureTarget, int width, int height, int numTex
 	InitRenderTargets(attachments);
 }
 
+TextureData::TextureData(const CompressedTexture& compressedTexture, GLfloat filter, bool clamp)
+{
+	m_proxy = 0;
+	m_streamJob = 0;
+	m_textureID = new GLuint[1];
+	m_textureTarget = GL_TEXTURE_2D;
+	m_numTextures = 1;
+	m_frameBuffer = 0;
+	m_renderBuffer = 0;
+	
+	InitCompressedTexture(compressedTexture, filter, clamp);
+}
+
+TextureData::TextureData(const std::string& fileName, AsyncLoader* loader, GLfloat filter, bool clamp)
+{
+	m_proxy = new Texture("defaultTexture.png");
+	m_streamJob = new TextureStreamJob(this, fileName, filter, clamp);
+	m_textureID = new GLuint[1];
+	m_textureID[0] = 0;
+	m_textureTarget = GL_TEXTURE_2D;
+	m_numTextures = 1;
+	m_width = 0;
+	m_height = 0;
+	m_frameBuffer = 0;
+	m_renderBuffer = 0;
+	
+	loader->Queue(m_streamJob);
+}
+
 TextureData::~TextureData()
 {
+	if(m_streamJob) m_streamJob->Cancel();
+	delete m_proxy;
+
 	if(*m_textureID) glDeleteTextures(m_numTextures, m_textureID);
 	if(m_frameBuffer) glDeleteFramebuffers(1, &m_frameBuffer);
 	if(m_renderBuffer) glDeleteRenderbuffers(1, &m_renderBuffer);
@@ -65,7 +443,7 @@ void TextureData::InitTextures(void** data, GLfloat* filters, GLenum* internalFo
 		glBindTexture(m_textureTarget, m_textureID[i]);
 
 		glTexParameterf(m_textureTarget, GL_TEXTURE_MIN_FILTER, filters[i]);
-		glTexParameterf(m_textureTarget, GL_TEXTURE_MAG_FILTER, filters[i]);
+		glTexParameterf(m_textureTarget, GL_TEXTURE_MAG_FILTER, GetMagFilter(filters[i]));
 
 		if(clamp)
 		{
@@ -99,15 +477,15 @@ void TextureData::InitTextures(void** data, GLfloat* filters, GLenum* internalFo
 			}
 		}
 
-		if(filters[i] == GL_NEAREST_MIPMAP_NEAREST ||
-			filters[i] == GL_NEAREST_MIPMAP_LINEAR ||
-			filters[i] == GL_LINEAR_MIPMAP_NEAREST ||
-			filters[i] == GL_LINEAR_MIPMAP_LINEAR)
+		if(IsMipmapped(filters[i]))
 		{
 			glGenerateMipmap(m_textureTarget);
-			GLfloat maxAnisotropy;
-			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
-			glTexParameterf(m_textureTarget, GL_TEXTURE_MAX_ANISOTROPY_EXT, Clamp(0.0f, 8.0f, maxAnisotropy));
+			if(GLEW_EXT_texture_filter_anisotropic)
+			{
+				GLfloat maxAnisotropy;
+				glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+				glTexParameterf(m_textureTarget, GL_TEXTURE_MAX_ANISOTROPY_EXT, Clamp(0.0f, 8.0f, maxAnisotropy));
+			}
 		}
 		else
 		{
@@ -117,6 +495,48 @@ void TextureData::InitTextures(void** data, GLfloat* filters, GLenum* internalFo
 	}
 }
 
+void TextureData::InitSampling(GLfloat filter, bool clamp, int numMips)
+{
+	glGenTextures(1, m_textureID);
+	glBindTexture(m_textureTarget, m_textureID[0]);
+	
+	glTexParameterf(m_textureTarget, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameterf(m_textureTarget, GL_TEXTURE_MAG_FILTER, GetMagFilter(filter));
+	
+	if(clamp)
+	{
+		glTexParameterf(m_textureTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameterf(m_textureTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	
+	glTexParameteri(m_textureTarget, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(m_textureTarget, GL_TEXTURE_MAX_LEVEL, numMips - 1);
+	
+	if(IsMipmapped(filter) && GLEW_EXT_texture_filter_anisotropic)
+	{
+		GLfloat maxAnisotropy;
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+		glTexParameterf(m_textureTarget, GL_TEXTURE_MAX_ANISOTROPY_EXT, Clamp(0.0f, 8.0f, maxAnisotropy));
+	}
+}
+
+void TextureData::InitCompressedTexture(const CompressedTexture& compressedTexture, GLfloat filter, bool clamp)
+{
+	//The mips were filtered offline, so nothing is generated here; each level
+	//is handed over the way it sits in the mapped file.
+	int firstMip;
+	int lastMip;
+	CalcMipRange(compressedTexture, filter, &firstMip, &lastMip);
+	m_width = compressedTexture.GetMipWidth(firstMip);
+	m_height = compressedTexture.GetMipHeight(firstMip);
+	
+	InitSampling(filter, clamp, lastMip - firstMip + 1);
+	for(int mip = firstMip; mip <= lastMip; mip++)
+	{
+		UploadCompressedMip(compressedTexture, mip, mip - firstMip);
+	}
+}
+
 void TextureData::InitRenderTargets(GLenum* attachments)
 {
 	if(attachments == 0)
@@ -178,6 +598,12 @@ void TextureData::InitRenderTargets(GLenum* attachments)
 
 void TextureData::Bind(int textureNum) const
 {
+	if(m_proxy)
+	{
+		m_proxy->m_textureData->Bind(0);
+		return;
+	}
+	
 	glBindTexture(m_textureTarget, m_textureID[textureNum]);
 }
 
@@ -198,6 +624,34 @@ void TextureData::BindCubeMapUnit(unsigned int unit, unsigned int mip_level) con
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + unit, m_textureID[0], mip_level);
 }
 
+void TextureData::CopyTo(const TextureData& dest, int x, int y, int destX, int destY, int width, int height, GLbitfield buffers) const
+{
+	assert(x + width <= m_width && y + height <= m_height && destX + width <= dest.m_width && destY + height <= dest.m_height);
+	dest.BindAsRenderTarget();
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_frameBuffer);
+	glBlitFramebuffer(x, y, x + width, y + height, destX, destY, destX + width, destY + height, buffers, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, dest.m_frameBuffer);
+}
+
+void TextureData::GetImage(GLenum image, int mipLevel, GLenum format, GLenum type, void* pixels) const
+{
+	glBindTexture(m_textureTarget, m_textureID[0]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(image, mipLevel, format, type, pixels);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+}
+
+void TextureData::SetImage(GLenum image, int mipLevel, GLenum format, GLenum type, const void* pixels) const
+{
+	int width = m_width >> mipLevel;
+	int height = m_height >> mipLevel;
+
+	glBindTexture(m_textureTarget, m_textureID[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(image, mipLevel, 0, 0, width > 0 ? width : 1, height > 0 ? height : 1, format, type, pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
 Texture::Texture(const std::string& fileName, GLenum textureTarget, GLfloat filter, GLenum internalFormat, GLenum format, GLenum type, bool clamp, GLenum attachment)
 {
  	m_fileName = fileName;
@@ -210,8 +664,21 @@ Texture::Texture(const std::string& fileName, GLenum textureTarget, GLfloat filt
 	}
 	else
 	{
+		//Cooked textures are mapped and uploaded with their mips as they
+		//are. Anything that hasn't been cooked is still decoded here.
+		bool isCooked = false;
+		if(textureTarget == GL_TEXTURE_2D && type == GL_UNSIGNED_BYTE && attachment == GL_NONE)
+		{
+			CompressedTexture compressedTexture("./res/textures/" + fileName + ".ktx");
+			if(compressedTexture.IsValid())
+			{
+				m_textureData = new TextureData(compressedTexture, filter, clamp);
+				isCooked = true;
+			}
+		}
+		
 		// load texture form file
-		if(textureTarget == GL_TEXTURE_2D)
+		if(textureTarget == GL_TEXTURE_2D && !isCooked)
 		{
 			int x, y, bytesPerPixel;
             void* data = NULL;
@@ -266,6 +733,23 @@ Texture::Texture(const std::string& fileName, GLenum textureTarget, GLfloat filt
 	}
 }
 
+Texture::Texture(const std::string& fileName, AsyncLoader* loader, GLfloat filter, bool clamp)
+{
+	m_fileName = fileName;
+
+	std::map<std::string, TextureData*>::const_iterator it = s_resourceMap.find(fileName);
+	if(it != s_resourceMap.end())
+	{
+		m_textureData = it->second;
+		m_textureData->AddReference();
+	}
+	else
+	{
+		m_textureData = new TextureData(fileName, loader, filter, clamp);
+		s_resourceMap.insert(std::pair<std::string, TextureData*>(fileName, m_textureData));
+	}
+}
+
 Texture::Texture(int width, int height, void* data, GLenum textureTarget, GLfloat filter, GLenum internalFormat, GLenum format, GLenum type, bool clamp, GLenum attachment)
 {
 	m_fileName = "";
@@ -314,3 +798,18 @@ void Texture::BindCubeMapUnit(unsigned int unit, unsigned int mip_level) const
 {
     m_textureData->BindCubeMapUnit(unit, mip_level);
 }
+
+void Texture::CopyTo(const Texture& dest, int x, int y, int destX, int destY, int width, int height, GLbitfield buffers) const
+{
+	m_textureData->CopyTo(*dest.m_textureData, x, y, destX, destY, width, height, buffers);
+}
+
+void Texture::GetImage(GLenum image, int mipLevel, GLenum format, GLenum type, void* pixels) const
+{
+	m_textureData->GetImage(image, mipLevel, format, type, pixels);
+}
+
+void Texture::SetImage(GLenum image, int mipLevel, GLenum format, GLenum type, const void* pixels) const
+{
+	m_textureData->SetImage(image, mipLevel, format, type, pixels);
+}
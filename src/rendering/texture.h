@@ -18,31 +18,52 @@
 #define TEXTURE_H
 
 #include "../core/referenceCounter.h"
+#include "../core/asyncLoader.h"
+#include "compressedTexture.h"
 #include <GL/glew.h>
 #include <string>
 #include <map>
 
+class Texture;
+class TextureStreamJob;
+
 class TextureData : public ReferenceCounter
 {
 public:
 	TextureData(GLenum textureTarget, int width, int height, int numTextures, void** data, GLfloat* filters, GLenum* internalFormat, GLenum* format, GLenum* type, bool clamp, GLenum* attachments);
+	//Uploads every mip level of a cooked texture as it is. Contexts that can't
+	//read its format get it decompressed instead.
+	TextureData(const CompressedTexture& compressedTexture, GLfloat filter, bool clamp);
+	//Queues the file to be streamed in by loader, and binds the default
+	//texture in its place until the first mip level has been uploaded.
+	TextureData(const std::string& fileName, AsyncLoader* loader, GLfloat filter, bool clamp);
 	
 	void Bind(int textureNum) const;
 	void BindAsRenderTarget() const;
     void BindCubeMapUnit(unsigned int unit, unsigned int mip_level) const;
+	void CopyTo(const TextureData& dest, int x, int y, int destX, int destY, int width, int height, GLbitfield buffers) const;
+	void GetImage(GLenum image, int mipLevel, GLenum format, GLenum type, void* pixels) const;
+	void SetImage(GLenum image, int mipLevel, GLenum format, GLenum type, const void* pixels) const;
 	
 	inline int GetWidth()  const { return m_width; }
 	inline int GetHeight() const { return m_height; }
+	inline bool IsStreaming() const { return m_streamJob != 0; }
 	
 	virtual ~TextureData();
 protected:	
 private:
+	friend class TextureStreamJob;
+
 	TextureData(TextureData& other) {}
 	void operator=(TextureData& other) {}
 
 	void InitTextures(void** data, GLfloat* filter, GLenum* internalFormat, GLenum* format, GLenum* type, bool clamp);
+	void InitSampling(GLfloat filter, bool clamp, int numMips);
+	void InitCompressedTexture(const CompressedTexture& compressedTexture, GLfloat filter, bool clamp);
 	void InitRenderTargets(GLenum* attachments);
 
+	Texture* m_proxy;                //Bound instead until enough has been streamed in to draw with
+	TextureStreamJob* m_streamJob;   //0 unless it's still being streamed in
 	GLuint* m_textureID;
 	GLenum m_textureTarget;
 	GLuint m_frameBuffer;
@@ -56,6 +77,10 @@ class Texture
 {
 public:
 	Texture(const std::string& fileName, GLenum textureTarget = GL_TEXTURE_2D, GLfloat filter = GL_LINEAR_MIPMAP_LINEAR, GLenum internalFormat = GL_RGBA, GLenum format = GL_RGBA, GLenum type = GL_UNSIGNED_BYTE, bool clamp = false, GLenum attachment = GL_NONE);
+	//Returns straight away, with the file loaded on loader's threads and
+	//uploaded a bit at a time by its Update. Only for 2D textures with 8 bits
+	//per channel, which are drawn as defaultTexture.png until then.
+	Texture(const std::string& fileName, AsyncLoader* loader, GLfloat filter = GL_LINEAR_MIPMAP_LINEAR, bool clamp = false);
 	Texture(int width = 0, int height = 0, void* data = 0, GLenum textureTarget = GL_TEXTURE_2D, GLfloat filter = GL_LINEAR_MIPMAP_LINEAR, GLenum internalFormat = GL_RGBA, GLenum format = GL_RGBA, GLenum type = GL_UNSIGNED_BYTE, bool clamp = false, GLenum attachment = GL_NONE);
 	Texture(const Texture& texture);
 	void operator=(Texture texture);
@@ -64,14 +89,27 @@ public:
 	void Bind(unsigned int unit = 0) const;	
 	void BindAsRenderTarget() const;
 	void BindCubeMapUnit(unsigned int unit, unsigned int mip_level = 0) const;
+	//Copies a rectangle of this render target into another one. buffers says
+	//what to copy, like GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT. Leaves dest
+	//bound as the render target.
+	void CopyTo(const Texture& dest, int x, int y, int destX, int destY, int width, int height, GLbitfield buffers) const;
+	//Reads one mip level of one image back from the GPU, or replaces what's in
+	//it. image is a cube map face, like GL_TEXTURE_CUBE_MAP_POSITIVE_X, or
+	//GL_TEXTURE_2D. Pixels are in format and type, as for glTexImage2D, with
+	//no padding between rows.
+	void GetImage(GLenum image, int mipLevel, GLenum format, GLenum type, void* pixels) const;
+	void SetImage(GLenum image, int mipLevel, GLenum format, GLenum type, const void* pixels) const;
 	
 	inline int GetWidth()  const { return m_textureData->GetWidth(); }
 	inline int GetHeight() const { return m_textureData->GetHeight(); }
+	inline bool IsStreaming() const { return m_textureData->IsStreaming(); }
 	
 	bool operator==(const Texture& texture) const { return m_textureData == texture.m_textureData; }
 	bool operator!=(const Texture& texture) const { return !operator==(texture); }
 protected:
 private:
+	friend class TextureData;
+
 	static std::map<std::string, TextureData*> s_resourceMap;
 
 	TextureData* m_textureData;
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "uniformBuffer.h"
+#include "lighting.h"
+
+#include <GL/glew.h>
+#include <cstring>
+
+UniformBuffer::UniformBuffer(const UniformBlockLayout& layout) :
+	m_layout(layout),
+	m_data(layout.GetSize() / sizeof(float), 0.0f),
+	m_isChanged(true)
+{
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, m_layout.GetSize(), 0, GL_DYNAMIC_DRAW);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	glDeleteBuffers(1, &m_buffer);
+}
+
+void UniformBuffer::SetFloat(int offset, float value)
+{
+	SetFloats(offset, &value, 1);
+}
+
+void UniformBuffer::SetVector3f(int offset, const Vector3f& value)
+{
+	float values[] = { value.GetX(), value.GetY(), value.GetZ() };
+	SetFloats(offset, values, 3);
+}
+
+void UniformBuffer::SetMatrix4f(int offset, const Matrix4f& value)
+{
+	//Both are column major, so the matrix can be copied as it is.
+	SetFloats(offset, &(value[0][0]), 16);
+}
+
+void UniformBuffer::SetDirectionalLight(const int* memberOffsets, const DirectionalLight& directionalLight)
+{
+	SetVector3f(memberOffsets[0], directionalLight.GetTransform().GetTransformedRot().GetForward());
+	SetVector3f(memberOffsets[1], directionalLight.GetColor());
+	SetFloat(memberOffsets[2], directionalLight.GetIntensity());
+}
+
+void UniformBuffer::SetPointLight(const int* memberOffsets, const PointLight& pointLight)
+{
+	SetVector3f(memberOffsets[0], pointLight.GetColor());
+	SetFloat(memberOffsets[1], pointLight.GetIntensity());
+	SetFloat(memberOffsets[2], pointLight.GetAttenuation().GetConstant());
+	SetFloat(memberOffsets[3], pointLight.GetAttenuation().GetLinear());
+	SetFloat(memberOffsets[4], pointLight.GetAttenuation().GetExponent());
+	SetVector3f(memberOffsets[5], pointLight.GetTransform().GetTransformedPos());
+	SetFloat(memberOffsets[6], pointLight.GetRange());
+}
+
+void UniformBuffer::SetSpotLight(const int* memberOffsets, const SpotLight& spotLight)
+{
+	SetPointLight(memberOffsets, spotLight);
+	SetVector3f(memberOffsets[7], spotLight.GetTransform().GetTransformedRot().GetForward());
+	SetFloat(memberOffsets[8], spotLight.GetCutoff());
+}
+
+void UniformBuffer::FindLightOffsets(const std::string& memberName, const std::string& lightType, int* memberOffsets) const
+{
+	const char* const* lightMembers = 0;
+	unsigned int numLightMembers = ShaderData::FindLightMembers(lightType, &lightMembers);
+
+	for(unsigned int i = 0; i < ShaderData::UniformBinding::MAX_MEMBERS; i++)
+	{
+		memberOffsets[i] = i < numLightMembers ? m_layout.GetOffset(memberName + lightMembers[i]) : -1;
+	}
+}
+
+void UniformBuffer::Bind() const
+{
+	if(m_isChanged)
+	{
+		//Replacing the whole buffer lets the driver give it new storage rather
+		//than waiting for draws still reading the old values.
+		glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+		glBufferData(GL_UNIFORM_BUFFER, m_layout.GetSize(), &m_data[0], GL_DYNAMIC_DRAW);
+		m_isChanged = false;
+	}
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, m_layout.GetBindingPoint(), m_buffer);
+}
+
+void UniformBuffer::SetFloats(int offset, const float* values, unsigned int numValues)
+{
+	if(offset < 0)
+	{
+		return;
+	}
+
+	memcpy(&m_data[offset / sizeof(float)], values, numValues * sizeof(float));
+	m_isChanged = true;
+}
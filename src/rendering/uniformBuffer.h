@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include "shader.h"
+
+#include <vector>
+#include <string>
+
+//The values of a uniform block, kept in a buffer that can be bound once for
+//every program using the block, rather than set on each program separately.
+//Values are set on the CPU copy, and uploaded the next time it's bound.
+class UniformBuffer
+{
+public:
+	UniformBuffer(const UniformBlockLayout& layout);
+	virtual ~UniformBuffer();
+
+	//Members the block doesn't have are ignored, so the same values can be set
+	//without knowing which of them the shader actually declared.
+	inline void SetFloat(const std::string& memberName, float value)              { SetFloat(m_layout.GetOffset(memberName), value); }
+	inline void SetVector3f(const std::string& memberName, const Vector3f& value) { SetVector3f(m_layout.GetOffset(memberName), value); }
+	inline void SetMatrix4f(const std::string& memberName, const Matrix4f& value) { SetMatrix4f(m_layout.GetOffset(memberName), value); }
+
+	//Values that are set every frame can be set by offset instead, found once
+	//with UniformBlockLayout::GetOffset. -1 is ignored like a missing member.
+	void SetFloat(int offset, float value);
+	void SetVector3f(int offset, const Vector3f& value);
+	void SetMatrix4f(int offset, const Matrix4f& value);
+
+	//memberOffsets are where each member of the light is, from FindLightOffsets.
+	void SetDirectionalLight(const int* memberOffsets, const DirectionalLight& value);
+	void SetPointLight(const int* memberOffsets, const PointLight& value);
+	void SetSpotLight(const int* memberOffsets, const SpotLight& value);
+	//memberOffsets needs room for ShaderData::UniformBinding::MAX_MEMBERS.
+	void FindLightOffsets(const std::string& memberName, const std::string& lightType, int* memberOffsets) const;
+
+	//Binds to the binding point of the block the buffer was made for.
+	void Bind() const;
+
+	inline const UniformBlockLayout& GetLayout() const { return m_layout; }
+protected:
+private:
+	UniformBlockLayout m_layout;
+	std::vector<float> m_data;      //Every member is 4 byte aligned
+	unsigned int       m_buffer;
+	mutable bool       m_isChanged; //Since it was last uploaded
+
+	void SetFloats(int offset, const float* values, unsigned int numValues);
+
+	UniformBuffer(const UniformBuffer& other) : m_layout(other.m_layout) {}
+	void operator=(const UniformBuffer& other) {}
+};
+
+#endif
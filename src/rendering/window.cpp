@@ -19,13 +19,141 @@
 #include <SDL2/SDL.h>
 #include <GL/glew.h>
 
-Window::Window(int width, int height, const std::string& title) :
+//Defined by the build when EGL was found
+#ifdef HAS_EGL
+	#include <EGL/egl.h>
+	#include <EGL/eglext.h>
+	#include <cstring>
+#endif
+
+static void InitGLEW(bool isHeadless)
+{
+	//Apparently this is necessary to build with Xcode
+	glewExperimental = GL_TRUE;
+	
+	GLenum res = glewInit();
+	
+	//GLEW may try to load GLX functions through a display that doesn't exist
+	//when headless, which it reports as an error, even though every OpenGL
+	//function the engine uses was loaded.
+	if(res != GLEW_OK && !(isHeadless && GLEW_VERSION_3_2))
+	{
+		fprintf(stderr, "Error: '%s'\n", glewGetErrorString(res));
+	}
+}
+
+#ifdef HAS_EGL
+static EGLDisplay GetHeadlessDisplay()
+{
+	//The surfaceless platform needs no display server or GPU at all, but it
+	//isn't always there, so the default display is tried as well.
+	const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if(clientExtensions && strstr(clientExtensions, "EGL_MESA_platform_surfaceless"))
+	{
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		
+		if(getPlatformDisplay)
+		{
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+			if(display != EGL_NO_DISPLAY && eglInitialize(display, 0, 0))
+			{
+				return display;
+			}
+		}
+	}
+	
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if(display != EGL_NO_DISPLAY && eglInitialize(display, 0, 0))
+	{
+		return display;
+	}
+	
+	return EGL_NO_DISPLAY;
+}
+#endif
+
+Window::Window(int width, int height, const std::string& title, bool isHeadless) :
 	m_width(width),
 	m_height(height),
 	m_title(title),
+	m_window(0),
+	m_glContext(0),
 	m_input(this),
-	m_isCloseRequested(false)
+	m_isCloseRequested(false),
+	m_isHeadless(isHeadless),
+	m_eglDisplay(0),
+	m_eglSurface(0),
+	m_eglContext(0)
 {
+	if(isHeadless)
+	{
+	#ifdef HAS_EGL
+		EGLDisplay display = GetHeadlessDisplay();
+		if(display == EGL_NO_DISPLAY || !eglBindAPI(EGL_OPENGL_API))
+		{
+			fprintf(stderr, "Error: No EGL display supports OpenGL\n");
+			exit(1);
+		}
+		
+		//Drawing goes to a pbuffer rather than a framebuffer object so it
+		//is still framebuffer 0, the same as drawing to a window.
+		const EGLint configAttribs[] =
+		{
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8,
+			EGL_GREEN_SIZE, 8,
+			EGL_BLUE_SIZE, 8,
+			EGL_ALPHA_SIZE, 8,
+			EGL_DEPTH_SIZE, 16,
+			EGL_NONE
+		};
+		
+		const EGLint surfaceAttribs[] =
+		{
+			EGL_WIDTH, width,
+			EGL_HEIGHT, height,
+			EGL_NONE
+		};
+		
+		const EGLint contextAttribs[] =
+		{
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 2,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		
+		EGLConfig config;
+		EGLint numConfigs = 0;
+		EGLSurface surface = EGL_NO_SURFACE;
+		EGLContext context = EGL_NO_CONTEXT;
+		
+		if(eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) && numConfigs > 0)
+		{
+			surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+			context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+		}
+		
+		if(surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context))
+		{
+			fprintf(stderr, "Error: Could not create a headless OpenGL 3.2 context (EGL error 0x%x)\n", eglGetError());
+			exit(1);
+		}
+		
+		m_eglDisplay = display;
+		m_eglSurface = surface;
+		m_eglContext = context;
+		
+		InitGLEW(true);
+		return;
+	#else
+		fprintf(stderr, "Error: Headless rendering needs EGL, which this build was made without\n");
+		exit(1);
+	#endif
+	}
+
 	SDL_Init(SDL_INIT_EVERYTHING);
 
 	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
@@ -49,18 +177,22 @@ Window::Window(int width, int height, const std::string& title) :
 	//SDL_SetHint(SDL_HINT_RENDER_VSYNC, "1");
 	SDL_GL_SetSwapInterval(1);
 
-	//Apparently this is necessary to build with Xcode
-	glewExperimental = GL_TRUE;
-	
-	GLenum res = glewInit();
-	if(res != GLEW_OK)
-	{
-		fprintf(stderr, "Error: '%s'\n", glewGetErrorString(res));
-	}
+	InitGLEW(false);
 }
 
 Window::~Window()
 {
+	if(m_isHeadless)
+	{
+	#ifdef HAS_EGL
+		eglMakeCurrent(m_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(m_eglDisplay, m_eglContext);
+		eglDestroySurface(m_eglDisplay, m_eglSurface);
+		eglTerminate(m_eglDisplay);
+	#endif
+		return;
+	}
+
 	SDL_GL_DeleteContext(m_glContext);
 	SDL_DestroyWindow(m_window);
 	SDL_Quit();
@@ -80,6 +212,12 @@ void Window::Update()
 		m_input.SetKeyUp(i, false);
 	}
 
+	//There's nothing to send events when headless
+	if(m_isHeadless)
+	{
+		return;
+	}
+
 	SDL_Event e;
 	while(SDL_PollEvent(&e))
 	{
@@ -127,6 +265,14 @@ void Window::Update()
 
 void Window::SwapBuffers()
 {
+	if(m_isHeadless)
+	{
+	#ifdef HAS_EGL
+		eglSwapBuffers(m_eglDisplay, m_eglSurface);
+	#endif
+		return;
+	}
+
 	SDL_GL_SwapWindow(m_window);
 }
 
@@ -142,8 +288,22 @@ void Window::BindAsRenderTarget() const
 	#endif
 }
 
+void Window::ReadPixels(std::vector<unsigned char>* pixels) const
+{
+	pixels->resize(m_width * m_height * 4);
+	
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, &(*pixels)[0]);
+}
+
 void Window::SetFullScreen(bool value)
 {
+	if(m_isHeadless)
+	{
+		return;
+	}
+
 	int mode = 0;
 	if(value)
 		mode = SDL_WINDOW_FULLSCREEN;
@@ -19,19 +19,28 @@
 
 #include <SDL2/SDL.h>
 #include <string>
+#include <vector>
 #include "../core/input.h"
 
 class Window
 {
 public:
-	Window(int width, int height, const std::string& title);
+	//A headless window has no window on screen, and needs no display server.
+	//It draws into an offscreen surface through EGL, so the engine can be
+	//benchmarked on machines without a GPU, using a software renderer such as
+	//llvmpipe. Exits if headless rendering isn't available.
+	Window(int width, int height, const std::string& title, bool isHeadless = false);
 	virtual ~Window();
 	
 	void Update();
 	void SwapBuffers();
 	void BindAsRenderTarget() const;
+	//Reads back the last frame drawn to the window, as rows of RGBA bytes
+	//starting from the bottom. Stalls until the GPU has finished drawing it.
+	void ReadPixels(std::vector<unsigned char>* pixels) const;
 
 	inline bool IsCloseRequested()          const { return m_isCloseRequested; }
+	inline bool IsHeadless()                const { return m_isHeadless; }
 	inline int GetWidth()                   const { return m_width; }
 	inline int GetHeight()                  const { return m_height; }
 	inline float GetAspect()                const { return (float)m_width/(float)m_height; }
@@ -50,6 +59,10 @@ private:
 	SDL_GLContext m_glContext;
 	Input         m_input;
 	bool          m_isCloseRequested;
+	bool          m_isHeadless;
+	void*         m_eglDisplay;       //These are only used when headless, and are
+	void*         m_eglSurface;       //stored untyped so EGL's headers aren't needed
+	void*         m_eglContext;       //everywhere this one is included.
 	
 	Window(const Window& other) : m_input(this) {}
 	void operator=(const Window& other) {}
@@ -103,7 +103,7 @@ public:
 	//Bit 2/3: Which element goes to slot 2
 	//Bit 4/5: Which element goes to slot 3
 	//Bit 6/7: Which element goes to slot 4
-	inline SIMD4i Shuffle(int8_t shuffleByte)
+	inline SIMD4i Shuffle(int8_t shuffleByte) const
 	{
 		int index0 = (shuffleByte)      & 3;
 		int index1 = (shuffleByte >> 2) & 3;
@@ -414,7 +414,7 @@ public:
 	//Bit 2/3: Which element goes to slot 2
 	//Bit 4/5: Which element goes to slot 3
 	//Bit 6/7: Which element goes to slot 4
-	inline SIMD4f Shuffle(int8_t shuffleByte)
+	inline SIMD4f Shuffle(int8_t shuffleByte) const
 	{
 		int index0 = (shuffleByte)      & 3;
 		int index1 = (shuffleByte >> 2) & 3;
@@ -519,6 +519,21 @@ public:
 		return SIMD4f(result);
 	}
 	
+	//Returns a 4 bit mask with bit i set if element i has its sign bit set.
+	//Useful for checking the results of comparisons.
+	inline int GetSignMask() const
+	{
+		int result = 0;
+		for(int i = 0; i < 4; i++)
+		{
+			if(m_data[i] < 0.0f)
+			{
+				result |= (1 << i);
+			}
+		}
+		return result;
+	}
+	
 	inline SIMD4f Sqrt() const
 	{
 		float result[4];
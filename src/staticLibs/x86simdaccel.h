@@ -56,7 +56,7 @@ public:
 	inline SIMD4i Pick(const SIMD4i& sourceIfTrue, const SIMD4i& sourceIfFalse)
 	{
 		#if SIMD_SUPPORTED_LEVEL >= SIMD_LEVEL_x86_SSE4_1
-			return SIMD4i(_mm_blendv_epi8((*this), sourceIfTrue, sourceIfFalse));
+			return SIMD4i(_mm_blendv_epi8(sourceIfFalse, sourceIfTrue, (*this)));
 		#else
 			return ((*this) & sourceIfTrue) | (this->AndNot(sourceIfFalse));
 		#endif
@@ -72,7 +72,7 @@ public:
 	//Bit 2/3: Which element goes to slot 2
 	//Bit 4/5: Which element goes to slot 3
 	//Bit 6/7: Which element goes to slot 4
-	inline SIMD4i Shuffle(int8_t shuffleByte)
+	inline SIMD4i Shuffle(int8_t shuffleByte) const
 	{
 		return SIMD4i(_mm_shuffle_epi32(m_data, shuffleByte));
 	}
@@ -80,7 +80,7 @@ public:
 	inline int32_t HorizontalAdd()
 	{
 		#if  SIMD_SUPPORTED_LEVEL >= SIMD_LEVEL_x86_SSSE3
-			SIMD4i temp1 = SIMD4i(_mm_hadd_epi32(m_data, other.m_data));
+			SIMD4i temp1 = SIMD4i(_mm_hadd_epi32(m_data, m_data));
 			SIMD4i temp2 = SIMD4i(_mm_hadd_epi32(temp1, temp1));
 			return _mm_cvtsi128_si32(temp2);
 		#else
@@ -233,6 +233,13 @@ public:
 		return SIMD4f(_mm_andnot_ps(m_data, other.m_data));
 	}
 	
+	//Returns a 4 bit mask with bit i set if element i has its sign bit set.
+	//Useful for checking the results of comparisons.
+	inline int GetSignMask() const
+	{
+		return _mm_movemask_ps(m_data);
+	}
+	
 	inline SIMD4f Max(const SIMD4f& other) const
 	{
 		return SIMD4f(_mm_max_ps(m_data, other.m_data));
@@ -246,7 +253,7 @@ public:
 	inline SIMD4f Pick(const SIMD4f& sourceIfTrue, const SIMD4f& sourceIfFalse)
 	{
 		#if SIMD_SUPPORTED_LEVEL >= SIMD_LEVEL_x86_SSE4_1
-			return SIMD4f(_mm_blendv_ps((*this), sourceIfTrue, sourceIfFalse));
+			return SIMD4f(_mm_blendv_ps(sourceIfFalse, sourceIfTrue, (*this)));
 		#else
 			return ((*this) & sourceIfTrue) | (this->AndNot(sourceIfFalse));
 		#endif
@@ -262,7 +269,7 @@ public:
 	//Bit 2/3: Which element goes to slot 2
 	//Bit 4/5: Which element goes to slot 3
 	//Bit 6/7: Which element goes to slot 4
-	inline SIMD4f Shuffle(int8_t shuffleByte)
+	inline SIMD4f Shuffle(int8_t shuffleByte) const
 	{
 		return SIMD4f(_mm_shuffle_ps(m_data, m_data, shuffleByte));
 	}
@@ -4,6 +4,25 @@
 #include "physics/aabb.h"
 #include "physics/plane.h"
 #include "physics/physicsObject.h"
+#include "physics/broadphase.h"
+#include "physics/physicsBodyStore.h"
+#include "physics/physicsEngine.h"
+#include "rendering/boundingVolumeHierarchy.h"
+#include "rendering/camera.h"
+#include "rendering/lighting.h"
+#include "rendering/renderQueue.h"
+#include "rendering/shader.h"
+#include "rendering/lightClusters.h"
+#include "rendering/shadowAtlas.h"
+#include "rendering/environmentBaker.h"
+#include "rendering/occlusionCuller.h"
+#include "rendering/potentiallyVisibleSet.h"
+#include "rendering/packedMesh.h"
+#include "rendering/meshOptimizer.h"
+#include "rendering/objReader.h"
+#include "rendering/compressedTexture.h"
+#include "core/asyncLoader.h"
+#include "core/profiling.h"
 
 #include <iostream>
 #include <cassert>
@@ -14,6 +33,26 @@ void Testing::RunAllTests()
 	AABB::Test();
 	Plane::Test();
 	PhysicsObject::Test();
+	Broadphase::Test();
+	PhysicsBodyStore::Test();
+	PhysicsEngine::Test();
+	BoundingVolumeHierarchy::Test();
+	Camera::Test();
+	DirectionalLight::Test();
+	RenderQueue::Test();
+	UniformBlockLayout::Test();
+	ShaderData::Test();
+	LightClusters::Test();
+	ShadowAtlas::Test();
+	EnvironmentBaker::Test();
+	OcclusionCuller::Test();
+	PotentiallyVisibleSet::Test();
+	PackedMesh::Test();
+	MeshOptimizer::Test();
+	ObjReader::Test();
+	CompressedTexture::Test();
+	AsyncLoader::Test();
+	Profiler::Test();
 }
 
 
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//Converts any model Assimp can read into the .mesh files the engine maps at
+//runtime, optimizing it on the way. This is the only part of the engine that
+//needs Assimp. OBJ files are read with ObjReader instead, which is much
+//faster and keeps every object in the file rather than just the first.
+//
+//Usage: meshConverter [--float-vertices] [--assimp] [--compare-assimp] <model file> [output file]
+//The output file defaults to the model file with .mesh added to the end.
+//--assimp reads OBJ files with Assimp too. --compare-assimp reads an OBJ file
+//both ways instead of converting it, and fails unless the first object comes
+//out the same once welded. The build adds it as a test for every bundled
+//model.
+
+#include "../src/rendering/indexedModel.h"
+#include "../src/rendering/meshOptimizer.h"
+#include "../src/rendering/objReader.h"
+#include "../src/rendering/packedMesh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+static bool LoadModel(const std::string& fileName, IndexedModel* result)
+{
+	Assimp::Importer importer;
+	
+	const aiScene* scene = importer.ReadFile(fileName.c_str(),
+	                                         aiProcess_Triangulate |
+	                                         aiProcess_GenSmoothNormals | 
+	                                         aiProcess_FlipUVs |
+	                                         aiProcess_CalcTangentSpace);
+	
+	if(!scene || scene->mNumMeshes == 0)
+	{
+		std::cout << "Mesh load failed!: " << fileName << std::endl;
+		return false;
+	}
+	
+	const aiMesh* model = scene->mMeshes[0];
+	
+	std::vector<Vector3f> positions;
+	std::vector<Vector2f> texCoords;
+	std::vector<Vector3f> normals;
+	std::vector<Vector3f> tangents;
+	std::vector<unsigned int> indices;
+
+	const aiVector3D aiZeroVector(0.0f, 0.0f, 0.0f);
+	for(unsigned int i = 0; i < model->mNumVertices; i++) 
+	{
+		const aiVector3D pos = model->mVertices[i];
+		const aiVector3D normal = model->mNormals[i];
+		const aiVector3D texCoord = model->HasTextureCoords(0) ? model->mTextureCoords[0][i] : aiZeroVector;
+		const aiVector3D tangent = model->HasTangentsAndBitangents() ? model->mTangents[i] : aiZeroVector;
+
+		positions.push_back(Vector3f(pos.x, pos.y, pos.z));
+		texCoords.push_back(Vector2f(texCoord.x, texCoord.y));
+		normals.push_back(Vector3f(normal.x, normal.y, normal.z));
+		tangents.push_back(Vector3f(tangent.x, tangent.y, tangent.z));
+	}
+
+	for(unsigned int i = 0; i < model->mNumFaces; i++)
+	{
+		const aiFace& face = model->mFaces[i];
+		assert(face.mNumIndices == 3);
+		indices.push_back(face.mIndices[0]);
+		indices.push_back(face.mIndices[1]);
+		indices.push_back(face.mIndices[2]);
+	}
+
+	*result = IndexedModel(indices, positions, texCoords, normals, tangents);
+	return true;
+}
+
+static bool IsObjFile(const std::string& fileName)
+{
+	std::string extension = fileName.substr(std::min(fileName.size(), fileName.rfind('.') + 1));
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == "obj";
+}
+
+//The triangles from firstIndex to firstIndex + numIndices, with identical
+//vertices welded together and numbered in the order the triangles first use
+//them, so models read different ways can be compared index by index.
+//Tangents are left out, since they're averaged differently.
+static IndexedModel CalcWeldedModel(const IndexedModel& model, unsigned int firstIndex, unsigned int numIndices)
+{
+	std::vector<unsigned int> indices(model.GetIndices().begin() + firstIndex, model.GetIndices().begin() + firstIndex + numIndices);
+	IndexedModel welded(indices, model.GetPositions(), model.GetTexCoords(), model.GetNormals());
+	MeshOptimizer::WeldVertices(&welded);
+
+	const unsigned int NO_VERTEX = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(welded.GetPositions().size(), NO_VERTEX);
+	std::vector<unsigned int> orderedIndices(welded.GetIndices().size());
+	std::vector<Vector3f> positions;
+	std::vector<Vector2f> texCoords;
+	std::vector<Vector3f> normals;
+	for(unsigned int i = 0; i < welded.GetIndices().size(); i++)
+	{
+		unsigned int vertex = welded.GetIndices()[i];
+		if(remap[vertex] == NO_VERTEX)
+		{
+			remap[vertex] = (unsigned int)positions.size();
+			positions.push_back(welded.GetPositions()[vertex]);
+			texCoords.push_back(vertex < welded.GetTexCoords().size() ? welded.GetTexCoords()[vertex] : Vector2f(0.0f, 0.0f));
+			normals.push_back(vertex < welded.GetNormals().size() ? welded.GetNormals()[vertex] : Vector3f(0.0f, 0.0f, 0.0f));
+		}
+		orderedIndices[i] = remap[vertex];
+	}
+
+	return IndexedModel(orderedIndices, positions, texCoords, normals);
+}
+
+//Whether the first of ObjReader's groups, once welded, has the same vertices
+//and indices as Assimp's first mesh welded the same way. Assimp's float
+//parsing is slightly less exact, hence the tolerance.
+static bool IsSameAsAssimp(const IndexedModel& objModel, const std::vector<ObjReader::Group>& groups, const IndexedModel& assimpModel)
+{
+	unsigned int numIndices = groups.empty() ? 0 : groups[0].numIndices;
+	if(numIndices != assimpModel.GetIndices().size())
+	{
+		std::cout << "ObjReader read " << numIndices / 3 << " triangles, Assimp " << assimpModel.GetIndices().size() / 3 << std::endl;
+		return false;
+	}
+
+	IndexedModel objWelded = CalcWeldedModel(objModel, groups[0].firstIndex, numIndices);
+	IndexedModel assimpWelded = CalcWeldedModel(assimpModel, 0, numIndices);
+	if(objWelded.GetPositions().size() != assimpWelded.GetPositions().size() || objWelded.GetIndices() != assimpWelded.GetIndices())
+	{
+		std::cout << "ObjReader welded to " << objWelded.GetPositions().size() << " vertices, Assimp " <<
+			assimpWelded.GetPositions().size() << ", with different indices" << std::endl;
+		return false;
+	}
+
+	const float tolerance = 1e-5f;
+	unsigned int numVertices = (unsigned int)objWelded.GetPositions().size();
+	unsigned int numDifferent = 0;
+	for(unsigned int i = 0; i < numVertices; i++)
+	{
+		Vector3f position = objWelded.GetPositions()[i] - assimpWelded.GetPositions()[i];
+		Vector2f texCoord = objWelded.GetTexCoords()[i] - assimpWelded.GetTexCoords()[i];
+		float normalDot = objWelded.GetNormals()[i].Normalized().Dot(assimpWelded.GetNormals()[i].Normalized());
+		if(position.Length() > tolerance * std::max(1.0f, assimpWelded.GetPositions()[i].Length()) ||
+			texCoord.Length() > tolerance || normalDot < 1.0f - tolerance)
+		{
+			numDifferent++;
+		}
+	}
+
+	std::cout << numVertices - numDifferent << " of " << numVertices << " welded vertices match Assimp" << std::endl;
+	return numDifferent == 0;
+}
+
+int main(int argc, char** argv)
+{
+	VertexFormat vertexFormat = VERTEX_FORMAT_PACKED;
+	bool useAssimp = false;
+	bool compareWithAssimp = false;
+	std::vector<std::string> fileNames;
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--float-vertices") == 0)
+		{
+			vertexFormat = VERTEX_FORMAT_FLOAT;
+		}
+		else if(strcmp(argv[i], "--assimp") == 0)
+		{
+			useAssimp = true;
+		}
+		else if(strcmp(argv[i], "--compare-assimp") == 0)
+		{
+			compareWithAssimp = true;
+		}
+		else
+		{
+			fileNames.push_back(argv[i]);
+		}
+	}
+
+	//Only OBJ files read with ObjReader can be compared.
+	if(fileNames.empty() || fileNames.size() > 2 || (compareWithAssimp && (useAssimp || !IsObjFile(fileNames[0]))))
+	{
+		std::cout << "Usage: meshConverter [--float-vertices] [--assimp] [--compare-assimp] <model file> [output file]" << std::endl;
+		return 1;
+	}
+
+	std::string outputFileName = fileNames.size() > 1 ? fileNames[1] : fileNames[0] + ".mesh";
+	IndexedModel model;
+	if(IsObjFile(fileNames[0]) && !useAssimp)
+	{
+		unsigned int numThreads = ThreadPool::GetNumCPUs();
+		ThreadPool* threadPool = numThreads > 1 ? new ThreadPool(numThreads) : 0;
+		std::vector<ObjReader::Group> groups;
+		bool isLoaded = ObjReader::Load(fileNames[0], &model, &groups, threadPool);
+		delete threadPool;
+		if(!isLoaded)
+		{
+			std::cout << "Mesh load failed!: " << fileNames[0] << std::endl;
+			return 1;
+		}
+
+		if(compareWithAssimp)
+		{
+			IndexedModel assimpModel;
+			return LoadModel(fileNames[0], &assimpModel) && IsSameAsAssimp(model, groups, assimpModel) ? 0 : 1;
+		}
+	}
+	else if(!LoadModel(fileNames[0], &model))
+	{
+		return 1;
+	}
+
+	MeshOptimizer::Report report = MeshOptimizer::Optimize(&model);
+	std::cout << "Optimized " << fileNames[0] << ": " << report.numVerticesBefore << " -> " << report.numVerticesAfter
+		<< " vertices, ACMR " << report.acmrBefore << " -> " << report.acmrAfter << std::endl;
+
+	//Always written with 10 bit directions. The engine widens them itself on
+	//the rare context that can't read those.
+	PackedMesh packedMesh(model, vertexFormat, true);
+	if(!packedMesh.IsValid() || !packedMesh.Save(outputFileName))
+	{
+		std::cout << "Error: Couldn't write " << outputFileName << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2014 Benny Bobaganoosh
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+//Cooks images into the block compressed .ktx files the engine maps at
+//runtime. Every mip level is filtered here rather than by the driver.
+//
+//Usage: textureCooker [--normal|--data] [--bc1|--bc3|--bc5] [--clamp] <image file> [output file]
+//The output file defaults to the image file with .ktx added to the end.
+//Images are taken to be sRGB colour, and their mips are filtered in linear
+//light. --normal is for normal maps, which have their mips renormalized, and
+//--data for anything else that isn't colour, which is filtered as it's stored.
+//Without a format, normal maps become BC5, images with any transparency BC3,
+//and the rest BC1. --clamp filters the mips without wrapping around the edges.
+
+#include "../src/rendering/compressedTexture.h"
+#include "../src/core/threadPool.h"
+#include "../src/staticLibs/stb_image.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static bool HasTransparency(const unsigned char* pixels, int numPixels)
+{
+	for(int i = 0; i < numPixels; i++)
+	{
+		if(pixels[i * 4 + 3] != 255)
+			return true;
+	}
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	int compression = -1;
+	TextureContent content = TEXTURE_CONTENT_COLOR;
+	bool isWrapped = true;
+	std::vector<std::string> fileNames;
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--normal") == 0)
+		{
+			content = TEXTURE_CONTENT_NORMAL;
+		}
+		else if(strcmp(argv[i], "--data") == 0)
+		{
+			content = TEXTURE_CONTENT_DATA;
+		}
+		else if(strcmp(argv[i], "--bc1") == 0)
+		{
+			compression = TEXTURE_COMPRESSION_BC1;
+		}
+		else if(strcmp(argv[i], "--bc3") == 0)
+		{
+			compression = TEXTURE_COMPRESSION_BC3;
+		}
+		else if(strcmp(argv[i], "--bc5") == 0)
+		{
+			compression = TEXTURE_COMPRESSION_BC5;
+		}
+		else if(strcmp(argv[i], "--clamp") == 0)
+		{
+			isWrapped = false;
+		}
+		else
+		{
+			fileNames.push_back(argv[i]);
+		}
+	}
+
+	if(fileNames.empty() || fileNames.size() > 2)
+	{
+		std::cout << "Usage: textureCooker [--normal|--data] [--bc1|--bc3|--bc5] [--clamp] <image file> [output file]" << std::endl;
+		return 1;
+	}
+
+	std::string outputFileName = fileNames.size() > 1 ? fileNames[1] : fileNames[0] + ".ktx";
+	int width, height, numComponents;
+	unsigned char* pixels = stbi_load(fileNames[0].c_str(), &width, &height, &numComponents, 4);
+	if(pixels == NULL)
+	{
+		std::cout << "Unable to load texture: " << fileNames[0] << std::endl;
+		return 1;
+	}
+
+	if(compression == -1)
+	{
+		if(content == TEXTURE_CONTENT_NORMAL)
+			compression = TEXTURE_COMPRESSION_BC5;
+		else if(HasTransparency(pixels, width * height))
+			compression = TEXTURE_COMPRESSION_BC3;
+		else
+			compression = TEXTURE_COMPRESSION_BC1;
+	}
+
+	unsigned int numThreads = ThreadPool::GetNumCPUs();
+	ThreadPool* threadPool = numThreads > 1 ? new ThreadPool(numThreads) : 0;
+	CompressedTexture compressedTexture(pixels, width, height, (TextureCompression)compression,
+		content, isWrapped, threadPool);
+	delete threadPool;
+	stbi_image_free(pixels);
+
+	const char* formatNames[] = { "BC1", "BC3", "BC5" };
+	std::cout << "Cooked " << fileNames[0] << ": " << width << "x" << height << " " << formatNames[compression]
+		<< ", " << compressedTexture.GetNumMips() << " mips" << std::endl;
+
+	if(!compressedTexture.IsValid() || !compressedTexture.Save(outputFileName))
+	{
+		std::cout << "Error: Couldn't write " << outputFileName << std::endl;
+		return 1;
+	}
+	return 0;
+}